@@ -0,0 +1,98 @@
+/**
+ * @file        : adc_scan.h
+ * @brief       : Сканирование списка каналов АЦП с записью кадров в кольцевой буфер DMA.
+ * @author      : xmatech
+ * @date        : 19.03.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ *
+ * @Description : АЦП в режиме сканирования (SCAN) преобразует регулярную последовательность до 16 каналов (SQR1..SQR3),
+ *                время выборки задаётся для каждого канала (SMPR1 - каналы 10..18, SMPR2 - 0..9). Режим CONT,
+ *                запросы DMA после каждого преобразования (DMA = DDS = 1). Поток DMA в циклическом режиме пишет отсчёты
+ *                подряд, поэтому кольцо - массив кадров с постоянным шагом n * 2 байт: кадр - структура из n полей
+ *                uint16_t в порядке списка каналов (проверка - ADC_SCAN_FRAME_CHECK()).
+ *                - Прерывания потока - HT и TC: callback-функция получает заполненную половину кольца (frames / 2
+ *                  кадров), вторую половину DMA в это время заполняет. Одно прерывание на frames / 2 * n отсчётов.
+ *                - Поток выдаёт dma_mgr_claim() по запросу АЦП и запускает dma_mgr_start(): ошибку потока (TE/DME)
+ *                  исправляет dma_mgr.c, переполнение АЦП (OVR) - adc_scan_irq(). В обоих случаях последовательность
+ *                  начинается с первого канала в первом кадре кольца - поля кадра не сдвигаются.
+ *                Кольцо должно быть доступно DMA (не CCM RAM).
+ */
+
+#ifndef ADC_SCAN_H
+#define ADC_SCAN_H
+
+#include <stm32f4xx.h>
+#include "dma_mgr.h"
+
+#define ADC_SCAN_MAX 16 // Каналов в последовательности (SQ1..SQ16)
+
+#ifndef ADC_SCAN_ADCPRE
+#define ADC_SCAN_ADCPRE 3 // Делитель АЦП (общий для ADC1..3): PCLK2 / 8 = 10,5 МГц (не более 36 МГц)
+#endif
+
+#ifndef ADC_SCAN_REARM_MAX
+#define ADC_SCAN_REARM_MAX 8 // Перезапусков потока подряд в прерывании; дальше - из основного цикла (adc_scan_poll())
+#endif
+
+// Время выборки (код SMPx), циклов АЦП; преобразование - ещё 12 циклов
+#define ADC_SMP_3   0
+#define ADC_SMP_15  1
+#define ADC_SMP_28  2
+#define ADC_SMP_56  3
+#define ADC_SMP_84  4
+#define ADC_SMP_112 5
+#define ADC_SMP_144 6 // Датчик температуры и VREFINT: выборка не менее 10 мкс (144 цикла при 10,5 МГц)
+#define ADC_SMP_480 7
+
+// Внутренние каналы (только ADC1)
+#define ADC_SCAN_TEMP  16 // Датчик температуры
+#define ADC_SCAN_VREF  17 // VREFINT
+#define ADC_SCAN_VBAT  18 // VBAT / 2
+
+// Проверка шага кадра: структура кадра - n полей uint16_t без выравнивания между ними
+#define ADC_SCAN_FRAME_CHECK(type, n) _Static_assert(sizeof(type) == (n) * sizeof(uint16_t), "adc_scan: шаг кадра")
+
+// Канал последовательности
+typedef struct {
+    uint8_t ch;  // Канал ADCx_INn: 0..15 - выводы, ADC_SCAN_TEMP/VREF/VBAT
+    uint8_t smp; // Время выборки ADC_SMP_*
+} adc_scan_ch_t;
+
+// Заполнена половина кольца: frames - первый кадр половины, count - кадров (прерывание потока)
+typedef void (*adc_scan_cb_t)(void *ctx, const void *frames, uint16_t count);
+
+// Настройка сканирования (хранится вызывающей стороной до остановки)
+typedef struct {
+    ADC_TypeDef         *adc;    // ADC1, ADC2 или ADC3
+    const adc_scan_ch_t *list;   // Каналы в порядке преобразования (= порядок полей кадра)
+    uint8_t              n;      // Каналов, 1..ADC_SCAN_MAX
+    void                *ring;   // Кольцо кадров, frames * n отсчётов
+    uint16_t             frames; // Кадров в кольце, чётное; frames * n не более 65535 (NDTR)
+    adc_scan_cb_t        cb;     // Может быть 0 - кадры читаются adc_scan_last()
+    void                *ctx;
+    uint8_t              prio;   // Приоритет прерываний потока и ADC_IRQn
+} adc_scan_cfg_t;
+
+// Статистика
+typedef struct {
+    uint32_t halves; // Заполнено половин кольца
+    uint32_t ovr;    // Переполнений АЦП (OVR)
+    uint32_t rearms; // Перезапусков после ошибки потока (DMA_MGR_REARM)
+    uint32_t polls;  // Перезапусков из основного цикла после DMA_MGR_FAIL
+} adc_scan_stats_t;
+
+// Сканирование на одном АЦП
+typedef struct {
+    const adc_scan_cfg_t *cfg;
+    DMA_Stream_TypeDef   *dma;   // Поток запроса АЦП (dma_mgr.c), 0 - не запущено
+    adc_scan_stats_t      stats;
+} adc_scan_t;
+
+uint8_t     adc_scan_init(adc_scan_t *scan, const adc_scan_cfg_t *cfg); // Настройка АЦП и потока, запуск; 0 - ошибка
+void        adc_scan_irq(adc_scan_t *scan);                            // Из ADC_IRQHandler(): переполнение (OVR)
+void        adc_scan_poll(adc_scan_t *scan);                           // Из основного цикла: перезапуск после DMA_MGR_FAIL
+const void *adc_scan_last(const adc_scan_t *scan);                     // Последний полностью записанный кадр
+
+#endif // ADC_SCAN_H
@@ -8,18 +8,48 @@
  * @IDE         : Segger Embedded Studio
  *
  * @Description : Заголовочный файл содержит прототипы функций для настройки тактирования, инициализации таймера TIM1,
- *                инициализации ADC1, настройки DMA2 Stream 0 и обработчика прерывания DMA2 Stream 0.
+ *                сканирования каналов ADC1 (adc_scan.c, поток DMA - dma_mgr.c) и формат кадров сканирования и журнала
+ *                измерений во внешней памяти W25Q64.
+ *                Восстановление после сбоев: ошибку потока (TE/DME) dma_mgr.c исправляет перезапуском потока с исходной
+ *                настройкой, переполнение ADC1 (OVR - отсчёт не забран DMA) - adc_scan_irq() из ADC_IRQHandler(). В обоих
+ *                случаях сканирование начинается с первого кадра кольца, усреднение и ШИМ продолжаются.
  */
 
 #include <stm32f4xx.h>
+#include "dma_mgr.h"
+#include "adc_scan.h"
+
+#define ADC_DMA_IRQ_PRIO  0 // Приоритет прерываний потока ADC1 и ADC (обновление ШИМ - без задержки за SPI2 и TIM7)
+
+// Кадр сканирования ADC1: поля - в порядке adc1_list[] (main.c), шаг кольца - sizeof(adc_frame_t)
+typedef struct {
+  uint16_t pot;   // PA5 (ADC1_IN5), потенциометр; выборка 84 цикла
+  uint16_t vref;  // VREFINT (ADC1_IN17); выборка 144 цикла
+  uint16_t temp;  // Датчик температуры (ADC1_IN16); выборка 144 цикла
+} adc_frame_t;
+
+#define ADC_CHANNELS 3  // Полей adc_frame_t
+#define ADC_FRAMES   16 // Кадров в кольце: прерывание потока на каждые 8 кадров
+
+extern adc_scan_t adc1_scan;
+
+/* Журнал измерений во внешней памяти W25Q64 */
+// Кадр сканирования: АЦП 10,5 МГц / ((84 + 12) + 2 * (144 + 12)) циклов = 25,7 кГц, по 8 кадров -> 3,22 кГц;
+// / 3 -> ~1,07 кГц
+#define LOG_DECIM 3
+
+// Кадр журнала
+typedef struct {
+  uint32_t index; // Номер кадра с момента включения
+  uint16_t adc;   // Усреднённое значение АЦП (PA5)
+  uint16_t pwm;   // Значение TIM1->CCR3
+} log_frame_t;
 
 
 /* Прототипы функций */ 
 void rcc_init(void);   // Настройка тактирования
 void tim1_init(void);  // Инициализация TIM1
-void adc1_init(void); // Инициализация ADC1
-void DMA2_Stream0_Init(void); // Инициализация DMA2 Stream 0
-void DMA2_Stream0_IRQHandler(void);
+void adc1_init(void); // Сканирование ADC1 (adc_scan.c, поток DMA2 Stream0 или Stream4)
 
 
 
@@ -0,0 +1,236 @@
+/**
+ * @file        : adc_scan.c
+ * @brief       : Сканирование списка каналов АЦП с записью кадров в кольцевой буфер DMA.
+ * @author      : xmatech
+ * @date        : 19.03.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ *
+ * @Description : Ранг i последовательности: SQR3 - ранги 1..6, SQR2 - 7..12, SQR1 - 13..16 (по 5 бит), длина - SQR1.L.
+ *                Время выборки задаётся для канала, а не для ранга: SMPR2 - каналы 0..9, SMPR1 - 10..18 (по 3 бита).
+ *                Выводы каналов (корпус LQFP100): ADC1/ADC2 IN0..7 - PA0..PA7, IN8..9 - PB0..PB1, IN10..15 - PC0..PC5;
+ *                у ADC3 на этом корпусе только IN0..3 (PA0..PA3) и IN10..13 (PC0..PC3), остальные входы - порт F.
+ *                Перезапуск после ошибки (adc_scan_restart()) выключает АЦП (ADON = 0): незаконченная последовательность
+ *                сбрасывается, следующий отсчёт - первый канал списка, его DMA пишет в начало кольца.
+ */
+
+#include "adc_scan.h"
+
+#define ADC_SCAN_NOPIN 0xFF
+
+// Вывод канала 0..15: (порт << 4) | номер вывода, порт 0 - GPIOA
+static const uint8_t adc_scan_pin12[16] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x10, 0x11, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25
+};
+static const uint8_t adc_scan_pin3[16] = {
+    0x00, 0x01, 0x02, 0x03, ADC_SCAN_NOPIN, ADC_SCAN_NOPIN, ADC_SCAN_NOPIN, ADC_SCAN_NOPIN,
+    ADC_SCAN_NOPIN, ADC_SCAN_NOPIN, 0x20, 0x21, 0x22, 0x23, ADC_SCAN_NOPIN, ADC_SCAN_NOPIN
+};
+
+/**
+ * @brief Перезапуск АЦП с первого канала последовательности.
+ *
+ * ADON = 0 прерывает последовательность, OVR сбрасывается (rc_w0), бит DMA устанавливается заново (RM0090, 13.8.1).
+ * После ADON = 1 - ожидание стабилизации tSTAB (не более 3 мкс), затем SWSTART. Поток DMA к этому моменту
+ * запущен с начала кольца.
+ */
+static void adc_scan_restart(ADC_TypeDef *adc) {
+    volatile uint32_t t;
+
+    adc->CR2 &= ~(ADC_CR2_ADON | ADC_CR2_DMA);
+    adc->SR   = ~(uint32_t)ADC_SR_OVR;                       // Сброс OVR, остальные флаги без изменений
+    adc->CR2 |=  ADC_CR2_DMA | ADC_CR2_ADON;
+    for (t = SystemCoreClock / 1000000UL * 3; t; t--);      // tSTAB: не менее 3 мкс
+    adc->CR2 |=  ADC_CR2_SWSTART;
+}
+
+static void adc_scan_dma_irq(void *ctx, uint32_t flags);
+
+/**
+ * @brief Настройка АЦП и потока DMA по списку каналов, запуск сканирования.
+ *
+ * Вызывается из основного цикла. Выводы каналов переводятся в аналоговый режим, для внутренних каналов
+ * включаются TSVREFE/VBATE. Поток выдаёт dma_mgr_claim() (ADC1: DMA2 Stream0 или Stream4), прерывания потока
+ * и ADC_IRQn получают приоритет cfg->prio.
+ *
+ * @param scan Состояние сканирования.
+ * @param cfg  Настройка; хранится вызывающей стороной, пока сканирование выполняется.
+ * @return uint8_t 1 - сканирование запущено, 0 - неверный список (канал без вывода, внутренний канал не на ADC1,
+ *                 n или frames вне допустимых значений) или все потоки запроса АЦП заняты.
+ */
+uint8_t adc_scan_init(adc_scan_t *scan, const adc_scan_cfg_t *cfg) {
+    ADC_TypeDef        *adc = cfg->adc;
+    const uint8_t      *pins;
+    DMA_Stream_TypeDef *s;
+    GPIO_TypeDef       *gpio;
+    dma_req_t           req;
+    uint32_t            sqr[3] = { 0 }, smpr1 = 0, smpr2 = 0, ccr = 0;
+    uint8_t             i, ch, pin, dma_ch;
+
+    scan->cfg   = cfg;
+    scan->dma   = 0;
+    scan->stats = (adc_scan_stats_t){ 0 };
+
+    if      (adc == ADC1) req = DMA_REQ_ADC1;
+    else if (adc == ADC2) req = DMA_REQ_ADC2;
+    else if (adc == ADC3) req = DMA_REQ_ADC3;
+    else return 0;
+    pins = adc == ADC3 ? adc_scan_pin3 : adc_scan_pin12;
+
+    if (!cfg->n || cfg->n > ADC_SCAN_MAX || !cfg->frames || (cfg->frames & 1) ||
+        (uint32_t)cfg->frames * cfg->n > 0xFFFFUL) return 0;
+
+    /* Проверка списка, значения SQRx и SMPRx */
+    for (i = 0; i < cfg->n; i++) {
+        ch = cfg->list[i].ch;
+        if (ch > ADC_SCAN_VBAT || cfg->list[i].smp > ADC_SMP_480) return 0;
+        if (ch >= ADC_SCAN_TEMP) {
+            if (adc != ADC1) return 0;
+            ccr |= ch == ADC_SCAN_VBAT ? ADC_CCR_VBATE : ADC_CCR_TSVREFE;
+        } else if (pins[ch] == ADC_SCAN_NOPIN) {
+            return 0;
+        }
+
+        sqr[i / 6] |= (uint32_t)ch << (5 * (i % 6));           // sqr[0] - SQR3, sqr[1] - SQR2, sqr[2] - SQR1
+        if (ch < 10) smpr2 |= (uint32_t)cfg->list[i].smp << (3 * ch);
+        else         smpr1 |= (uint32_t)cfg->list[i].smp << (3 * (ch - 10));
+    }
+
+    /* Тактирование и выводы */
+    RCC->APB2ENR |= adc == ADC1 ? RCC_APB2ENR_ADC1EN : adc == ADC2 ? RCC_APB2ENR_ADC2EN : RCC_APB2ENR_ADC3EN;
+    for (i = 0; i < cfg->n; i++) {
+        ch = cfg->list[i].ch;
+        if (ch >= ADC_SCAN_TEMP) continue;
+        pin  = pins[ch];
+        gpio = (GPIO_TypeDef *)(GPIOA_BASE + (pin >> 4) * 0x400UL);
+        RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN << (pin >> 4);
+        gpio->MODER  |= 3UL << (2 * (pin & 0x0F));              // Аналоговый режим
+    }
+
+    /* АЦП: сканирование, непрерывный режим, запросы DMA после каждого преобразования */
+    adc->CR2   = 0;                                             // АЦП выключен (включает adc_scan_restart())
+    ADC->CCR   = (ADC->CCR & ~ADC_CCR_ADCPRE) | ((uint32_t)ADC_SCAN_ADCPRE << ADC_CCR_ADCPRE_Pos) | ccr;
+    adc->SMPR1 = smpr1;
+    adc->SMPR2 = smpr2;
+    adc->SQR3  = sqr[0];
+    adc->SQR2  = sqr[1];
+    adc->SQR1  = ((uint32_t)(cfg->n - 1) << ADC_SQR1_L_Pos) | sqr[2];
+    adc->CR1   = ADC_CR1_SCAN | ADC_CR1_OVRIE;                  // 12 бит, прерывание по переполнению
+    adc->CR2   = ADC_CR2_CONT | ADC_CR2_DDS;
+
+    /* Поток DMA: кольцо кадров */
+    s = dma_mgr_claim(req, &dma_ch, adc_scan_dma_irq, scan, cfg->prio); // Поток остановлен, флаги сброшены
+    if (!s) return 0;
+
+    s->PAR  = (uint32_t)&adc->DR;
+    s->M0AR = (uint32_t)cfg->ring;
+    s->NDTR = (uint32_t)cfg->frames * cfg->n;
+    s->FCR &= ~DMA_SxFCR_DMDIS;                                 // Прямой режим без FIFO
+    s->CR   = (uint32_t)dma_ch << DMA_SxCR_CHSEL_Pos;           // Канал запроса АЦП, P -> M
+    s->CR  |= DMA_SxCR_PL;                                      // Высокий приоритет
+    s->CR  |= DMA_SxCR_MSIZE_0 | DMA_SxCR_PSIZE_0;              // Полуслово
+    s->CR  |= DMA_SxCR_MINC | DMA_SxCR_CIRC;                    // Кольцо
+    s->CR  |= DMA_SxCR_HTIE | DMA_SxCR_TCIE;                    // Половины кольца
+    scan->dma = s;
+
+    NVIC_SetPriority(ADC_IRQn, cfg->prio);
+    NVIC_EnableIRQ(ADC_IRQn);
+
+    dma_mgr_start(s, ADC_SCAN_REARM_MAX);                       // Прерывания ошибок, сохранение настройки, EN = 1
+    adc_scan_restart(adc);                                      // Первый отсчёт - первый канал в кадре 0
+    return 1;
+}
+
+/**
+ * @brief Переполнение АЦП (OVR): вызывается из ADC_IRQHandler() для каждого запущенного сканирования.
+ *
+ * DMA не забрал отсчёт (поток задержан на шине): АЦП прекратил запросы DMA. Поток перезапускается с начала кольца,
+ * затем АЦП. Если поток остановлен после DMA_MGR_FAIL, запросы DMA выключаются до adc_scan_poll() - без DMA = 1
+ * переполнение не фиксируется и прерывание не повторяется.
+ */
+void adc_scan_irq(adc_scan_t *scan) {
+    ADC_TypeDef *adc;
+
+    if (!scan->dma) return;
+    adc = scan->cfg->adc;
+    if (!(adc->SR & ADC_SR_OVR)) return;
+
+    scan->stats.ovr++;
+    if (scan->dma->CR & DMA_SxCR_EN) {
+        dma_mgr_rearm(scan->dma);
+        adc_scan_restart(adc);
+    } else {
+        adc->CR2 &= ~ADC_CR2_DMA;
+        adc->SR   = ~(uint32_t)ADC_SR_OVR;
+    }
+}
+
+/**
+ * @brief Перезапуск потока из основного цикла.
+ *
+ * После ADC_SCAN_REARM_MAX ошибок подряд dma_mgr.c оставляет поток остановленным (DMA_MGR_FAIL), чтобы непрерывные
+ * ошибки шины не заняли процессор прерываниями. Поток и АЦП перезапускаются при следующем вызове; прерывания потока
+ * и ADC_IRQn на это время запрещены.
+ */
+void adc_scan_poll(adc_scan_t *scan) {
+    DMA_Stream_TypeDef *s = scan->dma;
+    IRQn_Type           irqn;
+
+    if (!s || (s->CR & DMA_SxCR_EN)) return;
+
+    irqn = dma_mgr_irqn(s);
+    NVIC_DisableIRQ(irqn);
+    NVIC_DisableIRQ(ADC_IRQn);
+    if (!(s->CR & DMA_SxCR_EN) && dma_mgr_rearm(s)) {
+        adc_scan_restart(scan->cfg->adc);
+        scan->stats.polls++;
+    }
+    NVIC_EnableIRQ(ADC_IRQn);
+    NVIC_EnableIRQ(irqn);
+}
+
+/**
+ * @brief Последний полностью записанный кадр (по NDTR потока).
+ *
+ * Кадр перезаписывается через frames - 1 кадров: значения копируются сразу. До записи первого кадра -
+ * последний кадр кольца.
+ *
+ * @return const void* Кадр в кольце или 0 - сканирование не запущено.
+ */
+const void *adc_scan_last(const adc_scan_t *scan) {
+    const adc_scan_cfg_t *cfg = scan->cfg;
+    uint32_t              frame;
+
+    if (!scan->dma) return 0;
+
+    frame = ((uint32_t)cfg->frames * cfg->n - scan->dma->NDTR) / cfg->n; // Записываемый кадр
+    frame = frame ? frame - 1 : cfg->frames - 1u;
+    return (const uint16_t *)cfg->ring + frame * cfg->n;
+}
+
+/**
+ * @brief Прерывание потока (dma_mgr.c, флаги уже сброшены): заполнена половина кольца (HT - первая, TC - вторая).
+ *
+ * После перезапуска потока ошибкой (DMA_MGR_REARM) кольцо заполняется с начала, АЦП перезапускается.
+ */
+static void adc_scan_dma_irq(void *ctx, uint32_t flags) {
+    adc_scan_t           *scan = ctx;
+    const adc_scan_cfg_t *cfg  = scan->cfg;
+    uint16_t              half = cfg->frames / 2;
+
+    if (flags & DMA_MGR_REARM) {
+        scan->stats.rearms++;
+        adc_scan_restart(cfg->adc);
+        return;
+    }
+
+    if (flags & DMA_MGR_HT) {
+        scan->stats.halves++;
+        if (cfg->cb) cfg->cb(cfg->ctx, cfg->ring, half);
+    }
+    if (flags & DMA_MGR_TC) {
+        scan->stats.halves++;
+        if (cfg->cb) cfg->cb(cfg->ctx, (const uint16_t *)cfg->ring + (uint32_t)half * cfg->n, half);
+    }
+}
@@ -8,9 +8,22 @@
  * @IDE         : Segger Embedded Studio
  *
  * @Description : АЦП измеряет значение на аналоговом входе PA5 (напряжение на потенциометре), затем записывает эти данные в память
- *                с помощью модуля DMA. В прерывании по окончанию передачи DMA данные отправляются в таймер, который
+ *                с помощью модуля DMA. Вход PA5 - первый канал сканирования ADC1 (adc_scan.c) вместе с VREFINT и датчиком
+ *                температуры: кадры adc_frame_t пишутся в кольцо adc_ring. В прерывании по заполнению половины кольца
+ *                усреднённое значение PA5 отправляется в таймер, который
  *                работает в режиме ШИМ и управляет яркостью светодиода PE14.
  *                Таким образом, регулируется яркость светодиода с помощью потенциометра посредством передачи данных в память.
+ *
+ *                Усреднённые значения также сохраняются в кольцевой журнал во внешней памяти W25Q64 (SPI2, драйвер
+ *                из проекта spi-flash-memory): каждое LOG_DECIM-е прерывание DMA (~1 кГц) добавляет кадр log_frame_t.
+ *                w25_log_push() только копирует кадр в буфер страницы в RAM; программирование страниц и стирание
+ *                следующего сектора выполняет движок w25_async из прерывания TIM7 с низшим приоритетом.
+ *                При включении w25_log_mount() находит последнюю записанную страницу, журнал продолжается с неё.
+ *                Если потоки DMA1 для SPI2 выданы другому драйверу (spi2_init() возвращает 0), журнал не ведётся.
+ *
+ *                Ошибки потока DMA (TE, DME) и переполнение АЦП (OVR) не останавливают регулирование: поток
+ *                перезапускается dma_mgr.c с исходной настройкой, АЦП - adc_scan.c с первого канала (RM0090, 13.8.1).
+ *                Ошибки потока считает dma_mgr_err[], перезапуски - adc1_scan.stats.
  */
 
 
@@ -19,18 +32,55 @@
 
 #include <stm32f4xx.h>
 
-uint16_t buffer [8] __attribute__ ((section(".fast"))); // Буфер для хранения данных АЦП
+#include "spi2_init.h"
+#include "w25_async.h"
+#include "w25_log.h"
+
+ADC_SCAN_FRAME_CHECK(adc_frame_t, ADC_CHANNELS);
+
+adc_frame_t adc_ring [ADC_FRAMES] __attribute__ ((section(".fast"))); // Кольцо кадров сканирования ADC1
+
+// Каналы ADC1 в порядке полей adc_frame_t
+static const adc_scan_ch_t adc1_list[ADC_CHANNELS] = {
+    { 5,             ADC_SMP_84  }, // PA5 - потенциометр
+    { ADC_SCAN_VREF, ADC_SMP_144 }, // VREFINT
+    { ADC_SCAN_TEMP, ADC_SMP_144 }, // Датчик температуры
+};
+
+static void adc1_frames(void *ctx, const void *frames, uint16_t count);
+
+static const adc_scan_cfg_t adc1_cfg = {
+    .adc    = ADC1,
+    .list   = adc1_list,
+    .n      = ADC_CHANNELS,
+    .ring   = adc_ring,
+    .frames = ADC_FRAMES,
+    .cb     = adc1_frames,
+    .prio   = ADC_DMA_IRQ_PRIO,
+};
+
+static log_frame_t log_frame;      // Кадр журнала
+static uint8_t     log_on = 0;     // Журнал ведётся: потоки DMA1 для SPI2 получены (spi2_init())
+static uint8_t     log_decim = 0;  // Счётчик прерываний DMA между кадрами
+
+adc_scan_t adc1_scan; // Сканирование ADC1 (поток, статистика перезапусков)
 
  int main(void) {
 
   SystemInit();        // Инициализация системы
   rcc_init();          // Устаовка тактирования на 84 МГц  
   tim1_init();         // Инициализация TIM2
-  adc1_init();         // Инициализация ADC1
-  DMA2_Stream0_Init(); // Инициализация DMA2 Stream 0
+  log_on = spi2_init(); // Инициализация SPI2 и сброс W25Q64; 0 - потоки DMA1 заняты, регулирование без журнала
+  if (log_on) {
+    spi2_autotune();     // Подбор частоты SPI2
+    w25_log_mount();     // Поиск головы журнала, подготовка стёртых секторов
+    w25_async_timer_init(); // Запуск движка стирания/программирования (TIM7)
+  }
+  adc1_init();         // Сканирование ADC1, поток DMA2 Stream0 (adc_scan.c, dma_mgr.c)
 
   while (1) {
         // Основной цикл
+        adc_scan_poll(&adc1_scan); // Поток, остановленный серией ошибок, - перезапуск
     }
 }
 
@@ -66,84 +116,54 @@ void tim1_init(void) {
 
 /**
     @brief Инициализация ADC1.
-    @details Настраивает ADC1 для измерения напряжения на PA5 (ADC1_CH5) и передачи данных через DMA.
+    @details Запускает сканирование ADC1 по списку adc1_list (PA5, VREFINT, датчик температуры) с записью кадров
+             в adc_ring через DMA. Поток выдаёт dma_mgr_claim() по запросу ADC1 (DMA2 Stream0 или Stream4, канал 0).
+             Половины кольца передаются в adc1_frames().
 */
 void adc1_init(void) {
-    
-    RCC -> APB2ENR |= RCC_APB2ENR_ADC1EN;          // Включение тактирования ADC1
-    RCC -> AHB1ENR |= RCC_AHB1ENR_GPIOAEN;         // Включение тактирования GPIOA
-                                                                                 
-    GPIOA -> MODER |= GPIO_MODER_MODE5;            // Аналоговый режим работы PA5 (ADC1_CH5)
-                                                    
-    ADC -> CCR     |= ADC_CCR_ADCPRE;              // PCLK / 8
-    ADC1 -> SMPR2  |= ADC_SMPR2_SMP5_2;            // 84 + 12 циклов (конвертация произайдет за 84+12 = 96 циклов тактирования АЦП)
-
-    ADC1->SQR1     &= ~ADC_SQR1_L;                 // Длина последовательности конвертации = 1
-    ADC1->SQR3     |= 5 << ADC_SQR3_SQ1_Pos;       // Первая конвертация на 5-ом канале
-
-    ADC1 -> CR2    |=  ADC_CR2_CONT;               // Непрерывный режим 
-    ADC1 -> CR2    |= ADC_CR2_DMA | ADC_CR2_DDS;   // Включение непрерывных запросов DMA
-
-    ADC1 -> CR2    |= ADC_CR2_ADON;                // Вкл. АЦП
-    ADC1 -> CR2    |= ADC_CR2_SWSTART;             // Запуск конвертации
-
+    adc_scan_init(&adc1_scan, &adc1_cfg);
 }
 
-
-
-
-
-
 /**
-    @brief Инициализация DMA2 Stream 0.
-    @details Настраивает DMA2 Stream 0 для передачи данных из ADC1 в буфер.
+    @brief Прерывание ADC1: переполнение (OVR) - перезапуск потока и АЦП (adc_scan.c).
 */
-void DMA2_Stream0_Init(void) {
-    RCC->AHB1ENR |= RCC_AHB1ENR_DMA2EN;           // Включение тактирования DMA2
-
-    // Настройка DMA2 Stream 0 Channel 0 для ADC1
-    DMA2_Stream0 -> PAR  =  (uint32_t)&(ADC1->DR);                 // Адрес регистра данных ADC1
-    DMA2_Stream0 -> M0AR =  (uint32_t)buffer;                      // Адрес буфера для хранения данных
-    DMA2_Stream0 -> NDTR = 8;                                     // Количество передаваемых данных
-    DMA2_Stream0 -> FCR &= ~(DMA_SxFCR_DMDIS);                    // Прямой режим без FIFO
-    DMA2_Stream0 -> CR  &= ~(DMA_SxCR_CHSEL);                     // Установка канала 0
-    DMA2_Stream0 -> CR  &= ~(DMA_SxCR_MBURST | DMA_SxCR_PBURST);  // Одиночная передача
-    DMA2_Stream0 -> CR  &= ~(DMA_SxCR_DBM);                       // Режим двойного буфера выключен
-    DMA2_Stream0 -> CR  |=   DMA_SxCR_PL;                         // Высокий приоритет
-    DMA2_Stream0 -> CR  |=   DMA_SxCR_MSIZE_0 | DMA_SxCR_PSIZE_0; // Размер данных памяти и переферии - полуслово (16 бит)
-    DMA2_Stream0 -> CR  |=   DMA_SxCR_MINC;                       // Инкремент адреса памяти
-    DMA2_Stream0 -> CR  &= ~(DMA_SxCR_PINC);                      // Без инкремента адреса периферии
-    DMA2_Stream0 -> CR  |=   DMA_SxCR_CIRC;                       // Циклический режим
-    DMA2_Stream0 -> CR  &= ~(DMA_SxCR_DIR);                       // Передача из периферии в память
-    DMA2_Stream0 -> CR  |=   DMA_SxCR_TCIE;                       // Прерывание по завершению передачи
-                                                               
-    NVIC_EnableIRQ(DMA2_Stream0_IRQn);                          // Разрешение прерывания DMA2 Stream 0
-    DMA2_Stream0->CR    |= DMA_SxCR_EN;                           // Включение DMA2 Stream 0
+void ADC_IRQHandler(void) {
+    adc_scan_irq(&adc1_scan);
 }
 
 
 
 
 /**
-    @brief Обработчик прерывания DMA2 Stream 0.
-    @details Обрабатывает данные, полученные от ADC1, и обновляет значение ШИМ для управления яркостью светодиода.
+    @brief Заполнена половина кольца ADC1 (прерывание потока DMA).
+    @details Усредняет значения PA5 из кадров половины кольца и обновляет значение ШИМ для управления яркостью
+             светодиода.
 */
-void DMA2_Stream0_IRQHandler(void) {
+static void adc1_frames(void *ctx, const void *frames, uint16_t count) {
 
-    uint8_t i = 0;     // перемення для цикла for
-    uint16_t ovr = 0;  //  переменная, которая названа по операции оверсемплинга, когда мы берем 
-                       // несколько значений из АЦП и усредненное значение отпрвляем в TIM
+    const adc_frame_t *f = frames;
+    uint16_t i = 0;     // перемення для цикла for
+    uint32_t ovr = 0;   //  переменная, которая названа по операции оверсемплинга, когда мы берем 
+                        // несколько значений из АЦП и усредненное значение отпрвляем в TIM
 
-   /* Усреднение значений из буфера  */
-    for (i = 0; i < 8; i++) {
-      ovr = ovr + buffer[i];
+    (void)ctx;
+
+   /* Усреднение значений PA5 из кадров */
+    for (i = 0; i < count; i++) {
+      ovr = ovr + f[i].pot;
     }
-     ovr /= 8;
+     ovr /= count;
 
     // Обновление значения ШИМ                          
     TIM1 -> CCR3 = (ovr * 1000) / 4096; // Вычисление значения и запись его в таймер  
                                         // 1000 - ARR, 4096 - разрядность АЦП
 
-    DMA2 -> LIFCR |= DMA_LIFCR_CTCIF0; // Очистка флага прерывания
-    NVIC_ClearPendingIRQ(DMA2_Stream0_IRQn);
+    // Кадр журнала с частотой ~1 кГц: копирование в RAM, без ожидания памяти
+    if (log_on && ++log_decim >= LOG_DECIM) {
+      log_decim       = 0;
+      log_frame.adc   = (uint16_t)ovr;
+      log_frame.pwm   = (uint16_t)TIM1->CCR3;
+      w25_log_push(&log_frame, sizeof(log_frame));
+      log_frame.index++;
+    }
 }
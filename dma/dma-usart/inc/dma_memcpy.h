@@ -0,0 +1,51 @@
+/**
+ * @file        : dma_memcpy.h
+ * @brief       : Асинхронное копирование памяти через DMA2 (режим память-память) с очередью запросов.
+ * @author      : xmatech
+ * @date        : 19.03.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ *
+ * @Description : dma_memcpy_async() ставит запрос в очередь и возвращается сразу; копирование выполняет поток DMA2
+ *                (режим память-память есть только у DMA2), выданный dma_mgr_claim(); по окончании запроса из прерывания
+ *                вызывается callback-функция. Запросы выполняются по порядку постановки. Если свободного потока DMA2
+ *                нет, все запросы копирует ядро.
+ *                - Адреса, выровненные на 4 байта: передача словами через FIFO, при выравнивании на 16 байт -
+ *                  пакетами по 4 слова (INCR4). Источник с другим смещением: FIFO собирает байты в слова приёмника.
+ *                  Начальные (до выравнивания приёмника) и последние (меньше слова или пакета) байты копирует ядро.
+ *                - Запросы короче DMA_MEMCPY_MIN и запросы с адресами в CCM RAM (DMA недоступна) копирует ядро:
+ *                  при пустой очереди - сразу в dma_memcpy_async(), иначе - в прерывании в порядке очереди.
+ *                Буферы не должны изменяться (источник) и читаться (приёмник) до вызова callback-функции.
+ */
+
+#ifndef DMA_MEMCPY_H
+#define DMA_MEMCPY_H
+
+#include <stm32f4xx.h>
+
+#define DMA_MEMCPY_QUEUE     8            // Запросов в очереди (степень двойки)
+#define DMA_MEMCPY_MIN       64           // Запросы короче копирует ядро, байт. Начальное значение: уточнить по
+                                          // таблице memcpy_bench() (MEMCPY_BENCH, main.h) - где DMA быстрее ядра
+#define DMA_MEMCPY_IRQ_PRIO  7            // Приоритет прерывания потока (callback-функции)
+
+// Уведомление об окончании копирования (из прерывания или из dma_memcpy_async())
+typedef void (*dma_memcpy_cb_t)(void *dst, uint32_t len);
+
+// Статистика
+typedef struct {
+    uint32_t requests;  // Выполнено запросов
+    uint32_t dma_bytes; // Скопировано DMA, байт
+    uint32_t cpu_bytes; // Скопировано ядром (короткие запросы, CCM RAM, края), байт
+    uint32_t full;      // Отказов: очередь заполнена
+    uint32_t errors;    // Ошибок потока (TE) - участок скопирован ядром
+} dma_memcpy_stats_t;
+
+extern dma_memcpy_stats_t dma_memcpy_stats;
+
+uint8_t dma_memcpy_init(void);                                                      // Получение потока DMA2, 0 - копирует ядро
+uint8_t dma_memcpy_async(void *dst, const void *src, uint32_t len, dma_memcpy_cb_t cb); // 1 - запрос принят, 0 - очередь заполнена
+uint8_t dma_memcpy_busy(void);                                                      // 1 - очередь не пуста
+void    dma_memcpy(void *dst, const void *src, uint32_t len);                       // Копирование с ожиданием окончания
+
+#endif // DMA_MEMCPY_H
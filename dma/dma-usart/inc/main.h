@@ -11,12 +11,53 @@
  */
 
 #include <stm32f4xx.h>
+#include "usart_baud.h"
+#include "usart_port.h"
+#include "usart_stream.h"
+#include "dma_memcpy.h"
+
+#define USART1_BAUD 115200 // Скорость USART1, бод
+
+// Режим передачи: раскомментируйте для непрерывного потока телеметрии (DMA2 Stream7, DBM)
+// вместо передачи строки 1 раз в секунду
+//#define USART_STREAM 1
+
+// Несколько портов одновременно: раскомментируйте для проверки USART2, USART3 и USART6 по петле
+// (перемычки PA2-PA3, PB10-PB11, PC6-PC7) на скорости MULTI_BAUD; отчёт 1 раз в секунду по USART1
+//#define UART_MULTI 1
+
+// Управление потоком в петле: раскомментируйте вместе с UART_MULTI для RTS/CTS на USART2 и USART3 (перемычки
+// PD4-PD3, PB14-PB13) и медленного чтения приёма - проверка приёма без потерь при заполнении буфера
+//#define MULTI_FLOW 1
+
+// Пакеты цепочкой DMA: раскомментируйте для передачи по USART1 пакетов "заголовок + данные + CRC" через
+// usart_port_write_sg() вперемешку со строками usart_port_write(); отчёт о цепочках 1 раз в секунду
+//#define USART_SG 1
+#if defined(USART_SG) && defined(USART_STREAM)
+#error "USART_SG requires the USART1 TX stream (not available with USART_STREAM)"
+#endif
+#define SG_PAYLOAD 61 // USART_SG: байт данных пакета (сегмент - данные и "\r\n")
+
+// Сравнение memcpy() и dma_memcpy_async(): раскомментируйте для вывода таблицы по USART1 при запуске
+//#define MEMCPY_BENCH 1
+#define MEMCPY_BENCH_MAX 4096 // Наибольший размер копирования в таблице, байт
+
+#define MULTI_BAUD        2000000 // Скорость портов петли, бод
+#define MULTI_READ_CYCLES 84000   // MULTI_FLOW: период чтения приёма, такты ядра (1 мс: 64 байт при 200 байт/мс линии)
+#define UART_IRQ_PRIO     5       // Приоритет прерываний портов usart_port.c
+
+#define STREAM_BENCH_CYCLES 84000000UL // Период измерения скорости потока, такты ядра (1 с)
+
+// Результаты измерения скорости потока
+typedef struct {
+    uint32_t bytes_per_s; // Передано байт данных в секунду
+    uint32_t line_pct;    // Загрузка линии, % (10 бит на байт)
+    uint32_t underruns;   // Переходов DMA без готового буфера за период
+} stream_bench_t;
 
 
 
 /* Прототипы функций */ 
 void rcc_init(void);                  // Настройка тактирования
 void usart1_init(void);               // Настройка USART1
-void DMA2_Stream0_MEM2MEM_Init(void); // Инициализация DMA2 Stream 0
-void DMA2_Stream7_USART1_Init(void);  // Инициализация DMA2 Stream 7
 void delay_ms(uint32_t ms);           // Функция задержки в миллисекундах
\ No newline at end of file
@@ -0,0 +1,47 @@
+/**
+ * @file        : usart_stream.h
+ * @brief       : Непрерывная передача USART1 через DMA2 Stream7 в режиме двойного буфера (DBM).
+ * @author      : xmatech
+ * @date        : 19.03.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ *
+ * @Description : Приложение получает свободный буфер (usart_stream_acquire()), заполняет его и ставит в очередь
+ *                (usart_stream_commit()), пока DMA передаёт другие буферы. Переход между буферами выполняет сам DMA
+ *                (биты DBM/CT), поэтому линия занята без пауз между буферами.
+ *                Если к моменту перехода следующий буфер не поставлен в очередь, передаётся буфер нулей
+ *                (в протоколе COBS - разделители кадров) и увеличивается счётчик underruns.
+ *                Ошибка DMA (TE) останавливает поток: прерванные буферы возвращаются в список свободных (lost), передача
+ *                продолжается со следующего буфера очереди. После USART_STREAM_REARM_MAX ошибок подряд (без TC между
+ *                ними) передача остаётся остановленной до usart_stream_start().
+ */
+
+#ifndef USART_STREAM_H
+#define USART_STREAM_H
+
+#include <stm32f4xx.h>
+
+#define USART_STREAM_LEN  256 // Размер буфера, байт (NDTR общий для M0AR/M1AR - все буферы одной длины)
+#define USART_STREAM_BUFS 4   // Количество буферов приложения (степень двойки)
+#define USART_STREAM_REARM_MAX 4 // Перезапусков после ошибки DMA подряд
+
+// Статистика передачи
+typedef struct {
+    uint32_t buffers;   // Передано буферов приложения
+    uint32_t bytes;     // Передано байт данных приложения (без дополнения нулями)
+    uint32_t underruns; // Переходов DMA без готового буфера (передан буфер нулей)
+    uint32_t errors;    // Ошибок DMA (TEIF, DMEIF)
+    uint32_t rearms;    // Перезапусков после остановки потока ошибкой
+    uint32_t lost;      // Буферов приложения, прерванных ошибкой
+} usart_stream_stats_t;
+
+extern usart_stream_stats_t usart_stream_stats;
+
+uint8_t  usart_stream_init(void);                    // Настройка потока USART1_TX (DBM) и USART1->CR3.DMAT, 0 - поток занят
+void     usart_stream_start(void);                   // Запуск передачи
+void     usart_stream_stop(void);                    // Остановка передачи
+uint8_t *usart_stream_acquire(void);                 // Свободный буфер или 0
+void     usart_stream_commit(uint8_t *buf, uint16_t len); // Постановка буфера в очередь (остаток - нули)
+
+#endif // USART_STREAM_H
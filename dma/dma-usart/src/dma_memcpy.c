@@ -0,0 +1,230 @@
+/**
+ * @file        : dma_memcpy.c
+ * @brief       : Асинхронное копирование памяти через DMA2 (режим память-память) с очередью запросов.
+ * @author      : xmatech
+ * @date        : 19.03.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ *
+ * @Description : В режиме память-память источник задаётся в PAR (порт периферии), приёмник - в M0AR, NDTR считает
+ *                элементы размера PSIZE, прямой режим запрещён (DMDIS = 1). Участок одной передачи:
+ *                - источник и приёмник выровнены на 4: PSIZE = MSIZE = 32 бит, NDTR = слов; при выравнивании обоих на 16
+ *                  пакеты INCR4 на обоих портах (порог FIFO - 4 слова), NDTR кратен 4 - пакет не пересекает границу 1 КБ;
+ *                - источник не выровнен: PSIZE = 8 бит, MSIZE = 32 бит (упаковка в FIFO), NDTR = байт, кратно 4.
+ *                NDTR не больше 0xFFFC, длинный запрос копируется несколькими участками из прерывания TC.
+ *                Текущий запрос (dma_memcpy_cur) и очередь изменяются в прерывании и при запрещённых прерываниях.
+ *                Приоритет потока - низкий (PL = 0): потоки USART на DMA2 обслуживаются раньше копирования.
+ */
+
+#include "main.h"
+
+#include <string.h>
+
+#define DMA_MEMCPY_MASK (DMA_MEMCPY_QUEUE - 1)
+#define DMA_MEMCPY_NDTR 0xFFFCUL                             // Наибольший NDTR, кратный пакету INCR4
+#define DMA_MEMCPY_TAIL 16                                   // Остаток запроса короче копирует ядро, байт
+
+// Запрос копирования
+typedef struct {
+    uint8_t        *dst;
+    const uint8_t  *src;
+    uint32_t        len;
+    dma_memcpy_cb_t cb;
+} dma_memcpy_req_t;
+
+dma_memcpy_stats_t dma_memcpy_stats;
+
+static dma_memcpy_req_t dma_memcpy_queue[DMA_MEMCPY_QUEUE];    // Очередь: [tail] - выполняемый запрос
+static volatile uint8_t dma_memcpy_q_head = 0, dma_memcpy_q_tail = 0;
+static DMA_Stream_TypeDef *dma_memcpy_dma = 0;                   // Поток DMA2 (0 - копирует ядро)
+
+// Выполняемый запрос: оставшаяся часть и участок текущей передачи DMA
+static struct {
+    uint8_t       *dst;
+    const uint8_t *src;
+    uint32_t       left;
+    uint32_t       step; // Байт в передаче DMA (0 - поток свободен)
+} dma_memcpy_cur;
+
+/**
+ * @brief Проверка доступности адреса для DMA: CCM RAM (0x10000000..0x1000FFFF) подключена только к шине D ядра.
+ */
+static uint8_t dma_memcpy_reachable(const void *p, uint32_t len) {
+    uint32_t a = (uint32_t)p;
+
+    return dma_memcpy_dma && !(a < CCMDATARAM_BASE + 0x10000UL && a + len > CCMDATARAM_BASE);
+}
+
+/**
+ * @brief Копирование ядром (короткие участки, CCM RAM, края запроса).
+ */
+static void dma_memcpy_cpu(uint32_t n) {
+    memcpy(dma_memcpy_cur.dst, dma_memcpy_cur.src, n);
+    dma_memcpy_cur.dst  += n;
+    dma_memcpy_cur.src  += n;
+    dma_memcpy_cur.left -= n;
+    dma_memcpy_stats.cpu_bytes += n;
+}
+
+/**
+ * @brief Запуск передачи DMA для следующего участка или выполнение запросов очереди до первого участка для DMA.
+ *
+ * Вызывается из прерывания потока или при запрещённых прерываниях, когда поток свободен.
+ */
+static void dma_memcpy_next(void) {
+    DMA_Stream_TypeDef *s = dma_memcpy_dma;
+    dma_memcpy_req_t   *req;
+    uint32_t            n, cr;
+
+    while (dma_memcpy_q_tail != dma_memcpy_q_head) {
+        req = &dma_memcpy_queue[dma_memcpy_q_tail & DMA_MEMCPY_MASK];
+
+        if (dma_memcpy_cur.left >= DMA_MEMCPY_TAIL) {
+            if ((uint32_t)dma_memcpy_cur.dst & 3) dma_memcpy_cpu(4 - ((uint32_t)dma_memcpy_cur.dst & 3)); // Выравнивание приёмника
+
+            if (((uint32_t)dma_memcpy_cur.src & 3) == 0) {
+                n  = dma_memcpy_cur.left / 4;                        // Слова
+                if (n > DMA_MEMCPY_NDTR) n = DMA_MEMCPY_NDTR;
+                cr = DMA_SxCR_PSIZE_1 | DMA_SxCR_MSIZE_1;
+                if ((((uint32_t)dma_memcpy_cur.src | (uint32_t)dma_memcpy_cur.dst) & 15) == 0 && n >= 4) {
+                    n  &= ~3UL;                                      // NDTR кратен пакету
+                    cr |= DMA_SxCR_PBURST_0 | DMA_SxCR_MBURST_0;     // INCR4
+                }
+                dma_memcpy_cur.step = n * 4;
+            } else {
+                n  = dma_memcpy_cur.left & ~3UL;                     // Байты источника, кратно слову приёмника
+                if (n > DMA_MEMCPY_NDTR) n = DMA_MEMCPY_NDTR;
+                cr = DMA_SxCR_MSIZE_1;
+                dma_memcpy_cur.step = n;
+            }
+
+            dma_mgr_clear(s, DMA_MGR_ALL);
+            s->CR   = DMA_SxCR_DIR_1 | DMA_SxCR_PINC | DMA_SxCR_MINC | cr | DMA_SxCR_TCIE | DMA_SxCR_TEIE;
+            s->FCR  = DMA_SxFCR_DMDIS | DMA_SxFCR_FTH;               // Порог FIFO - 4 слова
+            s->PAR  = (uint32_t)dma_memcpy_cur.src;
+            s->M0AR = (uint32_t)dma_memcpy_cur.dst;
+            s->NDTR = n;
+            s->CR  |= DMA_SxCR_EN;
+            return;
+        }
+
+        if (dma_memcpy_cur.left) dma_memcpy_cpu(dma_memcpy_cur.left); // Остаток меньше DMA_MEMCPY_TAIL
+
+        dma_memcpy_stats.requests++;
+        if (req->cb) req->cb(req->dst, req->len);                // Запрос ещё в очереди: новые запросы из cb
+        dma_memcpy_q_tail++;                                     // только ставятся в очередь
+
+        if (dma_memcpy_q_tail != dma_memcpy_q_head) {             // Следующий запрос
+            req = &dma_memcpy_queue[dma_memcpy_q_tail & DMA_MEMCPY_MASK];
+            dma_memcpy_cur.dst  = req->dst;
+            dma_memcpy_cur.src  = req->src;
+            dma_memcpy_cur.left = req->len;
+            if (req->len < DMA_MEMCPY_MIN || !dma_memcpy_reachable(req->dst, req->len) ||
+                !dma_memcpy_reachable(req->src, req->len)) dma_memcpy_cpu(req->len);
+        }
+    }
+}
+
+static void dma_memcpy_irq(void *ctx, uint32_t flags);
+
+/**
+ * @brief Получение потока DMA2 у dma_mgr.c (поток остановлен, прерывание разрешено).
+ *
+ * @return uint8_t 1 - поток получен, 0 - все потоки DMA2 заняты, запросы копирует ядро.
+ */
+uint8_t dma_memcpy_init(void) {
+    dma_memcpy_q_head = dma_memcpy_q_tail = 0;
+    dma_memcpy_cur.left = dma_memcpy_cur.step = 0;
+
+    if (!dma_memcpy_dma) dma_memcpy_dma = dma_mgr_claim(DMA_REQ_MEM2MEM, 0, dma_memcpy_irq, 0, DMA_MEMCPY_IRQ_PRIO);
+
+    return dma_memcpy_dma != 0;
+}
+
+/**
+ * @brief Постановка запроса копирования в очередь.
+ *
+ * Если очередь пуста и запрос копирует ядро (короче DMA_MEMCPY_MIN или CCM RAM), копирование и вызов cb
+ * выполняются до возврата. Функцию можно вызывать из прерываний.
+ *
+ * @param dst Приёмник.
+ * @param src Источник.
+ * @param len Длина, байт.
+ * @param cb  Уведомление об окончании (может быть 0).
+ * @return uint8_t 1 - запрос принят, 0 - очередь заполнена (stats.full).
+ */
+uint8_t dma_memcpy_async(void *dst, const void *src, uint32_t len, dma_memcpy_cb_t cb) {
+    uint32_t          primask = __get_PRIMASK();
+    uint8_t           cpu     = len < DMA_MEMCPY_MIN || !dma_memcpy_reachable(dst, len) || !dma_memcpy_reachable(src, len);
+    dma_memcpy_req_t *req;
+
+    __disable_irq();
+    if (dma_memcpy_q_head == dma_memcpy_q_tail && cpu) {         // Очередь пуста - копирование сразу
+        dma_memcpy_stats.cpu_bytes += len;
+        dma_memcpy_stats.requests++;
+        __set_PRIMASK(primask);
+        memcpy(dst, src, len);
+        if (cb) cb(dst, len);
+        return 1;
+    }
+    if ((uint8_t)(dma_memcpy_q_head - dma_memcpy_q_tail) >= DMA_MEMCPY_QUEUE) {
+        dma_memcpy_stats.full++;
+        __set_PRIMASK(primask);
+        return 0;
+    }
+
+    req      = &dma_memcpy_queue[dma_memcpy_q_head & DMA_MEMCPY_MASK];
+    req->dst = (uint8_t *)dst;
+    req->src = (const uint8_t *)src;
+    req->len = len;
+    req->cb  = cb;
+
+    if (dma_memcpy_q_head++ == dma_memcpy_q_tail) {              // Поток свободен - запуск
+        dma_memcpy_cur.dst  = req->dst;
+        dma_memcpy_cur.src  = req->src;
+        dma_memcpy_cur.left = len;
+        dma_memcpy_next();
+    }
+    __set_PRIMASK(primask);
+
+    return 1;
+}
+
+/**
+ * @brief Проверка выполнения очереди.
+ */
+uint8_t dma_memcpy_busy(void) {
+    return dma_memcpy_q_head != dma_memcpy_q_tail;
+}
+
+/**
+ * @brief Копирование с ожиданием окончания всех запросов очереди (из основного цикла).
+ */
+void dma_memcpy(void *dst, const void *src, uint32_t len) {
+    while (!dma_memcpy_async(dst, src, len, 0));
+    while (dma_memcpy_busy());
+}
+
+/**
+ * @brief Прерывание потока (dma_mgr.c, флаги уже сброшены): участок скопирован (TC) или ошибка шины (TE).
+ *
+ * При TE поток отключён аппаратно, участок копирует ядро и очередь продолжает выполняться.
+ */
+static void dma_memcpy_irq(void *ctx, uint32_t flags) {
+    (void)ctx;
+    if (!(flags & (DMA_MGR_TC | DMA_MGR_TE))) return;
+
+    if (flags & DMA_MGR_TE) {
+        dma_memcpy_stats.errors++;
+        dma_memcpy_cpu(dma_memcpy_cur.step);
+    } else {
+        dma_memcpy_cur.dst  += dma_memcpy_cur.step;
+        dma_memcpy_cur.src  += dma_memcpy_cur.step;
+        dma_memcpy_cur.left -= dma_memcpy_cur.step;
+        dma_memcpy_stats.dma_bytes += dma_memcpy_cur.step;
+    }
+    dma_memcpy_cur.step = 0;
+
+    dma_memcpy_next();
+}
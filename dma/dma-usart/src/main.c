@@ -1,9 +1,19 @@
 /**
  * @file        main.c
  * @brief       Программа демонстрации работы DMA на STM32F407VET6
- *              - Копирует строку из массива bufferOUT в bufferIN через DMA (режим память-память)
+ *              - Копирует строку из массива bufferOUT в bufferIN через dma_memcpy() (DMA2, режим память-память;
+ *                14 байт короче DMA_MEMCPY_MIN - копирует ядро)
  *              - Периодически отправляет строку по USART1 через DMA (режим память-периферия)
  *              - Передача осуществляется 1 раз в секунду с использованием SysTick для отсчёта времени
+ *              - При USART_STREAM (main.h) вместо периодической передачи - непрерывный поток телеметрии
+ *                через DMA2 Stream7 в режиме двойного буфера (usart_stream.c) и измерение скорости (stream_bench)
+ *              - При UART_MULTI (main.h) - одновременный обмен по петле через USART2, USART3 и USART6 и отчёт
+ *                о скорости приёма и ошибках каждого порта по USART1
+ *              - При MULTI_FLOW - управление потоком RTS/CTS на USART2 и USART3 и медленное чтение приёма
+ *              - При USART_SG (main.h) - пакеты "заголовок + данные + CRC" цепочкой DMA (usart_port_write_sg())
+ *                между строками usart_port_write() и отчёт о цепочках (паузы между сегментами) по USART1
+ *              - При MEMCPY_BENCH (main.h) - таблица времени копирования memcpy() и dma_memcpy_async() по USART1
+ *              USART1 и порты петли обслуживает общий драйвер usart_port.c (../../usart)
  *
  * @author      xmatech
  * @date        2023
@@ -14,106 +24,395 @@
 
 #include "main.h"
 
+#include <string.h>
+
 #define BUF_SIZE 14
 
+usart_port_t uart1; // USART1: строка 1 раз в секунду, отчёты
+
+static uint8_t uart1_rx[64] USART_DMA_BUF; // Буфер приёма USART1
+
+#if defined(USART_STREAM)
+// Передачу выполняет usart_stream.c (DMA2 Stream7, DBM): поток передачи драйвером не используется
+static const usart_port_cfg_t uart1_cfg = { USART1, GPIOA, 9, GPIOA, 10, 7, DMA_REQ_USART1_RX, DMA_REQ_NONE,
+                                            USART1_BAUD, uart1_rx, sizeof(uart1_rx), 0, 0, UART_IRQ_PRIO, 0, UART_FC_NONE };
+#else
+static uint8_t uart1_tx[256] USART_DMA_BUF; // Буфер передачи USART1
+
+static const usart_port_cfg_t uart1_cfg = { UART_HW_USART1, USART1_BAUD, uart1_rx, sizeof(uart1_rx),
+                                            uart1_tx, sizeof(uart1_tx), UART_IRQ_PRIO, 0, UART_FC_NONE };
+#endif
+
 // Массив, содержащий строку для передачи, расположен в секции ".fast"
 uint8_t bufferOUT[BUF_SIZE] __attribute__((section(".fast"))) = "USART-DMA OK!\r\n";
 // Массив для копирования строки, расположен в секции ".fast"
 uint8_t bufferIN[BUF_SIZE] __attribute__((section(".fast")));
 
+#if defined(USART_STREAM) || defined(UART_MULTI) || defined(USART_SG)
+#define STREAM_REC_LEN 16                            // Запись телеметрии: "TLM nnnnnnnnnn\r\n"
 
 /**
- * @brief Основная функция программы. Инициализирует систему, выполняет копирование данных и настраивает периферию.
+ * @brief Запись в буфер строки "<tag> nnnnnnnnnn\r\n" (16 байт, десятичное число с ведущими нулями).
  */
-int main(void) {
-    SystemInit();                // Инициализация системы микроконтроллера
-    rcc_init();                  // Включение тактирования необходимых периферийных устройств
-    DMA2_Stream0_MEM2MEM_Init(); // Копирование данных: bufferOUT -> bufferIN через DMA (режим память-память)
-    usart1_init();               // Инициализация USART1 для работы с DMA
-    DMA2_Stream7_USART1_Init();  // Настройка DMA для передачи данных по USART1 (режим память-периферия)
+static void stream_record(uint8_t *rec, const char *tag, uint32_t value) {
+    for (uint8_t i = 0; i < 3; i++) rec[i] = (uint8_t)tag[i];
+    rec[3] = ' ';
+    for (int8_t i = 13; i >= 4; i--) {
+        rec[i] = (uint8_t)('0' + value % 10);
+        value /= 10;
+    }
+    rec[14] = '\r';
+    rec[15] = '\n';
+}
+
+#endif
+
+#if defined(USART_STREAM)
+stream_bench_t  stream_bench;                        // Результаты последнего измерения
+static uint32_t stream_counter = 0;                  // Номер записи телеметрии
+
+/**
+ * @brief Заполнение буферов телеметрии и измерение скорости потока каждую секунду (DWT->CYCCNT).
+ *
+ * Первая запись буфера после измерения - результат: "BPS" (байт/с данных), затем записи "TLM" с номером.
+ */
+static void stream_run(void) {
+    uint32_t t0, bytes0, under0, dt;
+    uint8_t *buf, report = 0;
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+
+    if (!usart_stream_init()) return;                 // Поток USART1_TX занят (dma_mgr_stats.conflicts)
+    usart_stream_start();
+    t0 = DWT->CYCCNT; bytes0 = usart_stream_stats.bytes; under0 = usart_stream_stats.underruns;
 
- 
     while (1) {
+        if ((buf = usart_stream_acquire()) != 0) {
+            for (uint16_t i = 0; i < USART_STREAM_LEN; i += STREAM_REC_LEN) {
+                if (report) stream_record(&buf[i], "BPS", stream_bench.bytes_per_s);
+                else        stream_record(&buf[i], "TLM", stream_counter++);
+                report = 0;
+            }
+            usart_stream_commit(buf, USART_STREAM_LEN);
+        }
 
-        DMA2_Stream7->CR |= DMA_SxCR_EN;   // Запуск потока DMA для передачи данных
-        delay_ms(1000);                    // задержка в 1 секунду
+        dt = DWT->CYCCNT - t0;
+        if (dt >= STREAM_BENCH_CYCLES) {
+            stream_bench.bytes_per_s = (uint32_t)((uint64_t)(usart_stream_stats.bytes - bytes0) * 84000000UL / dt);
+            stream_bench.line_pct    = stream_bench.bytes_per_s * 10 * 100 / uart1.baud.baud;  // 10 бит на байт (8N1)
+            stream_bench.underruns   = usart_stream_stats.underruns - under0;
+            t0 += dt; bytes0 = usart_stream_stats.bytes; under0 = usart_stream_stats.underruns;
+            report = 1;
+        }
     }
 }
+#endif
+
+#if defined(UART_MULTI)
+#define MULTI_PORTS 3  // Портов петли
+#define MULTI_CHUNK 64 // Байт в одной записи usart_port_write() (делитель 256 - счётчик данных не сбивается)
+
+static uint8_t multi_rx[MULTI_PORTS][1024] USART_DMA_BUF; // Буферы портов петли
+static uint8_t multi_tx[MULTI_PORTS][1024] USART_DMA_BUF;
+
+#if defined(MULTI_FLOW)
+#define MULTI_FC2 UART_FC_USART2 // RTS/CTS USART2 и USART3 (перемычки PD4-PD3, PB14-PB13)
+#define MULTI_FC3 UART_FC_USART3
+#else
+#define MULTI_FC2 UART_FC_NONE
+#define MULTI_FC3 UART_FC_NONE
+#endif
 
+static const usart_port_cfg_t multi_cfg[MULTI_PORTS] = {
+    { UART_HW_USART2, MULTI_BAUD, multi_rx[0], sizeof(multi_rx[0]), multi_tx[0], sizeof(multi_tx[0]), UART_IRQ_PRIO, 0,
+      MULTI_FC2 },
+    { UART_HW_USART3, MULTI_BAUD, multi_rx[1], sizeof(multi_rx[1]), multi_tx[1], sizeof(multi_tx[1]), UART_IRQ_PRIO, 0,
+      MULTI_FC3 },
+    { UART_HW_USART6, MULTI_BAUD, multi_rx[2], sizeof(multi_rx[2]), multi_tx[2], sizeof(multi_tx[2]), UART_IRQ_PRIO, 0,
+      UART_FC_NONE },
+};
+static const char multi_name[MULTI_PORTS] = { '2', '3', '6' };
 
+usart_port_t multi_port[MULTI_PORTS];                 // USART2, USART3, USART6
 
 /**
- * @brief Инициализация USART1.
+ * @brief Обмен по петле через три порта одновременно.
  *
- * Настраивает пины PA9 (TX) и PA10 (RX) для альтернативной функции USART1,
- * устанавливает скорость передачи 115200 бод.
+ * Каждый порт передаёт возрастающую последовательность байт и проверяет её при приёме. 1 раз в секунду по USART1
+ * передаются записи "RXn" (байт/с принято портом USARTn) и "ERn" (нарушений последовательности и ошибок линии).
+ * При MULTI_FLOW приём читается не чаще 1 раза в MULTI_READ_CYCLES (медленнее линии): USART2 и USART3 останавливает
+ * RTS/CTS без ошибок, запись "PSn" - количество остановок приёма, у USART6 без управления потоком растёт "ERn".
  */
-void usart1_init(void) {
-    RCC->APB2ENR |= RCC_APB2ENR_USART1EN;                                        // Включение тактирования USART1
-    RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN;                                         // Включение тактирования порта A
-
-    // Настройка скорости передачи. В данном примере используется значение 0x2D9
-    USART1->BRR = 0x2D9; // 115200 бод (при SystemCoreClock = 16 МГц)
-    // Включение передатчика и самого USART1
-    USART1->CR1 |= USART_CR1_TE | USART_CR1_UE;
-    USART1->CR2 &= ~USART_CR2_STOP;                                              // Настройка на 1 стоп-бит
-    USART1->CR3 |= USART_CR3_DMAT;                                               // Разрешение работы DMA для передачи данных
-
-    // Настройка пинов PA9 (TX) и PA10 (RX) в альтернативный режим (AF7 для USART1)
-    GPIOA->MODER |= GPIO_MODER_MODE9_1 | GPIO_MODER_MODE10_1;                    // Режим альтернативной функции
-    GPIOA->AFR[1] |= (7 << GPIO_AFRH_AFSEL9_Pos) | (7 << GPIO_AFRH_AFSEL10_Pos); // AF7 для USART1
+static void multi_run(void) {
+    uint8_t  tx_seq[MULTI_PORTS] = { 0 }, rx_seq[MULTI_PORTS] = { 0 };
+    uint32_t bad[MULTI_PORTS] = { 0 }, rx0[MULTI_PORTS] = { 0 }, t0, dt;
+    uint8_t  buf[MULTI_CHUNK], rec[STREAM_REC_LEN];
+    char     tag[4] = "RX0";
+    uint16_t n;
+#if defined(MULTI_FLOW)
+    uint32_t t_read = 0;
+#endif
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+
+    for (uint8_t i = 0; i < MULTI_PORTS; i++) usart_port_init(&multi_port[i], &multi_cfg[i]);
+    t0 = DWT->CYCCNT;
+
+    while (1) {
+        for (uint8_t i = 0; i < MULTI_PORTS; i++) {
+            usart_port_t *port = &multi_port[i];
+
+            for (uint8_t k = 0; k < MULTI_CHUNK; k++) buf[k] = (uint8_t)(tx_seq[i] + k);
+            if (usart_port_write(port, buf, MULTI_CHUNK)) tx_seq[i] += MULTI_CHUNK;
+
+#if defined(MULTI_FLOW)
+            if (DWT->CYCCNT - t_read < MULTI_READ_CYCLES) continue;
+            if (i == MULTI_PORTS - 1) t_read = DWT->CYCCNT;
+#endif
+            n = usart_port_read(port, buf, sizeof(buf));
+            for (uint16_t k = 0; k < n; k++) {
+                if (buf[k] != rx_seq[i]) bad[i]++;
+                rx_seq[i] = (uint8_t)(buf[k] + 1);
+            }
+        }
+
+        dt = DWT->CYCCNT - t0;
+        if (dt >= STREAM_BENCH_CYCLES) {
+            for (uint8_t i = 0; i < MULTI_PORTS; i++) {
+                const usart_port_stats_t *st = &multi_port[i].stats;
+
+                tag[0] = 'R'; tag[1] = 'X'; tag[2] = multi_name[i];
+                stream_record(rec, tag, (uint32_t)((uint64_t)(st->rx_bytes - rx0[i]) * 84000000UL / dt));
+                usart_port_write(&uart1, rec, sizeof(rec));
+
+                tag[0] = 'E'; tag[1] = 'R';
+                stream_record(rec, tag, bad[i] + st->ore + st->fe + st->ne + st->dma_errors);
+                usart_port_write(&uart1, rec, sizeof(rec));
+#if defined(MULTI_FLOW)
+                tag[0] = 'P'; tag[1] = 'S';
+                stream_record(rec, tag, st->rx_pauses);
+                usart_port_write(&uart1, rec, sizeof(rec));
+#endif
+
+                rx0[i] = st->rx_bytes;
+            }
+            t0 += dt;
+        }
+    }
 }
 
+void USART2_IRQHandler(void) { usart_port_irq(&multi_port[0]); }
+void USART3_IRQHandler(void) { usart_port_irq(&multi_port[1]); }
+void USART6_IRQHandler(void) { usart_port_irq(&multi_port[2]); }
+#endif
+
+#if defined(USART_SG)
+static uint8_t sg_head[STREAM_REC_LEN] USART_DMA_BUF; // Заголовок "PKT nnnnnnnnnn\r\n"
+static uint8_t sg_data[SG_PAYLOAD + 2] USART_DMA_BUF; // Данные и "\r\n"
+static uint8_t sg_crc[STREAM_REC_LEN]  USART_DMA_BUF; // "CRC nnnnnnnnnn\r\n": CRC-16 заголовка и данных
+
+// Пакет - три сегмента без копирования в буфер передачи USART1
+static const dma_seg_t sg_seg[3] = {
+    { sg_head, sizeof(sg_head), &sg_seg[1] },
+    { sg_data, sizeof(sg_data), &sg_seg[2] },
+    { sg_crc,  sizeof(sg_crc),  0 },
+};
+
 /**
- * @brief Инициализация DMA для копирования данных из памяти в память.
- *
- * Копирует содержимое массива bufferOUT в bufferIN.
- * Используется канал DMA2, Stream0 в режиме память-память.
+ * @brief CRC-16/CCITT-FALSE (полином 0x1021, начальное значение 0xFFFF), продолжение вычисления с crc.
  */
-void DMA2_Stream0_MEM2MEM_Init(void) {
-    RCC->AHB1ENR |= RCC_AHB1ENR_DMA2EN;                                // Включаем тактирование DMA2
-    
-    // Настройка DMA потока: направление, инкремент адресов и количество данных
-    DMA2_Stream0->CR = DMA_SxCR_DIR_1 | DMA_SxCR_PINC | DMA_SxCR_MINC; // Режим память-память
-    DMA2_Stream0->NDTR = BUF_SIZE;                                     // Размер буфера
-    DMA2_Stream0->PAR = (uint32_t)bufferOUT;                           // Адрес источника (bufferOUT)
-    DMA2_Stream0->M0AR = (uint32_t)bufferIN;                           // Адрес назначения (bufferIN)
-    
-    DMA2_Stream0->CR |= DMA_SxCR_EN;                                   // Запуск DMA
-    // Ожидание завершения копирования
-    while (!(DMA2->LISR & DMA_LISR_TCIF0));                            // Ожидаем флага завершения передачи
-    // Сброс флага завершения передачи
-    DMA2->LIFCR |= DMA_LIFCR_CTCIF0;                                   // Очистка флага завершения
+static uint16_t sg_crc16(uint16_t crc, const uint8_t *p, uint16_t n) {
+    while (n--) {
+        crc ^= (uint16_t)(*p++ << 8);
+        for (uint8_t i = 0; i < 8; i++) crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+    return crc;
 }
 
 /**
- * @brief Инициализация DMA для передачи данных по USART1.
+ * @brief Передача пакетов цепочкой DMA вперемешку с записями в буфер передачи USART1.
  *
- * Используется DMA2 Stream7 для передачи данных из bufferIN в регистр данных USART1.
- * Канал настроен для режима "из памяти в периферию" с включенным прерыванием по завершению передачи.
+ * Порядок на линии для пакета n: "TXT n" (usart_port_write() до цепочки), "PKT n", SG_PAYLOAD байт данных,
+ * "CRC c" (цепочка usart_port_write_sg()), "END n" (usart_port_write() после цепочки - ждёт её окончания).
+ * Строка "TXT" длиной 16..22 байт сдвигает записи в буфере передачи, поэтому граница цепочки (tx_sg_at) и конец
+ * буфера приходятся на разные места строк. Приёмная сторона проверяет порядок номеров и CRC пакета.
+ * 1 раз в секунду - записи статистики цепочек uart1.tx_chain.stats: "SGC" (цепочек), "SGS" (сегментов),
+ * "SGE" (цепочек с ошибкой), "SGG" (наибольшая пауза между сегментами, такты), "SGA" (средняя пауза, такты) и
+ * "SGD" (отброшено сообщений usart_port_write()).
  */
-void DMA2_Stream7_USART1_Init(void) {
-    RCC->AHB1ENR |= RCC_AHB1ENR_DMA2EN;  // Включаем тактирование DMA2
-    
-    // Настройка DMA потока: выбор канала, направление, инкремент адресов, приоритет и прерывания
-    DMA2_Stream7->CR = DMA_SxCR_CHSEL_2 | DMA_SxCR_MINC | DMA_SxCR_DIR_0 | DMA_SxCR_PL | DMA_SxCR_TCIE;
-    DMA2_Stream7->NDTR = BUF_SIZE;             // Размер буфера для передачи
-    DMA2_Stream7->PAR = (uint32_t)&USART1->DR; // Адрес регистра данных USART1 (периферия)
-    DMA2_Stream7->M0AR = (uint32_t)bufferIN;   // Адрес источника данных (bufferIN)
-    
-    NVIC_EnableIRQ(DMA2_Stream7_IRQn);         // Разрешаем прерывание по завершению передачи DMA
+static void sg_run(void) {
+    static const char tag[][4] = { "SGC", "SGS", "SGE", "SGG", "SGA", "SGD" };
+    uint32_t seq = 0, t0, dt;
+    uint8_t  line[STREAM_REC_LEN + 6], n;
+    uint16_t crc;
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+    t0 = DWT->CYCCNT;
+
+    while (1) {
+        while (usart_port_sg_busy(&uart1));              // Буферы сегментов изменяются только после передачи
+
+        stream_record(sg_head, "PKT", seq);
+        for (uint8_t i = 0; i < SG_PAYLOAD; i++) sg_data[i] = (uint8_t)('A' + (seq + i) % 26);
+        sg_data[SG_PAYLOAD] = '\r'; sg_data[SG_PAYLOAD + 1] = '\n';
+        crc = sg_crc16(sg_crc16(0xFFFF, sg_head, sizeof(sg_head)), sg_data, sizeof(sg_data));
+        stream_record(sg_crc, "CRC", crc);
+
+        n = (uint8_t)(seq % 7);                          // "TXT nnnnnnnnnn" + n точек + "\r\n"
+        stream_record(line, "TXT", seq);
+        for (uint8_t i = 0; i < n; i++) line[14 + i] = '.';
+        line[14 + n] = '\r'; line[15 + n] = '\n';
+        usart_port_write(&uart1, line, (uint16_t)(STREAM_REC_LEN + n));
+        usart_port_write_sg(&uart1, &sg_seg[0]);         // Цепочка свободна: принимается всегда
+        stream_record(line, "END", seq++);
+        usart_port_write(&uart1, line, STREAM_REC_LEN);
+
+        dt = DWT->CYCCNT - t0;
+        if (dt >= STREAM_BENCH_CYCLES) {
+            const dma_chain_stats_t *cs = &uart1.tx_chain.stats;
+            uint32_t val[6];
+
+            val[0] = cs->chains;
+            val[1] = cs->segs;
+            val[2] = cs->errors;
+            val[3] = cs->gap_max;
+            val[4] = cs->segs > cs->chains ? cs->gap_sum / (cs->segs - cs->chains) : 0;
+            val[5] = uart1.stats.tx_dropped;
+            for (uint8_t i = 0; i < 6; i++) {
+                stream_record(line, tag[i], val[i]);
+                usart_port_write(&uart1, line, STREAM_REC_LEN);
+            }
+            t0 += dt;
+        }
+    }
+}
+#endif
+
+#if defined(MEMCPY_BENCH)
+static uint8_t           bench_src[MEMCPY_BENCH_MAX + 16] USART_DMA_BUF __attribute__((aligned(16))); // SRAM1
+static uint8_t           bench_dst[MEMCPY_BENCH_MAX + 16] USART_DMA_BUF __attribute__((aligned(16)));
+static volatile uint32_t bench_done;                 // DWT->CYCCNT в callback-функции (0 - не выполнено)
+
+static void bench_cb(void *dst, uint32_t len) {
+    (void)dst; (void)len;
+    bench_done = DWT->CYCCNT | 1;
 }
 
 /**
- * @brief Обработчик прерывания DMA2 Stream7.
+ * @brief Запись числа в поле шириной w символов (выравнивание вправо).
+ */
+static char *bench_num(char *p, uint32_t v, uint8_t w) {
+    for (int8_t i = (int8_t)w - 1; i >= 0; i--) {
+        p[i] = (i == (int8_t)w - 1 || v) ? (char)('0' + v % 10) : ' ';
+        v /= 10;
+    }
+    return p + w;
+}
+
+static void bench_send(const char *line, uint16_t len) {
+    while (!usart_port_tx_idle(&uart1));                 // Таблица больше буфера передачи USART1
+    usart_port_write(&uart1, line, len);
+}
+
+/**
+ * @brief Сравнение memcpy() и dma_memcpy_async() по размерам и смещениям источника/приёмника, таблица по USART1.
  *
- * При завершении передачи данных по DMA для USART1 сбрасывает флаг завершения передачи (transfer_complete).
+ * Столбцы: размер, смещения источника и приёмника от адреса, выровненного на 16, такты memcpy(), такты DMA от вызова
+ * до callback-функции, такты ядра в dma_memcpy_async() (остальное время ядро свободно), результат сравнения.
  */
-void DMA2_Stream7_IRQHandler(void) {
-    if (DMA2->HISR & DMA_HISR_TCIF7) {    // Проверяем флаг завершения передачи
-        DMA2->HIFCR |= DMA_HIFCR_CTCIF7;  // Сброс флага завершения передачи
+static void memcpy_bench(void) {
+    static const uint16_t size[]       = { 16, 64, 256, 1024, MEMCPY_BENCH_MAX };
+    static const uint8_t  off[][2]     = { { 0, 0 }, { 4, 4 }, { 1, 1 }, { 1, 0 } }; // Пакеты, слова, слова, упаковка
+    static const char     head[]       = "  size src/dst  cpu,cyc  dma,cyc call,cyc\r\n";
+    char                  line[48], *p;
+    uint32_t              t0, t_cpu, t_call, t_dma;
+    uint8_t               ok;
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+
+    for (uint32_t i = 0; i < sizeof(bench_src); i++) bench_src[i] = (uint8_t)(i * 7 + 1);
+    bench_send(head, sizeof(head) - 1);
+
+    for (uint8_t k = 0; k < sizeof(size) / sizeof(size[0]); k++) {
+        for (uint8_t j = 0; j < sizeof(off) / sizeof(off[0]); j++) {
+            const uint8_t *src = bench_src + off[j][0];
+            uint8_t       *dst = bench_dst + off[j][1];
+            uint16_t       n   = size[k];
+
+            t0    = DWT->CYCCNT;
+            memcpy(dst, src, n);
+            t_cpu = DWT->CYCCNT - t0;
+
+            for (uint16_t i = 0; i < n; i++) dst[i] = 0;
+            bench_done = 0;
+            t0     = DWT->CYCCNT;
+            dma_memcpy_async(dst, src, n, bench_cb);
+            t_call = DWT->CYCCNT - t0;
+            while (!bench_done);
+            t_dma  = bench_done - t0;
+            ok     = memcmp(dst, src, n) == 0;
+
+            p = bench_num(line, n, 6);
+            *p++ = ' '; *p++ = ' '; *p++ = ' '; *p++ = (char)('0' + off[j][0]); *p++ = '/'; *p++ = (char)('0' + off[j][1]);
+            p = bench_num(p, t_cpu, 9);
+            p = bench_num(p, t_dma, 9);
+            p = bench_num(p, t_call, 9);
+            *p++ = ' '; *p++ = ok ? 'O' : 'E'; *p++ = ok ? 'K' : 'R';
+            *p++ = '\r'; *p++ = '\n';
+            bench_send(line, (uint16_t)(p - line));
+        }
     }
 }
+#endif
+
+
+/**
+ * @brief Основная функция программы. Инициализирует систему, выполняет копирование данных и настраивает периферию.
+ */
+int main(void) {
+    SystemInit();                // Инициализация системы микроконтроллера
+    rcc_init();                  // Включение тактирования необходимых периферийных устройств
+    dma_memcpy_init();           // Поток DMA2 для копирования память-память (dma_memcpy.c, dma_mgr.c)
+    dma_memcpy(bufferIN, bufferOUT, BUF_SIZE); // Копирование данных: bufferOUT -> bufferIN
+    usart1_init();               // Инициализация USART1 (usart_port.c: DMA2 Stream2 - приём, Stream7 - передача)
+#if defined(MEMCPY_BENCH)
+    memcpy_bench();              // Таблица времени копирования по USART1
+#endif
+#if defined(USART_STREAM)
+    stream_run();                // Непрерывный поток телеметрии (возврат - только если поток занят)
+#elif defined(UART_MULTI)
+    multi_run();                 // Обмен по петле через USART2, USART3, USART6 (не возвращается)
+#elif defined(USART_SG)
+    sg_run();                    // Пакеты цепочкой DMA по USART1 (не возвращается)
+#endif
+
+ 
+    while (1) {
+
+        usart_port_write(&uart1, bufferIN, BUF_SIZE); // Передача строки через DMA2 Stream7
+        delay_ms(1000);                               // задержка в 1 секунду
+    }
+}
+
+
+
+/**
+ * @brief Инициализация USART1.
+ *
+ * Выводы PA9 (TX) и PA10 (RX) в режиме AF7, скорость USART1_BAUD, приём и передача через DMA (usart_port.c).
+ */
+void usart1_init(void) {
+    usart_port_init(&uart1, &uart1_cfg);
+}
+
+/**
+ * @brief Обработчик прерывания USART1 (usart_port.c). Прерывания потоков DMA обслуживает dma_mgr.c.
+ */
+void USART1_IRQHandler(void) { usart_port_irq(&uart1); }
 
 
  /**
@@ -0,0 +1,207 @@
+/**
+ * @file        : usart_stream.c
+ * @brief       : Непрерывная передача USART1 через DMA2 Stream7 в режиме двойного буфера (DBM).
+ * @author      : xmatech
+ * @date        : 19.03.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ *
+ * @Description : В режиме DBM поток по окончании буфера (TC) сам переключается на другой регистр адреса (CT) и продолжает
+ *                передачу. Регистр адреса, не используемый в данный момент (M0AR при CT = 1, M1AR при CT = 0),
+ *                можно изменять при включённом потоке. В прерывании TC:
+ *                - буфер, передача которого закончилась, возвращается в список свободных;
+ *                - в свободный регистр адреса записывается следующий буфер очереди или буфер нулей (underrun).
+ *                Таким образом, у приложения есть время передачи целого буфера (USART_STREAM_LEN * 10 бит),
+ *                чтобы поставить следующий, а передаваемые буферы никогда не изменяются во время передачи.
+ *                Очередь и список свободных буферов изменяются в прерывании и при запрещённых прерываниях.
+ *                Модуль собирается при USART_STREAM (main.h): поток запроса USART1_TX (DMA2 Stream7) выдаёт dma_mgr.c,
+ *                поэтому передача usart_port.c для USART1 в этом режиме не настраивается (DMA_REQ_NONE).
+ */
+
+#include "main.h"
+
+#if defined(USART_STREAM)
+
+#define USART_STREAM_MASK (USART_STREAM_BUFS - 1)
+
+usart_stream_stats_t usart_stream_stats;
+
+static uint8_t  usart_stream_buf[USART_STREAM_BUFS][USART_STREAM_LEN] USART_DMA_BUF; // Буферы приложения (SRAM1)
+static uint8_t  usart_stream_zero[USART_STREAM_LEN] USART_DMA_BUF;                   // Буфер нулей для underrun
+static uint16_t usart_stream_used[USART_STREAM_BUFS];                  // Байт данных в буфере
+
+static uint8_t  usart_stream_queue[USART_STREAM_BUFS];  // Очередь номеров буферов к передаче
+static uint8_t  usart_stream_q_head = 0, usart_stream_q_tail = 0;
+static uint8_t  usart_stream_free   = 0;                // Маска свободных буферов
+static int8_t   usart_stream_slot[2] = { -1, -1 };      // Номер буфера в M0AR/M1AR (-1 - буфер нулей)
+static DMA_Stream_TypeDef *usart_stream_dma = 0;        // Поток передачи (dma_mgr_claim())
+static uint8_t  usart_stream_burst  = 0;                // Перезапусков после ошибки подряд
+
+static void usart_stream_dma_irq(void *ctx, uint32_t flags);
+
+/**
+ * @brief Следующий буфер для регистра адреса: из очереди или буфер нулей.
+ *
+ * @param slot 0 - M0AR, 1 - M1AR.
+ * @return uint32_t Адрес буфера.
+ */
+static uint32_t usart_stream_next(uint8_t slot) {
+    uint8_t n;
+
+    if (usart_stream_q_head == usart_stream_q_tail) {
+        usart_stream_slot[slot] = -1;
+        return (uint32_t)usart_stream_zero;
+    }
+
+    n = usart_stream_queue[usart_stream_q_tail++ & USART_STREAM_MASK];
+    usart_stream_slot[slot] = (int8_t)n;
+    return (uint32_t)usart_stream_buf[n];
+}
+
+/**
+ * @brief Настройка потока USART1_TX (DMA2 Stream7, канал 4): память -> периферия, DBM, прерывания TC, TE и DME.
+ *
+ * @return uint8_t 1 - поток получен, 0 - поток занят другим драйвером (dma_mgr_stats.conflicts).
+ */
+uint8_t usart_stream_init(void) {
+    uint8_t ch;
+
+    usart_stream_dma = dma_mgr_claim(DMA_REQ_USART1_TX, &ch, usart_stream_dma_irq, 0, UART_IRQ_PRIO);
+    if (!usart_stream_dma) return 0;
+
+    usart_stream_dma->CR   = ((uint32_t)ch << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_DBM | DMA_SxCR_MINC | DMA_SxCR_DIR_0 |
+                             DMA_SxCR_PL | DMA_SxCR_TCIE | DMA_SxCR_TEIE | DMA_SxCR_DMEIE;
+    usart_stream_dma->NDTR = USART_STREAM_LEN;
+    usart_stream_dma->PAR  = (uint32_t)&USART1->DR;
+
+    usart_stream_free   = (1 << USART_STREAM_BUFS) - 1;
+    usart_stream_q_head = usart_stream_q_tail = 0;
+    for (uint16_t i = 0; i < USART_STREAM_LEN; i++) usart_stream_zero[i] = 0; // Буфер без инициализации при старте
+
+    USART1->CR3 |= USART_CR3_DMAT;                           // Запросы DMA по TXE
+    return 1;
+}
+
+/**
+ * @brief Включение остановленного потока: первые два буфера очереди (или буферы нулей) в M0AR и M1AR.
+ */
+static void usart_stream_arm(void) {
+    dma_mgr_clear(usart_stream_dma, DMA_MGR_ALL);
+    usart_stream_dma->CR  &= ~DMA_SxCR_CT;                   // Начало с M0AR
+    usart_stream_dma->M0AR = usart_stream_next(0);
+    usart_stream_dma->M1AR = usart_stream_next(1);
+    usart_stream_dma->NDTR = USART_STREAM_LEN;
+    usart_stream_dma->CR  |= DMA_SxCR_EN;
+}
+
+/**
+ * @brief Запуск передачи.
+ */
+void usart_stream_start(void) {
+    __disable_irq();
+    usart_stream_burst = 0;
+    usart_stream_arm();
+    __enable_irq();
+}
+
+/**
+ * @brief Остановка передачи. Незавершённый буфер не передаётся, буферы возвращаются в список свободных.
+ */
+void usart_stream_stop(void) {
+    __disable_irq();
+    usart_stream_dma->CR &= ~DMA_SxCR_EN;
+    while (usart_stream_dma->CR & DMA_SxCR_EN);
+    for (uint8_t s = 0; s < 2; s++) {
+        if (usart_stream_slot[s] >= 0) usart_stream_free |= 1 << usart_stream_slot[s];
+        usart_stream_slot[s] = -1;
+    }
+    while (usart_stream_q_head != usart_stream_q_tail)
+        usart_stream_free |= 1 << usart_stream_queue[usart_stream_q_tail++ & USART_STREAM_MASK];
+    __enable_irq();
+}
+
+/**
+ * @brief Получение свободного буфера для заполнения.
+ *
+ * @return uint8_t* Буфер USART_STREAM_LEN байт или 0 - все буферы в очереди или передаются.
+ */
+uint8_t *usart_stream_acquire(void) {
+    uint8_t *buf = 0;
+
+    __disable_irq();
+    for (uint8_t n = 0; n < USART_STREAM_BUFS; n++) {
+        if (usart_stream_free & (1 << n)) {
+            usart_stream_free &= ~(1 << n);
+            buf = usart_stream_buf[n];
+            break;
+        }
+    }
+    __enable_irq();
+
+    return buf;
+}
+
+/**
+ * @brief Постановка заполненного буфера в очередь передачи.
+ *
+ * @param buf Буфер, полученный usart_stream_acquire().
+ * @param len Байт данных (остаток буфера заполняется нулями).
+ */
+void usart_stream_commit(uint8_t *buf, uint16_t len) {
+    uint8_t n = (uint8_t)((buf - usart_stream_buf[0]) / USART_STREAM_LEN);
+
+    for (uint16_t i = len; i < USART_STREAM_LEN; i++) buf[i] = 0;
+    usart_stream_used[n] = len;
+
+    __disable_irq();
+    usart_stream_queue[usart_stream_q_head++ & USART_STREAM_MASK] = n;
+    __enable_irq();
+}
+
+/**
+ * @brief Прерывание потока передачи (dma_mgr.c, флаги уже сброшены): окончание буфера (TC) или ошибка (TE, DME).
+ *
+ * Поток, отключённый ошибкой, перезапускается в этом же прерывании со следующего буфера очереди: прерванные буферы
+ * не передаются повторно (часть уже на линии), а возвращаются в список свободных.
+ */
+static void usart_stream_dma_irq(void *ctx, uint32_t flags) {
+    uint8_t done;
+    int8_t  n;
+
+    (void)ctx;
+    if (flags & (DMA_MGR_TE | DMA_MGR_DME)) usart_stream_stats.errors++;
+
+    if ((flags & DMA_MGR_ERR) && !(usart_stream_dma->CR & DMA_SxCR_EN)) { // Поток отключён аппаратно
+        for (uint8_t s = 0; s < 2; s++) {
+            if (usart_stream_slot[s] >= 0) {
+                usart_stream_free |= 1 << usart_stream_slot[s];
+                usart_stream_stats.lost++;
+            }
+            usart_stream_slot[s] = -1;
+        }
+        if (usart_stream_burst < USART_STREAM_REARM_MAX) {
+            usart_stream_burst++;
+            usart_stream_stats.rearms++;
+            usart_stream_arm();
+        }
+        return;
+    }
+
+    if (flags & DMA_MGR_TC) {
+        usart_stream_burst = 0;
+        done = (usart_stream_dma->CR & DMA_SxCR_CT) ? 0 : 1; // CT указывает на уже начатый буфер
+        n    = usart_stream_slot[done];
+        if (n >= 0) {
+            usart_stream_stats.buffers++;
+            usart_stream_stats.bytes += usart_stream_used[n];
+            usart_stream_free |= 1 << n;                     // Передача буфера закончилась
+        }
+
+        if (done) usart_stream_dma->M1AR = usart_stream_next(1); // Свободный регистр - следующий буфер
+        else      usart_stream_dma->M0AR = usart_stream_next(0);
+        if (usart_stream_slot[done] < 0) usart_stream_stats.underruns++;
+    }
+}
+
+#endif // USART_STREAM
@@ -0,0 +1,118 @@
+/**
+ * @file        : dma_chain.c
+ * @brief       : Программные цепочки сегментов DMA (scatter-gather) для потоков, выданных dma_mgr.c.
+ * @author      : xmatech
+ * @date        : 19.03.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ *
+ * @Description : По TC поток в обычном режиме сам сбрасывает EN, остальные биты CR сохраняются. Поэтому перезапуск -
+ *                три записи: M0AR, NDTR, CR |= EN. Флаги к этому моменту уже сброшены (dma_mgr.c или драйвер).
+ *                Значения следующего сегмента читаются до записи в поток, время между TC и EN = 1 - чтение
+ *                дескриптора и три записи на шине AHB.
+ *                c->seg изменяется в прерывании потока или при запрещённом прерывании потока.
+ */
+
+#include "dma_chain.h"
+
+/**
+ * @brief Привязка цепочки к потоку и запуск счётчика тактов DWT (измерение пауз между сегментами).
+ *
+ * @param c Цепочка.
+ * @param s Поток, полученный dma_mgr_claim(); CR (направление, размеры, MINC, TCIE, TEIE) и PAR записывает драйвер.
+ */
+void dma_chain_init(dma_chain_t *c, DMA_Stream_TypeDef *s) {
+    c->s     = s;
+    c->seg   = 0;
+    c->stats = (dma_chain_stats_t){ 0 };
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/**
+ * @brief Запуск цепочки: флаги сбрасываются, первый сегмент записывается в поток, EN = 1.
+ *
+ * Вызывается при остановленном потоке и запрещённом прерывании потока (или с его приоритетом).
+ *
+ * @param c   Цепочка.
+ * @param seg Первый сегмент, следующие - по next. Сегменты нулевой длины не допускаются (NDTR = 0).
+ * @return uint8_t 1 - цепочка запущена, 0 - цепочка уже выполняется или сегмент пустой.
+ */
+uint8_t dma_chain_start(dma_chain_t *c, const dma_seg_t *seg) {
+    if (c->seg || !c->s || !seg) return 0;
+    for (const dma_seg_t *p = seg; p; p = p->next) {
+        if (!p->len) return 0;
+    }
+
+    c->seg = seg;
+    dma_mgr_clear(c->s, DMA_MGR_ALL);
+    c->s->M0AR = (uint32_t)seg->addr;
+    c->s->NDTR = seg->len;
+    c->s->CR  |= DMA_SxCR_EN;
+    return 1;
+}
+
+/**
+ * @brief Обработка флагов потока в его callback-функции dma_mgr.c: по TC - запуск следующего сегмента.
+ *
+ * Пауза отсчитывается от входа в прерывание потока (dma_mgr_irq_entry()).
+ *
+ * @param c     Цепочка.
+ * @param flags Флаги DMA_MGR_* (уже сброшены).
+ * @return uint8_t DMA_CHAIN_BUSY - цепочка продолжается, DMA_CHAIN_DONE - передан последний сегмент,
+ *                 DMA_CHAIN_ERROR - ошибка TE, поток остановлен.
+ */
+uint8_t dma_chain_irq(dma_chain_t *c, uint32_t flags) {
+    return dma_chain_irq_at(c, flags, dma_mgr_irq_entry(c->s));
+}
+
+/**
+ * @brief Обработка флагов потока с заданным началом паузы.
+ *
+ * @param c     Цепочка.
+ * @param flags Флаги DMA_MGR_* (уже сброшены).
+ * @param t0    DWT->CYCCNT обнаружения TC: вход в прерывание или чтение флагов при опросе.
+ * @return uint8_t DMA_CHAIN_BUSY, DMA_CHAIN_DONE или DMA_CHAIN_ERROR (см. dma_chain_irq()).
+ */
+uint8_t dma_chain_irq_at(dma_chain_t *c, uint32_t flags, uint32_t t0) {
+    uint32_t         gap;
+    const dma_seg_t *next;
+
+    if (!c->seg) return DMA_CHAIN_BUSY;
+
+    if (flags & DMA_MGR_TE) {                   // Поток отключён аппаратно
+        c->seg = 0;
+        c->stats.errors++;
+        return DMA_CHAIN_ERROR;
+    }
+    if (!(flags & DMA_MGR_TC)) return DMA_CHAIN_BUSY;
+
+    c->stats.segs++;
+    next = c->seg->next;
+    if (!next) {
+        c->seg = 0;
+        c->stats.chains++;
+        return DMA_CHAIN_DONE;
+    }
+
+    c->seg     = next;
+    c->s->M0AR = (uint32_t)next->addr;
+    c->s->NDTR = next->len;
+    c->s->CR  |= DMA_SxCR_EN;                   // Запрос периферии активен - передача продолжается сразу
+
+    gap = DWT->CYCCNT - t0;
+    c->stats.gap_last = gap;
+    c->stats.gap_sum += gap;
+    if (gap > c->stats.gap_max) c->stats.gap_max = gap;
+
+    return DMA_CHAIN_BUSY;
+}
+
+/**
+ * @brief Проверка выполнения цепочки.
+ */
+uint8_t dma_chain_busy(const dma_chain_t *c) {
+    return c->seg != 0;
+}
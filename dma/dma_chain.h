@@ -0,0 +1,69 @@
+/**
+ * @file        : dma_chain.h
+ * @brief       : Программные цепочки сегментов DMA (scatter-gather) для потоков, выданных dma_mgr.c.
+ * @author      : xmatech
+ * @date        : 19.03.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ *
+ * @Description : У DMA STM32F4 нет списков дескрипторов: поток передаёт один блок (M0AR, NDTR) и останавливается по TC.
+ *                Цепочка dma_seg_t (адрес, длина, next) позволяет передать, например, заголовок, данные и CRC пакета
+ *                из разных буферов без копирования в один: по TC поток перезаписывается следующим сегментом
+ *                (M0AR, NDTR, EN = 1). Остальные биты CR и PAR не меняются - их записывает драйвер потока один раз.
+ *                - Модуль не владеет потоком и его прерыванием: драйвер вызывает dma_chain_irq() из своей
+ *                  callback-функции dma_mgr.c или в цикле опроса флагов (dma_mgr_flags()/dma_mgr_clear()).
+ *                - Запрос периферии (TXE USART, TXE SPI) остаётся активным, пока поток перезаписывается: первый байт
+ *                  следующего сегмента уходит сразу после EN = 1. У USART и SPI есть запас - регистр сдвига ещё
+ *                  передаёт последний байт предыдущего сегмента, поэтому при коротком прерывании пауз на линии нет.
+ *                - Пауза между сегментами (gap) измеряется DWT->CYCCNT от входа в прерывание потока (dma_mgr_irq_entry():
+ *                  первая инструкция обработчика dma_mgr.c) до записи EN = 1, т.е. с диспетчером, сбросом флагов
+ *                  и кодом драйвера до dma_chain_irq(). Не входят только задержка установки флага TC и аппаратный вход
+ *                  в исключение (12 тактов Cortex-M4, больше при вытеснении прерыванием с большим приоритетом).
+ *                  При опросе флагов начало паузы передаёт драйвер: dma_chain_irq_at().
+ *                Буферы сегментов должны быть доступны DMA (не CCM RAM) и не изменяться до окончания цепочки.
+ */
+
+#ifndef DMA_CHAIN_H
+#define DMA_CHAIN_H
+
+#include "dma_mgr.h"
+
+// Результат dma_chain_irq()
+#define DMA_CHAIN_BUSY  0 // Запущен следующий сегмент (или флаги не относятся к цепочке)
+#define DMA_CHAIN_DONE  1 // Последний сегмент передан
+#define DMA_CHAIN_ERROR 2 // Ошибка потока (TE): оставшиеся сегменты не передавались
+
+typedef struct dma_seg dma_seg_t;
+
+// Сегмент цепочки. Структура и буфер принадлежат вызывающей стороне
+struct dma_seg {
+    const void      *addr; // Адрес в памяти (M0AR)
+    uint16_t         len;  // Элементов размера PSIZE (NDTR), 1..65535
+    const dma_seg_t *next; // Следующий сегмент или 0
+};
+
+// Статистика цепочек потока
+typedef struct {
+    uint32_t chains;   // Завершено цепочек
+    uint32_t segs;     // Передано сегментов
+    uint32_t errors;   // Цепочек с ошибкой потока
+    uint32_t gap_last; // Пауза перед последним перезапуском, тактов
+    uint32_t gap_max;  // Наибольшая пауза, тактов
+    uint32_t gap_sum;  // Сумма пауз (среднее = gap_sum / (segs - chains)), тактов
+} dma_chain_stats_t;
+
+// Цепочка на потоке
+typedef struct {
+    DMA_Stream_TypeDef *s;         // Поток (dma_mgr_claim()), CR и PAR записаны драйвером
+    const dma_seg_t *volatile seg; // Передаваемый сегмент (0 - цепочка не выполняется)
+    dma_chain_stats_t   stats;
+} dma_chain_t;
+
+void    dma_chain_init(dma_chain_t *c, DMA_Stream_TypeDef *s); // Привязка к потоку, запуск DWT->CYCCNT
+uint8_t dma_chain_start(dma_chain_t *c, const dma_seg_t *seg); // Запуск первого сегмента, 0 - занято или пустой сегмент
+uint8_t dma_chain_irq(dma_chain_t *c, uint32_t flags);         // Обработка флагов потока: DMA_CHAIN_BUSY/DONE/ERROR
+uint8_t dma_chain_irq_at(dma_chain_t *c, uint32_t flags, uint32_t t0); // То же, начало паузы t0 (DWT->CYCCNT) - при опросе
+uint8_t dma_chain_busy(const dma_chain_t *c);                  // 1 - цепочка выполняется
+
+#endif // DMA_CHAIN_H
@@ -0,0 +1,387 @@
+/**
+ * @file        : dma_mgr.c
+ * @brief       : Распределение потоков DMA1/DMA2 по таблице запросов STM32F407 и диспетчер их прерываний.
+ * @author      : xmatech
+ * @date        : 19.03.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ *
+ * @Description : Потоки нумеруются 0..15: DMA1 Stream0..7, затем DMA2 Stream0..7. Флаги потоков 0..3 контроллера
+ *                находятся в LISR/LIFCR, 4..7 - в HISR/HIFCR со сдвигами 0, 6, 16, 22.
+ *                - Таблица dma_mgr_map: для каждого запроса до двух вариантов поток/канал в порядке предпочтения
+ *                  (первый - основной вариант RM0090). Запрос память-память может использовать любой поток DMA2:
+ *                  порядок dma_mgr_m2m начинается с потоков, нужных меньшему числу запросов периферии.
+ *                - Поток считается занятым, пока у него есть владелец (dma_mgr_slot[].req). Выдача и освобождение
+ *                  выполняются при запрещённых прерываниях.
+ *                - Контроллер определяется при обращении (DMA1/DMA2), а не по адресу потока: модель регистров host
+ *                  (spi-flash-memory/host) подменяет DMA1 и потоки SPI2 переменными.
+ *                - Восстановление: TE отключает поток всегда, FE и DME - только при ошибке настройки (FIFO или размеры
+ *                  при включении), обычно поток продолжает работу. Поэтому перезапуск выполняется по EN = 0 после
+ *                  любой ошибки, а не по виду ошибки. Сохранённая настройка записывается при остановленном потоке:
+ *                  время восстановления - время записи шести регистров в прерывании потока. Счётчик перезапусков
+ *                  подряд (burst) сбрасывается прерыванием HT без ошибок и любым TC - передача снова идёт.
+ *                - FE в прямом режиме (DMDIS = 0, FEIE выключен) может установиться без ошибки передачи: флаг
+ *                  сбрасывается, но в flags (callback-функция, dma_mgr_flags()) и dma_mgr_err[].fe не передаётся.
+ *                  DMA_MGR_FE означает ошибку FIFO только у потоков с включённым FIFO.
+ */
+
+#include "dma_mgr.h"
+
+#define DMA_MGR_ALT 2 // Вариантов поток/канал для запроса периферии
+
+// Вариант запроса: 1 - есть, канал (биты 4..6), номер потока 0..15 (биты 0..3)
+#define DMA_MGR_MAP(dma, stream, ch) (uint8_t)(0x80 | ((ch) << 4) | (((dma) - 1) << 3) | (stream))
+
+// Владелец потока
+typedef struct {
+    dma_mgr_cb_t cb;
+    void        *ctx;
+    uint8_t      req;   // dma_req_t (DMA_REQ_NONE - поток свободен)
+    uint8_t      max;   // Перезапусков подряд (0 - поток не восстанавливается)
+    uint8_t      burst; // Выполнено перезапусков подряд
+    uint32_t     cr, ndtr, par, m0ar, m1ar, fcr; // Настройка при dma_mgr_start()
+} dma_mgr_slot_t;
+
+dma_mgr_stats_t dma_mgr_stats;
+dma_mgr_err_t   dma_mgr_err[DMA_MGR_STREAMS];
+
+static dma_mgr_slot_t dma_mgr_slot[DMA_MGR_STREAMS];
+static uint32_t       dma_mgr_entry[DMA_MGR_STREAMS]; // DWT->CYCCNT при входе в прерывание потока
+
+static DMA_Stream_TypeDef *const dma_mgr_stream[DMA_MGR_STREAMS] = {
+    DMA1_Stream0, DMA1_Stream1, DMA1_Stream2, DMA1_Stream3, DMA1_Stream4, DMA1_Stream5, DMA1_Stream6, DMA1_Stream7,
+    DMA2_Stream0, DMA2_Stream1, DMA2_Stream2, DMA2_Stream3, DMA2_Stream4, DMA2_Stream5, DMA2_Stream6, DMA2_Stream7,
+};
+
+static const IRQn_Type dma_mgr_irq[DMA_MGR_STREAMS] = {
+    DMA1_Stream0_IRQn, DMA1_Stream1_IRQn, DMA1_Stream2_IRQn, DMA1_Stream3_IRQn,
+    DMA1_Stream4_IRQn, DMA1_Stream5_IRQn, DMA1_Stream6_IRQn, DMA1_Stream7_IRQn,
+    DMA2_Stream0_IRQn, DMA2_Stream1_IRQn, DMA2_Stream2_IRQn, DMA2_Stream3_IRQn,
+    DMA2_Stream4_IRQn, DMA2_Stream5_IRQn, DMA2_Stream6_IRQn, DMA2_Stream7_IRQn,
+};
+
+static const uint8_t dma_mgr_shift[4] = { 0, 6, 16, 22 }; // Сдвиг флагов потока в LISR/HISR
+
+// Потоки DMA2 для запроса память-память в порядке выдачи
+static const uint8_t dma_mgr_m2m[8] = { 12, 14, 11, 13, 9, 8, 10, 15 };
+
+// Варианты поток/канал запросов периферии (RM0090, табл. 42 - DMA1, табл. 43 - DMA2)
+static const uint8_t dma_mgr_map[DMA_REQ_COUNT][DMA_MGR_ALT] = {
+    [DMA_REQ_ADC1]      = { DMA_MGR_MAP(2, 0, 0), DMA_MGR_MAP(2, 4, 0) },
+    [DMA_REQ_ADC2]      = { DMA_MGR_MAP(2, 2, 1), DMA_MGR_MAP(2, 3, 1) },
+    [DMA_REQ_ADC3]      = { DMA_MGR_MAP(2, 0, 2), DMA_MGR_MAP(2, 1, 2) },
+    [DMA_REQ_SPI1_RX]   = { DMA_MGR_MAP(2, 0, 3), DMA_MGR_MAP(2, 2, 3) },
+    [DMA_REQ_SPI1_TX]   = { DMA_MGR_MAP(2, 3, 3), DMA_MGR_MAP(2, 5, 3) },
+    [DMA_REQ_SPI2_RX]   = { DMA_MGR_MAP(1, 3, 0) },
+    [DMA_REQ_SPI2_TX]   = { DMA_MGR_MAP(1, 4, 0) },
+    [DMA_REQ_SPI3_RX]   = { DMA_MGR_MAP(1, 0, 0), DMA_MGR_MAP(1, 2, 0) },
+    [DMA_REQ_SPI3_TX]   = { DMA_MGR_MAP(1, 5, 0), DMA_MGR_MAP(1, 7, 0) },
+    [DMA_REQ_USART1_RX] = { DMA_MGR_MAP(2, 2, 4), DMA_MGR_MAP(2, 5, 4) },
+    [DMA_REQ_USART1_TX] = { DMA_MGR_MAP(2, 7, 4) },
+    [DMA_REQ_USART2_RX] = { DMA_MGR_MAP(1, 5, 4) },
+    [DMA_REQ_USART2_TX] = { DMA_MGR_MAP(1, 6, 4) },
+    [DMA_REQ_USART3_RX] = { DMA_MGR_MAP(1, 1, 4) },
+    [DMA_REQ_USART3_TX] = { DMA_MGR_MAP(1, 3, 4), DMA_MGR_MAP(1, 4, 7) },
+    [DMA_REQ_UART4_RX]  = { DMA_MGR_MAP(1, 2, 4) },
+    [DMA_REQ_UART4_TX]  = { DMA_MGR_MAP(1, 4, 4) },
+    [DMA_REQ_UART5_RX]  = { DMA_MGR_MAP(1, 0, 4) },
+    [DMA_REQ_UART5_TX]  = { DMA_MGR_MAP(1, 7, 4) },
+    [DMA_REQ_USART6_RX] = { DMA_MGR_MAP(2, 1, 5), DMA_MGR_MAP(2, 2, 5) },
+    [DMA_REQ_USART6_TX] = { DMA_MGR_MAP(2, 6, 5), DMA_MGR_MAP(2, 7, 5) },
+    [DMA_REQ_I2C1_RX]   = { DMA_MGR_MAP(1, 0, 1), DMA_MGR_MAP(1, 5, 1) },
+    [DMA_REQ_I2C1_TX]   = { DMA_MGR_MAP(1, 6, 1), DMA_MGR_MAP(1, 7, 1) },
+    [DMA_REQ_I2C2_RX]   = { DMA_MGR_MAP(1, 2, 7), DMA_MGR_MAP(1, 3, 7) },
+    [DMA_REQ_I2C2_TX]   = { DMA_MGR_MAP(1, 7, 7) },
+    [DMA_REQ_I2C3_RX]   = { DMA_MGR_MAP(1, 2, 3) },
+    [DMA_REQ_I2C3_TX]   = { DMA_MGR_MAP(1, 4, 3) },
+    [DMA_REQ_DAC1]      = { DMA_MGR_MAP(1, 5, 7) },
+    [DMA_REQ_DAC2]      = { DMA_MGR_MAP(1, 6, 7) },
+    [DMA_REQ_SDIO]      = { DMA_MGR_MAP(2, 3, 4), DMA_MGR_MAP(2, 6, 4) },
+    [DMA_REQ_TIM1_UP]   = { DMA_MGR_MAP(2, 5, 6) },
+    [DMA_REQ_TIM6_UP]   = { DMA_MGR_MAP(1, 1, 7) },
+    [DMA_REQ_TIM7_UP]   = { DMA_MGR_MAP(1, 2, 1), DMA_MGR_MAP(1, 4, 1) },
+    [DMA_REQ_TIM8_UP]   = { DMA_MGR_MAP(2, 1, 7) },
+};
+
+static DMA_TypeDef *dma_mgr_dma(uint8_t i) {
+    return (i < 8) ? DMA1 : DMA2;
+}
+
+/**
+ * @brief Номер потока 0..15 по указателю (DMA_MGR_STREAMS - поток не найден).
+ */
+static uint8_t dma_mgr_index(const DMA_Stream_TypeDef *s) {
+    uint8_t i;
+
+    for (i = 0; i < DMA_MGR_STREAMS; i++) {
+        if (dma_mgr_stream[i] == s) break;
+    }
+    return i;
+}
+
+static uint32_t dma_mgr_flags_i(uint8_t i) {
+    DMA_TypeDef *dma = dma_mgr_dma(i);
+
+    return ((((i & 7) < 4) ? dma->LISR : dma->HISR) >> dma_mgr_shift[i & 3]) & DMA_MGR_ALL;
+}
+
+// Флаги без FE прямого режима (FIFO выключен - FE не означает ошибку)
+static uint32_t dma_mgr_valid_i(uint8_t i, uint32_t flags) {
+    return (dma_mgr_stream[i]->FCR & DMA_SxFCR_DMDIS) ? flags : (flags & ~DMA_MGR_FE);
+}
+
+static void dma_mgr_clear_i(uint8_t i, uint32_t flags) {
+    DMA_TypeDef *dma = dma_mgr_dma(i);
+
+    if ((i & 7) < 4) dma->LIFCR = flags << dma_mgr_shift[i & 3];
+    else             dma->HIFCR = flags << dma_mgr_shift[i & 3];
+}
+
+static void dma_mgr_stop_i(uint8_t i) {
+    DMA_Stream_TypeDef *s = dma_mgr_stream[i];
+
+    s->CR &= ~DMA_SxCR_EN;
+    while (s->CR & DMA_SxCR_EN);                                  // Поток заканчивает текущую пересылку
+    dma_mgr_clear_i(i, DMA_MGR_ALL);
+}
+
+/**
+ * @brief Выдача свободного потока для запроса.
+ *
+ * Поток останавливается, флаги сбрасываются, тактирование контроллера включается. Если задана cb, прерывание
+ * потока разрешается в NVIC с приоритетом prio (разрешение прерываний в CR - задача драйвера).
+ *
+ * @param req  Запрос периферии или DMA_REQ_MEM2MEM.
+ * @param ch   Канал потока для поля CHSEL (может быть 0).
+ * @param cb   Обработчик прерывания потока (0 - драйвер опрашивает флаги сам).
+ * @param ctx  Контекст cb.
+ * @param prio Приоритет прерывания.
+ * @return DMA_Stream_TypeDef* Поток или 0 - все допустимые потоки заняты (dma_mgr_stats.conflicts).
+ */
+DMA_Stream_TypeDef *dma_mgr_claim(dma_req_t req, uint8_t *ch, dma_mgr_cb_t cb, void *ctx, uint8_t prio) {
+    uint32_t primask = __get_PRIMASK();
+    uint8_t  i = DMA_MGR_STREAMS, c = 0;
+
+    if (req == DMA_REQ_NONE || req >= DMA_REQ_COUNT) return 0;
+
+    __disable_irq();
+    if (req == DMA_REQ_MEM2MEM) {
+        for (uint8_t k = 0; k < sizeof(dma_mgr_m2m); k++) {
+            if (dma_mgr_slot[dma_mgr_m2m[k]].req == DMA_REQ_NONE) { i = dma_mgr_m2m[k]; break; }
+        }
+    } else {
+        for (uint8_t k = 0; k < DMA_MGR_ALT; k++) {
+            uint8_t m = dma_mgr_map[req][k];
+
+            if (m && dma_mgr_slot[m & 0x0F].req == DMA_REQ_NONE) { i = m & 0x0F; c = (m >> 4) & 7; break; }
+        }
+    }
+    if (i == DMA_MGR_STREAMS) {
+        dma_mgr_stats.conflicts++;
+        __set_PRIMASK(primask);
+        return 0;
+    }
+    dma_mgr_slot[i] = (dma_mgr_slot_t){ .cb = cb, .ctx = ctx, .req = (uint8_t)req };
+    dma_mgr_stats.claims++;
+    __set_PRIMASK(primask);
+
+    RCC->AHB1ENR |= (i < 8) ? RCC_AHB1ENR_DMA1EN : RCC_AHB1ENR_DMA2EN;
+    dma_mgr_stop_i(i);
+    if (ch) *ch = c;
+
+    if (cb) {
+        NVIC_SetPriority(dma_mgr_irq[i], prio);
+        NVIC_ClearPendingIRQ(dma_mgr_irq[i]);
+        NVIC_EnableIRQ(dma_mgr_irq[i]);
+    }
+
+    return dma_mgr_stream[i];
+}
+
+/**
+ * @brief Освобождение потока: остановка, запрет прерывания, поток снова доступен dma_mgr_claim().
+ */
+void dma_mgr_release(DMA_Stream_TypeDef *s) {
+    uint8_t i = dma_mgr_index(s);
+
+    if (i == DMA_MGR_STREAMS) return;
+
+    NVIC_DisableIRQ(dma_mgr_irq[i]);
+    dma_mgr_stop_i(i);
+    dma_mgr_slot[i] = (dma_mgr_slot_t){ .req = DMA_REQ_NONE };   // Без сохранённой настройки и перезапусков
+}
+
+/**
+ * @brief Остановка потока (EN = 0) с ожиданием и сброс его флагов.
+ */
+void dma_mgr_stop(DMA_Stream_TypeDef *s) {
+    uint8_t i = dma_mgr_index(s);
+
+    if (i < DMA_MGR_STREAMS) dma_mgr_stop_i(i);
+}
+
+uint32_t dma_mgr_flags(const DMA_Stream_TypeDef *s) {
+    uint8_t i = dma_mgr_index(s);
+
+    return (i < DMA_MGR_STREAMS) ? dma_mgr_valid_i(i, dma_mgr_flags_i(i)) : 0;
+}
+
+void dma_mgr_clear(const DMA_Stream_TypeDef *s, uint32_t flags) {
+    uint8_t i = dma_mgr_index(s);
+
+    if (i < DMA_MGR_STREAMS) dma_mgr_clear_i(i, flags);
+}
+
+IRQn_Type dma_mgr_irqn(const DMA_Stream_TypeDef *s) {
+    uint8_t i = dma_mgr_index(s);
+
+    return (i < DMA_MGR_STREAMS) ? dma_mgr_irq[i] : DMA1_Stream0_IRQn;
+}
+
+const dma_mgr_err_t *dma_mgr_errors(const DMA_Stream_TypeDef *s) {
+    uint8_t i = dma_mgr_index(s);
+
+    return (i < DMA_MGR_STREAMS) ? &dma_mgr_err[i] : 0;
+}
+
+/**
+ * @brief Запись сохранённой настройки в остановленный поток и включение.
+ */
+static void dma_mgr_restore_i(uint8_t i) {
+    DMA_Stream_TypeDef   *s    = dma_mgr_stream[i];
+    const dma_mgr_slot_t *slot = &dma_mgr_slot[i];
+
+    dma_mgr_clear_i(i, DMA_MGR_ALL);
+    s->CR   = slot->cr & ~DMA_SxCR_EN;
+    s->FCR  = slot->fcr;
+    s->PAR  = slot->par;
+    s->M0AR = slot->m0ar;
+    s->M1AR = slot->m1ar;
+    s->NDTR = slot->ndtr;
+    s->CR   = slot->cr | DMA_SxCR_EN;
+}
+
+/**
+ * @brief Запуск настроенного потока с восстановлением после ошибок.
+ *
+ * Разрешает прерывания TE и DME (и FE, если включён FIFO), сохраняет CR, NDTR, PAR, M0AR, M1AR, FCR и включает поток.
+ * Подходит для циклических потоков и потоков, перезапускаемых одной настройкой (приём АЦП, USART).
+ *
+ * @param s         Поток, полученный dma_mgr_claim(), с записанной настройкой (EN = 0).
+ * @param rearm_max Перезапусков подряд после остановки ошибкой (0 - ошибки только считаются).
+ */
+void dma_mgr_start(DMA_Stream_TypeDef *s, uint8_t rearm_max) {
+    uint8_t         i = dma_mgr_index(s);
+    dma_mgr_slot_t *slot;
+
+    if (i == DMA_MGR_STREAMS) return;
+    slot = &dma_mgr_slot[i];
+
+    s->CR |= DMA_SxCR_TEIE | DMA_SxCR_DMEIE;
+    if (s->FCR & DMA_SxFCR_DMDIS) s->FCR |= DMA_SxFCR_FEIE;
+
+    slot->cr    = s->CR;
+    slot->fcr   = s->FCR;
+    slot->par   = s->PAR;
+    slot->m0ar  = s->M0AR;
+    slot->m1ar  = s->M1AR;
+    slot->ndtr  = s->NDTR;
+    slot->max   = rearm_max;
+    slot->burst = 0;
+
+    dma_mgr_clear_i(i, DMA_MGR_ALL);
+    s->CR |= DMA_SxCR_EN;
+}
+
+/**
+ * @brief Перезапуск потока с настройкой dma_mgr_start(): остановка, сброс флагов, запись регистров, EN = 1.
+ *
+ * Используется драйвером, когда передачу остановила периферия (например, переполнение АЦП), и после DMA_MGR_FAIL.
+ * Вызывать из прерывания потока или при запрещённом прерывании потока.
+ *
+ * @return uint8_t 1 - поток запущен, 0 - поток не запускался dma_mgr_start().
+ */
+uint8_t dma_mgr_rearm(DMA_Stream_TypeDef *s) {
+    uint8_t i = dma_mgr_index(s);
+
+    if (i == DMA_MGR_STREAMS || !dma_mgr_slot[i].cr) return 0;
+
+    dma_mgr_stop_i(i);
+    dma_mgr_restore_i(i);
+    dma_mgr_slot[i].burst = 0;
+    return 1;
+}
+
+/**
+ * @brief Время входа в последнее прерывание потока (DWT->CYCCNT, счётчик запускает владелец потока).
+ *
+ * Вызывается из callback-функции потока: время до неё (диспетчер, сброс флагов, учёт ошибок) входит в измерение.
+ *
+ * @return uint32_t DWT->CYCCNT в начале обработчика или 0 - поток не из таблицы.
+ */
+uint32_t dma_mgr_irq_entry(const DMA_Stream_TypeDef *s) {
+    uint8_t i = dma_mgr_index(s);
+
+    return (i < DMA_MGR_STREAMS) ? dma_mgr_entry[i] : 0;
+}
+
+/**
+ * @brief Общий обработчик прерываний потоков: сброс флагов, учёт ошибок, восстановление и вызов обработчика владельца.
+ */
+static void dma_mgr_irq_handler(uint8_t i) {
+    dma_mgr_slot_t *slot  = &dma_mgr_slot[i];
+    dma_mgr_err_t  *err   = &dma_mgr_err[i];
+    uint32_t        flags;
+
+    dma_mgr_entry[i] = DWT->CYCCNT;                            // До чтения флагов: начало паузы после TC
+    flags            = dma_mgr_flags_i(i);
+
+    dma_mgr_clear_i(i, flags);
+    flags = dma_mgr_valid_i(i, flags);                          // FE прямого режима сброшен, но не передаётся
+    if (!flags || !slot->cb) {
+        dma_mgr_stats.spurious++;
+        return;
+    }
+
+    if (flags & DMA_MGR_TC) slot->burst = 0;                     // Передача дошла до конца, даже вместе с ошибкой
+
+    if (flags & DMA_MGR_ERR) {
+        if (flags & DMA_MGR_TE)  err->te++;
+        if (flags & DMA_MGR_DME) err->dme++;
+        if (flags & DMA_MGR_FE)  err->fe++;
+
+        if (slot->max && !(dma_mgr_stream[i]->CR & DMA_SxCR_EN)) { // Поток остановлен ошибкой
+            if (slot->burst < slot->max) {
+                slot->burst++;
+                err->rearms++;
+                dma_mgr_restore_i(i);
+                flags |= DMA_MGR_REARM;
+            } else {
+                err->failed++;
+                flags |= DMA_MGR_FAIL;
+            }
+        }
+    } else if (flags & DMA_MGR_HT) {
+        slot->burst = 0;
+    }
+
+    slot->cb(slot->ctx, flags);
+}
+
+void DMA1_Stream0_IRQHandler(void) { dma_mgr_irq_handler(0); }
+void DMA1_Stream1_IRQHandler(void) { dma_mgr_irq_handler(1); }
+void DMA1_Stream2_IRQHandler(void) { dma_mgr_irq_handler(2); }
+void DMA1_Stream3_IRQHandler(void) { dma_mgr_irq_handler(3); }
+void DMA1_Stream4_IRQHandler(void) { dma_mgr_irq_handler(4); }
+void DMA1_Stream5_IRQHandler(void) { dma_mgr_irq_handler(5); }
+void DMA1_Stream6_IRQHandler(void) { dma_mgr_irq_handler(6); }
+void DMA1_Stream7_IRQHandler(void) { dma_mgr_irq_handler(7); }
+void DMA2_Stream0_IRQHandler(void) { dma_mgr_irq_handler(8); }
+void DMA2_Stream1_IRQHandler(void) { dma_mgr_irq_handler(9); }
+void DMA2_Stream2_IRQHandler(void) { dma_mgr_irq_handler(10); }
+void DMA2_Stream3_IRQHandler(void) { dma_mgr_irq_handler(11); }
+void DMA2_Stream4_IRQHandler(void) { dma_mgr_irq_handler(12); }
+void DMA2_Stream5_IRQHandler(void) { dma_mgr_irq_handler(13); }
+void DMA2_Stream6_IRQHandler(void) { dma_mgr_irq_handler(14); }
+void DMA2_Stream7_IRQHandler(void) { dma_mgr_irq_handler(15); }
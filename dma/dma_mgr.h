@@ -0,0 +1,121 @@
+/**
+ * @file        : dma_mgr.h
+ * @brief       : Распределение потоков DMA1/DMA2 по таблице запросов STM32F407 и диспетчер их прерываний.
+ * @author      : xmatech
+ * @date        : 19.03.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ *
+ * @Description : Драйвер не выбирает поток и канал сам: dma_mgr_claim() получает запрос периферии (dma_req_t),
+ *                перебирает допустимые для него пары поток/канал (RM0090, табл. 42/43) и выдаёт первый свободный
+ *                поток. Два драйвера, которым нужен один поток, больше не настраивают его одновременно: второй получает
+ *                другой поток из таблицы или 0 (конфликт, dma_mgr_stats.conflicts).
+ *                - Поток выдаётся остановленным, со сброшенными флагами и включённым тактированием контроллера.
+ *                - Обработчики DMAx_Streamy_IRQHandler() определяет менеджер: флаги потока (DMA_MGR_*) сбрасываются
+ *                  и передаются callback-функции владельца вместе с её контекстом.
+ *                - Канал записывается драйвером в CR (поле CHSEL) при каждой записи CR: ((uint32_t)ch << DMA_SxCR_CHSEL_Pos).
+ *                - Ошибки TE, DME, FE считаются по потокам (dma_mgr_err[]). Поток, запущенный dma_mgr_start(), менеджер
+ *                  восстанавливает сам: если после ошибки поток остановлен (EN = 0), в прерывании записываются
+ *                  сохранённые при запуске CR, NDTR, PAR, M0AR, M1AR, FCR и поток включается снова - не позже одного
+ *                  входа в прерывание после ошибки. Callback-функция получает DMA_MGR_REARM и перезапускает периферию.
+ *                  Число перезапусков подряд (без HT/TC между ними) ограничено: после rearm_max поток остаётся
+ *                  остановленным (DMA_MGR_FAIL), повторить запуск можно dma_mgr_rearm().
+ *                Потоки выдаются при инициализации (из основного цикла), освобождение - dma_mgr_release().
+ */
+
+#ifndef DMA_MGR_H
+#define DMA_MGR_H
+
+#include <stm32f4xx.h>
+
+#define DMA_MGR_STREAMS 16 // Потоков: DMA1 Stream0..7, DMA2 Stream0..7
+
+// Флаги потока (после сдвига из LISR/HISR)
+#define DMA_MGR_FE  0x01 // Ошибка FIFO (только потоки с DMDIS = 1, в прямом режиме не передаётся)
+#define DMA_MGR_DME 0x04 // Ошибка прямого режима
+#define DMA_MGR_TE  0x08 // Ошибка передачи (поток отключён)
+#define DMA_MGR_HT  0x10 // Половина передачи
+#define DMA_MGR_TC  0x20 // Конец передачи
+#define DMA_MGR_ALL 0x3D
+#define DMA_MGR_ERR (DMA_MGR_FE | DMA_MGR_DME | DMA_MGR_TE)
+
+// Признаки восстановления (только в аргументе callback-функции)
+#define DMA_MGR_REARM 0x40 // Поток остановлен ошибкой и перезапущен с сохранённой настройкой
+#define DMA_MGR_FAIL  0x80 // Предел перезапусков подряд исчерпан - поток остановлен
+
+// Запросы DMA (RM0090, табл. 42/43)
+typedef enum {
+    DMA_REQ_NONE = 0,  // Направление не использует DMA
+    DMA_REQ_MEM2MEM,   // Память -> память (только DMA2)
+    DMA_REQ_ADC1,
+    DMA_REQ_ADC2,
+    DMA_REQ_ADC3,
+    DMA_REQ_SPI1_RX,
+    DMA_REQ_SPI1_TX,
+    DMA_REQ_SPI2_RX,
+    DMA_REQ_SPI2_TX,
+    DMA_REQ_SPI3_RX,
+    DMA_REQ_SPI3_TX,
+    DMA_REQ_USART1_RX,
+    DMA_REQ_USART1_TX,
+    DMA_REQ_USART2_RX,
+    DMA_REQ_USART2_TX,
+    DMA_REQ_USART3_RX,
+    DMA_REQ_USART3_TX,
+    DMA_REQ_UART4_RX,
+    DMA_REQ_UART4_TX,
+    DMA_REQ_UART5_RX,
+    DMA_REQ_UART5_TX,
+    DMA_REQ_USART6_RX,
+    DMA_REQ_USART6_TX,
+    DMA_REQ_I2C1_RX,
+    DMA_REQ_I2C1_TX,
+    DMA_REQ_I2C2_RX,
+    DMA_REQ_I2C2_TX,
+    DMA_REQ_I2C3_RX,
+    DMA_REQ_I2C3_TX,
+    DMA_REQ_DAC1,
+    DMA_REQ_DAC2,
+    DMA_REQ_SDIO,
+    DMA_REQ_TIM1_UP,
+    DMA_REQ_TIM6_UP,
+    DMA_REQ_TIM7_UP,
+    DMA_REQ_TIM8_UP,
+    DMA_REQ_COUNT
+} dma_req_t;
+
+// Прерывание потока: flags - DMA_MGR_* (уже сброшены), ctx - контекст, переданный dma_mgr_claim()
+typedef void (*dma_mgr_cb_t)(void *ctx, uint32_t flags);
+
+// Статистика
+typedef struct {
+    uint32_t claims;    // Выдано потоков
+    uint32_t conflicts; // Отказов: все потоки запроса заняты
+    uint32_t spurious;  // Прерываний потока без владельца или без флагов
+} dma_mgr_stats_t;
+
+// Ошибки потока
+typedef struct {
+    uint32_t te;     // Ошибок передачи (шина, поток отключён)
+    uint32_t dme;    // Ошибок прямого режима
+    uint32_t fe;     // Ошибок FIFO
+    uint32_t rearms; // Перезапусков после остановки ошибкой
+    uint32_t failed; // Отказов восстановления (предел перезапусков подряд)
+} dma_mgr_err_t;
+
+extern dma_mgr_stats_t dma_mgr_stats;
+extern dma_mgr_err_t   dma_mgr_err[DMA_MGR_STREAMS]; // Индекс - номер потока 0..15 (DMA1 Stream0..DMA2 Stream7)
+
+DMA_Stream_TypeDef *dma_mgr_claim(dma_req_t req, uint8_t *ch, dma_mgr_cb_t cb, void *ctx, uint8_t prio); // 0 - конфликт
+void     dma_mgr_release(DMA_Stream_TypeDef *s);                  // Остановка потока, запрет прерывания, освобождение
+void     dma_mgr_stop(DMA_Stream_TypeDef *s);                     // EN = 0, ожидание остановки, сброс флагов
+uint32_t dma_mgr_flags(const DMA_Stream_TypeDef *s);              // Флаги DMA_MGR_* потока
+void     dma_mgr_clear(const DMA_Stream_TypeDef *s, uint32_t flags); // Сброс флагов DMA_MGR_*
+IRQn_Type dma_mgr_irqn(const DMA_Stream_TypeDef *s);              // Прерывание NVIC потока
+void     dma_mgr_start(DMA_Stream_TypeDef *s, uint8_t rearm_max); // Прерывания ошибок, сохранение настройки, EN = 1
+uint8_t  dma_mgr_rearm(DMA_Stream_TypeDef *s);                    // Перезапуск с настройкой dma_mgr_start()
+const dma_mgr_err_t *dma_mgr_errors(const DMA_Stream_TypeDef *s); // Ошибки потока
+uint32_t dma_mgr_irq_entry(const DMA_Stream_TypeDef *s);          // DWT->CYCCNT при входе в прерывание потока
+
+#endif // DMA_MGR_H
@@ -0,0 +1,71 @@
+/**------------------------------------------------------------------------------------------------------------------------------
+ * @file        : core_cm4.h
+ * @brief       : Заглушка ядра Cortex-M4 для сборки драйвера W25Q64 на Linux (host).
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : Linux x86-64 (host)
+ * @MCU         : STM32F407VET6 (модель)
+ * @IDE         : gcc
+ * @Description : Подменяет CMSIS core_cm4.h при сборке с -Ihost: определяет квалификаторы __IO/__I/__O,
+ *                функции управления прерываниями и NVIC без ассемблерных вставок ARM,
+ *                счётчик тактов DWT->CYCCNT (вычисляется из виртуального времени модели при ядре 84 МГц).
+ *                Регистры периферии и битовые маски берутся из оригинального stm32f407xx.h.
+  -------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#ifndef HOST_CORE_CM4_H
+#define HOST_CORE_CM4_H
+
+#include <stdint.h>
+
+#define __I   volatile const
+#define __O   volatile
+#define __IO  volatile
+#define __IM  volatile const
+#define __OM  volatile
+#define __IOM volatile
+
+// На host прерывания не вытесняют друг друга - маскирование не требуется
+static inline void     __enable_irq(void)            {}
+static inline void     __disable_irq(void)           {}
+static inline uint32_t __get_PRIMASK(void)           { return 0; }
+static inline void     __set_PRIMASK(uint32_t pm)    { (void)pm; }
+static inline void     __NOP(void)                   {}
+static inline void     __DSB(void)                   {}
+static inline void     __ISB(void)                   {}
+
+// Ожидание прерывания: модель вызывает обработчик ожидающего прерывания DMA (stm32_mock.c)
+void sim_wfi(void);
+static inline void     __WFI(void)                   { sim_wfi(); }
+
+// Невыровненное чтение слова (Cortex-M4 допускает LDR по невыровненному адресу)
+static inline uint32_t __UNALIGNED_UINT32_READ(const void *addr) { uint32_t v; __builtin_memcpy(&v, addr, 4); return v; }
+
+static inline void     NVIC_EnableIRQ(IRQn_Type irq)                    { (void)irq; }
+static inline void     NVIC_DisableIRQ(IRQn_Type irq)                   { (void)irq; }
+static inline void     NVIC_ClearPendingIRQ(IRQn_Type irq)              { (void)irq; }
+static inline void     NVIC_SetPriority(IRQn_Type irq, uint32_t prio)   { (void)irq; (void)prio; }
+
+// Регистры отладки, используемые для измерения времени
+typedef struct {
+  __IOM uint32_t CTRL;
+  __IOM uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct {
+  __IOM uint32_t DHCSR;
+  __OM  uint32_t DCRSR;
+  __IOM uint32_t DCRDR;
+  __IOM uint32_t DEMCR;
+} CoreDebug_Type;
+
+#define DWT_CTRL_CYCCNTENA_Msk      (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk  (1UL << 24)
+
+extern CoreDebug_Type sim_coredebug;
+DWT_Type *sim_dwt(void);
+
+#define DWT       (sim_dwt())
+#define CoreDebug (&sim_coredebug)
+
+#endif // HOST_CORE_CM4_H
@@ -0,0 +1,186 @@
+/**
+------------------------------------------------------------------------------------------------------------------------------
+ * @file        : stm32_mock.c
+ * @brief       : Модель регистров SPI2, GPIOE и DMA1 STM32F407, подключённая к модели W25Q64 (host).
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : Linux x86-64 (host)
+ * @MCU         : STM32F407VET6 (модель)
+ * @IDE         : gcc
+ * @Description : Драйвер обращается к регистрам через макросы SPI2, GPIOE, DMA1 (host/stm32f4xx.h), которые вызывают
+ *                sim_spi2(), sim_gpioe(), sim_dma1(). Каждый такой вызов сначала выполняет sim_sync():
+ *                1. Запись в GPIOE->BSRR применяется к ODR, изменение PE3 передаётся модели как CS.
+ *                2. Запись в DMA1->LIFCR/HIFCR сбрасывает флаги LISR/HISR.
+ *                3. Новое значение в SPI2->DR (бит 16 сброшен) - обмен с моделью, ответ кладётся в DR с битом 16,
+ *                   который отсекается при чтении драйвером в uint16_t.
+ *                4. Если установлены SPI2->CR2.TXDMAEN и DMA1_Stream4 EN - весь блок передаётся через модель,
+ *                   принятые байты записываются по адресу DMA1_Stream3 (если RXDMAEN и поток включён),
+ *                   устанавливаются флаги TCIF3/TCIF4.
+ *                Частота SCK вычисляется из SPI2->CR1.BR при APB1 = 42 МГц.
+ *                Поток DMA с PSIZE = 16 бит передаёт кадр двумя байтами, старшим первым (SPI2->CR1.DFF = 1).
+ *                __WFI() (sim_wfi()) вызывает DMA1_Stream3_IRQHandler() (dma/dma_mgr.c -> spi2_bus_dma_irq()), если
+ *                установлены TCIF3/TEIF3 и TCIE/TEIE.
+ *                Блок CRC (sim_crc()) вычисляет CRC-32/MPEG-2 по словам, как STM32F4: новое слово в CRC->DR (бит 32
+ *                сброшен) обрабатывается при следующем обращении к CRC, CR.RESET устанавливает 0xFFFFFFFF.
+ *                DWT->CYCCNT - виртуальное время модели в тактах ядра 84 МГц (учитывается только время шины).
+ -------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#include <stm32f4xx.h>
+#include "w25q64_sim.h"
+
+void DMA1_Stream3_IRQHandler(void); // Обработчик прерывания потока (dma_mgr.c), далее - очередь шины SPI2 (spi2_bus.c)
+
+#define SIM_APB1_HZ  42000000UL // Тактовая частота APB1 (rcc_init: 84 МГц / 2)
+#define SIM_CORE_HZ  84000000UL // Тактовая частота ядра (rcc_init)
+#define SIM_DR_IDLE  0x10000UL  // Признак: в DR лежит ответ, новой записи не было
+#define SIM_CS_PIN   3          // PE3 - CS памяти
+#define SIM_CRC_IDLE (1ULL << 32) // Признак: в CRC->DR лежит результат, новой записи не было
+#define SIM_CRC_POLY 0x04C11DB7UL // Полином блока CRC
+
+RCC_TypeDef        sim_rcc;
+GPIO_TypeDef       sim_gpiob;
+GPIO_TypeDef       sim_gpioc;
+DMA_Stream_TypeDef sim_dma1_stream[8];
+TIM_TypeDef        sim_tim7;
+CoreDebug_Type     sim_coredebug;
+
+static GPIO_TypeDef sim_gpioe_regs;
+static SPI_TypeDef  sim_spi2_regs = { .SR = SPI_SR_TXE, .DR = SIM_DR_IDLE };
+static DMA_TypeDef  sim_dma1_regs;
+static uint8_t      sim_cs_level = 1;
+static DWT_Type     sim_dwt_regs;
+static sim_crc_t    sim_crc_regs = { .DR = 0xFFFFFFFFUL | SIM_CRC_IDLE };
+static uint32_t     sim_crc_state = 0xFFFFFFFFUL; // Результат (запись в DR затирает его в модели регистра)
+
+/**
+ * @brief Текущая частота SCK по делителю SPI2->CR1.BR.
+ */
+static uint32_t sim_sck_hz(void) {
+  return SIM_APB1_HZ >> (((sim_spi2_regs.CR1 & SPI_CR1_BR) >> SPI_CR1_BR_Pos) + 1);
+}
+
+/**
+ * @brief Обмен через модель блока, описанного потоками DMA1 Stream4 (TX) и Stream3 (RX).
+ */
+static void sim_dma_run(void) {
+  DMA_Stream_TypeDef *tx = &sim_dma1_stream[4];
+  DMA_Stream_TypeDef *rx = &sim_dma1_stream[3];
+  const uint8_t      *src = (const uint8_t *)(uintptr_t)tx->M0AR;
+  uint8_t            *dst = 0;
+  uint32_t            n   = tx->NDTR;
+  uint32_t            w   = (tx->CR & DMA_SxCR_PSIZE_0) ? 2 : 1; // Размер кадра: 16 бит - старший байт первым
+  uint32_t            si, di;
+  uint8_t             miso;
+
+  if ((rx->CR & DMA_SxCR_EN) && (sim_spi2_regs.CR2 & SPI_CR2_RXDMAEN)) dst = (uint8_t *)(uintptr_t)rx->M0AR;
+
+  for (uint32_t i = 0; i < n; i++) {
+    si = (tx->CR & DMA_SxCR_MINC) ? i * w : 0;
+    di = (rx->CR & DMA_SxCR_MINC) ? i * w : 0;
+    for (uint32_t b = w; b-- > 0;) { // Полуслово в памяти - little-endian
+      miso = w25sim_xfer(src[si + b], sim_sck_hz());
+      if (dst) dst[di + b] = miso;
+    }
+  }
+
+  tx->NDTR = 0;
+  tx->CR  &= ~DMA_SxCR_EN;
+  sim_dma1_regs.HISR |= DMA_HISR_TCIF4;
+  if (dst) {
+    rx->NDTR = 0;
+    rx->CR  &= ~DMA_SxCR_EN;
+    sim_dma1_regs.LISR |= DMA_LISR_TCIF3;
+  }
+}
+
+/**
+ * @brief Применение записей драйвера, сделанных с момента предыдущего обращения к периферии.
+ */
+static void sim_sync(void) {
+  uint32_t bsrr = sim_gpioe_regs.BSRR;
+  uint32_t tx, rx;
+  uint8_t  level;
+
+  if (bsrr) { // 1. GPIOE: установка имеет приоритет над сбросом
+    sim_gpioe_regs.ODR  = (sim_gpioe_regs.ODR & ~(bsrr >> 16)) | (bsrr & 0xFFFF);
+    sim_gpioe_regs.BSRR = 0;
+    level = (sim_gpioe_regs.ODR >> SIM_CS_PIN) & 1;
+    if (level != sim_cs_level) {
+      sim_cs_level = level;
+      w25sim_cs(level);
+    }
+  }
+
+  // 2. DMA1: сброс флагов записью в регистры очистки
+  sim_dma1_regs.LISR &= ~sim_dma1_regs.LIFCR;
+  sim_dma1_regs.HISR &= ~sim_dma1_regs.HIFCR;
+  sim_dma1_regs.LIFCR = 0;
+  sim_dma1_regs.HIFCR = 0;
+
+  if ((sim_spi2_regs.DR & SIM_DR_IDLE) == 0) { // 3. SPI2: новая запись в DR
+    tx = sim_spi2_regs.DR;
+    w25sim_advance_ns(w25sim_timing.poll_gap);
+    if (sim_spi2_regs.CR1 & SPI_CR1_DFF) {
+      rx  = (uint32_t)w25sim_xfer((tx >> 8) & 0xFF, sim_sck_hz()) << 8;
+      rx |= w25sim_xfer(tx & 0xFF, sim_sck_hz());
+    } else {
+      rx = w25sim_xfer(tx & 0xFF, sim_sck_hz());
+    }
+    sim_spi2_regs.DR  = rx | SIM_DR_IDLE;
+    sim_spi2_regs.SR |= SPI_SR_TXE | SPI_SR_RXNE;
+  }
+
+  // 4. DMA1 Stream4 -> SPI2 -> DMA1 Stream3
+  if ((sim_spi2_regs.CR2 & SPI_CR2_TXDMAEN) && (sim_dma1_stream[4].CR & DMA_SxCR_EN)) sim_dma_run();
+}
+
+GPIO_TypeDef *sim_gpioe(void) {
+  sim_sync();
+  return &sim_gpioe_regs;
+}
+
+SPI_TypeDef *sim_spi2(void) {
+  sim_sync();
+  return &sim_spi2_regs;
+}
+
+DMA_TypeDef *sim_dma1(void) {
+  sim_sync();
+  return &sim_dma1_regs;
+}
+
+sim_crc_t *sim_crc(void) {
+  uint32_t crc;
+
+  if (sim_crc_regs.CR & CRC_CR_RESET) { // Сброс: начальное значение 0xFFFFFFFF
+    sim_crc_regs.CR &= ~CRC_CR_RESET;
+    sim_crc_state    = 0xFFFFFFFFUL;
+    sim_crc_regs.DR  = sim_crc_state | SIM_CRC_IDLE;
+  }
+
+  if ((sim_crc_regs.DR & SIM_CRC_IDLE) == 0) { // Новое слово: crc ^= слово, 32 шага со старшего бита
+    crc = sim_crc_state ^ (uint32_t)sim_crc_regs.DR;
+    for (int i = 0; i < 32; i++) crc = (crc & 0x80000000UL) ? (crc << 1) ^ SIM_CRC_POLY : crc << 1;
+    sim_crc_state   = crc;
+    sim_crc_regs.DR = crc | SIM_CRC_IDLE;
+  }
+
+  return &sim_crc_regs;
+}
+
+/**
+ * @brief Модель __WFI(): применение записей и вызов обработчика ожидающего прерывания DMA1 Stream3.
+ */
+void sim_wfi(void) {
+  sim_sync();
+  if ((sim_dma1_regs.LISR & (DMA_LISR_TCIF3 | DMA_LISR_TEIF3)) &&
+      (sim_dma1_stream[3].CR & (DMA_SxCR_TCIE | DMA_SxCR_TEIE))) DMA1_Stream3_IRQHandler();
+}
+
+DWT_Type *sim_dwt(void) {
+  if (sim_dwt_regs.CTRL & DWT_CTRL_CYCCNTENA_Msk) {
+    sim_dwt_regs.CYCCNT = (uint32_t)(w25sim_time_ns() * (SIM_CORE_HZ / 1000000UL) / 1000ULL);
+  }
+  return &sim_dwt_regs;
+}
@@ -0,0 +1,81 @@
+/**------------------------------------------------------------------------------------------------------------------------------
+ * @file        : stm32f4xx.h
+ * @brief       : Модель регистров STM32F407 (SPI2, GPIOE, DMA1, RCC, TIM7, CRC) для сборки драйвера W25Q64 на Linux (host).
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : Linux x86-64 (host)
+ * @MCU         : STM32F407VET6 (модель)
+ * @IDE         : gcc
+ * @Description : Подменяет заголовок <stm32f4xx.h> при сборке с -Ihost. Структуры регистров и битовые маски берутся
+ *                из оригинального stm32f407xx.h, а макросы экземпляров периферии (SPI2, GPIOE, DMA1, ...) указывают
+ *                на переменные в ОЗУ host (все потоки DMA1 - sim_dma1_stream[], обмен выполняют Stream3 и Stream4). Обращение к SPI2, GPIOE и DMA1 проходит через функции stm32_mock.c,
+ *                которые перед возвратом указателя обрабатывают предыдущую запись драйвера:
+ *                - запись в GPIOE->BSRR   -> изменение CS (PE3) модели памяти;
+ *                - запись в SPI2->DR      -> обмен байтом (полусловом при DFF = 1) с моделью;
+ *                - включение TXDMAEN      -> обмен всем блоком DMA1 Stream4 -> модель -> DMA1 Stream3;
+ *                - запись в CRC->DR/CR     -> шаг вычисления/сброс модели блока CRC (регистр DR шириной 64 бита:
+ *                                             бит 32 отмечает уже обработанное значение, драйвер читает младшие 32 бита).
+ *                Поэтому драйвер (w25q64.c, spi2_init.c, w25_async.c) компилируется без изменений.
+ *                DMA хранит адреса в 32-битных регистрах: сборка выполняется с -no-pie, буферы - статические.
+  -------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#ifndef HOST_STM32F4XX_H
+#define HOST_STM32F4XX_H
+
+#include "stm32f407xx.h"
+
+// Регистры периферии host
+extern RCC_TypeDef        sim_rcc;
+extern GPIO_TypeDef       sim_gpiob;
+extern GPIO_TypeDef       sim_gpioc;
+extern DMA_Stream_TypeDef sim_dma1_stream[8];
+extern TIM_TypeDef        sim_tim7;
+
+// Модель блока CRC
+typedef struct {
+  volatile uint64_t DR;  // Данные/результат (бит 32 - значение обработано)
+  volatile uint32_t IDR; // Независимый регистр данных
+  volatile uint32_t CR;  // Управление (бит RESET)
+} sim_crc_t;
+
+// Функции доступа с обработкой отложенных записей
+GPIO_TypeDef *sim_gpioe(void);
+SPI_TypeDef  *sim_spi2(void);
+DMA_TypeDef  *sim_dma1(void);
+sim_crc_t    *sim_crc(void);
+
+#undef  RCC
+#define RCC          (&sim_rcc)
+#undef  GPIOB
+#define GPIOB        (&sim_gpiob)
+#undef  GPIOC
+#define GPIOC        (&sim_gpioc)
+#undef  GPIOE
+#define GPIOE        (sim_gpioe())
+#undef  SPI2
+#define SPI2         (sim_spi2())
+#undef  DMA1
+#define DMA1         (sim_dma1())
+#undef  DMA1_Stream0
+#define DMA1_Stream0 (&sim_dma1_stream[0])
+#undef  DMA1_Stream1
+#define DMA1_Stream1 (&sim_dma1_stream[1])
+#undef  DMA1_Stream2
+#define DMA1_Stream2 (&sim_dma1_stream[2])
+#undef  DMA1_Stream3
+#define DMA1_Stream3 (&sim_dma1_stream[3])
+#undef  DMA1_Stream4
+#define DMA1_Stream4 (&sim_dma1_stream[4])
+#undef  DMA1_Stream5
+#define DMA1_Stream5 (&sim_dma1_stream[5])
+#undef  DMA1_Stream6
+#define DMA1_Stream6 (&sim_dma1_stream[6])
+#undef  DMA1_Stream7
+#define DMA1_Stream7 (&sim_dma1_stream[7])
+#undef  TIM7
+#define TIM7         (&sim_tim7)
+#undef  CRC
+#define CRC          (sim_crc())
+
+#endif // HOST_STM32F4XX_H
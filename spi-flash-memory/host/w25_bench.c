@@ -0,0 +1,561 @@
+/**
+------------------------------------------------------------------------------------------------------------------------------
+ * @file        : w25_bench.c
+ * @brief       : Проверка и замер пропускной способности драйвера W25Q64 на модели памяти (host).
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : Linux x86-64 (host)
+ * @MCU         : STM32F407VET6 (модель)
+ * @IDE         : gcc
+ * @Description : Программа собирается из неизменённых исходников драйвера и моделей host/:
+ *
+ *                cd spi-flash-memory
+ *                gcc -std=gnu11 -O2 -no-pie -Wno-pointer-to-int-cast -DSTM32F407xx \
+ *                    -Ihost -Iinc -I../dma -ISTM32F4xx/Device/Include -o w25_bench \
+ *                    host/w25_bench.c host/w25q64_sim.c host/stm32_mock.c \
+ *                    src/w25q64.c src/spi2_init.c src/w25_async.c src/w25_cache.c src/w25_kv.c \
+ *                    src/w25_log.c src/w25_crc.c src/spi2_bus.c src/w25_ovl.c ../dma/dma_mgr.c ../dma/dma_chain.c
+ *                ./w25_bench
+ *
+ *                - проверяет отказ spi2_init(), если поток DMA1 для SPI2 занят другим драйвером;
+ *                - проверяет флаги прерывания dma_mgr (DMA1 Stream0): FE прямого режима не передаётся и не считается,
+ *                  FE потока с FIFO считается, TC вместе с TE сбрасывает счётчик перезапусков подряд;
+ *                - проверяет выбор частоты spi2_autotune() при ограниченной и неограниченной частоте линии;
+ *                - проверяет запись/чтение через w25read(), w25_read(), w25_write(), w25_erase_sector();
+ *                  запись страницы - цепочкой DMA из двух сегментов (команда с адресом, данные);
+ *                - сравнивает побайтное чтение w25read() и блочное w25_read() по виртуальному времени шины;
+ *                - проверяет CRC-32 модели блока CRC, чтение и запись с проверкой (w25_read_verified(), w25_write_verified())
+ *                  и обнаружение искажённого бита;
+ *                - ставит в очередь шины spi2_bus транзакции второго устройства (16-битный кадр) и проверяет, что чтение
+ *                  памяти получает шину после одной транзакции, а SPI2->CR1 перенастраивается только при смене устройства;
+ *                - записывает образ оверлея в W25Q64 (w25_ovl_install()), загружает его в RAM (w25_ovl_load())
+ *                  и проверяет повторную загрузку, обнаружение искажённого образа и запись образа, переданного
+ *                  программатором в область загрузки (w25_ovl_staged()) (выполнение кода ARM на host
+ *                  невозможно - сравнение скорости flash/RAM выполняется на плате, ovl_fir_bench());
+ *                - выполняет стирание и запись через движок w25_async (шаг опроса - 1 мс, как TIM7);
+ *                - проверяет попадания и сквозную запись кэша w25_cache на цикле чтений, как в main.c;
+ *                - проверяет хранилище w25_kv (перемонтирование, сборка мусора, прерванная запись, пропадание
+ *                  питания после стирания при сборке мусора) и измеряет время монтирования при разной длине журнала;
+ *                - записывает в журнал w25_log поток 1 кГц (4 канала) при типовых и максимальных tSE/tBE,
+ *                  проверяет поиск головы журнала после пропадания питания и прерванного программирования;
+ *                - сравнивает наибольшую задержку срочного чтения w25_async_read() во время стирания и записи
+ *                  с приостановкой операции (Suspend/Resume) и с ожиданием её завершения.
+ *                Время - виртуальное время модели (SCK из SPI2->CR1.BR, tSE/tPP из w25sim_timing).
+ *                Код возврата - количество непройденных проверок.
+ -------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "main.h"
+#include "w25q64.h"
+#include "w25_async.h"
+#include "w25_cache.h"
+#include "w25_kv.h"
+#include "w25_log.h"
+#include "w25_crc.h"
+#include "spi2_bus.h"
+#include "w25_ovl.h"
+#include "spi2_init.h"
+#include "w25q64_sim.h"
+
+#define BENCH_ADDR 0x010000UL // Адрес тестового блока (граница сектора)
+#define BENCH_LEN  4096       // Размер тестового блока
+
+static uint8_t bench_src[BENCH_LEN]; // Записываемые данные
+static uint8_t bench_ovl_img[3000];  // Образ оверлея (на плате - ovl_fir.bin или копия во flash, OVL_FLASH_COPY)
+static uint8_t bench_dst[BENCH_LEN]; // Считанные данные
+static int     bench_failed = 0;
+static volatile uint32_t bench_done = 0;
+
+static void bench_check(const char *name, int ok) {
+  printf("  %-44s %s\n", name, ok ? "OK" : "FAIL");
+  if (!ok) bench_failed++;
+}
+
+static void bench_report(const char *name, uint64_t ns, uint64_t bytes, uint32_t payload) {
+  printf("  %-30s %10.3f мс  %9.1f КБ/с  %5.2f байт шины на байт данных\n",
+         name, ns / 1e6, payload / 1024.0 / (ns / 1e9), (double)bytes / payload);
+}
+
+/**
+ * @brief Проверка значений всех ключей хранилища после серии записей bench_kv_fill().
+ */
+static int bench_kv_verify(uint32_t rounds) {
+  uint8_t  val[W25_KV_MAX_LEN];
+  uint16_t key, len;
+
+  for (key = 0; key < 16; key++) {
+    uint32_t last = rounds - 1 - ((rounds - 1 - key) % 16); // Последний раунд, в котором записан ключ
+    len = (uint16_t)(4 + last % (W25_KV_MAX_LEN - 4));
+    if (w25_kv_get(key, val, sizeof(val)) != len) return 0;
+    for (uint16_t j = 0; j < len; j++) {
+      if (val[j] != (uint8_t)(last + j)) return 0;
+    }
+  }
+  return 1;
+}
+
+/**
+ * @brief Серия записей: раунд r записывает ключ r % 16 длиной 4..W25_KV_MAX_LEN - 1.
+ */
+static void bench_kv_fill(uint32_t from, uint32_t rounds) {
+  uint8_t  val[W25_KV_MAX_LEN];
+  uint16_t len;
+
+  for (uint32_t r = from; r < rounds; r++) {
+    len = (uint16_t)(4 + r % (W25_KV_MAX_LEN - 4));
+    for (uint16_t j = 0; j < len; j++) val[j] = (uint8_t)(r + j);
+    w25_kv_set((uint16_t)(r % 16), val, len);
+  }
+}
+
+#define BENCH_KV_SIZE (W25_KV_SECTORS * W25_SECTOR_SIZE)
+
+static uint8_t bench_kv_img[BENCH_KV_SIZE];  // Область хранилища до записи (откат попытки)
+static uint8_t bench_kv_cut[BENCH_KV_SIZE];  // Область хранилища в момент пропадания питания
+static int     bench_kv_cut_done = 0;
+
+/**
+ * @brief Пропадание питания сразу после стирания сектора при сборке мусора: снимок области хранилища.
+ */
+static void bench_kv_erase_hook(uint32_t base) {
+  if (bench_kv_cut_done || base < W25_KV_BASE || base >= W25_KV_BASE + BENCH_KV_SIZE) return;
+  memcpy(bench_kv_cut, &w25sim_mem()[W25_KV_BASE], BENCH_KV_SIZE);
+  bench_kv_cut_done = 1;
+}
+
+/**
+ * @brief Пропадание питания между стиранием старого сектора и записью нового значения ключа.
+ *
+ * Ключ 20 записывается один раз в сектор 0, затем ключи 0..15 заполняют сектора 0..6 записями того же размера.
+ * Первая сборка мусора (переход на сектор 7) переносит сектор 0; запись ключа 20, вызвавшая её, прерывается
+ * после стирания. Попытки записи ключа 20 без перехода откатываются.
+ *
+ * @return int 1 - после монтирования ключ 20 содержит старое значение, ключи 0..15 - последние.
+ */
+static int bench_kv_power_cut(void) {
+  uint32_t r, val, v_old = 0xA5A50001UL, v_new = 0xA5A50002UL;
+
+  memset(&w25sim_mem()[W25_KV_BASE], 0xFF, BENCH_KV_SIZE);
+  w25_kv_mount();
+  w25_kv_set(20, &v_old, 4);
+
+  for (r = 0; w25_kv_stats.active < W25_KV_SECTORS - 2; r++) w25_kv_set((uint16_t)(r % 16), &r, 4);
+
+  bench_kv_cut_done = 0;
+  while (1) {                                           // Запись ключа 20 до перехода на следующий сектор
+    memcpy(bench_kv_img, &w25sim_mem()[W25_KV_BASE], BENCH_KV_SIZE);
+    w25sim_erase_hook = bench_kv_erase_hook;
+    w25_kv_set(20, &v_new, 4);
+    w25sim_erase_hook = 0;
+    if (bench_kv_cut_done) break;
+    memcpy(&w25sim_mem()[W25_KV_BASE], bench_kv_img, BENCH_KV_SIZE); // Откат: запись без перехода
+    w25_kv_mount();
+    w25_kv_set((uint16_t)(r % 16), &r, 4);
+    r++;
+  }
+
+  memcpy(&w25sim_mem()[W25_KV_BASE], bench_kv_cut, BENCH_KV_SIZE);
+  w25_kv_mount();
+
+  for (uint16_t key = 0; key < 16; key++) {
+    if (w25_kv_get(key, &val, 4) != 4 || val != r - 1 - ((r - 1 - key) % 16)) return 0;
+  }
+  return w25_kv_get(20, &val, 4) == 4 && val == v_old;
+}
+
+// Кадр журнала: метка времени и 4 канала АЦП
+typedef struct {
+  uint32_t ms;
+  uint16_t ch[4];
+} bench_frame_t;
+
+static uint8_t bench_page[W25_PAGE_SIZE];
+
+/**
+ * @brief Поток кадров 1 кГц: запись из «прерывания» и шаг движка (TIM7) каждую миллисекунду.
+ */
+static void bench_log_stream(uint32_t from, uint32_t ms) {
+  bench_frame_t f;
+
+  for (uint32_t t = from; t < from + ms; t++) {
+    f.ms = t;
+    for (int c = 0; c < 4; c++) f.ch[c] = (uint16_t)((t * (c + 1)) & 0x0FFF);
+    w25_log_push(&f, sizeof(f));
+    w25_async_poll();
+    w25sim_advance_ns(1000000ULL);
+  }
+  for (uint32_t n = 0; !w25_async_idle() && n < 10000; n++) { // Завершение очереди
+    w25_async_poll();
+    w25sim_advance_ns(1000000ULL);
+  }
+}
+
+/**
+ * @brief Проверка страниц журнала first..last: кадры с последовательными метками времени.
+ */
+static int bench_log_verify(uint32_t first, uint32_t last) {
+  bench_frame_t f;
+  int16_t       used;
+  uint32_t      t = (uint32_t)-1;
+
+  for (uint32_t seq = first; seq <= last; seq++) {
+    used = w25_log_read(seq, bench_page);
+    if (used <= 0 || used % sizeof(f)) return 0;
+    for (int16_t off = 0; off < used; off += sizeof(f)) {
+      memcpy(&f, &bench_page[W25_LOG_HDR_SIZE + off], sizeof(f));
+      if (t != (uint32_t)-1 && f.ms != t + 1) return 0;
+      if (f.ch[3] != (uint16_t)((f.ms * 4) & 0x0FFF)) return 0;
+      t = f.ms;
+    }
+  }
+  return 1;
+}
+
+/**
+ * @brief Стирание и запись 4 КБ через движок, срочное чтение 16 байт другой области каждые 3 мс.
+ *
+ * @return int 1 - все срочные чтения и записанные данные верны.
+ */
+static spi2_dev_t  bench_sensor;             // Датчик на PE4: режим 3, 16-битный кадр
+static spi2_xfer_t bench_sens_x[4][2];       // Транзакции: команда + чтение 8 кадров
+static uint16_t    bench_sens_cmd = 0x8F00;
+static uint16_t    bench_sens_rx[4][8];
+static uint32_t    bench_sens_done = 0;
+
+static void bench_sensor_cb(spi2_xfer_t *xfer) {
+  if (xfer->state == SPI2_XFER_DONE) bench_sens_done++;
+}
+
+static int bench_urgent(uint32_t target, uint32_t other, uint8_t use_suspend) {
+  static uint8_t buf[16]; // Статический буфер: адрес DMA должен помещаться в 32 бита
+  int            ok = 1;
+
+  w25_async_suspend_enable = use_suspend;
+  memset(&w25_async_stats, 0, sizeof(w25_async_stats));
+  memset(bench_src, 0xA5, BENCH_LEN);
+
+  w25_async_erase(target, 0);
+  w25_async_program(target, bench_src, BENCH_LEN, 0);
+  for (uint32_t ms = 0; !w25_async_idle() && ms < 100000; ms++) {
+    if (ms % 3 == 1) {
+      w25_async_read(other, buf, sizeof(buf));
+      if (memcmp(buf, &w25sim_mem()[other], sizeof(buf))) ok = 0;
+    }
+    w25_async_poll();
+    w25sim_advance_ns(1000000ULL);
+  }
+
+  return ok && memcmp(&w25sim_mem()[target], bench_src, BENCH_LEN) == 0;
+}
+
+static void bench_async_done(uint8_t op, uint32_t address) {
+  (void)op;
+  (void)address;
+  bench_done++;
+}
+
+void DMA1_Stream0_IRQHandler(void); // dma_mgr.c
+
+static uint32_t bench_dma_flags; // Флаги последнего вызова callback-функции dma_mgr
+
+static void bench_dma_cb(void *ctx, uint32_t flags) {
+  (void)ctx;
+  bench_dma_flags = flags;
+}
+
+// Установка флагов DMA1 Stream0 (LISR, сдвиг 0) и прерывание потока; err - поток остановлен ошибкой (EN = 0)
+static uint32_t bench_dma_irq(uint32_t flags, int err) {
+  if (err) DMA1_Stream0->CR &= ~DMA_SxCR_EN;
+  DMA1->LISR |= flags;
+  bench_dma_flags = 0;
+  DMA1_Stream0_IRQHandler();
+  return bench_dma_flags;
+}
+
+// Флаги прерывания dma_mgr: маска FE прямого режима и сброс счётчика перезапусков по TC
+static void bench_dma_mgr(void) {
+  DMA_Stream_TypeDef  *s   = dma_mgr_claim(DMA_REQ_SPI3_RX, 0, bench_dma_cb, 0, 0); // DMA1 Stream0
+  const dma_mgr_err_t *err = dma_mgr_errors(s);
+
+  printf("Флаги потоков dma_mgr:\n");
+  s->FCR  = 0;                                        // Прямой режим
+  s->NDTR = 16;
+  dma_mgr_start(s, 1);
+  bench_check("прямой режим: FE + HT -> только HT", bench_dma_irq(DMA_LISR_FEIF0 | DMA_LISR_HTIF0, 0) == DMA_MGR_HT &&
+              err->fe == 0 && (DMA1->LISR & DMA_LISR_FEIF0) == 0);
+  bench_check("TE, поток остановлен -> перезапуск", bench_dma_irq(DMA_LISR_TEIF0, 1) == (DMA_MGR_TE | DMA_MGR_REARM));
+  bench_check("TC + TE: счётчик сброшен -> снова перезапуск",
+              bench_dma_irq(DMA_LISR_TCIF0 | DMA_LISR_TEIF0, 1) == (DMA_MGR_TC | DMA_MGR_TE | DMA_MGR_REARM));
+  bench_check("TE подряд без TC -> FAIL", bench_dma_irq(DMA_LISR_TEIF0, 1) & DMA_MGR_FAIL);
+
+  dma_mgr_stop(s);
+  s->FCR = DMA_SxFCR_DMDIS;                           // FIFO включён
+  dma_mgr_start(s, 1);
+  bench_check("FIFO: FE передаётся и считается", (bench_dma_irq(DMA_LISR_FEIF0, 0) & DMA_MGR_FE) && err->fe == 1);
+  dma_mgr_release(s);
+}
+
+int main(void) {
+  uint64_t t0, b0;
+  uint32_t i, polls, seq0;
+  int      ok;
+
+  for (i = 0; i < BENCH_LEN; i++) bench_src[i] = (uint8_t)(i * 7 + 3);
+
+  w25sim_reset();
+  printf("Инициализация SPI2:\n");
+  bench_check("spi2_init: DMA1 Stream4 занят (UART4_TX) -> 0", dma_mgr_claim(DMA_REQ_UART4_TX, 0, 0, 0, 0) == DMA1_Stream4 &&
+              spi2_init() == 0);
+  dma_mgr_release(DMA1_Stream4);
+  bench_check("spi2_init: потоки освобождены -> 1", spi2_init() == 1);
+
+  bench_dma_mgr();
+
+  printf("Калибровка частоты SPI2:\n");
+  w25sim_timing.sck_max = 11000000UL; // Линия надёжно работает только до 11 МГц
+  bench_check("spi2_autotune: ограничение линии 11 МГц -> 10,5 МГц", spi2_autotune() == 10500000UL);
+  w25sim_timing.sck_max = 0;
+  bench_check("spi2_autotune: без ограничения -> 21 МГц", spi2_autotune() == 21000000UL);
+  printf("  SCK = %lu Гц (SPI2->CR1.BR = %lu)\n", (unsigned long)spi2_sck_hz,
+         (unsigned long)((SPI2->CR1 & SPI_CR1_BR) >> SPI_CR1_BR_Pos));
+
+  printf("Проверки драйвера:\n");
+  w25_erase_sector(BENCH_ADDR);
+  bench_check("w25_erase_sector: сектор стёрт (0xFF)", w25sim_mem()[BENCH_ADDR] == 0xFF && w25sim_mem()[BENCH_ADDR + 4095] == 0xFF);
+
+  t0 = w25sim_time_ns(); b0 = w25sim_stats.bytes;
+  w25_write(BENCH_ADDR + 5, bench_src, BENCH_LEN - 5); // Невыровненный адрес - разбиение по страницам
+  bench_check("w25_write: данные в массиве модели", memcmp(&w25sim_mem()[BENCH_ADDR + 5], bench_src, BENCH_LEN - 5) == 0);
+  bench_check("w25_write: байт перед блоком не изменён", w25sim_mem()[BENCH_ADDR + 4] == 0xFF);
+  bench_check("w25_write: страницы цепочкой из 2 сегментов", spi2_tx_chain.stats.chains == w25sim_stats.programs &&
+              spi2_tx_chain.stats.segs == 2 * spi2_tx_chain.stats.chains && spi2_tx_chain.stats.errors == 0);
+  printf("  %-44s %u\n", "страниц запрограммировано:", w25sim_stats.programs);
+  bench_report("w25_write 4 КБ", w25sim_time_ns() - t0, w25sim_stats.bytes - b0, BENCH_LEN - 5);
+
+  t0 = w25sim_time_ns(); b0 = w25sim_stats.bytes;
+  w25_read(BENCH_ADDR + 5, bench_dst, BENCH_LEN - 5);
+  uint64_t t_bulk = w25sim_time_ns() - t0, b_bulk = w25sim_stats.bytes - b0;
+  bench_check("w25_read: совпадение с записанным", memcmp(bench_dst, bench_src, BENCH_LEN - 5) == 0);
+
+  t0 = w25sim_time_ns(); b0 = w25sim_stats.bytes;
+  for (i = 0, ok = 1; i < BENCH_LEN - 5; i++) {
+    w25read(BENCH_ADDR + 5 + i);
+    if (memrd != bench_src[i]) ok = 0;
+  }
+  uint64_t t_byte = w25sim_time_ns() - t0, b_byte = w25sim_stats.bytes - b0;
+  bench_check("w25read: совпадение с записанным", ok);
+
+  printf("Чтение 4 КБ:\n");
+  bench_report("w25read (побайтно)", t_byte, b_byte, BENCH_LEN - 5);
+  bench_report("w25_read (Fast Read + DMA)", t_bulk, b_bulk, BENCH_LEN - 5);
+
+  printf("Проверка CRC-32 (блок CRC):\n");
+  uint32_t word = 0x12345678UL, crc;
+  bench_check("w25_crc32: слово 0x12345678 -> 0xDF8A8A2B", w25_crc32(W25_CRC_INIT, (uint8_t *)&word, 4) == 0xDF8A8A2BUL);
+  crc = w25_crc32(W25_CRC_INIT, bench_src, BENCH_LEN - 5);
+  bench_check("w25_crc32: вычисление по частям", w25_crc32(w25_crc32(W25_CRC_INIT, bench_src, 1000), &bench_src[1000],
+              BENCH_LEN - 1005) == crc);
+  t0 = w25sim_time_ns(); b0 = w25sim_stats.bytes;
+  memset(bench_dst, 0, BENCH_LEN);
+  ok = w25_read_verified(BENCH_ADDR + 5, bench_dst, BENCH_LEN - 5, crc);
+  bench_check("w25_read_verified: CRC и данные верны", ok && memcmp(bench_dst, bench_src, BENCH_LEN - 5) == 0);
+  bench_report("w25_read_verified 4 КБ", w25sim_time_ns() - t0, w25sim_stats.bytes - b0, BENCH_LEN - 5);
+  bench_check("w25_crc_flash: совпадение с CRC данных", w25_crc_flash(BENCH_ADDR + 5, BENCH_LEN - 5) == crc);
+  w25sim_mem()[BENCH_ADDR + 3000] ^= 0x10;           // Искажение одного бита в памяти
+  bench_check("w25_read_verified: искажение обнаружено", !w25_read_verified(BENCH_ADDR + 5, bench_dst, BENCH_LEN - 5, crc));
+  w25sim_mem()[BENCH_ADDR + 3000] ^= 0x10;
+  w25_erase_sector(BENCH_ADDR + 0x1000);
+  bench_check("w25_write_verified: стёртая область", w25_write_verified(BENCH_ADDR + 0x1000, bench_src, 1000));
+  bench_check("w25_write_verified: нестёртая область - ошибка", !w25_write_verified(BENCH_ADDR + 0x1000, &bench_src[1], 1000));
+
+  printf("Шина spi2_bus (датчик на PE4, режим 3, 16 бит, 5,25 МГц):\n");
+  spi2_bus_dev_init(&bench_sensor, GPIOE, 4, SPI2_DEV_CR1(3, 2, 1));
+  uint32_t reconfigs = spi2_bus_stats.reconfigs;
+  b0 = w25sim_stats.bytes;
+  for (i = 0, ok = 1; i < 4; i++) {
+    bench_sens_x[i][0] = (spi2_xfer_t){ &bench_sensor, &bench_sens_cmd, 0, 1, &bench_sens_x[i][1], bench_sensor_cb, 0 };
+    bench_sens_x[i][1] = (spi2_xfer_t){ 0, 0, bench_sens_rx[i], 8, 0, 0, 0 };
+    ok &= spi2_bus_submit(bench_sens_x[i]);
+  }
+  bench_check("spi2_bus_submit: 4 транзакции приняты", ok && spi2_bus_stats.max_queue == 4);
+  memset(bench_dst, 0, 256);
+  w25_read(BENCH_ADDR + 5, bench_dst, 256);             // Захват шины во время потока датчика
+  bench_check("w25_read: шина получена после 1 транзакции", bench_sens_done == 1 && spi2_bus_stats.waits == 1);
+  bench_check("w25_read: данные верны", memcmp(bench_dst, bench_src, 256) == 0);
+  while (!spi2_bus_idle()) __WFI();
+  bench_check("spi2_bus: все транзакции завершены", bench_sens_done == 4 && spi2_bus_stats.xfers == 4);
+  bench_check("spi2_bus: CR1 перенастроен 3 раза", spi2_bus_stats.reconfigs - reconfigs == 3);
+  bench_check("spi2_bus: 16-битные кадры (4 x 9 x 2 байт)", w25sim_stats.bytes - b0 == 4 * 18 + 5 + 256);
+  bench_check("spi2_bus: режим датчика в SPI2->CR1", (SPI2->CR1 & SPI2_DEV_CR1_MASK) == SPI2_DEV_CR1(3, 2, 1));
+  w25_read(BENCH_ADDR + 5, bench_dst, 256);
+  bench_check("w25_read: после датчика - режим памяти", memcmp(bench_dst, bench_src, 256) == 0 &&
+              (SPI2->CR1 & SPI2_DEV_CR1_MASK) == w25_dev.cr1);
+
+  printf("Оверлей w25_ovl (образ %u байт):\n", (unsigned)sizeof(bench_ovl_img));
+  for (i = 0; i < sizeof(bench_ovl_img); i++) bench_ovl_img[i] = (uint8_t)(i * 13 + 1);
+  const w25_ovl_t bench_ovl = { bench_ovl_img, bench_ovl_img + sizeof(bench_ovl_img), W25_OVL_BASE };
+  uint8_t *ovl_base;
+  bench_check("w25_ovl_install: без образа не записывается", w25_ovl_install(&bench_ovl, 0) == 0);
+  bench_check("w25_ovl_install: образ записан", w25_ovl_install(&bench_ovl, bench_ovl_img) == 1);
+  bench_check("w25_ovl_install: повторная запись не нужна", w25_ovl_install(&bench_ovl, bench_ovl_img) == 0);
+  t0 = w25sim_time_ns();
+  ovl_base = w25_ovl_load(&bench_ovl);
+  bench_check("w25_ovl_load: образ в RAM", ovl_base && memcmp(ovl_base, bench_ovl_img, sizeof(bench_ovl_img)) == 0);
+  printf("  %-44s %.3f мс, %lu тактов\n", "загрузка:", (w25sim_time_ns() - t0) / 1e6,
+         (unsigned long)w25_ovl_stats.load_cycles);
+  bench_check("w25_ovl_load: повторный запрос без чтения", w25_ovl_load(&bench_ovl) == ovl_base && w25_ovl_stats.hits == 1);
+  bench_check("W25_OVL_PTR: пересчёт адреса", W25_OVL_PTR(&bench_ovl, ovl_base, &bench_ovl_img[100]) == ovl_base + 100);
+  w25sim_mem()[W25_OVL_BASE + W25_OVL_HDR_SIZE + 2000] ^= 0x01; // Искажение образа в памяти
+  w25_ovl_unload();
+  bench_check("w25_ovl_load: искажение обнаружено", w25_ovl_load(&bench_ovl) == 0 && w25_ovl_stats.errors == 1);
+  bench_check("w25_ovl_install: повреждённый образ перезаписан", w25_ovl_install(&bench_ovl, bench_ovl_img) == 1 &&
+              w25_ovl_load(&bench_ovl) == ovl_base && w25_ovl_stats.installs == 2);
+  w25sim_mem()[W25_OVL_BASE + W25_OVL_HDR_SIZE + 10] ^= 0x01;
+  bench_check("w25_ovl_staged: область без образа", w25_ovl_staged(&bench_ovl) == 0);
+  ((uint32_t *)ovl_base)[0] = W25_OVL_STAGE; // Программатор: заголовок и образ в области загрузки
+  ((uint32_t *)ovl_base)[1] = sizeof(bench_ovl_img);
+  memcpy(ovl_base + W25_OVL_HDR_SIZE, bench_ovl_img, sizeof(bench_ovl_img));
+  bench_check("w25_ovl_staged: образ от программатора записан", w25_ovl_install(&bench_ovl, w25_ovl_staged(&bench_ovl)) == 1 &&
+              w25_ovl_stats.installs == 3 && w25_ovl_staged(&bench_ovl) == 0);
+  bench_check("w25_ovl_load: образ от программатора", w25_ovl_load(&bench_ovl) == ovl_base &&
+              memcmp(ovl_base, bench_ovl_img, sizeof(bench_ovl_img)) == 0);
+
+  printf("Движок w25_async (шаг 1 мс):\n");
+  memset(bench_src, 0x5A, BENCH_LEN);
+  t0 = w25sim_time_ns();
+  w25_async_erase(BENCH_ADDR, bench_async_done);
+  w25_async_program(BENCH_ADDR, bench_src, BENCH_LEN, bench_async_done);
+  for (polls = 0; !w25_async_idle() && polls < 100000; polls++) {
+    w25_async_poll();
+    w25sim_advance_ns(1000000ULL); // Период TIM7
+  }
+  bench_check("w25_async: оба запроса завершены", bench_done == 2);
+  bench_check("w25_async: данные в массиве модели", memcmp(&w25sim_mem()[BENCH_ADDR], bench_src, BENCH_LEN) == 0);
+  printf("  %-44s %u шагов, %.1f мс\n", "стирание + 4 КБ программирования:", polls, (w25sim_time_ns() - t0) / 1e6);
+
+  printf("Кэш w25_cache (%u строк по %u байт):\n", W25_CACHE_WAYS, W25_CACHE_LINE);
+  w25_cache_init();
+  t0 = w25sim_time_ns(); b0 = w25sim_stats.bytes;
+  for (i = 0, ok = 1; i < 300; i++) { // Опрос трёх кнопок, как в основном цикле main.c
+    w25_cache_read(BENCH_ADDR + i % 3, &memrd, 1);
+    if (memrd != 0x5A) ok = 0;
+  }
+  bench_check("w25_cache_read: совпадение с памятью", ok);
+  bench_check("w25_cache_read: 1 промах, 299 попаданий", w25_cache_stats.misses == 1 && w25_cache_stats.hits == 299);
+  printf("  %-44s %.3f мс, %lu байт шины\n", "300 чтений по 1 байту:", (w25sim_time_ns() - t0) / 1e6,
+         (unsigned long)(w25sim_stats.bytes - b0));
+
+  memset(bench_src, 0x12, 16);
+  w25_write(BENCH_ADDR, bench_src, 16);
+  w25_cache_read(BENCH_ADDR, bench_dst, 16);
+  bench_check("w25_write: сквозная запись в кэш (0x5A & 0x12)", bench_dst[0] == 0x12 && bench_dst[15] == 0x12);
+  w25_erase_sector(BENCH_ADDR);
+  w25_cache_read(BENCH_ADDR, bench_dst, 16);
+  bench_check("w25_erase_sector: строки сектора в кэше - 0xFF", bench_dst[0] == 0xFF && bench_dst[15] == 0xFF);
+  static const dma_seg_t busy = { bench_src, 1, 0 };
+  uint32_t chains0 = spi2_tx_chain.stats.chains;
+  spi2_tx_chain.seg = &busy;                           // Цепочка занята: spi2_dma_tx_chain() не запускается
+  w25_write(BENCH_ADDR, bench_src, 16);
+  spi2_tx_chain.seg = 0;
+  w25_cache_read(BENCH_ADDR, bench_dst, 16);
+  bench_check("w25_program_page: цепочка занята -> побайтно", spi2_tx_chain.stats.chains == chains0 &&
+              w25sim_mem()[BENCH_ADDR] == 0x12 && w25sim_mem()[BENCH_ADDR + 15] == 0x12);
+  bench_check("... кэш совпадает с памятью", memcmp(bench_dst, &w25sim_mem()[BENCH_ADDR], 16) == 0);
+  w25_cache_read(BENCH_ADDR, bench_dst, BENCH_LEN);
+  bench_check("w25_cache_read: длинное чтение мимо кэша", w25_cache_stats.bypass == 1 && w25_cache_stats.misses == 1);
+  printf("  %-44s %lu / %lu / %lu\n", "попаданий / промахов / вытеснений:", (unsigned long)w25_cache_stats.hits,
+         (unsigned long)w25_cache_stats.misses, (unsigned long)w25_cache_stats.evictions);
+
+  printf("Хранилище w25_kv (%u секторов с 0x%06X):\n", W25_KV_SECTORS, W25_KV_BASE);
+  w25_kv_mount();
+  bench_check("w25_kv_mount: разметка пустой области", w25_kv_stats.live == 0 && w25_kv_stats.active == 0);
+  printf("  %-44s %8.3f мс\n", "монтирование пустой области:", w25_kv_stats.mount_cycles / 84e3);
+
+  bench_kv_fill(0, 32);
+  w25_kv_mount();
+  bench_check("w25_kv_mount: 32 записи, 16 ключей", w25_kv_stats.live == 16 && bench_kv_verify(32));
+  printf("  %-44s %8.3f мс\n", "монтирование, 32 записи:", w25_kv_stats.mount_cycles / 84e3);
+
+  uint32_t erases0 = w25sim_stats.erases;
+  bench_kv_fill(32, 5000);
+  bench_check("w25_kv_set: 5000 записей, значения верны", bench_kv_verify(5000));
+  bench_check("w25_kv_set: сборка мусора выполнялась", w25_kv_stats.gc_runs > W25_KV_SECTORS);
+  printf("  %-44s %lu стираний (%.1f на сектор)\n", "5000 записей:", (unsigned long)(w25sim_stats.erases - erases0),
+         (double)(w25sim_stats.erases - erases0) / W25_KV_SECTORS);
+  w25_kv_mount();
+  bench_check("w25_kv_mount: после 5000 записей", w25_kv_stats.live == 16 && w25_kv_stats.crc_errors == 0 && bench_kv_verify(5000));
+  printf("  %-44s %8.3f мс (%lu записей просмотрено)\n", "монтирование, 5000 записей:", w25_kv_stats.mount_cycles / 84e3,
+         (unsigned long)w25_kv_stats.records);
+
+  // Прерванная запись: данные следующей записи запрограммированы, заголовок - нет
+  uint8_t *sect = &w25sim_mem()[W25_KV_BASE + w25_kv_stats.active * W25_SECTOR_SIZE];
+  for (i = W25_SECTOR_SIZE; i > 0 && sect[i - 1] == 0xFF; i--);
+  i = (i + 3) & ~3UL;
+  if (i + 16 < W25_SECTOR_SIZE) sect[i + 12] = 0x00;
+  w25_kv_mount();
+  bench_kv_fill(5000, 5001);
+  bench_check("w25_kv: прерванная запись не видна, значения верны", bench_kv_verify(5001));
+  w25_kv_mount();
+  bench_check("w25_kv_mount: после прерванной записи", w25_kv_stats.live == 16 && bench_kv_verify(5001));
+  w25_kv_delete(3);
+  w25_kv_mount();
+  bench_check("w25_kv_delete: ключ удалён после перемонтирования", w25_kv_get(3, bench_dst, 1) == -1 && w25_kv_stats.live == 15);
+  bench_check("w25_kv: питание пропало после стирания при сборке", bench_kv_power_cut());
+
+  printf("Журнал w25_log (1 кГц, кадр %u байт, %u кадров на страницу):\n", (unsigned)sizeof(bench_frame_t),
+         (unsigned)(W25_LOG_PAYLOAD / sizeof(bench_frame_t)));
+  w25_log_mount();
+  bench_check("w25_log_mount: пустая область, seq = 1", w25_log_seq() == 1);
+  printf("  %-44s %8.3f мс\n", "монтирование пустой области:", w25_log_stats.mount_cycles / 84e3);
+
+  bench_log_stream(0, 5000);
+  bench_check("w25_log: 5 с потока без потерь", w25_log_stats.dropped == 0 && w25_log_stats.pages == 250);
+  bench_check("w25_log_read: страницы 1..250 верны", bench_log_verify(1, 250));
+  printf("  %-44s %u страниц, %u стираний, до %u буферов занято\n", "tSE 45 мс, 5 с:", w25_log_stats.pages,
+         w25_log_stats.erases, w25_log_stats.max_pending);
+
+  w25_log_push(bench_page, 12);                   // Неполная страница в RAM теряется при отключении питания
+  w25_log_mount();
+  bench_check("w25_log_mount: голова после 250 страниц", w25_log_seq() == 251 && bench_log_verify(250, 250));
+  printf("  %-44s %8.3f мс\n", "монтирование, 250 страниц:", w25_log_stats.mount_cycles / 84e3);
+
+  w25sim_mem()[W25_LOG_BASE + 250 * W25_PAGE_SIZE + 40] = 0x00; // Прерванное программирование страницы 251
+  w25_log_mount();
+  bench_check("w25_log_mount: пропуск повреждённого сектора", w25_log_seq() == 257);
+  bench_log_stream(5000, 400);
+  bench_check("w25_log: запись после восстановления", bench_log_verify(257, 276) && bench_log_verify(1, 250));
+
+  w25sim_timing.t_se = 400000000ULL;  // Максимальные времена стирания по документации
+  w25sim_timing.t_be = 2000000000ULL;
+  w25_log_mount();
+  seq0 = w25_log_seq();
+  bench_log_stream(10000, 20000);     // 4 блока 64 КБ
+  bench_check("w25_log: tSE 400 мс, tBE 2 с - без потерь", w25_log_stats.dropped == 0 && w25_log_stats.pages == 1000);
+  bench_check("w25_log_read: страницы верны", bench_log_verify(seq0, seq0 + 999));
+  printf("  %-44s %u страниц, отброшено %u кадров, до %u буферов занято\n", "tSE 400 мс, tBE 2 с, 20 с:",
+         w25_log_stats.pages, w25_log_stats.dropped, w25_log_stats.max_pending);
+  printf("  %-44s %u\n", "приостановок стирания для программирования:", w25_async_stats.bg_suspends);
+  w25sim_timing.t_se = 45000000ULL;
+  w25sim_timing.t_be = 150000000ULL;
+
+  printf("Срочное чтение w25_async_read() во время стирания и записи 4 КБ:\n");
+  w25sim_timing.t_se = 400000000ULL; // Максимальное время стирания по документации
+  bench_check("без Suspend: данные верны", bench_urgent(BENCH_ADDR, BENCH_ADDR + 0x10000, 0));
+  uint32_t wait_max = w25_async_stats.read_max_cycles;
+  printf("  %-44s %10.1f мкс (%u чтений, %u с ожиданием)\n", "без Suspend, наибольшая задержка:", wait_max / 84.0,
+         w25_async_stats.reads, w25_async_stats.waits);
+  bench_check("с Suspend: данные верны", bench_urgent(BENCH_ADDR, BENCH_ADDR + 0x10000, 1));
+  printf("  %-44s %10.1f мкс (%u чтений, %u приостановок)\n", "с Suspend, наибольшая задержка:",
+         w25_async_stats.read_max_cycles / 84.0, w25_async_stats.reads, w25_async_stats.suspends);
+  bench_check("с Suspend: задержка < 100 мкс", w25_async_stats.read_max_cycles < 100 * 84);
+  bench_check("чтение стираемого сектора ждёт завершения", bench_urgent(BENCH_ADDR, BENCH_ADDR + 0x100, 1) &&
+              w25_async_stats.waits > 0);
+  w25sim_timing.t_se = 45000000ULL;
+  w25_async_suspend_enable = 1;
+
+  printf("Непройдено проверок: %d\n", bench_failed);
+  return bench_failed;
+}
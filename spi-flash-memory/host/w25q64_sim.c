@@ -0,0 +1,277 @@
+/**
+------------------------------------------------------------------------------------------------------------------------------
+ * @file        : w25q64_sim.c
+ * @brief       : Поведенческая модель памяти W25Q64 (host).
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : Linux x86-64 (host)
+ * @MCU         : STM32F407VET6 (модель)
+ * @IDE         : gcc
+ * @Description : Автомат команд W25Q64. Каждая команда начинается спадом CS; первый байт - код команды,
+ *                следующие - адрес, фиктивные байты и данные. Операции стирания/программирования/сброса
+ *                выполняются по подъёму CS при выполненных условиях (WEL = 1, полный адрес).
+ -------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#include <string.h>
+#include "w25q64_sim.h"
+
+// Коды команд W25Q64
+#define SIM_WR_EN    0x06
+#define SIM_WR_DIS   0x04
+#define SIM_RD_SR1   0x05
+#define SIM_RD_DATA  0x03
+#define SIM_FAST_RD  0x0B
+#define SIM_PG_PROG  0x02
+#define SIM_SECT_ER  0x20
+#define SIM_BLK_ER   0xD8
+#define SIM_EN_RST   0x66
+#define SIM_RST      0x99
+#define SIM_JEDEC    0x9F
+#define SIM_RD_SR2   0x35
+#define SIM_SUSPEND  0x75
+#define SIM_RESUME   0x7A
+#define SIM_IGNORED  0x00     // Команда отброшена (память занята или неизвестный код)
+
+#define SIM_SR1_BUSY 0x01
+#define SIM_SR1_WEL  0x02
+#define SIM_SR2_SUS  0x80
+
+w25sim_timing_t w25sim_timing = {
+  45000000ULL,  // tSE  = 45 мс
+  700000ULL,    // tPP  = 0,7 мс
+  30000ULL,     // tRST = 30 мкс
+  20000ULL,     // tSUS = 20 мкс
+  0ULL,         // Пауза между байтами при побайтном обмене
+  0UL,          // Ограничение частоты SCK отсутствует
+  150000000ULL  // tBE  = 150 мс
+};
+
+w25sim_stats_t w25sim_stats;
+void (*w25sim_erase_hook)(uint32_t base) = 0;
+
+static uint8_t w25sim_array[W25SIM_SIZE]; // Массив памяти
+
+static struct {
+  uint8_t  cs;          // Уровень CS
+  uint8_t  cmd;         // Код текущей команды
+  uint32_t idx;         // Номер байта в текущей команде (0 - код команды)
+  uint32_t addr;        // Адрес текущей команды
+  uint8_t  wel;         // Бит WEL
+  uint8_t  rst_en;      // Получена команда EN_RST, ожидается RST
+  uint64_t now;         // Виртуальное время, нс
+  uint64_t busy_until;  // Время окончания внутренней операции
+  uint8_t  busy_op;     // Выполняемая операция (SIM_SECT_ER, SIM_BLK_ER, SIM_PG_PROG, SIM_RST, SIM_SUSPEND)
+  uint8_t  sus;         // Бит SUS: операция приостановлена
+  uint8_t  sus_op;      // Приостановленная операция
+  uint64_t remaining;   // Оставшееся время приостановленной операции
+  uint32_t sus_base;    // Область приостановленного стирания
+  uint32_t sus_size;
+  uint32_t er_base;     // Область выполняемого стирания
+  uint32_t er_size;
+  uint64_t resumed_at;  // Время последнего Resume
+  uint8_t  page[256];   // Буфер страницы для PG_PROG
+} sim;
+
+/**
+ * @brief Состояние после подачи питания: массив стёрт, CS = 1, время = 0.
+ */
+void w25sim_reset(void) {
+  memset(w25sim_array, 0xFF, sizeof(w25sim_array));
+  memset(&sim, 0, sizeof(sim));
+  memset(&w25sim_stats, 0, sizeof(w25sim_stats));
+  sim.cs = 1;
+}
+
+uint8_t w25sim_busy(void) {
+  return sim.now < sim.busy_until;
+}
+
+uint64_t w25sim_time_ns(void) {
+  return sim.now;
+}
+
+void w25sim_advance_ns(uint64_t ns) {
+  sim.now += ns;
+}
+
+uint8_t *w25sim_mem(void) {
+  return w25sim_array;
+}
+
+/**
+ * @brief Завершение команды по подъёму CS: запуск стирания, программирования или сброса.
+ */
+static void w25sim_finish(void) {
+  uint32_t base, size;
+
+  switch (sim.cmd) {
+    case SIM_WR_EN:
+      sim.wel = 1;
+      break;
+    case SIM_WR_DIS:
+      sim.wel = 0;
+      break;
+    case SIM_SECT_ER:
+    case SIM_BLK_ER:
+      if (sim.idx < 4 || !sim.wel) { w25sim_stats.rejected++; break; }
+      size = (sim.cmd == SIM_BLK_ER) ? 0x10000UL : 0x1000UL;
+      base = sim.addr & ~(size - 1);
+      memset(&w25sim_array[base], 0xFF, size);
+      if (w25sim_erase_hook) w25sim_erase_hook(base);
+      sim.wel = 0;
+      sim.busy_until = sim.now + ((sim.cmd == SIM_BLK_ER) ? w25sim_timing.t_be : w25sim_timing.t_se);
+      sim.busy_op    = sim.cmd;
+      sim.er_base    = base;
+      sim.er_size    = size;
+      w25sim_stats.erases++;
+      break;
+    case SIM_PG_PROG:
+      if (sim.idx < 5 || !sim.wel) { w25sim_stats.rejected++; break; }
+      base = sim.addr & ~0xFFUL;
+      if (sim.sus && base - sim.sus_base < sim.sus_size) { w25sim_stats.rejected++; break; } // Стираемая область
+      for (uint32_t i = 0; i < 256; i++) w25sim_array[base + i] &= sim.page[i]; // Программирование сбрасывает биты
+      sim.wel = 0;
+      sim.busy_until = sim.now + w25sim_timing.t_pp;
+      sim.busy_op    = SIM_PG_PROG;
+      w25sim_stats.programs++;
+      break;
+    case SIM_RST:
+      if (!sim.rst_en) break;
+      sim.wel = 0;
+      sim.busy_until = sim.now + w25sim_timing.t_rst;
+      sim.busy_op    = SIM_RST;
+      sim.sus        = 0;
+      break;
+    case SIM_SUSPEND: // Только во время стирания/программирования, без вложенной приостановки и не раньше tSUS после Resume
+      if (!w25sim_busy() || sim.sus ||
+          (sim.busy_op != SIM_SECT_ER && sim.busy_op != SIM_BLK_ER && sim.busy_op != SIM_PG_PROG) ||
+          sim.now < sim.resumed_at + w25sim_timing.t_sus) break;
+      sim.remaining  = sim.busy_until - sim.now;
+      sim.sus_op     = sim.busy_op;
+      sim.sus_base   = (sim.busy_op == SIM_PG_PROG) ? 0 : sim.er_base;
+      sim.sus_size   = (sim.busy_op == SIM_PG_PROG) ? 0 : sim.er_size;
+      sim.busy_until = sim.now + w25sim_timing.t_sus; // BUSY сбрасывается через tSUS
+      sim.busy_op    = SIM_SUSPEND;
+      sim.sus        = 1;
+      w25sim_stats.suspends++;
+      break;
+    case SIM_RESUME:
+      if (!sim.sus || w25sim_busy()) break;
+      sim.busy_until = sim.now + sim.remaining;
+      sim.busy_op    = sim.sus_op;
+      sim.resumed_at = sim.now;
+      sim.sus        = 0;
+      break;
+    default:
+      break;
+  }
+
+  sim.rst_en = (sim.cmd == SIM_EN_RST); // RST выполняется только сразу после EN_RST
+}
+
+/**
+ * @brief Изменение уровня CS.
+ *
+ * @param level 0 - начало новой команды, 1 - завершение текущей.
+ */
+void w25sim_cs(uint8_t level) {
+  level = level ? 1 : 0;
+  if (level == sim.cs) return;
+  sim.cs = level;
+
+  if (level == 0) {
+    sim.idx  = 0;
+    sim.addr = 0;
+    sim.cmd  = SIM_IGNORED;
+  } else if (sim.idx) {
+    w25sim_stats.commands++;
+    w25sim_finish();
+  }
+}
+
+/**
+ * @brief Обработка кода команды (первый байт после спада CS).
+ *
+ * @param op Код команды.
+ */
+static void w25sim_opcode(uint8_t op) {
+  if (w25sim_busy() && op != SIM_RD_SR1 && op != SIM_RD_SR2 && op != SIM_SUSPEND) { // Во время операции - только статус и Suspend
+    sim.cmd = SIM_IGNORED;
+    w25sim_stats.rejected++;
+    return;
+  }
+
+  if (sim.sus && (op == SIM_SECT_ER || op == SIM_BLK_ER || (op == SIM_PG_PROG && sim.sus_op == SIM_PG_PROG))) {
+    // Во время приостановки стирание запрещено, программирование - только при приостановленном стирании
+    sim.cmd = SIM_IGNORED;
+    w25sim_stats.rejected++;
+    return;
+  }
+
+  sim.cmd = op;
+  if (op == SIM_PG_PROG) memset(sim.page, 0xFF, sizeof(sim.page));
+}
+
+/**
+ * @brief Обмен байтом с моделью.
+ *
+ * @param mosi   Байт от контроллера.
+ * @param sck_hz Частота SCK, Гц (определяет приращение виртуального времени).
+ * @return uint8_t Байт от памяти (MISO, 0x00 когда выход памяти в третьем состоянии - вывод подтянут к земле).
+ */
+uint8_t w25sim_xfer(uint8_t mosi, uint32_t sck_hz) {
+  uint8_t  miso = 0x00;
+  uint32_t n;
+
+  sim.now += (8ULL * 1000000000ULL) / (sck_hz ? sck_hz : 1);
+  w25sim_stats.bytes++;
+
+  if (sim.cs) return miso; // CS = 1 - память не выбрана
+
+  n = sim.idx++;
+  if (n == 0) {
+    w25sim_opcode(mosi);
+    return miso;
+  }
+
+  switch (sim.cmd) {
+    case SIM_RD_SR1:
+      miso = (w25sim_busy() ? SIM_SR1_BUSY : 0) | (sim.wel ? SIM_SR1_WEL : 0);
+      break;
+
+    case SIM_RD_SR2:
+      miso = sim.sus ? SIM_SR2_SUS : 0;
+      break;
+
+    case SIM_JEDEC:
+      if (n == 1) miso = W25SIM_JEDEC_MF;
+      else if (n == 2) miso = (W25SIM_JEDEC_ID >> 8) & 0xFF;
+      else if (n == 3) miso = W25SIM_JEDEC_ID & 0xFF;
+      break;
+
+    case SIM_RD_DATA:
+    case SIM_FAST_RD:
+    case SIM_PG_PROG:
+    case SIM_SECT_ER:
+    case SIM_BLK_ER:
+      if (n <= 3) {
+        sim.addr = ((sim.addr << 8) | mosi) & (W25SIM_SIZE - 1); // 24-битный адрес, старший байт первым
+        break;
+      }
+      if (sim.cmd == SIM_RD_DATA || (sim.cmd == SIM_FAST_RD && n >= 5)) {
+        uint32_t offset = (sim.cmd == SIM_RD_DATA) ? n - 4 : n - 5;
+        miso = w25sim_array[(sim.addr + offset) & (W25SIM_SIZE - 1)]; // Чтение с переходом через конец массива
+      } else if (sim.cmd == SIM_PG_PROG) {
+        sim.page[(sim.addr + n - 4) & 0xFF] = mosi; // Адрес «заворачивается» внутри страницы
+      }
+      break;
+
+    default:
+      break;
+  }
+
+  if (w25sim_timing.sck_max && sck_hz > w25sim_timing.sck_max) miso ^= 0x01; // Ошибка выборки на слишком высокой частоте
+
+  return miso;
+}
@@ -0,0 +1,68 @@
+/**------------------------------------------------------------------------------------------------------------------------------
+ * @file        : w25q64_sim.h
+ * @brief       : Поведенческая модель памяти W25Q64 для сборки и проверки драйвера на Linux (host).
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : Linux x86-64 (host)
+ * @MCU         : STM32F407VET6 (модель)
+ * @IDE         : gcc
+ * @Description : Модель работает на уровне сигналов CS и байтов SPI (режим 0, MSB first):
+ *                - команды EN_RST/RST, WR_EN, SECT_ER, BLK_ER (64 КБ), RD_SR1, RD_SR2, PG_PROG, RD_DATA, FAST_RD,
+ *                  JEDEC ID (0x9F), Erase/Program Suspend (0x75) и Resume (0x7A);
+ *                - массив 8 МБ, стирание устанавливает 0xFF, программирование может только сбрасывать биты;
+ *                - программирование внутри страницы «заворачивается» на её начало, как у реальной памяти;
+ *                - стирание/программирование запускаются по подъёму CS и занимают время tSE/tPP,
+ *                  пока BUSY = 1, память выполняет только чтение статусного регистра;
+ *                - виртуальное время увеличивается на 8 периодов SCK за каждый байт и через w25sim_advance_ns();
+ *                - Suspend во время стирания/программирования через tSUS сбрасывает BUSY и устанавливает SUS (SR2 бит 7),
+ *                  память выполняет чтение; Resume продолжает операцию с оставшимся временем. Suspend игнорируется
+ *                  в течение tSUS после Resume и при SUS = 1. Во время приостановки стирания допускается программирование
+ *                  страниц вне стираемой области (стирание запрещено); во время приостановки программирования - только чтение;
+ *                - выше частоты sck_max младший бит MISO читается с ошибкой (модель плохой разводки линии).
+ *                Времена по умолчанию - типовые значения из документации W25Q64 (tSE 45 мс, tBE 150 мс, tPP 0,7 мс, tRST 30 мкс).
+  -------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#ifndef W25Q64_SIM_H
+#define W25Q64_SIM_H
+
+#include <stdint.h>
+
+#define W25SIM_SIZE      (8UL * 1024 * 1024) // Объём памяти, байт
+#define W25SIM_JEDEC_MF  0xEF                // Производитель: Winbond
+#define W25SIM_JEDEC_ID  0x4017              // Тип памяти 0x40, ёмкость 0x17 (64 Мбит)
+
+// Временные параметры модели, нс
+typedef struct {
+  uint64_t t_se;       // Стирание сектора 4 КБ
+  uint64_t t_pp;       // Программирование страницы
+  uint64_t t_rst;      // Сброс
+  uint64_t t_sus;      // Приостановка операции (Suspend) и минимальный интервал Resume -> Suspend
+  uint64_t poll_gap;   // Пауза CPU между байтами при побайтном обмене через SPI2->DR
+  uint32_t sck_max;    // Максимальная частота SCK, при которой линия работает без ошибок (0 - без ограничения)
+  uint64_t t_be;       // Стирание блока 64 КБ
+} w25sim_timing_t;
+
+// Статистика модели
+typedef struct {
+  uint64_t bytes;      // Байт передано по шине (в обе стороны одновременно)
+  uint32_t commands;   // Количество команд (циклов CS)
+  uint32_t erases;     // Выполнено стираний секторов и блоков
+  uint32_t programs;   // Выполнено программирований страниц
+  uint32_t rejected;   // Команд проигнорировано (BUSY = 1 или WEL = 0)
+  uint32_t suspends;   // Выполнено приостановок операций
+} w25sim_stats_t;
+
+extern w25sim_timing_t w25sim_timing; // Можно изменить до запуска (например, на максимальные значения tSE 400 мс, tBE 2 с, tPP 3 мс)
+extern w25sim_stats_t  w25sim_stats;
+extern void (*w25sim_erase_hook)(uint32_t base); // Вызывается после стирания сектора или блока (модель пропадания питания), 0 - нет
+
+void     w25sim_reset(void);                 // Состояние после подачи питания, массив стёрт (0xFF), время = 0
+void     w25sim_cs(uint8_t level);           // Изменение уровня CS (0 - начало команды, 1 - завершение)
+uint8_t  w25sim_xfer(uint8_t mosi, uint32_t sck_hz); // Обмен байтом на частоте SCK
+void     w25sim_advance_ns(uint64_t ns);     // Продвижение виртуального времени без обмена
+uint64_t w25sim_time_ns(void);               // Текущее виртуальное время
+uint8_t  w25sim_busy(void);                  // Текущее значение бита BUSY
+uint8_t *w25sim_mem(void);                   // Прямой доступ к массиву памяти модели
+
+#endif // W25Q64_SIM_H
@@ -0,0 +1,39 @@
+/**------------------------------------------------------------------------------------------------------------------------------
+ * @file        : ovl_fir.h
+ * @brief       : Заголовочный файл оверлея КИХ-фильтра и сравнения скорости выполнения из flash и из RAM.
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ * @Description : Оверлей ovl_fir (блок линкера ovl_fir): КИХ-фильтр нижних частот Q15 на OVL_FIR_TAPS отводов
+ *                (окно Хэмминга, частота среза 0,1 fs) и таблица его коэффициентов.
+ *                ovl_fir_bench() фильтрует блок OVL_FIR_LEN отсчётов кодом, загруженным w25_ovl_load() в RAM,
+ *                а с опцией OVL_FLASH_COPY - ещё и копией во внутренней flash, и сохраняет длительности (такты DWT)
+ *                в ovl_fir_stats.
+  -------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#ifndef OVL_FIR_H
+#define OVL_FIR_H
+
+#include "w25_ovl.h"
+
+#define OVL_FIR_TAPS 32                     // Количество отводов фильтра
+#define OVL_FIR_LEN  256                    // Отсчётов в блоке сравнения
+#define OVL_FIR_ADDR W25_OVL_BASE           // Адрес образа в W25Q64 (= адрес блока ovl_fir в STM32F4xx_Flash_CCM.icf)
+
+// Результаты сравнения
+typedef struct {
+  uint32_t flash_cycles; // Фильтрация блока кодом во внутренней flash, такты ядра (OVL_FLASH_COPY)
+  uint32_t ram_cycles;   // Фильтрация блока кодом оверлея в RAM, такты ядра
+  uint32_t load_cycles;  // Загрузка оверлея из W25Q64, такты ядра
+  uint8_t  match;        // 1 - результаты фильтрации совпадают
+} ovl_fir_stats_t;
+
+extern ovl_fir_stats_t ovl_fir_stats;
+extern const w25_ovl_t ovl_fir;
+
+uint8_t ovl_fir_bench(void); // Запись образа (при необходимости), загрузка и сравнение. Возврат - 1 при успехе
+
+#endif // OVL_FIR_H
@@ -0,0 +1,84 @@
+/**------------------------------------------------------------------------------------------------------------------------------
+ * @file        : spi2_bus.h
+ * @brief       : Заголовочный файл менеджера шины SPI2 для нескольких устройств.
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ * @Description : Каждое устройство на шине описывается структурой spi2_dev_t: вывод CS, режим (CPOL/CPHA),
+ *                делитель частоты и размер кадра (8/16 бит). SPI2->CR1 перенастраивается только при смене устройства.
+ *                Шина используется двумя способами:
+ *                - Очередь транзакций: spi2_bus_submit() можно вызывать из основного цикла и из прерываний.
+ *                  Транзакция - цепочка сегментов (next) под одним CS, сегменты передаются через DMA1 Stream3/4,
+ *                  следующая транзакция запускается из прерывания DMA1 Stream3 сразу после предыдущей.
+ *                - Прямой доступ: spi2_bus_acquire()/spi2_bus_release() захватывают шину для синхронного драйвера
+ *                  (макросы CSLOW/CSHIGH драйвера W25Q64). Захват ждёт окончания текущей транзакции очереди,
+ *                  остальные транзакции ждут освобождения шины - поэтому память не простаивает за потоком датчика.
+ *                Из прерывания захватывать шину можно только после проверки spi2_bus_free() (как в w25_async_poll()).
+  -------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#ifndef SPI2_BUS_H
+#define SPI2_BUS_H
+
+#include <stm32f4xx.h>
+
+#define SPI2_BUS_QUEUE_LEN 8 // Глубина очереди транзакций (степень двойки)
+#define SPI2_BUS_IRQ_PRIO  6 // Приоритет прерывания DMA1 Stream3 (выше, чем у TIM7 движка w25_async)
+
+// Биты SPI2->CR1, задаваемые дескриптором устройства
+#define SPI2_DEV_CR1_MASK (SPI_CR1_CPHA | SPI_CR1_CPOL | SPI_CR1_BR | SPI_CR1_LSBFIRST | SPI_CR1_DFF)
+
+// Состояния транзакции
+#define SPI2_XFER_QUEUED 0 // В очереди или выполняется
+#define SPI2_XFER_DONE   1 // Завершена
+#define SPI2_XFER_ERROR  2 // Ошибка DMA (TEIF), оставшиеся сегменты не передавались
+
+// Дескриптор устройства на шине SPI2
+typedef struct {
+  GPIO_TypeDef *cs_port; // Порт вывода CS
+  uint8_t       cs_pin;  // Номер вывода CS (0..15)
+  uint16_t      cr1;     // Биты SPI2_DEV_CR1_MASK: режим, делитель, формат кадра
+} spi2_dev_t;
+
+typedef struct spi2_xfer spi2_xfer_t;
+
+// Тип callback-функции завершения транзакции (вызывается из прерывания DMA1 Stream3)
+typedef void (*spi2_xfer_cb_t)(spi2_xfer_t *xfer);
+
+// Сегмент транзакции. Структура и буферы принадлежат вызывающей стороне и не должны изменяться до завершения
+struct spi2_xfer {
+  const spi2_dev_t *dev;   // Устройство (задаётся в первом сегменте цепочки)
+  const void       *tx;    // Передаваемые кадры или 0 - передаются нули
+  void             *rx;    // Буфер приёма или 0 - принятые кадры отбрасываются (вне CCM RAM)
+  uint16_t          len;   // Количество кадров (байт или полуслов при 16-битном формате)
+  spi2_xfer_t      *next;  // Следующий сегмент под тем же CS или 0
+  spi2_xfer_cb_t    cb;    // Callback-функция (задаётся в первом сегменте, может быть 0)
+  volatile uint8_t  state; // Состояние транзакции (SPI2_XFER_QUEUED, SPI2_XFER_DONE, SPI2_XFER_ERROR)
+};
+
+// Статистика шины
+typedef struct {
+  uint32_t xfers;     // Завершено транзакций очереди
+  uint32_t reconfigs; // Перенастроек SPI2->CR1 (смена устройства)
+  uint32_t waits;     // Захватов шины, ожидавших окончания транзакции очереди
+  uint32_t errors;    // Транзакций с ошибкой DMA
+  uint8_t  max_queue; // Наибольшее количество транзакций в очереди
+} spi2_bus_stats_t;
+
+extern spi2_bus_stats_t spi2_bus_stats;
+
+// Значение поля cr1 дескриптора: режим 0..3 (CPOL, CPHA), делитель BR 0..7, 16-битный кадр
+#define SPI2_DEV_CR1(mode, br, frame16) ((uint16_t)(((mode) & 3) | (((br) & 7) << SPI_CR1_BR_Pos) | ((frame16) ? SPI_CR1_DFF : 0)))
+
+void    spi2_bus_dma_irq(void *ctx, uint32_t flags);                     // Прерывание DMA1 Stream3 (через dma_mgr.c)
+void    spi2_bus_dev_init(spi2_dev_t *dev, GPIO_TypeDef *port, uint8_t pin, uint16_t cr1); // Дескриптор и вывод CS
+void    spi2_bus_dev_config(spi2_dev_t *dev, uint16_t cr1);              // Изменение режима/делителя устройства
+uint8_t spi2_bus_submit(spi2_xfer_t *xfer);                              // Постановка транзакции в очередь
+void    spi2_bus_acquire(const spi2_dev_t *dev);                         // Захват шины и CS = 0 (прямой доступ)
+void    spi2_bus_release(const spi2_dev_t *dev);                         // CS = 1 и освобождение шины
+uint8_t spi2_bus_free(void);                                             // 1 - шина не занята
+uint8_t spi2_bus_idle(void);                                             // 1 - шина не занята и очередь пуста
+
+#endif // SPI2_BUS_H
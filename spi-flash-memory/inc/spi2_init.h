@@ -9,9 +9,66 @@
  ----------------------------------------------------------------------------------
  */
 
+#include <stdint.h>
+#include "dma_chain.h"
+
 /**
  * @brief Прототип функции для инициализации SPI2.
  * 
  * Функция настраивает SPI2 для работы в режиме Master с частотой 1,32 МГц.
+ * Возвращает 0, если потоки DMA1 для SPI2 заняты другим драйвером: память W25Q64 использовать нельзя.
+ */
+uint8_t spi2_init(void);
+
+/**
+ * @brief Прототип функции для получения (dma_mgr.c) и настройки потоков DMA1 под SPI2.
+ *
+ * DMA1 Stream3 Channel0 - приём (SPI2_RX), DMA1 Stream4 Channel0 - передача (SPI2_TX).
+ * Возвращает 0, если поток уже выдан другому драйверу.
+ */
+uint8_t spi2_dma_init(void);
+
+/**
+ * @brief Прототип функции полнодуплексного обмена по SPI2 через DMA.
+ *
+ * Если tx == 0, передаются нулевые байты; если rx == 0, принятые данные отбрасываются.
+ * Буферы не должны находиться в CCM RAM (DMA не имеет к ней доступа).
+ */
+void spi2_dma_txrx(const uint8_t *tx, uint8_t *rx, uint16_t len);
+
+/**
+ * @brief Прототипы функций запуска обмена по SPI2 через DMA и ожидания его завершения.
+ *
+ * Позволяют обрабатывать ранее принятые данные, пока DMA принимает следующую порцию.
+ */
+void spi2_dma_start(const uint8_t *tx, uint8_t *rx, uint16_t len);
+void spi2_dma_wait(void);
+void spi2_dma_end(void); // Окончание обмена без ожидания флагов (из прерывания потока приёма)
+
+/**
+ * @brief Прототип функции передачи цепочки сегментов по SPI2 (только передача, с ожиданием завершения).
+ *
+ * Сегменты (команда с адресом, данные) передаются под одним CS без копирования в общий буфер.
+ * Буферы не должны находиться в CCM RAM. Паузы между сегментами - spi2_tx_chain.stats.
+ * Результат: DMA_CHAIN_DONE, DMA_CHAIN_ERROR (передана часть) или 0 - цепочка не запущена, на шину ничего не передано.
+ */
+uint8_t spi2_dma_tx_chain(const dma_seg_t *seg);
+extern dma_chain_t spi2_tx_chain;
+
+/**
+ * @brief Текущая частота SCK модуля SPI2, Гц (обновляется spi2_set_prescaler()).
+ */
+extern uint32_t spi2_sck_hz;
+
+/**
+ * @brief Прототип функции установки делителя частоты SPI2 (поле BR: SCK = 42 МГц / 2^(br + 1)).
+ */
+void spi2_set_prescaler(uint8_t br);
+
+/**
+ * @brief Прототип функции подбора максимальной надёжной частоты SPI2.
+ *
+ * Перебирает делители от 32 до 2, проверяя JEDEC ID и шаблон в секторе W25_CAL_ADDR.
+ * Возвращает выбранную частоту SCK в Гц.
  */
-void spi2_init(void); 
\ No newline at end of file
+uint32_t spi2_autotune(void);
@@ -0,0 +1,80 @@
+/**------------------------------------------------------------------------------------------------------------------------------
+ * @file        : w25_async.h
+ * @brief       : Заголовочный файл неблокирующего движка стирания/программирования памяти W25Q64.
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ * @Description : Запросы на стирание сектора и программирование ставятся в очередь и выполняются автоматом состояний,
+ *                который опрашивает бит BUSY из прерывания TIM7 (или из основного цикла через w25_async_poll()).
+ *                По завершению каждого запроса вызывается callback-функция.
+ *                - Пока движок не простаивает (w25_async_idle() == 0), синхронные функции записи/стирания
+ *                  w25_write() и w25_erase_sector() использовать нельзя.
+ *                - Буфер данных программирования должен оставаться неизменным до вызова callback-функции.
+ *                - w25_async_read() - срочное чтение из основного цикла во время работы движка: выполняемое стирание или
+ *                  программирование приостанавливается (Erase/Program Suspend, 0x75), данные читаются, затем операция
+ *                  продолжается (Resume, 0x7A). Задержка чтения - tSUS (20 мкс) + время передачи вместо tSE (до 400 мс).
+ *                - w25_async_erase_block() - стирание блока 64 КБ в фоне: программирование других блоков выполняется
+ *                  в приостановке стирания и не ждёт tBE (до 2 с).
+  -------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#ifndef W25_ASYNC_H
+#define W25_ASYNC_H
+
+#include "w25q64.h"
+
+#define W25_ASYNC_QUEUE_LEN 8     // Глубина очереди запросов (степень двойки)
+
+// Типы операций движка
+#define W25_OP_ERASE   0x01       // Стирание сектора 4 КБ (SECT_ER)
+#define W25_OP_PROGRAM 0x02       // Программирование блока (PG_PROG постранично)
+#define W25_OP_ERASE_BLOCK 0x03   // Фоновое стирание блока 64 КБ (BLK_ER), программирование других блоков в приостановке
+
+// Тип callback-функции завершения операции (вызывается из контекста w25_async_poll())
+typedef void (*w25_async_cb_t)(uint8_t op, uint32_t address);
+
+// Запрос в очереди движка
+typedef struct {
+  uint8_t        op;      // Тип операции (W25_OP_ERASE / W25_OP_PROGRAM)
+  uint32_t       address; // Адрес в памяти W25Q64
+  const uint8_t *data;    // Данные для программирования
+  uint32_t       len;     // Количество байт для программирования
+  w25_async_cb_t cb;      // Callback-функция завершения (может быть 0)
+} w25_async_req_t;
+
+// Статистика срочных чтений
+typedef struct {
+  uint32_t reads;           // Выполнено срочных чтений
+  uint32_t suspends;        // Из них с приостановкой операции
+  uint32_t waits;           // Из них с ожиданием завершения операции
+  uint32_t read_max_cycles; // Наибольшая задержка срочного чтения, такты ядра (DWT->CYCCNT)
+  uint32_t bg_suspends;     // Приостановок фонового стирания для программирования
+} w25_async_stats_t;
+
+extern w25_async_stats_t w25_async_stats;
+extern uint8_t           w25_async_suspend_enable; // 1 - приостанавливать операцию при срочном чтении, 0 - ждать завершения
+
+// Постановка в очередь стирания сектора, содержащего address. Возвращает 1, если запрос принят, 0 - очередь заполнена
+uint8_t w25_async_erase(uint32_t address, w25_async_cb_t cb);
+
+// Постановка в очередь фонового стирания блока 64 КБ, содержащего address. Возвращает 1, если запрос принят
+uint8_t w25_async_erase_block(uint32_t address, w25_async_cb_t cb);
+
+// Постановка в очередь программирования len байт с адреса address. Возвращает 1, если запрос принят, 0 - очередь заполнена
+uint8_t w25_async_program(uint32_t address, const uint8_t *data, uint32_t len, w25_async_cb_t cb);
+
+// Один шаг автомата состояний: опрос BUSY, запуск следующей страницы/запроса, вызов callback-функций
+void w25_async_poll(void);
+
+// Срочное чтение len байт из основного цикла с приостановкой выполняемой операции. Возвращает 1, если операция приостанавливалась
+uint8_t w25_async_read(uint32_t address, uint8_t *buf, uint32_t len);
+
+// Возвращает 1, если очередь пуста и память не выполняет операцию движка
+uint8_t w25_async_idle(void);
+
+// Настройка TIM7 для вызова w25_async_poll() с частотой 1 кГц (низкий приоритет прерывания)
+void w25_async_timer_init(void);
+
+#endif // W25_ASYNC_H
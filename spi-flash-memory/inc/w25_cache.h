@@ -0,0 +1,69 @@
+/**------------------------------------------------------------------------------------------------------------------------------
+ * @file        : w25_cache.h
+ * @brief       : Заголовочный файл кэша чтения памяти W25Q64 в CCM RAM.
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ * @Description : Полностью ассоциативный кэш на W25_CACHE_WAYS строк с вытеснением по давности использования (LRU).
+ *                Строка - страница 256 байт или сектор 4 КБ (W25_CACHE_LINE). Данные строк размещены в CCM RAM
+ *                (секция .CCM_RAM1 из STM32F4xx_Flash_CCM.icf), промахи заполняются через DMA во вспомогательный
+ *                буфер в SRAM, так как DMA не имеет доступа к CCM RAM.
+ *                - Кэш сквозной: w25_program_page() и w25_erase_sector_start() обновляют закэшированные строки,
+ *                  поэтому содержимое кэша всегда совпадает с памятью.
+ *                - Для отключения кэша закомментируйте W25_CACHE_ENABLE: w25_cache_read() станет вызовом w25_read().
+ *                - Счётчики w25_cache_stats позволяют подобрать W25_CACHE_WAYS и W25_CACHE_LINE.
+  -------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#ifndef W25_CACHE_H
+#define W25_CACHE_H
+
+#include "w25q64.h"
+
+// Включение кэша (закомментируйте для отключения)
+#define W25_CACHE_ENABLE 1
+
+#define W25_CACHE_LINE   W25_PAGE_SIZE        // Размер строки: W25_PAGE_SIZE (256) или 4096 (сектор)
+#define W25_CACHE_WAYS   32                   // Количество строк (32 x 256 = 8 КБ CCM RAM)
+#define W25_CACHE_BYPASS (4 * W25_CACHE_LINE) // Чтения длиннее этого значения идут мимо кэша
+
+// Счётчики кэша
+typedef struct {
+  uint32_t hits;      // Обращений к строкам, найденным в кэше
+  uint32_t misses;    // Обращений, потребовавших заполнения строки
+  uint32_t evictions; // Вытеснений действительных строк
+  uint32_t bypass;    // Длинных чтений мимо кэша
+} w25_cache_stats_t;
+
+#ifdef W25_CACHE_ENABLE
+
+extern w25_cache_stats_t w25_cache_stats;
+
+// Сброс кэша и счётчиков
+void w25_cache_init(void);
+
+// Чтение len байт через кэш
+void w25_cache_read(uint32_t address, uint8_t *buf, uint32_t len);
+
+// Сквозная запись: обновление закэшированных строк после программирования (биты только сбрасываются)
+void w25_cache_program(uint32_t address, const uint8_t *buf, uint32_t len);
+
+// Сквозная запись: заполнение 0xFF закэшированных строк стираемого сектора
+void w25_cache_erase(uint32_t address);
+
+// Признание недействительными всех строк, пересекающих диапазон
+void w25_cache_invalidate(uint32_t address, uint32_t len);
+
+#else
+
+#define w25_cache_init()
+#define w25_cache_read(address, buf, len)    w25_read((address), (buf), (len))
+#define w25_cache_program(address, buf, len)
+#define w25_cache_erase(address)
+#define w25_cache_invalidate(address, len)
+
+#endif // W25_CACHE_ENABLE
+
+#endif // W25_CACHE_H
@@ -0,0 +1,31 @@
+/**------------------------------------------------------------------------------------------------------------------------------
+ * @file        : w25_crc.h
+ * @brief       : Заголовочный файл вычисления CRC-32 аппаратным блоком CRC STM32F4.
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ * @Description : Блок CRC STM32F4 имеет фиксированный алгоритм: полином 0x04C11DB7, начальное значение 0xFFFFFFFF,
+ *                без отражения и без финального XOR (CRC-32/MPEG-2), данные подаются 32-битными словами.
+ *                - Байты буфера объединяются в слова в порядке little-endian, неполное последнее слово дополняется нулями.
+ *                  Поэтому вычисление по частям w25_crc32(w25_crc32(W25_CRC_INIT, a, n), b, m) совпадает с CRC блока a + b,
+ *                  только если n кратно 4.
+ *                - Состояние блока загружается из параметра crc при каждом вызове, поэтому блок можно использовать
+ *                  из основного цикла и из прерываний: вычисление выполняется порциями по W25_CRC_BLOCK байт
+ *                  с запретом прерываний только на время порции.
+  -------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#ifndef W25_CRC_H
+#define W25_CRC_H
+
+#include <stm32f4xx.h>
+
+#define W25_CRC_INIT  0xFFFFFFFFUL // Начальное значение CRC (состояние блока после сброса)
+#define W25_CRC_BLOCK 256          // Порция вычисления с запретом прерываний, байт (кратно 4)
+
+// Функция вычисления CRC-32 блоком CRC (продолжение вычисления по частям через параметр crc)
+uint32_t w25_crc32(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+#endif // W25_CRC_H
@@ -0,0 +1,61 @@
+/**------------------------------------------------------------------------------------------------------------------------------
+ * @file        : w25_kv.h
+ * @brief       : Заголовочный файл хранилища «ключ-значение» с выравниванием износа в памяти W25Q64.
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ * @Description : Журнальное хранилище настроек и калибровок в секторах W25_KV_BASE .. W25_KV_BASE + W25_KV_SECTORS * 4 КБ.
+ *                - Сектор начинается с заголовка { W25_KV_MAGIC, seq }, seq растёт при каждом переходе на новый сектор.
+ *                - Записи только добавляются: { key, len, crc32 } + данные, выровненные на 4 байта.
+ *                  Новое значение ключа - новая запись, len = 0 - удаление ключа.
+ *                - Сектора используются по кольцу, один сектор всегда стёрт. При заполнении активного сектора
+ *                  живые записи самого старого сектора переносятся в новый, после чего старый сектор стирается.
+ *                - Индекс в RAM (адрес последней записи для каждого ключа) строится в w25_kv_mount() и даёт поиск за O(1).
+ *                Время монтирования ограничено объёмом области (W25_KV_SECTORS секторов) и не растёт с количеством
+ *                перезаписей; измеренное значение (такты DWT) - в w25_kv_stats.mount_cycles.
+ *                Функции синхронные: вызывать при свободном движке w25_async (w25_async_idle()).
+  -------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#ifndef W25_KV_H
+#define W25_KV_H
+
+#include "w25q64.h"
+
+#define W25_KV_BASE     0x7F7000   // Первый сектор области (8 секторов перед сектором калибровки W25_CAL_ADDR)
+#define W25_KV_SECTORS  8          // Количество секторов области (не менее 3)
+#define W25_KV_KEYS     64         // Количество ключей: 0 .. W25_KV_KEYS - 1
+#define W25_KV_MAX_LEN  48         // Максимальная длина значения, байт
+#define W25_KV_MAGIC    0x4B563235 // Признак размеченного сектора
+
+#define W25_KV_HDR_SIZE 8                                     // Размер заголовка сектора и заголовка записи
+#define W25_KV_REC_SIZE(len) (W25_KV_HDR_SIZE + (((len) + 3) & ~3UL)) // Размер записи с выравниванием
+#define W25_KV_REC_MAX  W25_KV_REC_SIZE(W25_KV_MAX_LEN)
+
+// Все живые записи и новая запись должны помещаться в один сектор: при сборке мусора переносится и старое
+// значение записываемого ключа, новое добавляется после переноса
+#if ((W25_KV_KEYS + 1) * W25_KV_REC_MAX) > (W25_SECTOR_SIZE - W25_KV_HDR_SIZE)
+#error "(W25_KV_KEYS + 1) * W25_KV_REC_MAX exceeds sector size"
+#endif
+
+// Статистика хранилища
+typedef struct {
+  uint32_t mount_cycles; // Длительность последнего w25_kv_mount(), такты ядра (DWT->CYCCNT)
+  uint32_t records;      // Записей с верной CRC, найденных при монтировании
+  uint32_t crc_errors;   // Повреждённых записей (прерванная запись, ошибка CRC)
+  uint32_t gc_runs;      // Переносов живых записей из старого сектора
+  uint32_t erases;       // Стираний секторов области
+  uint16_t live;         // Текущее количество ключей
+  uint8_t  active;       // Номер активного сектора
+} w25_kv_stats_t;
+
+extern w25_kv_stats_t w25_kv_stats;
+
+uint8_t w25_kv_mount(void);                                          // Построение индекса (разметка пустой области)
+uint8_t w25_kv_set(uint16_t key, const void *value, uint16_t len);   // Запись значения
+int16_t w25_kv_get(uint16_t key, void *buf, uint16_t size);          // Чтение значения, возврат - длина или -1
+uint8_t w25_kv_delete(uint16_t key);                                 // Удаление ключа
+
+#endif // W25_KV_H
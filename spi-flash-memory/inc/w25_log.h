@@ -0,0 +1,54 @@
+/**------------------------------------------------------------------------------------------------------------------------------
+ * @file        : w25_log.h
+ * @brief       : Заголовочный файл кольцевого журнала измерений в памяти W25Q64.
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ * @Description : Журнал для непрерывного потока записей (например, отсчётов АЦП с частотой 1 кГц):
+ *                - w25_log_push() копирует запись в буфер страницы в RAM и может вызываться из обработчика
+ *                  прерывания DMA: она не ждёт памяти и не обращается к шине SPI2;
+ *                - заполненная страница (256 байт) программируется одной командой через движок w25_async;
+ *                - при записи первой страницы блока 64 КБ в очередь ставится фоновое стирание следующего блока,
+ *                  поэтому к моменту перехода на него блок уже стёрт;
+ *                - каждая страница содержит номер seq и CRC-32, при включении w25_log_mount() находит
+ *                  последнюю записанную страницу (после пропадания питания запись продолжается с неё).
+ *                Пока память стирает блок, страницы программируются в приостановке стирания (Erase Suspend): страница
+ *                ждёт шага движка (1 мс), tSUS и tPP, а не tBE (до 2 с). Буферы вмещают 8 страниц по 248 байт -
+ *                160 мс потока 12 КБ/с.
+ *                Если все буферы заняты (память не успевает), запись отбрасывается и учитывается в w25_log_stats.dropped.
+  -------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#ifndef W25_LOG_H
+#define W25_LOG_H
+
+#include "w25q64.h"
+
+#define W25_LOG_BASE     0x400000 // Начало области журнала (граница блока 64 КБ)
+#define W25_LOG_SECTORS  512      // Размер области в секторах (2 МБ, кратно 16 - блоками по 64 КБ)
+#define W25_LOG_BUFS     8        // Количество буферов страниц в RAM (запас на шаг движка и программирование)
+#define W25_LOG_MAGIC    0x4C47   // Признак страницы журнала
+
+#define W25_LOG_HDR_SIZE 12                                 // Заголовок страницы: seq, magic, used, crc
+#define W25_LOG_PAYLOAD  (W25_PAGE_SIZE - W25_LOG_HDR_SIZE) // Полезная ёмкость страницы, байт
+
+// Статистика журнала
+typedef struct {
+  uint32_t mount_cycles; // Длительность последнего w25_log_mount(), такты ядра (DWT->CYCCNT)
+  uint32_t pages;        // Страниц записано с момента монтирования
+  uint32_t dropped;      // Записей отброшено (нет свободного буфера)
+  uint32_t erases;       // Блоков и секторов стёрто
+  uint8_t  max_pending;  // Наибольшее количество занятых буферов
+} w25_log_stats_t;
+
+extern w25_log_stats_t w25_log_stats;
+
+uint8_t  w25_log_mount(void);                                  // Поиск последней страницы, подготовка стёртой области
+uint8_t  w25_log_push(const void *rec, uint16_t len);          // Добавление записи (допускается вызов из прерывания)
+void     w25_log_flush(void);                                  // Запись неполной текущей страницы
+uint32_t w25_log_seq(void);                                    // Номер seq следующей страницы
+int16_t  w25_log_read(uint32_t seq, uint8_t *page);            // Чтение страницы seq (256 байт), возврат - длина данных или -1
+
+#endif // W25_LOG_H
@@ -0,0 +1,79 @@
+/**------------------------------------------------------------------------------------------------------------------------------
+ * @file        : w25_ovl.h
+ * @brief       : Заголовочный файл загрузчика оверлеев кода из памяти W25Q64 в RAM.
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ * @Description : Редко используемые, но требовательные к процессору функции (фильтры, БПФ) и их таблицы хранятся
+ *                в W25Q64 и по запросу загружаются в общую область RAM (секция .overlay в SRAM1 - INST_RAM
+ *                в STM32F4xx_Flash_CCM.icf), где выполняются без тактов ожидания flash.
+ *                - Код и таблицы оверлея помещаются в секции .ovl.<имя> (W25_OVL_CODE/W25_OVL_DATA), линкер собирает их
+ *                  в блок ovl_<имя> (символы __ovl_<имя>_start__/__ovl_<имя>_end__) и размещает по адресу образа
+ *                  в W25Q64 в окне W25_OVL_VMA: во внутренней flash образ места не занимает.
+ *                - Образ извлекается из ELF после сборки (post_build_command в spi-flash-memory.emProject: ovl_fir.bin,
+ *                  секции оверлея удаляются из загружаемого ELF). Программатор (J-Link) записывает его в область
+ *                  загрузки с заголовком W25_OVL_STAGE, w25_ovl_staged() проверяет заголовок, w25_ovl_install()
+ *                  записывает образ в W25Q64 (при первом запуске или после обновления прошивки).
+ *                - С опцией OVL_FLASH_COPY (для компилятора и сценария линкера) копия образа остаётся во внутренней
+ *                  flash (блок ovl_<имя>_copy): источник для w25_ovl_install() и вариант «код во flash» при сравнении.
+ *                - w25_ovl_load() читает образ через DMA (Fast Read) с проверкой CRC-32 (w25_read_verified())
+ *                  и возвращает адрес загрузки; повторная загрузка того же оверлея не выполняется.
+ *                - Оверлей выполняется не по адресу сборки, поэтому его код должен быть позиционно-независимым:
+ *                  вызывать только функции того же оверлея и обращаться к своим таблицам через указатели,
+ *                  пересчитанные W25_OVL_PTR() (глобальные переменные вне оверлея доступны как обычно).
+ *                Функции синхронные: вызывать при свободном движке w25_async (w25_async_idle()).
+  -------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#ifndef W25_OVL_H
+#define W25_OVL_H
+
+#include "w25q64.h"
+
+#define W25_OVL_BASE     0x7C0000   // Начало области образов оверлеев в W25Q64 (до области w25_kv)
+#define W25_OVL_AREA     0x30000    // Размер области образов, байт
+#define W25_OVL_SIZE     4096       // Размер области загрузки в RAM, байт (наибольший оверлей)
+#define W25_OVL_MAGIC    0x4C56524F // Признак записанного образа
+#define W25_OVL_STAGE    0x4753564F // Признак образа, переданного программатором в область загрузки
+#define W25_OVL_VMA      0x90000000 // Окно адресов сборки оверлеев: W25_OVL_VMA + адрес в W25Q64 (на шине памяти нет)
+#define W25_OVL_HDR_SIZE 16         // Заголовок образа: magic, size, crc, резерв
+
+// Размещение кода и таблиц оверлея (noinline, noclone - функция не встраивается в код вне оверлея и не копируется,
+// no-tree-loop-distribute-patterns - циклы не заменяются вызовами memset/memcpy вне оверлея)
+#define W25_OVL_CODE(name) __attribute__((section(".ovl." #name), noinline, noclone, optimize("no-tree-loop-distribute-patterns")))
+#define W25_OVL_DATA(name) __attribute__((section(".ovl." #name ".rodata")))
+
+// Описание оверлея по символам блока линкера ovl_<name>
+#define W25_OVL_DEFINE(name, address) { __ovl_##name##_start__, __ovl_##name##_end__, (address) }
+
+// Пересчёт адреса функции или элемента таблицы оверлея (&table[0]) из адреса сборки в адрес загрузки base
+// (бит Thumb адреса функции сохраняется)
+#define W25_OVL_PTR(ovl, base, sym) \
+  ((__typeof__(sym))((uintptr_t)(base) + ((uintptr_t)(sym) - (uintptr_t)(ovl)->start)))
+
+// Описание оверлея
+typedef struct {
+  const uint8_t *start;   // Начало образа (адрес сборки W25_OVL_VMA + address + W25_OVL_HDR_SIZE, не для чтения)
+  const uint8_t *end;     // Конец образа
+  uint32_t       address; // Адрес заголовка образа в W25Q64 (граница сектора)
+} w25_ovl_t;
+
+// Статистика загрузчика
+typedef struct {
+  uint32_t loads;       // Загрузок из W25Q64
+  uint32_t hits;        // Запросов уже загруженного оверлея
+  uint32_t errors;      // Ошибок CRC при загрузке
+  uint32_t installs;    // Записей образа в W25Q64
+  uint32_t load_cycles; // Длительность последней загрузки, такты ядра (DWT->CYCCNT)
+} w25_ovl_stats_t;
+
+extern w25_ovl_stats_t w25_ovl_stats;
+
+uint8_t        w25_ovl_install(const w25_ovl_t *ovl, const uint8_t *image); // Запись образа в W25Q64, если он отсутствует или устарел
+const uint8_t *w25_ovl_staged(const w25_ovl_t *ovl);                         // Образ от программатора в области загрузки или 0
+void          *w25_ovl_load(const w25_ovl_t *ovl);                           // Загрузка в RAM, возврат - адрес загрузки или 0
+void           w25_ovl_unload(void);                                         // Сброс признака загруженного оверлея
+
+#endif // W25_OVL_H
@@ -10,10 +10,16 @@
  *                - Определены команды для управления памятью (чтение, запись, стирание и т.д.).
  *                - Определены макросы для управления выводом CS (Chip Select).
  *                - Определены значения для управления светодиодами (LED1, LED2, LED3).
+ *                - Объявлены функции блочного чтения w25_read() (Fast Read через DMA)
+ *                  и постраничной записи w25_write() (Page Program через DMA).
   -------------------------------------------------------------------------------------------------------------------------------
  */
 
+#ifndef W25Q64_H
+#define W25Q64_H
+
 #include <stm32f4xx.h>
+#include "spi2_bus.h"
 
 // Функция для отправки данных по SPI2
 uint16_t w25send(uint16_t data);
@@ -21,11 +27,68 @@ uint16_t w25send(uint16_t data);
 // Функция для чтения данных из памяти W25Q64 по указанному адресу
 void w25read(uint32_t address);
 
-// Макрос для установки низкого уровня на выводе CS (активный режим, PE3)
-#define CSLOW  GPIOE -> BSRR |= GPIO_BSRR_BR3; // PE3(CS=0)
+// Функция для блочного чтения len байт из памяти W25Q64 (Fast Read + DMA)
+void w25_read(uint32_t address, uint8_t *buf, uint32_t len);
+
+// Функция для записи len байт в память W25Q64 постранично (Page Program + DMA)
+void w25_write(uint32_t address, const uint8_t *buf, uint32_t len);
+
+// Функция разрешения записи (WR_EN)
+void w25_write_enable(void);
+
+// Функция ожидания завершения внутренней операции памяти (бит BUSY в статусном регистре 1)
+void w25_wait_busy(void);
+
+// Функция чтения статусного регистра 1
+uint8_t w25_read_sr1(void);
+
+// Функция запуска программирования в пределах одной страницы (без ожидания BUSY)
+void w25_program_page(uint32_t address, const uint8_t *buf, uint32_t len);
+
+// Функция запуска стирания сектора 4 КБ (без ожидания BUSY)
+void w25_erase_sector_start(uint32_t address);
+
+// Функция стирания сектора 4 КБ с ожиданием завершения
+void w25_erase_sector(uint32_t address);
+
+// Функция запуска стирания блока 64 КБ (без ожидания BUSY)
+void w25_erase_block_start(uint32_t address);
+
+// Функция стирания блока 64 КБ с ожиданием завершения
+void w25_erase_block(uint32_t address);
+
+// Функция чтения идентификатора JEDEC (производитель, тип, ёмкость)
+uint32_t w25_read_jedec(void);
+
+// Функция чтения блока с проверкой CRC-32 (блок CRC, вычисление во время приёма DMA)
+uint8_t w25_read_verified(uint32_t address, uint8_t *buf, uint32_t len, uint32_t crc);
 
-// Макрос для установки высокого уровня на выводе CS (неактивный режим, PE3)
-#define CSHIGH GPIOE -> BSRR |= GPIO_BSRR_BS3; // PE3(CS=1)
+// Функция записи блока с проверкой записанных данных по CRC-32
+uint8_t w25_write_verified(uint32_t address, const uint8_t *buf, uint32_t len);
+
+// Функция вычисления CRC-32 области памяти W25Q64 (данные не сохраняются)
+uint32_t w25_crc_flash(uint32_t address, uint32_t len);
+
+// Функция чтения статусного регистра 2 (бит SUS - операция приостановлена)
+uint8_t w25_read_sr2(void);
+
+// Функция приостановки стирания/программирования (Erase/Program Suspend) с ожиданием сброса BUSY
+uint8_t w25_suspend(void);
+
+// Функция продолжения приостановленной операции (Erase/Program Resume)
+void w25_resume(void);
+
+// Флаг активной транзакции на шине (CS = 0). Проверяется обработчиками прерываний перед обращением к памяти
+extern volatile uint8_t w25_cs_active;
+
+// Дескриптор памяти на шине SPI2 (CS - PE3, режим 0, 8 бит, делитель - spi2_set_prescaler())
+extern spi2_dev_t w25_dev;
+
+// Макрос для установки низкого уровня на выводе CS: захват шины SPI2, настройка под память (PE3)
+#define CSLOW  do { spi2_bus_acquire(&w25_dev); w25_cs_active = 1; } while (0) // PE3(CS=0)
+
+// Макрос для установки высокого уровня на выводе CS: освобождение шины SPI2 (PE3)
+#define CSHIGH do { w25_cs_active = 0; spi2_bus_release(&w25_dev); } while (0) // PE3(CS=1)
 
 // Определение значений для управления светодиодами
 #define LED1    0x01      // Значение для включения LED1
@@ -38,7 +101,24 @@ void w25read(uint32_t address);
 #define RST	0x99      // Команда сброса
 #define WR_EN	0x06      // Команда разрешения записи
 #define SECT_ER	0x20      // Команда стирания сектора
+#define BLK_ER	0xD8      // Команда стирания блока 64 КБ
 #define RD_SR1	0x05      // Команда чтения статусного регистра 1
 #define PG_PROG	0x02      // Команда программирования страницы
 #define RD_DATA	0x03      // Команда чтения данных
-#define ADDR    0x303030  // Начальный адрес для операций чтения/записи
\ No newline at end of file
+#define FAST_RD	0x0B      // Команда быстрого чтения данных (с фиктивным байтом после адреса)
+#define JEDEC_ID	0x9F      // Команда чтения идентификатора JEDEC
+#define RD_SR2	0x35      // Команда чтения статусного регистра 2
+#define SUSPEND	0x75      // Команда приостановки стирания/программирования
+#define RESUME	0x7A      // Команда продолжения стирания/программирования
+#define ADDR    0x303030  // Начальный адрес для операций чтения/записи
+
+#define SR1_BUSY      0x01  // Бит BUSY статусного регистра 1
+#define SR2_SUS       0x80  // Бит SUS статусного регистра 2 (операция приостановлена)
+#define W25_PAGE_SIZE 256   // Размер страницы программирования, байт
+#define W25_SECTOR_SIZE 4096 // Размер сектора стирания, байт
+#define W25_BLOCK_SIZE  65536 // Размер блока стирания, байт
+
+#define W25Q64_JEDEC  0xEF4017 // Идентификатор JEDEC W25Q64: Winbond (0xEF), тип 0x40, ёмкость 0x17 (64 Мбит)
+#define W25_CAL_ADDR  0x7FF000 // Последний сектор памяти - зарезервирован под шаблон калибровки SPI2 (spi2_autotune)
+
+#endif // W25Q64_H
@@ -4,7 +4,7 @@
    @file        : main.c
    @brief       : Программа для управления светодиодами через SPI2 и внешнюю память W25Q64. 
                   Реализует запись и чтение данных по SPI2, управление светодиодами (LED1, LED2, LED3) 
-                  в зависимости от нажатий кнопок (S1, S2, S3) и переключение формата данных SPI2 между 8-битным и 16-битным.
+                  в зависимости от нажатий кнопок (S1, S2, S3). Стирание и запись памяти выполняются неблокирующим движком.
    @author      : xmatech
    @date        : 13.01.2025
    @board       : JZ-F407VET6
@@ -19,12 +19,18 @@
                   - LED3 включается, если считанное значение равно 0x03.
                   При этом предыдущий включенный светодиод гаснет.
 
-                  Программа также демонстрирует работу с 8-битным и 16-битным форматами данных SPI2:
-                  - Первый байт данных (0x01) записывается в 8-битном формате.
-                  - Затем формат данных SPI2 переключается на 16-битный, и одновременно записываются два следующих байта (0x02 и 0x03).
-                  - После записи формат данных возвращается к 8-битному.
+                  Стирание сектора и запись трёх байт ставятся в очередь движка w25_async: бит BUSY опрашивается
+                  из прерывания TIM7, поэтому основной цикл не блокируется на время стирания (до 400 мс).
+                  Чтение по кнопкам выполняется только после завершения записи (флаг flash_ready).
+                  Повторные чтения обслуживаются кэшем в CCM RAM (w25_cache.c): по шине SPI2 читается
+                  только первое обращение к странице 0x303000..0x3030FF.
 
-                  Скорость работы модуля SPI2 настроена на 1,32 МГц.
+                  Начальная скорость работы модуля SPI2 - 1,32 МГц, затем spi2_autotune() выбирает
+                  максимальную частоту (до 21 МГц), на которой JEDEC ID и шаблон калибровки читаются без ошибок.
+                  Выбранная частота сохраняется в хранилище настроек w25_kv (ключ KV_KEY_SPI2_HZ) при её изменении.
+                  ovl_fir_bench() записывает оверлей КИХ-фильтра в W25Q64 (образ от программатора или, с опцией
+                  OVL_FLASH_COPY, копия во flash), загружает его в SRAM1 и измеряет время фильтрации кодом в RAM
+                  (с OVL_FLASH_COPY - и кодом во flash; ovl_fir_stats, такты DWT).
 
                   Программа проверяет корректность работы:
                   - При нажатии на кнопку S1 должен загораться светодиод LED1.
@@ -37,56 +43,68 @@
 
 
 
+#include "main.h"
 #include "gpio.h"
 #include "rcc_init.h"
 #include "spi2_init.h"
 #include "w25q64.h"
+#include "w25_async.h"
+#include "w25_cache.h"
+#include "w25_kv.h"
+#include "ovl_fir.h"
+
+#define KV_KEY_SPI2_HZ 0 // Ключ хранилища: частота SCK, выбранная spi2_autotune()
+
+static const uint8_t led_codes[3] = { LED1, LED2, LED3 }; // Данные для записи по адресам 0x303030..0x303032
+static volatile uint8_t flash_ready = 0;                     // Запись завершена, чтение разрешено
+static uint32_t sck_saved = 0;                                // Частота SCK, сохранённая при предыдущем запуске
+
+/* Callback-функция завершения программирования (вызывается из прерывания TIM7) */
+static void flash_programmed(uint8_t op, uint32_t address) {
+  (void)op;
+  (void)address;
+  flash_ready = 1;
+}
 
 int main(void) {
 
   SystemInit();   // Инициализация системы
   rcc_init();     // Установка тактирования на 84 МГц 
-  spi2_init();    // Инициализация SPI (его настройка)
+  if (!spi2_init()) {  // Инициализация SPI (его настройка)
+    while (1);          // Потоки DMA1 Stream3/Stream4 заняты (dma_mgr_stats.conflicts): обмен с W25Q64 невозможен
+  }
+  spi2_autotune(); // Подбор частоты SPI2 (результат - в spi2_sck_hz)
   gpio_init();
+  w25_cache_init();       // Сброс кэша чтения в CCM RAM
+
+  w25_kv_mount();         // Хранилище настроек: построение индекса
+  if (w25_kv_get(KV_KEY_SPI2_HZ, &sck_saved, sizeof(sck_saved)) != sizeof(sck_saved) || sck_saved != spi2_sck_hz)
+    w25_kv_set(KV_KEY_SPI2_HZ, &spi2_sck_hz, sizeof(spi2_sck_hz)); // Запись только при изменении частоты
+
+  ovl_fir_bench();        // Оверлей КИХ-фильтра: загрузка из W25Q64 и сравнение flash/RAM
+
+  w25_async_timer_init(); // Опрос движка стирания/программирования из прерывания TIM7
 
   /****************************** Запись 0x01, 0x02, 0x03 в W25Q64 ******************************************/
-  CSLOW 
-  w25send(PG_PROG);                       // Команда - Page Programm
-  w25send((ADDR >> 16) & 0xFF);	          // Адрес в памяти 0x(30)3030
-  w25send((ADDR >> 8) & 0xFF);	          // Адрес в памяти 0x30(30)30 
-  w25send(ADDR & 0xFF);                   // Адрес в памяти 0x3030(30)
-  w25send(LED1);
-
-  SPI2->CR1 &= ~(SPI_CR1_SPE);            // SPI2 Disable
-  SPI2->CR1 |= SPI_CR1_DFF;               // Установить 16-битный формат данных
-  SPI2->CR1 |= SPI_CR1_SPE;               // SPI2 Enable
-
-  w25send(((LED2 << 8) & 0xFF00) | LED3); // Отправка 0x02 и 0x03 одновременно  
-
-  SPI2->CR1 &= ~(SPI_CR1_SPE);            // SPI2 Disable
-  SPI2->CR1 &= ~(SPI_CR1_DFF);            // Установить 8-битный формат данных
-  SPI2->CR1 |= SPI_CR1_SPE;               // SPI2 Enable
-  CSHIGH
-
-  CSLOW 
-  w25send(RD_SR1);                      // Команда - Read Status Register-1
-  while( (w25send(0x00) & 0x01) == 1 ); // Ожидание завершения операции записи (бит BSY в регистре статуса)
-  CSHIGH
+  w25_async_erase(ADDR, 0);                                  // Стирание сектора, содержащего 0x303030
+  w25_async_program(ADDR, led_codes, 3, flash_programmed);   // Запись после завершения стирания
 /***************************************************************************************************************/
   while (1) {
 
-    if ((GPIOE->IDR & GPIO_IDR_ID10) == 0)  // Если нажата кнопка S1 (E10)
-        /* Чтение адреса 0x303030 из памяти W25Q64 и запись считанных данных в переменную */
-        w25read(0x303030); 
+    if (flash_ready) {
+      if ((GPIOE->IDR & GPIO_IDR_ID10) == 0)  // Если нажата кнопка S1 (E10)
+          /* Чтение адреса 0x303030 из памяти W25Q64 и запись считанных данных в переменную */
+          w25_cache_read(0x303030, &memrd, 1); 
 
-    if ((GPIOE->IDR & GPIO_IDR_ID11) == 0)  // Если нажата кнопка S2 (E11)
-        /* Чтение адреса 0x303031 из памяти W25Q64 и запись считанных данных в переменную */
-        w25read(0x303031); 
+      if ((GPIOE->IDR & GPIO_IDR_ID11) == 0)  // Если нажата кнопка S2 (E11)
+          /* Чтение адреса 0x303031 из памяти W25Q64 и запись считанных данных в переменную */
+          w25_cache_read(0x303031, &memrd, 1); 
 
-    if ((GPIOE->IDR & GPIO_IDR_ID12) == 0)  // Если нажата кнопка S3 (E12)
-        /* Чтение адреса 0x303032 из памяти W25Q64 и запись считанных данных в переменную */
-        w25read(0x303032);
+      if ((GPIOE->IDR & GPIO_IDR_ID12) == 0)  // Если нажата кнопка S3 (E12)
+          /* Чтение адреса 0x303032 из памяти W25Q64 и запись считанных данных в переменную */
+          w25_cache_read(0x303032, &memrd, 1);
+    }
 
     switch_led();  // Включение/выключение светодиодов в зависимости от считанного значения
   }
-}
\ No newline at end of file
+}
@@ -0,0 +1,111 @@
+/**
+------------------------------------------------------------------------------------------------------------------------------
+ * @file        : ovl_fir.c
+ * @brief       : Оверлей КИХ-фильтра и сравнение скорости выполнения из flash и из RAM.
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ * @Description : Функция ovl_fir_q15() и таблица ovl_fir_coef размещены в секциях .ovl.fir (адрес сборки - окно W25_OVL_VMA)
+ *                и выполняются из RAM после w25_ovl_load(), а с опцией OVL_FLASH_COPY - ещё и из копии во flash.
+ *                Функция не вызывает других функций и получает таблицу через параметр, поэтому её код не зависит
+ *                от адреса размещения; обе копии вызываются по адресам W25_OVL_PTR().
+ *                Без OVL_FLASH_COPY образ в W25Q64 записывается из области загрузки (w25_ovl_staged()).
+ *                Внутренняя flash при 84 МГц работает с 2 тактами ожидания (ускоритель ART скрывает их только
+ *                на линейных участках и повторяющихся переходах), SRAM1 - без тактов ожидания.
+ -------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#include "ovl_fir.h"
+
+// Границы блока ovl_fir (STM32F4xx_Flash_CCM.icf)
+extern const uint8_t __ovl_fir_start__[], __ovl_fir_end__[];
+#ifdef OVL_FLASH_COPY
+extern const uint8_t __ovl_fir_copy_start__[]; // Копия образа во внутренней flash
+#endif
+
+const w25_ovl_t ovl_fir = W25_OVL_DEFINE(fir, OVL_FIR_ADDR);
+
+ovl_fir_stats_t ovl_fir_stats;
+
+// Коэффициенты ФНЧ Q15 (окно Хэмминга, срез 0,1 fs, сумма 32766)
+W25_OVL_DATA(fir) static const int16_t ovl_fir_coef[OVL_FIR_TAPS] = {
+   -17,   20,   73,  135,  163,   91, -129, -466, -782, -850, -435,  588, 2141, 3926, 5501, 6424,
+  6424, 5501, 3926, 2141,  588, -435, -850, -782, -466, -129,   91,  163,  135,   73,   20,  -17
+};
+
+static int16_t ovl_fir_in[OVL_FIR_LEN + OVL_FIR_TAPS - 1]; // Входной блок с предысторией
+static int16_t ovl_fir_out[2][OVL_FIR_LEN];                 // Результаты: код во flash, код в RAM
+
+/**
+ * @brief КИХ-фильтр Q15: y[i] = sum(coef[k] * x[i + k]) >> 15.
+ *
+ * @param coef Коэффициенты (OVL_FIR_TAPS).
+ * @param x    Входные отсчёты (n + OVL_FIR_TAPS - 1).
+ * @param y    Выходные отсчёты (n).
+ * @param n    Количество выходных отсчётов.
+ */
+W25_OVL_CODE(fir) static void ovl_fir_q15(const int16_t *coef, const int16_t *x, int16_t *y, uint32_t n) {
+  int32_t acc;
+
+  for (uint32_t i = 0; i < n; i++) {
+    acc = 0;
+    for (uint32_t k = 0; k < OVL_FIR_TAPS; k++) acc += (int32_t)coef[k] * x[i + k];
+    acc >>= 15;
+    y[i] = (int16_t)(acc > 32767 ? 32767 : (acc < -32768 ? -32768 : acc));
+  }
+}
+
+/**
+ * @brief Выполнение ovl_fir_q15() из внутренней flash (OVL_FLASH_COPY) и из RAM.
+ *
+ * @return uint8_t 1 - оверлей загружен и результаты совпадают (без OVL_FLASH_COPY - оверлей загружен).
+ */
+uint8_t ovl_fir_bench(void) {
+  void          (*fn)(const int16_t *, const int16_t *, int16_t *, uint32_t);
+  const int16_t *coef;
+  void          *base;
+  uint32_t       start;
+
+  for (uint32_t i = 0; i < OVL_FIR_LEN + OVL_FIR_TAPS - 1; i++) {
+    ovl_fir_in[i] = (int16_t)(((i * 7919) & 0x3FFF) - 0x2000); // Псевдослучайный сигнал
+  }
+
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+
+#ifdef OVL_FLASH_COPY
+  w25_ovl_install(&ovl_fir, __ovl_fir_copy_start__); // Запись образа в W25Q64 при первом запуске или после обновления
+
+  fn   = W25_OVL_PTR(&ovl_fir, __ovl_fir_copy_start__, &ovl_fir_q15);
+  coef = W25_OVL_PTR(&ovl_fir, __ovl_fir_copy_start__, &ovl_fir_coef[0]);
+
+  start = DWT->CYCCNT;
+  fn(coef, ovl_fir_in, ovl_fir_out[0], OVL_FIR_LEN);                    // Код и таблица во flash
+  ovl_fir_stats.flash_cycles = DWT->CYCCNT - start;
+#else
+  w25_ovl_install(&ovl_fir, w25_ovl_staged(&ovl_fir)); // Образ от программатора, если он передан
+#endif
+
+  w25_ovl_unload();
+  base = w25_ovl_load(&ovl_fir);
+  if (!base) return 0;
+  ovl_fir_stats.load_cycles = w25_ovl_stats.load_cycles;
+
+  fn   = W25_OVL_PTR(&ovl_fir, base, &ovl_fir_q15);
+  coef = W25_OVL_PTR(&ovl_fir, base, &ovl_fir_coef[0]);
+
+  start = DWT->CYCCNT;
+  fn(coef, ovl_fir_in, ovl_fir_out[1], OVL_FIR_LEN);                    // Код и таблица в RAM
+  ovl_fir_stats.ram_cycles = DWT->CYCCNT - start;
+
+  ovl_fir_stats.match = 1;
+#ifdef OVL_FLASH_COPY
+  for (uint32_t i = 0; i < OVL_FIR_LEN; i++) {
+    if (ovl_fir_out[0][i] != ovl_fir_out[1][i]) ovl_fir_stats.match = 0;
+  }
+#endif
+
+  return ovl_fir_stats.match;
+}
@@ -0,0 +1,256 @@
+/**
+------------------------------------------------------------------------------------------------------------------------------
+ * @file        : spi2_bus.c
+ * @brief       : Менеджер шины SPI2 для нескольких устройств с очередью транзакций.
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ * @Description : Владелец шины (spi2_bus_owner) - свободна, очередь (идёт передача DMA) или прямой доступ.
+ *                Владелец меняется только при запрещённых прерываниях.
+ *                - spi2_bus_submit() ставит транзакцию в кольцевую очередь указателей и, если шина свободна,
+ *                  сразу запускает её: выбор устройства, CS = 0, DMA с прерыванием по окончании приёма.
+ *                - spi2_bus_dma_irq() (прерывание DMA1 Stream3, выданного spi2_dma_init() через dma_mgr.c) запускает
+ *                  следующий сегмент цепочки, а после последнего сегмента
+ *                  поднимает CS, запускает следующую транзакцию очереди и вызывает callback-функцию завершённой.
+ *                - spi2_bus_acquire() устанавливает spi2_bus_want и ждёт (WFI) окончания текущей транзакции:
+ *                  пока spi2_bus_want = 1, следующая транзакция очереди не запускается. spi2_bus_release()
+ *                  возобновляет очередь.
+ *                Перенастройка SPI2->CR1 (SPE = 0, запись CR1, SPE = 1) выполняется при CS = 1 и только при смене
+ *                устройства или его параметров (spi2_bus_dev_config()).
+ -------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#include "spi2_bus.h"
+#include "spi2_init.h"
+#include "dma_mgr.h"
+
+#define SPI2_BUS_MASK (SPI2_BUS_QUEUE_LEN - 1)
+
+// Владелец шины
+#define SPI2_BUS_FREE   0 // Шина свободна
+#define SPI2_BUS_QUEUE  1 // Выполняется транзакция очереди
+#define SPI2_BUS_DIRECT 2 // Шина захвачена spi2_bus_acquire()
+
+// Постоянные биты SPI2->CR1: Master, программное управление NSS
+#define SPI2_BUS_CR1_BASE (SPI_CR1_MSTR | SPI_CR1_SSM | SPI_CR1_SSI)
+
+spi2_bus_stats_t spi2_bus_stats;
+
+static spi2_xfer_t       *spi2_bus_queue[SPI2_BUS_QUEUE_LEN]; // Кольцевая очередь транзакций
+static volatile uint8_t   spi2_bus_head  = 0;             // Счётчик поставленных транзакций
+static volatile uint8_t   spi2_bus_tail  = 0;             // Счётчик завершённых транзакций
+static volatile uint8_t   spi2_bus_owner = SPI2_BUS_FREE; // Текущий владелец шины
+static volatile uint8_t   spi2_bus_want  = 0;             // Прямой доступ ожидает шину - очередь приостановлена
+static spi2_xfer_t       *spi2_bus_seg   = 0;             // Передаваемый сегмент транзакции очереди
+static const spi2_dev_t  *spi2_bus_cur   = 0;             // Устройство, под которое настроен SPI2->CR1
+
+/**
+ * @brief Заполнение дескриптора устройства и настройка вывода CS (выход push-pull, уровень 1).
+ *
+ * Тактирование порта должно быть включено заранее.
+ *
+ * @param dev  Дескриптор устройства.
+ * @param port Порт вывода CS.
+ * @param pin  Номер вывода CS (0..15).
+ * @param cr1  Режим, делитель и формат кадра (SPI2_DEV_CR1()).
+ */
+void spi2_bus_dev_init(spi2_dev_t *dev, GPIO_TypeDef *port, uint8_t pin, uint16_t cr1) {
+  dev->cs_port = port;
+  dev->cs_pin  = pin;
+  dev->cr1     = cr1 & SPI2_DEV_CR1_MASK;
+
+  port->BSRR    = 1UL << pin;                                                 // CS = 1
+  port->OTYPER &= ~(1UL << pin);                                              // Push-Pull
+  port->MODER   = (port->MODER & ~(3UL << (2 * pin))) | (1UL << (2 * pin));   // Выход
+}
+
+/**
+ * @brief Изменение режима, делителя или формата кадра устройства.
+ *
+ * Новое значение применяется при следующем выборе устройства.
+ *
+ * @param dev Дескриптор устройства.
+ * @param cr1 Режим, делитель и формат кадра (SPI2_DEV_CR1()).
+ */
+void spi2_bus_dev_config(spi2_dev_t *dev, uint16_t cr1) {
+  uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  dev->cr1 = cr1 & SPI2_DEV_CR1_MASK;
+  if (spi2_bus_cur == dev) spi2_bus_cur = 0; // Перенастройка при следующем выборе
+  __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Выбор устройства: перенастройка SPI2->CR1 при смене устройства и CS = 0.
+ *
+ * @param dev Дескриптор устройства.
+ */
+static void spi2_bus_select(const spi2_dev_t *dev) {
+  while (SPI2->SR & SPI_SR_BSY); // CS и CR1 меняются только между кадрами
+
+  if (dev != spi2_bus_cur) {
+    SPI2->CR1 &= ~(SPI_CR1_SPE);                         // Поля BR, CPOL, CPHA, DFF изменяются при SPE = 0
+    SPI2->CR1  = SPI2_BUS_CR1_BASE | dev->cr1;
+    SPI2->CR1  = SPI2_BUS_CR1_BASE | dev->cr1 | SPI_CR1_SPE;
+    spi2_bus_cur = dev;
+    spi2_bus_stats.reconfigs++;
+  }
+
+  dev->cs_port->BSRR = 1UL << (dev->cs_pin + 16);        // CS = 0
+}
+
+/**
+ * @brief Запуск передачи сегмента через DMA с прерыванием по окончании приёма.
+ *
+ * @param seg Сегмент транзакции.
+ */
+static void spi2_bus_start_seg(spi2_xfer_t *seg) {
+  spi2_bus_seg = seg;
+  spi2_dma_start(seg->tx, seg->rx, seg->len);
+  DMA1_Stream3->CR |= DMA_SxCR_TCIE | DMA_SxCR_TEIE; // Биты разрешения прерываний можно менять при EN = 1
+}
+
+/**
+ * @brief Запуск следующей транзакции очереди (вызывается при запрещённых прерываниях).
+ *
+ * Если очередь пуста или прямой доступ ожидает шину, шина освобождается.
+ */
+static void spi2_bus_next(void) {
+  spi2_xfer_t *xfer;
+
+  if (spi2_bus_head == spi2_bus_tail || spi2_bus_want) {
+    spi2_bus_owner = SPI2_BUS_FREE;
+    return;
+  }
+
+  xfer = spi2_bus_queue[spi2_bus_tail & SPI2_BUS_MASK];
+  spi2_bus_owner = SPI2_BUS_QUEUE;
+  spi2_bus_select(xfer->dev);
+  spi2_bus_start_seg(xfer);
+}
+
+/**
+ * @brief Постановка транзакции в очередь.
+ *
+ * Функцию можно вызывать из основного цикла и из обработчиков прерываний. Если шина свободна,
+ * транзакция запускается сразу. Завершение - callback-функция или xfer->state != SPI2_XFER_QUEUED.
+ *
+ * @param xfer Первый сегмент транзакции (dev, cb), следующие сегменты - по цепочке next.
+ * @return uint8_t 1 - транзакция принята, 0 - очередь заполнена или сегмент пустой.
+ */
+uint8_t spi2_bus_submit(spi2_xfer_t *xfer) {
+  uint32_t primask = __get_PRIMASK();
+  uint8_t  ok = 0, depth;
+
+  for (spi2_xfer_t *seg = xfer; seg; seg = seg->next) {
+    if (seg->len == 0) return 0;
+  }
+
+  __disable_irq();
+  depth = (uint8_t)(spi2_bus_head - spi2_bus_tail);
+  if (depth < SPI2_BUS_QUEUE_LEN) {
+    xfer->state = SPI2_XFER_QUEUED;
+    spi2_bus_queue[spi2_bus_head & SPI2_BUS_MASK] = xfer;
+    spi2_bus_head++;
+    if (depth + 1 > spi2_bus_stats.max_queue) spi2_bus_stats.max_queue = depth + 1;
+    if (spi2_bus_owner == SPI2_BUS_FREE) spi2_bus_next();
+    ok = 1;
+  }
+  __set_PRIMASK(primask);
+
+  return ok;
+}
+
+/**
+ * @brief Прерывание DMA1 Stream3 (dma_mgr.c, флаги уже сброшены): окончание приёма сегмента транзакции очереди.
+ */
+void spi2_bus_dma_irq(void *ctx, uint32_t flags) {
+  spi2_xfer_t *xfer, *seg = spi2_bus_seg;
+  uint32_t     primask;
+  uint8_t      err;
+
+  (void)ctx;
+  if ((flags & (DMA_MGR_TC | DMA_MGR_TE)) == 0) return;
+
+  err = (flags & DMA_MGR_TE) ? 1 : 0;
+  DMA1_Stream3->CR &= ~(DMA_SxCR_TCIE | DMA_SxCR_TEIE);
+  spi2_dma_end(); // Ожидание BSY, отключение запросов DMA, сброс флагов Stream4
+
+  if (seg->next && !err) {
+    spi2_bus_start_seg(seg->next); // Следующий сегмент под тем же CS
+    return;
+  }
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  xfer = spi2_bus_queue[spi2_bus_tail & SPI2_BUS_MASK];
+  xfer->dev->cs_port->BSRR = 1UL << xfer->dev->cs_pin; // CS = 1
+  spi2_bus_tail++;
+  spi2_bus_stats.xfers++;
+  if (err) spi2_bus_stats.errors++;
+  spi2_bus_next();                                     // Следующая транзакция - без паузы на callback-функцию
+  __set_PRIMASK(primask);
+
+  xfer->state = err ? SPI2_XFER_ERROR : SPI2_XFER_DONE;
+  if (xfer->cb) xfer->cb(xfer);
+}
+
+/**
+ * @brief Захват шины для прямого доступа и CS = 0.
+ *
+ * Если выполняется транзакция очереди, функция ждёт её окончания (WFI), следующие транзакции
+ * очереди не запускаются до spi2_bus_release(). Из прерывания вызывать только при spi2_bus_free() = 1.
+ *
+ * @param dev Дескриптор устройства.
+ */
+void spi2_bus_acquire(const spi2_dev_t *dev) {
+  uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  if (spi2_bus_owner != SPI2_BUS_FREE) {
+    spi2_bus_want = 1;
+    spi2_bus_stats.waits++;
+    while (spi2_bus_owner != SPI2_BUS_FREE) {
+      __WFI();           // Ожидающее прерывание будит ядро и при PRIMASK = 1
+      __set_PRIMASK(primask);
+      __disable_irq();
+    }
+  }
+  spi2_bus_owner = SPI2_BUS_DIRECT;
+  spi2_bus_want  = 0;
+  __set_PRIMASK(primask);
+
+  spi2_bus_select(dev);
+}
+
+/**
+ * @brief CS = 1, освобождение шины и запуск ожидающих транзакций очереди.
+ *
+ * @param dev Дескриптор устройства.
+ */
+void spi2_bus_release(const spi2_dev_t *dev) {
+  uint32_t primask = __get_PRIMASK();
+
+  dev->cs_port->BSRR = 1UL << dev->cs_pin; // CS = 1
+
+  __disable_irq();
+  spi2_bus_next();
+  __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Проверка, свободна ли шина (нет транзакции очереди и прямого доступа).
+ */
+uint8_t spi2_bus_free(void) {
+  return spi2_bus_owner == SPI2_BUS_FREE;
+}
+
+/**
+ * @brief Проверка, свободна ли шина и пуста ли очередь.
+ */
+uint8_t spi2_bus_idle(void) {
+  return spi2_bus_owner == SPI2_BUS_FREE && spi2_bus_head == spi2_bus_tail;
+}
@@ -10,12 +10,44 @@
  * @Description : Функция spi2_init() настраивает SPI2 для взаимодействия с внешней памятью W25Q64.
  *                - Настраиваются выводы GPIO для SPI2: PC3 (MOSI), PC2 (MISO), PB10 (SCK), PE3 (CS).
  *                - SPI2 настраивается в режиме Master с частотой тактирования 1,32 МГц (делитель 32).
- *                - Выполняется инициализация памяти W25Q64: сброс, разрешение записи, стирание сектора.
+ *                - Выполняется инициализация памяти W25Q64: сброс. Стирание и программирование выполняются
+ *                  неблокирующим движком w25_async.c, чтобы не задерживать запуск программы.
  *                - После инициализации SPI2 готов к использованию для чтения/записи данных.
+ *                - Функции spi2_dma_init() и spi2_dma_txrx() обеспечивают блочный обмен по SPI2 через DMA1
+ *                  (Stream3 - приём, Stream4 - передача, канал 0). Запросы SPI2 обслуживают только эти потоки:
+ *                  spi2_dma_init() получает их у dma_mgr.c, и драйвер, настроенный на них раньше (например,
+ *                  USART3_TX), обнаруживается при запуске, а не порчей обмена.
+ *                - spi2_dma_tx_chain() передаёт цепочку сегментов (dma/dma_chain.c) одним потоком Stream4: запрос TXE
+ *                  остаётся активным, следующий сегмент запускается сразу по TC предыдущего, приём не используется.
+ *                - Функция spi2_autotune() уменьшает делитель частоты SPI2, пока чтение JEDEC ID и шаблона
+ *                  калибровки остаётся безошибочным, и фиксирует самую высокую надёжную частоту (до 21 МГц).
  ---------------------------------------------------------------------------------------------------------------
  */
 
 #include "w25q64.h"
+#include "spi2_init.h"
+#include "dma_mgr.h"
+#include "dma_chain.h"
+
+// Флаги прерываний DMA1 Stream3 (SPI2_RX) и DMA1 Stream4 (SPI2_TX)
+#define SPI2_DMA_RX_FLAGS (DMA_LIFCR_CTCIF3 | DMA_LIFCR_CHTIF3 | DMA_LIFCR_CTEIF3 | DMA_LIFCR_CDMEIF3 | DMA_LIFCR_CFEIF3)
+#define SPI2_DMA_TX_FLAGS (DMA_HIFCR_CTCIF4 | DMA_HIFCR_CHTIF4 | DMA_HIFCR_CTEIF4 | DMA_HIFCR_CDMEIF4 | DMA_HIFCR_CFEIF4)
+
+#define SPI2_PCLK_HZ    42000000UL // Тактовая частота APB1 (SPI2)
+#define SPI2_BR_DEFAULT 4          // Исходный делитель 32 (1,32 МГц)
+#define SPI2_CAL_PASSES 4          // Количество проверок на каждой частоте
+#define SPI2_ID_TRIES   100        // Попыток чтения JEDEC ID на исходной частоте (~2,4 мс при 1,32 МГц)
+
+static uint16_t spi2_dma_dummy_tx = 0x00; // Источник для передачи при чтении (MOSI = 0x00)
+static uint16_t spi2_dma_dummy_rx;        // Приёмник для отбрасываемых данных при записи
+static uint8_t spi2_cal_buf[W25_PAGE_SIZE]; // Буфер шаблона калибровки
+
+dma_chain_t spi2_tx_chain; // Цепочка сегментов передачи на DMA1 Stream4 (статистика пауз между сегментами)
+
+/**
+ * @brief Текущая частота SCK модуля SPI2, Гц.
+ */
+uint32_t spi2_sck_hz = SPI2_PCLK_HZ >> (SPI2_BR_DEFAULT + 1);
 
 /**
  * @brief Инициализация SPI2 для работы с памятью W25Q64.
@@ -30,13 +62,16 @@
  *    - Делитель частоты 32 (частота SPI2 = 1,32 МГц).
  *    - 8-битный формат данных.
  *    - Программное управление сигналом NSS.
- * 4. Инициализирует память W25Q64:
- *    - Сброс памяти (команды EN_RST и RST).
- *    - Разрешение записи (команда WR_EN).
- *    - Стирание сектора (команда SECT_ER).
- *    - Ожидание завершения операций записи/стирания.
+ * 4. Получает и настраивает потоки DMA1 для SPI2 (spi2_dma_init), прерывание приёма - очередь шины spi2_bus.
+ * 5. Инициализирует память W25Q64:
+ *    - Сброс памяти (команды EN_RST и RST, побайтный обмен без DMA).
+ *
+ * @return uint8_t 1 - готово, 0 - потоки DMA1 Stream3/Stream4 заняты другим драйвером (dma_mgr_stats.conflicts):
+ *         блочные функции драйвера (w25_read(), w25_write(), spi2_bus) использовать нельзя.
  */
-void spi2_init(void) {
+uint8_t spi2_init(void) {
+  uint8_t dma_ok;
+
   // Включение тактирования GPIOB, GPIOC, GPIOE
   RCC->AHB1ENR |= RCC_AHB1ENR_GPIOBEN | RCC_AHB1ENR_GPIOCEN | RCC_AHB1ENR_GPIOEEN;
 
@@ -50,15 +85,16 @@ void spi2_init(void) {
   GPIOB->AFR[1] |= GPIO_AFRH_AFRH2_2 | GPIO_AFRH_AFRH2_0;                     // AF5 для PB10
   GPIOB->PUPDR  |= GPIO_PUPDR_PUPD10_1;                                       // PB10 pull-down
                                                                               
-  // Настройка PE3 (CS) в режиме вывода                                       
-  GPIOE->MODER |= GPIO_MODER_MODE3_0;                                         // Режим работы на выход PE3
-  GPIOE->OTYPER &= ~(GPIO_OTYPER_OT3);                                        // Режим Push-Pull
+  // Настройка PE3 (CS) в режиме вывода: дескриптор W25Q64 на шине SPI2 (режим 0, делитель 32, 8 бит)
+  spi2_bus_dev_init(&w25_dev, GPIOE, 3, SPI2_DEV_CR1(0, SPI2_BR_DEFAULT, 0));
   GPIOE->PUPDR |= GPIO_PUPDR_PUPD3_1;                                         // Подтяжка вниз
-  GPIOE->BSRR |= GPIO_BSRR_BS3;                                               // Установка CS в неактивное состояние (CS = 1)
 
   // Включение тактирования SPI2
   RCC->APB1ENR |= RCC_APB1ENR_SPI2EN;
 
+  // Включение тактирования блока CRC (проверка данных памяти, w25_crc.c)
+  RCC->AHB1ENR |= RCC_AHB1ENR_CRCEN;
+
   // Настройка SPI2
   SPI2->CR1 |= SPI_CR1_MSTR | // Режим Master
                SPI_CR1_BR_2 | // Делитель частоты 32 (частота SPI2 = 1,32 МГц)
@@ -69,6 +105,9 @@ void spi2_init(void) {
   // Включение SPI2
   SPI2->CR1 |= SPI_CR1_SPE;
 
+  // Настройка потоков DMA1 для блочного обмена и прерывания очереди транзакций шины
+  dma_ok = spi2_dma_init();
+
   // Инициализация памяти W25Q64
   CSLOW;
   w25send(EN_RST); // Команда включения сброса (0x66)
@@ -78,25 +117,244 @@ void spi2_init(void) {
   w25send(RST); // Команда сброса (0x99)
   CSHIGH;
 
-  CSLOW;
-  w25send(WR_EN); // Команда разрешения записи (0x06)
-  CSHIGH;
+  return dma_ok;
+}
 
-  CSLOW;
-  w25send(SECT_ER); // Команда стирания сектора (0x20)
-  w25send((ADDR >> 16) & 0xFF); // Адрес сектора (старший байт)
-  w25send((ADDR >> 8) & 0xFF);  // Адрес сектора (средний байт)
-  w25send(ADDR & 0xFF);         // Адрес сектора (младший байт)
-  CSHIGH;
+/**
+ * @brief Настройка потоков DMA1 для работы с SPI2.
+ *
+ * Функция выполняет следующие шаги:
+ * 1. Получает у dma_mgr.c потоки Stream3 (SPI2_RX) и Stream4 (SPI2_TX): менеджер включает тактирование DMA1,
+ *    останавливает потоки и сбрасывает флаги. Прерывание Stream3 передаётся очереди шины (spi2_bus_dma_irq()).
+ * 2. Устанавливает адрес периферии - регистр данных SPI2 и прямой режим (без FIFO).
+ * Направление, адрес памяти и количество данных задаются при каждом обмене в spi2_dma_txrx().
+ *
+ * @return uint8_t 1 - потоки получены, 0 - поток занят другим драйвером (dma_mgr_stats.conflicts),
+ *         полученный поток приёма освобождается.
+ */
+uint8_t spi2_dma_init(void) {
+  if (dma_mgr_claim(DMA_REQ_SPI2_RX, 0, spi2_bus_dma_irq, 0, SPI2_BUS_IRQ_PRIO) != DMA1_Stream3) return 0;
+  if (dma_mgr_claim(DMA_REQ_SPI2_TX, 0, 0, 0, 0) != DMA1_Stream4) {
+    dma_mgr_release(DMA1_Stream3);
+    return 0;
+  }
 
-  // Ожидание завершения стирания сектора
-  CSLOW;
-  w25send(RD_SR1); // Чтение статусного регистра 1 (0x05)
-  while ((w25send(0x00) & 0x01) == 1); // Ожидание завершения операции
-  CSHIGH;
+  DMA1_Stream3->PAR  = (uint32_t)&(SPI2->DR); // Источник - регистр данных SPI2
+  DMA1_Stream4->PAR  = (uint32_t)&(SPI2->DR); // Приёмник - регистр данных SPI2
+  DMA1_Stream3->FCR &= ~(DMA_SxFCR_DMDIS);    // Прямой режим без FIFO
+  DMA1_Stream4->FCR &= ~(DMA_SxFCR_DMDIS);    // Прямой режим без FIFO
 
-  // Повторное разрешение записи
-  CSLOW;
-  w25send(WR_EN); // Команда разрешения записи (0x06)
-  CSHIGH;
-}
\ No newline at end of file
+  dma_chain_init(&spi2_tx_chain, DMA1_Stream4);
+
+  return 1;
+}
+
+/**
+ * @brief Запуск полнодуплексного обмена блоком данных по SPI2 через DMA без ожидания завершения.
+ *
+ * Функция запускает оба потока DMA1 на len байт и сразу возвращает управление: пока идёт обмен,
+ * процессор может обрабатывать ранее принятые данные. Завершение ожидается функцией spi2_dma_wait().
+ * Управление выводом CS остаётся за вызывающей стороной.
+ * Порядок включения соответствует RM0090: RXDMAEN, потоки DMA, затем TXDMAEN.
+ *
+ * @param tx  Буфер передачи или 0 - передаются нулевые байты (адрес памяти не инкрементируется).
+ * @param rx  Буфер приёма или 0 - принятые байты отбрасываются.
+ * @param len Количество кадров (1..65535): байт или полуслов при 16-битном формате (SPI2->CR1.DFF).
+ */
+void spi2_dma_start(const uint8_t *tx, uint8_t *rx, uint16_t len) {
+  uint32_t size = (SPI2->CR1 & SPI_CR1_DFF) ? (DMA_SxCR_PSIZE_0 | DMA_SxCR_MSIZE_0) : 0; // 8 или 16 бит по формату кадра
+
+  if (len == 0) return;
+
+  (void)SPI2->DR;                             // Сброс RXNE, оставшегося от предыдущего обмена
+
+  DMA1->LIFCR = SPI2_DMA_RX_FLAGS;            // Очистка флагов Stream3
+  DMA1->HIFCR = SPI2_DMA_TX_FLAGS;            // Очистка флагов Stream4
+
+  // Stream3: канал 0, периферия -> память, высокий приоритет (приём не должен отставать от передачи)
+  DMA1_Stream3->M0AR = rx ? (uint32_t)rx : (uint32_t)&spi2_dma_dummy_rx;
+  DMA1_Stream3->NDTR = len;
+  DMA1_Stream3->CR   = DMA_SxCR_PL_1 | size | (rx ? DMA_SxCR_MINC : 0);
+
+  // Stream4: канал 0, память -> периферия, средний приоритет
+  DMA1_Stream4->M0AR = tx ? (uint32_t)tx : (uint32_t)&spi2_dma_dummy_tx;
+  DMA1_Stream4->NDTR = len;
+  DMA1_Stream4->CR   = DMA_SxCR_PL_0 | DMA_SxCR_DIR_0 | size | (tx ? DMA_SxCR_MINC : 0);
+
+  SPI2->CR2 |= SPI_CR2_RXDMAEN;               // Запросы DMA по приёму
+  DMA1_Stream3->CR |= DMA_SxCR_EN;            // Запуск потока приёма
+  DMA1_Stream4->CR |= DMA_SxCR_EN;            // Запуск потока передачи
+  SPI2->CR2 |= SPI_CR2_TXDMAEN;               // Запросы DMA по передаче - старт обмена
+}
+
+/**
+ * @brief Ожидание завершения обмена, запущенного spi2_dma_start().
+ *
+ * Функция ожидает приёма последнего байта (к этому моменту передача тоже завершена)
+ * и освобождения шины, после чего отключает запросы DMA.
+ */
+void spi2_dma_wait(void) {
+  while ((DMA1->LISR & (DMA_LISR_TCIF3 | DMA_LISR_TEIF3)) == 0); // Ожидание приёма последнего байта
+  spi2_dma_end();
+}
+
+/**
+ * @brief Окончание обмена после приёма последнего байта (TCIF3/TEIF3): ожидание освобождения шины,
+ * отключение запросов DMA и сброс флагов потоков.
+ *
+ * Вызывается из spi2_dma_wait() и из прерывания потока приёма (флаги уже сброшены dma_mgr.c).
+ */
+void spi2_dma_end(void) {
+  while (SPI2->SR & SPI_SR_BSY);              // Ожидание освобождения шины
+
+  SPI2->CR2 &= ~(SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN);
+  DMA1->LIFCR = SPI2_DMA_RX_FLAGS;
+  DMA1->HIFCR = SPI2_DMA_TX_FLAGS;
+}
+
+/**
+ * @brief Передача цепочки сегментов по SPI2 через DMA1 Stream4 с ожиданием завершения.
+ *
+ * Поток приёма не включается: принятые байты остаются в DR (флаг OVR), после освобождения шины RXNE и OVR
+ * сбрасываются чтением DR, затем SR. Флаги потока опрашиваются: по TC следующий сегмент запускает
+ * dma_chain_irq_at() (пауза - от обнаружения TC), пока TXDMAEN = 1 и запрос TXE ожидает обслуживания.
+ * Управление выводом CS остаётся за вызывающей стороной.
+ *
+ * @param seg Первый сегмент (адрес, количество кадров, next).
+ * @return uint8_t DMA_CHAIN_DONE - цепочка передана, DMA_CHAIN_ERROR - ошибка потока (TE, передана часть),
+ *                 0 - цепочка не запущена (пустой сегмент или предыдущая цепочка не завершена): на шину ничего не передано.
+ */
+uint8_t spi2_dma_tx_chain(const dma_seg_t *seg) {
+  uint32_t size = (SPI2->CR1 & SPI_CR1_DFF) ? (DMA_SxCR_PSIZE_0 | DMA_SxCR_MSIZE_0) : 0; // 8 или 16 бит по формату кадра
+  uint32_t flags, t0;
+  uint8_t  r = DMA_CHAIN_DONE;
+
+  if (dma_chain_busy(&spi2_tx_chain)) return 0; // CR потока не трогается, пока цепочка выполняется
+  DMA1_Stream4->CR = DMA_SxCR_PL_0 | DMA_SxCR_DIR_0 | size | DMA_SxCR_MINC; // Канал 0, память -> периферия
+  if (!dma_chain_start(&spi2_tx_chain, seg)) return 0;
+  SPI2->CR2 |= SPI_CR2_TXDMAEN;               // Запросы DMA по передаче - старт обмена
+
+  while (dma_chain_busy(&spi2_tx_chain)) {
+    flags = dma_mgr_flags(DMA1_Stream4);
+    if (flags & (DMA_MGR_TC | DMA_MGR_TE)) {
+      t0 = DWT->CYCCNT;                       // Начало паузы - обнаружение TC
+      dma_mgr_clear(DMA1_Stream4, flags);
+      r = dma_chain_irq_at(&spi2_tx_chain, flags, t0); // Следующий сегмент
+    }
+  }
+
+  while (!(SPI2->SR & SPI_SR_TXE));           // Последний кадр в регистре сдвига
+  while (SPI2->SR & SPI_SR_BSY);              // Ожидание освобождения шины
+  SPI2->CR2 &= ~(SPI_CR2_TXDMAEN);
+  (void)SPI2->DR;                             // Сброс RXNE и OVR (последовательность DR -> SR)
+  (void)SPI2->SR;
+
+  return r;
+}
+
+/**
+ * @brief Полнодуплексный обмен блоком данных по SPI2 через DMA с ожиданием завершения.
+ *
+ * @param tx  Буфер передачи или 0 - передаются нулевые байты.
+ * @param rx  Буфер приёма или 0 - принятые байты отбрасываются.
+ * @param len Количество байт (0..65535).
+ */
+void spi2_dma_txrx(const uint8_t *tx, uint8_t *rx, uint16_t len) {
+  if (len == 0) return;
+
+  spi2_dma_start(tx, rx, len);
+  spi2_dma_wait();
+}
+
+/**
+ * @brief Установка делителя частоты SPI2 для памяти W25Q64.
+ *
+ * Делитель записывается в дескриптор w25_dev. Поле BR можно изменять только при выключенном SPI2,
+ * поэтому менеджер шины применяет его при следующем выборе памяти (spi2_bus_select()).
+ *
+ * @param br Значение поля BR (0..7): частота SCK = 42 МГц / 2^(br + 1).
+ */
+void spi2_set_prescaler(uint8_t br) {
+  spi2_bus_dev_config(&w25_dev, (w25_dev.cr1 & ~(SPI_CR1_BR)) | ((uint32_t)(br & 0x07) << SPI_CR1_BR_Pos));
+
+  spi2_sck_hz = SPI2_PCLK_HZ >> ((br & 0x07) + 1);
+}
+
+/**
+ * @brief Байт шаблона калибровки.
+ *
+ * Шаблон чередует байты с максимальным числом переходов (0x55, 0xAA) и байты 0x00/0xFF,
+ * а во второй половине каждых 32 байт - псевдослучайные значения.
+ *
+ * @param i Номер байта в странице.
+ */
+static uint8_t spi2_cal_pattern(uint32_t i) {
+  static const uint8_t base[4] = { 0x55, 0xAA, 0x00, 0xFF };
+
+  return (i & 0x10) ? (uint8_t)(i * 37 + 11) : base[i & 3];
+}
+
+/**
+ * @brief Проверка обмена на текущей частоте.
+ *
+ * SPI2_CAL_PASSES раз подряд читается JEDEC ID (побайтный обмен) и страница шаблона (Fast Read + DMA).
+ *
+ * @return uint8_t 1 - все чтения безошибочны, 0 - обнаружена ошибка.
+ */
+static uint8_t spi2_cal_check(void) {
+  uint32_t i;
+
+  for (uint8_t pass = 0; pass < SPI2_CAL_PASSES; pass++) {
+    if (w25_read_jedec() != W25Q64_JEDEC) return 0;
+
+    for (i = 0; i < W25_PAGE_SIZE; i++) spi2_cal_buf[i] = ~spi2_cal_pattern(i); // Заполнение заведомо неверными данными
+    w25_read(W25_CAL_ADDR, spi2_cal_buf, W25_PAGE_SIZE);
+    for (i = 0; i < W25_PAGE_SIZE; i++) {
+      if (spi2_cal_buf[i] != spi2_cal_pattern(i)) return 0;
+    }
+  }
+
+  return 1;
+}
+
+/**
+ * @brief Подбор максимальной надёжной частоты SPI2.
+ *
+ * Функция выполняет следующие шаги:
+ * 1. Устанавливает исходный делитель 32 (1,32 МГц) и читает JEDEC ID. После сброса в spi2_init() память
+ *    не принимает команды в течение tRST = 30 мкс, поэтому чтение повторяется до SPI2_ID_TRIES раз.
+ *    Если память так и не ответила, калибровка прекращается на исходной частоте.
+ * 2. Если в секторе W25_CAL_ADDR нет шаблона калибровки, стирает сектор и записывает шаблон на исходной частоте.
+ * 3. Уменьшает делитель (16, 8, 4, 2) и на каждой частоте проверяет JEDEC ID и шаблон (spi2_cal_check()).
+ *    Первая же ошибка останавливает перебор.
+ * 4. Устанавливает последний делитель, прошедший проверку.
+ * Вызывается после spi2_init() до запуска движка w25_async.
+ *
+ * @return uint32_t Выбранная частота SCK, Гц (также сохраняется в spi2_sck_hz).
+ */
+uint32_t spi2_autotune(void) {
+  uint8_t best = SPI2_BR_DEFAULT;
+  uint8_t tries;
+
+  spi2_set_prescaler(SPI2_BR_DEFAULT);
+  for (tries = 0; tries < SPI2_ID_TRIES; tries++) {
+    if (w25_read_jedec() == W25Q64_JEDEC) break;
+  }
+  if (tries == SPI2_ID_TRIES) return spi2_sck_hz; // Память не отвечает на исходной частоте
+
+  if (!spi2_cal_check()) { // Шаблон отсутствует - запись на исходной частоте
+    for (uint32_t i = 0; i < W25_PAGE_SIZE; i++) spi2_cal_buf[i] = spi2_cal_pattern(i);
+    w25_erase_sector(W25_CAL_ADDR);
+    w25_write(W25_CAL_ADDR, spi2_cal_buf, W25_PAGE_SIZE);
+    if (!spi2_cal_check()) return spi2_sck_hz;
+  }
+
+  for (uint8_t br = SPI2_BR_DEFAULT; br > 0; br--) {
+    spi2_set_prescaler(br - 1);
+    if (!spi2_cal_check()) break; // Ошибка - более высокие частоты не проверяются
+    best = br - 1;
+  }
+
+  spi2_set_prescaler(best);
+  return spi2_sck_hz;
+}
@@ -0,0 +1,363 @@
+/**
+------------------------------------------------------------------------------------------------------------------------------
+ * @file        : w25_async.c
+ * @brief       : Неблокирующий движок стирания/программирования памяти W25Q64.
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ * @Description : Стирание сектора занимает до 400 мс, программирование страницы - до 3 мс. Вместо ожидания бита BUSY
+ *                в цикле запросы ставятся в кольцевую очередь, а автомат состояний w25_async_poll() на каждом шаге:
+ *                - читает статусный регистр 1 один раз и сразу возвращает управление, если память занята;
+ *                - продолжает программирование следующей страницы текущего запроса;
+ *                - завершает запрос (вызывает callback-функцию) и запускает следующий из очереди.
+ *                Шаги выполняются из прерывания TIM7 (1 кГц, низший приоритет) либо из основного цикла.
+ *                Если прерывание застало транзакцию основного контекста (w25_cs_active = 1) или шина SPI2 занята
+ *                другим устройством (spi2_bus_free() = 0), шаг пропускается.
+ *                Срочное чтение w25_async_read() приостанавливает текущую операцию памяти, если читаемая область
+ *                не пересекается со стираемым сектором/программируемой страницей; иначе ожидается завершение операции.
+ *                На время срочного чтения шаги движка пропускаются (w25_async_hold = 1).
+ *                Стирание блока 64 КБ (w25_async_erase_block()) выполняется в фоне: запрос покидает очередь сразу
+ *                после запуска, следующие запросы программирования вне стираемого блока выполняются в приостановке
+ *                стирания (Erase Suspend допускает Page Program в другие блоки). Когда очередь пуста, стирание
+ *                продолжается (Resume). Запросы стирания и программирование стираемого блока ждут окончания стирания.
+ *                Между Resume и следующим Suspend выдерживается tSUS: иначе память игнорирует Suspend.
+ -------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#include "w25_async.h"
+
+#define W25_ASYNC_MASK (W25_ASYNC_QUEUE_LEN - 1)
+
+static w25_async_req_t  w25_async_queue[W25_ASYNC_QUEUE_LEN]; // Кольцевая очередь запросов
+static volatile uint8_t w25_async_head = 0; // Счётчик поставленных запросов (изменяется только при постановке)
+static volatile uint8_t w25_async_tail = 0; // Счётчик завершённых запросов (изменяется только в w25_async_poll())
+static volatile uint8_t w25_async_busy = 0; // Текущий запрос запущен, память выполняет операцию
+static uint32_t         w25_async_done = 0; // Количество байт текущего запроса, переданных в память
+static volatile uint8_t w25_async_hold = 0; // Выполняется срочное чтение - шаги движка пропускаются
+static uint32_t         w25_async_op_addr;  // Начало области, изменяемой текущей операцией памяти
+static uint32_t         w25_async_op_len;   // Длина этой области
+static volatile uint8_t w25_async_bg = 0;   // Фоновое стирание блока: W25_ASYNC_BG_RUN / W25_ASYNC_BG_SUS
+static uint32_t         w25_async_bg_addr;  // Начало стираемого блока
+static w25_async_cb_t   w25_async_bg_cb;    // Callback-функция фонового стирания
+static uint32_t         w25_async_bg_resumed; // DWT->CYCCNT последнего Resume фонового стирания
+
+#define W25_ASYNC_BG_RUN      1            // Стирание выполняется
+#define W25_ASYNC_BG_SUS      2            // Стирание приостановлено
+#define W25_ASYNC_TSUS_CYCLES (20U * 84U)  // tSUS = 20 мкс при 84 МГц
+
+w25_async_stats_t w25_async_stats;
+uint8_t           w25_async_suspend_enable = 1;
+
+/**
+ * @brief Постановка запроса в очередь.
+ *
+ * Копирование запроса выполняется при запрещённых прерываниях, поэтому функцию можно вызывать
+ * как из основного цикла, так и из обработчиков прерываний с любым приоритетом.
+ *
+ * @param req Запрос для постановки в очередь.
+ * @return uint8_t 1 - запрос принят, 0 - очередь заполнена.
+ */
+static uint8_t w25_async_push(const w25_async_req_t *req) {
+  uint32_t primask = __get_PRIMASK();
+  uint8_t  ok = 0;
+
+  __disable_irq();
+  if ((uint8_t)(w25_async_head - w25_async_tail) < W25_ASYNC_QUEUE_LEN) {
+    w25_async_queue[w25_async_head & W25_ASYNC_MASK] = *req;
+    w25_async_head++;
+    ok = 1;
+  }
+  __set_PRIMASK(primask);
+
+  return ok;
+}
+
+/**
+ * @brief Запуск программирования очередной страницы текущего запроса.
+ *
+ * @param req Текущий запрос программирования.
+ */
+static void w25_async_next_page(const w25_async_req_t *req) {
+  uint32_t address = req->address + w25_async_done;
+  uint32_t chunk   = W25_PAGE_SIZE - (address & (W25_PAGE_SIZE - 1)); // Остаток до конца страницы
+
+  if (chunk > req->len - w25_async_done) chunk = req->len - w25_async_done;
+
+  w25_async_op_addr = address;
+  w25_async_op_len  = chunk;
+  w25_program_page(address, req->data + w25_async_done, chunk);
+  w25_async_done += chunk;
+}
+
+/**
+ * @brief Постановка в очередь стирания сектора 4 КБ.
+ *
+ * @param address Любой адрес внутри стираемого сектора.
+ * @param cb      Callback-функция завершения (может быть 0).
+ * @return uint8_t 1 - запрос принят, 0 - очередь заполнена.
+ */
+uint8_t w25_async_erase(uint32_t address, w25_async_cb_t cb) {
+  w25_async_req_t req = { W25_OP_ERASE, address, 0, 0, cb };
+
+  return w25_async_push(&req);
+}
+
+/**
+ * @brief Постановка в очередь фонового стирания блока 64 КБ.
+ *
+ * Запрос завершается (callback-функция) по окончании стирания; программирование других блоков, поставленное
+ * после него, выполняется во время стирания.
+ *
+ * @param address Любой адрес внутри стираемого блока.
+ * @param cb      Callback-функция завершения (может быть 0).
+ * @return uint8_t 1 - запрос принят, 0 - очередь заполнена.
+ */
+uint8_t w25_async_erase_block(uint32_t address, w25_async_cb_t cb) {
+  w25_async_req_t req = { W25_OP_ERASE_BLOCK, address, 0, 0, cb };
+
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; // Счётчик тактов DWT для интервала Resume -> Suspend
+  DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+
+  return w25_async_push(&req);
+}
+
+/**
+ * @brief Постановка в очередь программирования блока данных.
+ *
+ * Блок может быть произвольной длины: движок сам разбивает его по границам страниц.
+ * Область памяти должна быть стёрта (например, предыдущим запросом w25_async_erase()).
+ *
+ * @param address Начальный адрес в памяти W25Q64.
+ * @param data    Данные для записи (не должны изменяться до вызова callback-функции).
+ * @param len     Количество байт для записи.
+ * @param cb      Callback-функция завершения (может быть 0).
+ * @return uint8_t 1 - запрос принят, 0 - очередь заполнена или len == 0.
+ */
+uint8_t w25_async_program(uint32_t address, const uint8_t *data, uint32_t len, w25_async_cb_t cb) {
+  w25_async_req_t req = { W25_OP_PROGRAM, address, data, len, cb };
+
+  if (len == 0) return 0;
+
+  return w25_async_push(&req);
+}
+
+/**
+ * @brief Окончание фонового стирания блока: вызов callback-функции.
+ */
+static void w25_async_bg_done(void) {
+  w25_async_cb_t cb = w25_async_bg_cb;
+
+  w25_async_bg = 0;
+  if (cb) cb(W25_OP_ERASE_BLOCK, w25_async_bg_addr);
+}
+
+/**
+ * @brief Продолжение приостановленного фонового стирания.
+ */
+static void w25_async_bg_resume(void) {
+  w25_resume();
+  w25_async_bg         = W25_ASYNC_BG_RUN;
+  w25_async_bg_resumed = DWT->CYCCNT;
+}
+
+/**
+ * @brief Проверка пересечения области с блоком фонового стирания.
+ */
+static uint8_t w25_async_bg_overlaps(uint32_t address, uint32_t len) {
+  return address < w25_async_bg_addr + W25_BLOCK_SIZE && address + len > w25_async_bg_addr;
+}
+
+/**
+ * @brief Один шаг автомата состояний движка.
+ *
+ * 1. Если шина занята транзакцией основного контекста или срочным чтением - выход (повтор на следующем шаге).
+ * 2. Если память выполняет операцию - одно чтение статусного регистра; при BUSY = 1 выход.
+ * 3. Если у текущего запроса программирования остались данные - запуск следующей страницы.
+ * 4. Иначе запрос завершён: освобождение места в очереди и вызов callback-функции.
+ * 5. Фоновое стирание: окончание (BUSY = 0), продолжение при пустой очереди, приостановка перед
+ *    программированием другого блока.
+ * 6. Запуск следующего запроса из очереди (если есть).
+ */
+void w25_async_poll(void) {
+  const w25_async_req_t *req;
+  w25_async_cb_t cb;
+  uint8_t        op;
+  uint32_t       address;
+
+  if (w25_cs_active || w25_async_hold || !spi2_bus_free()) return; // Шина занята (основной контекст, очередь SPI2) или срочное чтение
+
+  if (w25_async_busy) {
+    if (w25_read_sr1() & SR1_BUSY) return; // Память ещё занята
+
+    req = &w25_async_queue[w25_async_tail & W25_ASYNC_MASK];
+    if ((req->op == W25_OP_PROGRAM) && (w25_async_done < req->len)) {
+      w25_async_next_page(req); // Следующая страница текущего запроса
+      return;
+    }
+
+    // Запрос завершён: копирование полей до освобождения ячейки очереди
+    cb      = req->cb;
+    op      = req->op;
+    address = req->address;
+    w25_async_busy = 0;
+    w25_async_tail++;
+
+    if (cb) cb(op, address);
+  }
+
+  if (w25_async_bg == W25_ASYNC_BG_RUN && !(w25_read_sr1() & SR1_BUSY)) w25_async_bg_done();
+
+  if (w25_async_tail == w25_async_head) {
+    if (w25_async_bg == W25_ASYNC_BG_SUS) w25_async_bg_resume(); // Очередь пуста - стирание продолжается
+    return;
+  }
+
+  req = &w25_async_queue[w25_async_tail & W25_ASYNC_MASK];
+  if (w25_async_bg) {
+    if (req->op != W25_OP_PROGRAM || w25_async_bg_overlaps(req->address, req->len)) {
+      if (w25_async_bg == W25_ASYNC_BG_SUS) w25_async_bg_resume(); // Запрос ждёт окончания стирания
+      return;
+    }
+    if (w25_async_bg == W25_ASYNC_BG_RUN) {
+      if (DWT->CYCCNT - w25_async_bg_resumed < W25_ASYNC_TSUS_CYCLES) return; // Suspend раньше tSUS игнорируется
+      if (w25_suspend()) {
+        w25_async_bg = W25_ASYNC_BG_SUS;
+        w25_async_stats.bg_suspends++;
+      } else {
+        w25_async_bg_done(); // Стирание завершилось до приостановки
+      }
+    }
+  }
+
+  if (req->op == W25_OP_ERASE_BLOCK) {
+    w25_async_bg_addr = req->address & ~(W25_BLOCK_SIZE - 1UL);
+    w25_async_bg_cb   = req->cb;
+    w25_async_bg      = W25_ASYNC_BG_RUN;
+    w25_erase_block_start(req->address);
+    w25_async_tail++;                      // Запрос выполняется в фоне, очередь продолжается
+  } else if (req->op == W25_OP_ERASE) {
+    w25_async_op_addr = req->address & ~(W25_SECTOR_SIZE - 1UL);
+    w25_async_op_len  = W25_SECTOR_SIZE;
+    w25_erase_sector_start(req->address);
+    w25_async_busy = 1;
+  } else {
+    w25_async_done = 0;
+    w25_async_next_page(req);
+    w25_async_busy = 1;
+  }
+}
+
+/**
+ * @brief Срочное чтение во время работы движка.
+ *
+ * 1. Шаги движка из прерывания TIM7 запрещаются (w25_async_hold).
+ * 2. Если память выполняет операцию движка:
+ *    - область чтения не пересекается с изменяемой областью - операция приостанавливается (w25_suspend());
+ *    - иначе (или при w25_async_suspend_enable = 0) ожидается завершение операции;
+ *    - программирование во время приостановленного фонового стирания не приостанавливается (вложенный
+ *      Suspend не допускается) - ожидается его завершение.
+ * 3. Чтение данных (Fast Read + DMA).
+ * 4. Продолжение приостановленной операции (w25_resume()), разрешение шагов движка.
+ * Задержка чтения (такты DWT) учитывается в w25_async_stats.read_max_cycles.
+ *
+ * @param address Начальный адрес в памяти W25Q64.
+ * @param buf     Буфер для считанных данных.
+ * @param len     Количество байт для чтения.
+ * @return uint8_t 1 - операция приостанавливалась на время чтения.
+ */
+uint8_t w25_async_read(uint32_t address, uint8_t *buf, uint32_t len) {
+  uint32_t start, cycles;
+  uint8_t  suspended = 0;
+
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; // Счётчик тактов DWT для измерения задержки
+  DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+  start = DWT->CYCCNT;
+
+  w25_async_hold = 1;
+
+  if (w25_async_bg && w25_async_bg_overlaps(address, len)) { // Чтение стираемого блока - до окончания стирания
+    w25_wait_busy();                                          // Страница в приостановке стирания
+    if (w25_async_bg == W25_ASYNC_BG_SUS) w25_resume();
+    w25_wait_busy();
+    w25_async_bg_done();
+    w25_async_stats.waits++;
+  } else if (w25_async_busy && w25_async_bg == W25_ASYNC_BG_SUS) {
+    w25_wait_busy();             // Страница в приостановке стирания (не более tPP): вложенный Suspend недопустим
+    w25_async_stats.waits++;
+  } else if (w25_async_bg == W25_ASYNC_BG_RUN && !w25_async_busy && (w25_read_sr1() & SR1_BUSY)) {
+    if (w25_async_suspend_enable && DWT->CYCCNT - w25_async_bg_resumed >= W25_ASYNC_TSUS_CYCLES) {
+      suspended = w25_suspend(); // 0 - стирание завершилось, окончание обработает w25_async_poll()
+      if (suspended) w25_async_stats.suspends++;
+      else           w25_async_stats.waits++;
+    } else {
+      w25_wait_busy();
+      w25_async_stats.waits++;
+    }
+  } else if (w25_async_busy && (w25_read_sr1() & SR1_BUSY)) {
+    if (w25_async_suspend_enable &&
+        (address >= w25_async_op_addr + w25_async_op_len || address + len <= w25_async_op_addr)) {
+      suspended = w25_suspend(); // 0 - память не приняла Suspend и операция завершилась
+      if (suspended) w25_async_stats.suspends++;
+      else           w25_async_stats.waits++;
+    } else {
+      w25_wait_busy(); // Чтение изменяемой области или приостановка запрещена
+      w25_async_stats.waits++;
+    }
+  }
+
+  w25_read(address, buf, len);
+
+  if (suspended) {
+    w25_resume();
+    w25_async_bg_resumed = DWT->CYCCNT;
+  }
+
+  w25_async_hold = 0;
+
+  cycles = DWT->CYCCNT - start;
+  w25_async_stats.reads++;
+  if (cycles > w25_async_stats.read_max_cycles) w25_async_stats.read_max_cycles = cycles;
+
+  return suspended;
+}
+
+/**
+ * @brief Проверка простоя движка.
+ *
+ * @return uint8_t 1 - очередь пуста и операций движка (в том числе фонового стирания) не выполняется, 0 - движок занят.
+ */
+uint8_t w25_async_idle(void) {
+  return w25_async_head == w25_async_tail && !w25_async_bg;
+}
+
+/**
+ * @brief Настройка TIM7 для периодического вызова w25_async_poll().
+ *
+ * TIM7 тактируется от APB1 x2 = 84 МГц:
+ * - PSC = 84 - 1  -> 1 МГц;
+ * - ARR = 1000 - 1 -> прерывание с частотой 1 кГц.
+ * Прерывание имеет низший приоритет, чтобы не задерживать обработчики АЦП, DMA и USART.
+ */
+void w25_async_timer_init(void) {
+  RCC->APB1ENR |= RCC_APB1ENR_TIM7EN;    // Включение тактирования TIM7
+
+  TIM7->PSC   = 84 - 1;                  // Частота счёта 1 МГц
+  TIM7->ARR   = 1000 - 1;                // Период 1 мс
+  TIM7->DIER |= TIM_DIER_UIE;            // Прерывание по переполнению
+
+  NVIC_SetPriority(TIM7_IRQn, 15);       // Низший приоритет
+  NVIC_EnableIRQ(TIM7_IRQn);             // Разрешение прерывания TIM7
+
+  TIM7->CR1  |= TIM_CR1_CEN;             // Запуск таймера
+}
+
+/**
+ * @brief Обработчик прерывания TIM7: шаг движка стирания/программирования.
+ */
+void TIM7_IRQHandler(void) {
+  TIM7->SR &= ~(TIM_SR_UIF); // Сброс флага прерывания
+
+  w25_async_poll();
+}
@@ -0,0 +1,200 @@
+/**
+------------------------------------------------------------------------------------------------------------------------------
+ * @file        : w25_cache.c
+ * @brief       : Кэш чтения памяти W25Q64 в CCM RAM.
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ * @Description : Полностью ассоциативный кэш с вытеснением по давности использования (LRU).
+ *                - w25_cache_read() разбивает запрос по строкам; найденная строка копируется из CCM RAM,
+ *                  при промахе строка считывается w25_read() через DMA во вспомогательный буфер в SRAM
+ *                  и копируется на место самой давно использованной строки.
+ *                - w25_cache_program()/w25_cache_erase() вызываются драйвером после запуска программирования/стирания
+ *                  и повторяют действие памяти над закэшированными строками (сквозная запись).
+ *                Кэш используется из основного цикла. Движок w25_async обновляет строки из прерывания TIM7,
+ *                поэтому чтение через кэш выполняется только при свободном движке (w25_async_idle()).
+ -------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#include <string.h>
+#include "w25_cache.h"
+
+#ifdef W25_CACHE_ENABLE
+
+// Описание строки кэша
+typedef struct {
+  uint32_t tag;   // Номер строки в памяти W25Q64 (адрес / W25_CACHE_LINE)
+  uint32_t stamp; // Время последнего обращения (для LRU)
+  uint8_t  valid; // Строка содержит данные
+} w25_cache_tag_t;
+
+w25_cache_stats_t w25_cache_stats;
+
+static w25_cache_tag_t w25_cache_tags[W25_CACHE_WAYS];
+static uint32_t        w25_cache_clock; // Счётчик обращений
+
+// Данные строк - в CCM RAM, без инициализации при старте (действительность определяется w25_cache_tags)
+static uint8_t w25_cache_data[W25_CACHE_WAYS][W25_CACHE_LINE] __attribute__((section(".CCM_RAM1.non_init")));
+
+// Буфер заполнения строки - в SRAM, доступной для DMA
+static uint8_t w25_cache_fill_buf[W25_CACHE_LINE] __attribute__((section(".RAM1.non_init")));
+
+/**
+ * @brief Сброс кэша и счётчиков.
+ */
+void w25_cache_init(void) {
+  memset(w25_cache_tags, 0, sizeof(w25_cache_tags));
+  memset(&w25_cache_stats, 0, sizeof(w25_cache_stats));
+  w25_cache_clock = 0;
+}
+
+/**
+ * @brief Поиск строки в кэше.
+ *
+ * @param tag Номер строки в памяти W25Q64.
+ * @return int Индекс строки или -1, если строка не закэширована.
+ */
+static int w25_cache_find(uint32_t tag) {
+  for (int i = 0; i < W25_CACHE_WAYS; i++) {
+    if (w25_cache_tags[i].valid && w25_cache_tags[i].tag == tag) return i;
+  }
+  return -1;
+}
+
+/**
+ * @brief Заполнение строки при промахе.
+ *
+ * Выбирается свободная строка, а если свободных нет - самая давно использованная.
+ *
+ * @param tag Номер строки в памяти W25Q64.
+ * @return int Индекс заполненной строки.
+ */
+static int w25_cache_fill(uint32_t tag) {
+  int victim = 0;
+
+  for (int i = 0; i < W25_CACHE_WAYS; i++) {
+    if (!w25_cache_tags[i].valid) { victim = i; break; }
+    if (w25_cache_tags[i].stamp < w25_cache_tags[victim].stamp) victim = i;
+  }
+
+  if (w25_cache_tags[victim].valid) w25_cache_stats.evictions++;
+
+  w25_read(tag * W25_CACHE_LINE, w25_cache_fill_buf, W25_CACHE_LINE); // DMA в SRAM
+  memcpy(w25_cache_data[victim], w25_cache_fill_buf, W25_CACHE_LINE);  // Копирование в CCM RAM
+
+  w25_cache_tags[victim].tag   = tag;
+  w25_cache_tags[victim].valid = 1;
+
+  return victim;
+}
+
+/**
+ * @brief Чтение данных через кэш.
+ *
+ * Чтения длиннее W25_CACHE_BYPASS выполняются напрямую w25_read(), чтобы не вытеснять
+ * часто используемые строки однократно читаемым блоком.
+ *
+ * @param address Начальный адрес в памяти W25Q64.
+ * @param buf     Буфер для считанных данных.
+ * @param len     Количество байт для чтения.
+ */
+void w25_cache_read(uint32_t address, uint8_t *buf, uint32_t len) {
+  uint32_t offset, chunk;
+  int      line;
+
+  if (len > W25_CACHE_BYPASS) {
+    w25_cache_stats.bypass++;
+    w25_read(address, buf, len);
+    return;
+  }
+
+  while (len) {
+    offset = address % W25_CACHE_LINE;
+    chunk  = W25_CACHE_LINE - offset; // Остаток до конца строки
+    if (chunk > len) chunk = len;
+
+    line = w25_cache_find(address / W25_CACHE_LINE);
+    if (line >= 0) {
+      w25_cache_stats.hits++;
+    } else {
+      w25_cache_stats.misses++;
+      line = w25_cache_fill(address / W25_CACHE_LINE);
+    }
+    w25_cache_tags[line].stamp = ++w25_cache_clock;
+
+    memcpy(buf, &w25_cache_data[line][offset], chunk);
+
+    address += chunk;
+    buf     += chunk;
+    len     -= chunk;
+  }
+}
+
+/**
+ * @brief Обновление закэшированных строк после запуска программирования.
+ *
+ * Программирование может только сбрасывать биты, поэтому новое значение байта - (старое & записываемое).
+ *
+ * @param address Начальный адрес в памяти W25Q64.
+ * @param buf     Записанные данные.
+ * @param len     Количество байт.
+ */
+void w25_cache_program(uint32_t address, const uint8_t *buf, uint32_t len) {
+  uint32_t offset, chunk;
+  int      line;
+
+  while (len) {
+    offset = address % W25_CACHE_LINE;
+    chunk  = W25_CACHE_LINE - offset;
+    if (chunk > len) chunk = len;
+
+    line = w25_cache_find(address / W25_CACHE_LINE);
+    if (line >= 0) {
+      for (uint32_t i = 0; i < chunk; i++) w25_cache_data[line][offset + i] &= buf[i];
+    }
+
+    address += chunk;
+    buf     += chunk;
+    len     -= chunk;
+  }
+}
+
+/**
+ * @brief Обновление закэшированных строк после запуска стирания сектора 4 КБ.
+ *
+ * @param address Любой адрес внутри стираемого сектора.
+ */
+void w25_cache_erase(uint32_t address) {
+  uint32_t base = address & ~(W25_SECTOR_SIZE - 1UL);
+
+  for (int i = 0; i < W25_CACHE_WAYS; i++) {
+    if (w25_cache_tags[i].valid && (w25_cache_tags[i].tag * W25_CACHE_LINE & ~(W25_SECTOR_SIZE - 1UL)) == base) {
+      memset(w25_cache_data[i], 0xFF, W25_CACHE_LINE); // Строка лежит внутри сектора (W25_CACHE_LINE <= 4 КБ)
+    }
+  }
+}
+
+/**
+ * @brief Признание недействительными строк, пересекающих диапазон.
+ *
+ * Используется, если память изменена в обход драйвера (например, другим устройством на шине).
+ *
+ * @param address Начальный адрес диапазона.
+ * @param len     Длина диапазона, байт.
+ */
+void w25_cache_invalidate(uint32_t address, uint32_t len) {
+  uint32_t first, last;
+
+  if (len == 0) return;
+
+  first = address / W25_CACHE_LINE;
+  last  = (address + len - 1) / W25_CACHE_LINE;
+
+  for (int i = 0; i < W25_CACHE_WAYS; i++) {
+    if (w25_cache_tags[i].tag >= first && w25_cache_tags[i].tag <= last) w25_cache_tags[i].valid = 0;
+  }
+}
+
+#endif // W25_CACHE_ENABLE
@@ -0,0 +1,86 @@
+/**
+------------------------------------------------------------------------------------------------------------------------------
+ * @file        : w25_crc.c
+ * @brief       : Вычисление CRC-32 аппаратным блоком CRC STM32F4.
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ * @Description : Блок CRC обрабатывает слово за 4 такта AHB, вычисление 256 байт занимает около 70 тактов ядра
+ *                против нескольких тысяч при программном табличном методе.
+ *                - Блок хранит только текущее значение CRC (регистр DR), записать в DR произвольное состояние нельзя:
+ *                  запись слова W изменяет состояние S на F(S ^ W), где F - 32 шага сдвига с полиномом.
+ *                  Чтобы продолжить вычисление со значения crc, после сброса (S = 0xFFFFFFFF) записывается
+ *                  слово W = F^-1(crc) ^ 0xFFFFFFFF, где F^-1 - те же 32 шага в обратную сторону (w25_crc_unshift()).
+ *                - Начало вычисления (crc = W25_CRC_INIT) выполняется одним сбросом без обратного преобразования.
+ *                Тактирование блока CRC включается в spi2_init().
+ -------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#include "w25_crc.h"
+
+#define W25_CRC_POLY 0x04C11DB7UL // Полином блока CRC
+
+/**
+ * @brief Обратное преобразование для 32 шагов сдвига блока CRC.
+ *
+ * Шаг блока: S = (S << 1) ^ (старший бит ? POLY : 0). Младший бит POLY равен 1, поэтому младший бит
+ * результата шага показывает, был ли сложен полином, и шаг однозначно обращается.
+ *
+ * @param crc Состояние после 32 шагов.
+ * @return uint32_t Состояние до 32 шагов.
+ */
+static uint32_t w25_crc_unshift(uint32_t crc) {
+  for (uint8_t i = 0; i < 32; i++) {
+    crc = (crc & 1) ? ((crc ^ W25_CRC_POLY) >> 1) | 0x80000000UL : crc >> 1;
+  }
+  return crc;
+}
+
+/**
+ * @brief Вычисление CRC-32 блоком CRC.
+ *
+ * Байты объединяются в слова little-endian, неполное последнее слово дополняется нулями.
+ * Вычисление можно продолжать по частям, кратным 4 байтам:
+ * w25_crc32(w25_crc32(W25_CRC_INIT, a, 8), b, m) равно CRC блока a + b.
+ *
+ * @param crc Результат для предыдущей части данных (W25_CRC_INIT - начало вычисления).
+ * @param buf Данные.
+ * @param len Количество байт.
+ * @return uint32_t Значение CRC-32.
+ */
+uint32_t w25_crc32(uint32_t crc, const uint8_t *buf, uint32_t len) {
+  uint32_t seed, primask, chunk, word;
+
+  while (len) {
+    chunk = (len > W25_CRC_BLOCK) ? W25_CRC_BLOCK : len;
+    seed  = (crc == W25_CRC_INIT) ? 0 : w25_crc_unshift(crc) ^ 0xFFFFFFFFUL; // Вне запрета прерываний
+
+    primask = __get_PRIMASK();
+    __disable_irq();                           // Блок может использоваться прерыванием (w25_log)
+
+    CRC->CR = CRC_CR_RESET;                    // Состояние 0xFFFFFFFF
+    if (crc != W25_CRC_INIT) CRC->DR = seed;   // Состояние crc
+
+    len -= chunk;
+    while (chunk >= 4) {
+      word = __UNALIGNED_UINT32_READ(buf);     // Little-endian, допускается невыровненный адрес
+      CRC->DR = word;
+      buf   += 4;
+      chunk -= 4;
+    }
+    if (chunk) {
+      word = 0;
+      for (uint8_t i = 0; i < chunk; i++) word |= (uint32_t)buf[i] << (8 * i);
+      CRC->DR = word;                          // Последнее слово, дополненное нулями
+      buf += chunk;
+    }
+
+    crc = CRC->DR;
+
+    __set_PRIMASK(primask);
+  }
+
+  return crc;
+}
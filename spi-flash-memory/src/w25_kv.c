@@ -0,0 +1,350 @@
+/**
+------------------------------------------------------------------------------------------------------------------------------
+ * @file        : w25_kv.c
+ * @brief       : Хранилище «ключ-значение» с выравниванием износа в памяти W25Q64.
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ * @Description : Журнал записей в кольце секторов (формат описан в w25_kv.h).
+ *                - Запись добавляется в два шага: сначала данные, затем заголовок. При пропадании питания
+ *                  заголовок остаётся стёртым (запись не видна) либо не проходит проверку CRC.
+ *                - При монтировании сектора просматриваются в порядке seq, более поздняя запись ключа заменяет
+ *                  более раннюю. Если после последней записи область не стёрта, сектор закрывается для записи.
+ *                - Сектор без заголовка, содержащий данные (прерванное стирание), стирается при монтировании.
+ *                - Если за активным сектором нет стёртого (прервана сборка мусора), перенос повторяется:
+ *                  до стирания старого сектора в новый пишутся только копии, поэтому новый сектор можно стереть.
+ -------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#include <string.h>
+#include "w25_kv.h"
+#include "w25_crc.h"
+
+#define W25_KV_NONE     0xFFFFFFFFUL                                         // Ключ отсутствует
+#define W25_KV_SECT(s)  (W25_KV_BASE + (uint32_t)(s) * W25_SECTOR_SIZE)      // Адрес сектора s
+#define W25_KV_NEXT(s)  (((s) + 1) % W25_KV_SECTORS)                         // Следующий сектор кольца
+
+w25_kv_stats_t w25_kv_stats;
+
+static uint32_t w25_kv_index[W25_KV_KEYS];   // Адрес последней записи ключа
+static uint8_t  w25_kv_len[W25_KV_KEYS];     // Длина значения последней записи
+static uint32_t w25_kv_seq[W25_KV_SECTORS];  // Номер поколения сектора (0 - сектор стёрт)
+static uint8_t  w25_kv_active;               // Активный сектор
+static uint32_t w25_kv_wr;                   // Смещение свободного места в активном секторе
+static uint8_t  w25_kv_buf[W25_KV_REC_MAX];  // Буфер записи
+
+/**
+ * @brief CRC-32 записи: ключ, длина и данные (поле crc не входит).
+ *
+ * @param rec Запись в буфере (заголовок + данные).
+ * @param len Длина данных.
+ * @return uint32_t Значение CRC-32.
+ */
+static uint32_t w25_kv_crc(const uint8_t *rec, uint16_t len) {
+  return w25_crc32(w25_crc32(W25_CRC_INIT, rec, 4), &rec[W25_KV_HDR_SIZE], len);
+}
+
+/**
+ * @brief Чтение и проверка записи по адресу в буфер w25_kv_buf.
+ *
+ * @param address Адрес записи.
+ * @param len     Длина данных из индекса.
+ * @return uint8_t 1 - CRC верна.
+ */
+static uint8_t w25_kv_load(uint32_t address, uint16_t len) {
+  uint32_t crc;
+
+  w25_read(address, w25_kv_buf, W25_KV_HDR_SIZE + len);
+  memcpy(&crc, &w25_kv_buf[4], 4);
+
+  return crc == w25_kv_crc(w25_kv_buf, len);
+}
+
+/**
+ * @brief Проверка, что участок памяти стёрт (все байты 0xFF).
+ *
+ * @param address Начальный адрес.
+ * @param len     Длина участка.
+ * @return uint8_t 1 - участок стёрт.
+ */
+static uint8_t w25_kv_blank(uint32_t address, uint32_t len) {
+  uint32_t chunk;
+
+  while (len) {
+    chunk = (len > sizeof(w25_kv_buf)) ? sizeof(w25_kv_buf) : len;
+    w25_read(address, w25_kv_buf, chunk);
+    for (uint32_t i = 0; i < chunk; i++) {
+      if (w25_kv_buf[i] != 0xFF) return 0;
+    }
+    address += chunk;
+    len     -= chunk;
+  }
+
+  return 1;
+}
+
+/**
+ * @brief Программирование записи из w25_kv_buf в активный сектор и обновление индекса.
+ *
+ * Данные программируются раньше заголовка, поэтому запись становится видимой только целиком.
+ */
+static void w25_kv_put(void) {
+  uint16_t key, len;
+  uint32_t address = W25_KV_SECT(w25_kv_active) + w25_kv_wr;
+
+  memcpy(&key, &w25_kv_buf[0], 2);
+  memcpy(&len, &w25_kv_buf[2], 2);
+
+  if (len) w25_write(address + W25_KV_HDR_SIZE, &w25_kv_buf[W25_KV_HDR_SIZE], len); // Данные
+  w25_write(address, w25_kv_buf, W25_KV_HDR_SIZE);                                   // Заголовок
+
+  w25_kv_wr += W25_KV_REC_SIZE(len);
+
+  if (len && w25_kv_index[key] == W25_KV_NONE) w25_kv_stats.live++;
+  if (!len && w25_kv_index[key] != W25_KV_NONE) w25_kv_stats.live--;
+  w25_kv_index[key] = len ? address : W25_KV_NONE;
+  w25_kv_len[key]   = (uint8_t)len;
+}
+
+/**
+ * @brief Перенос живых записей сектора s в активный сектор и стирание сектора s.
+ *
+ * Переносятся все живые записи, в том числе ключа, который записывается после переноса: до программирования
+ * нового значения старое должно оставаться в памяти. Новая запись добавляется позже в тот же сектор
+ * и при монтировании заменяет копию.
+ *
+ * @param s Номер сектора.
+ */
+static void w25_kv_collect(uint8_t s) {
+  uint32_t base = W25_KV_SECT(s);
+
+  for (uint16_t key = 0; key < W25_KV_KEYS; key++) {
+    if (w25_kv_index[key] == W25_KV_NONE) continue;
+    if (w25_kv_index[key] < base || w25_kv_index[key] >= base + W25_SECTOR_SIZE) continue;
+
+    if (w25_kv_load(w25_kv_index[key], w25_kv_len[key])) {
+      w25_kv_put(); // Копия с тем же заголовком и CRC
+    } else {
+      w25_kv_index[key] = W25_KV_NONE; // Значение повреждено после монтирования
+      w25_kv_stats.live--;
+      w25_kv_stats.crc_errors++;
+    }
+  }
+
+  w25_erase_sector(base);
+  w25_kv_seq[s] = 0;
+  w25_kv_stats.gc_runs++;
+  w25_kv_stats.erases++;
+}
+
+/**
+ * @brief Разметка стёртого сектора s как нового активного.
+ *
+ * @param s   Номер сектора.
+ * @param seq Номер поколения.
+ */
+static void w25_kv_open(uint8_t s, uint32_t seq) {
+  uint32_t magic = W25_KV_MAGIC;
+
+  memcpy(&w25_kv_buf[0], &magic, 4);
+  memcpy(&w25_kv_buf[4], &seq, 4);
+  w25_write(W25_KV_SECT(s), w25_kv_buf, W25_KV_HDR_SIZE);
+  w25_kv_seq[s]       = seq;
+  w25_kv_active       = s;
+  w25_kv_wr           = W25_KV_HDR_SIZE;
+  w25_kv_stats.active = s;
+}
+
+/**
+ * @brief Переход на следующий (стёртый) сектор и сборка мусора в самом старом секторе.
+ */
+static void w25_kv_rotate(void) {
+  uint8_t next = W25_KV_NEXT(w25_kv_active);
+
+  w25_kv_open(next, w25_kv_seq[w25_kv_active] + 1);
+
+  next = W25_KV_NEXT(next); // Самый старый сектор
+  if (w25_kv_seq[next]) w25_kv_collect(next);
+}
+
+/**
+ * @brief Просмотр записей сектора и обновление индекса.
+ *
+ * @param s Номер сектора.
+ * @return uint32_t Смещение первого свободного байта (W25_SECTOR_SIZE - сектор заполнен или повреждён).
+ */
+static uint32_t w25_kv_scan(uint8_t s) {
+  uint32_t base = W25_KV_SECT(s);
+  uint32_t off  = W25_KV_HDR_SIZE;
+  uint32_t crc, chunk;
+  uint16_t key, len;
+
+  while (off + W25_KV_HDR_SIZE <= W25_SECTOR_SIZE) {
+    chunk = W25_SECTOR_SIZE - off;
+    if (chunk > W25_KV_REC_MAX) chunk = W25_KV_REC_MAX;
+    w25_read(base + off, w25_kv_buf, chunk); // Заголовок и данные одной командой
+
+    memcpy(&key, &w25_kv_buf[0], 2);
+    memcpy(&len, &w25_kv_buf[2], 2);
+    memcpy(&crc, &w25_kv_buf[4], 4);
+
+    if (key == 0xFFFF && len == 0xFFFF) break; // Свободное место
+
+    if (key >= W25_KV_KEYS || len > W25_KV_MAX_LEN || off + W25_KV_REC_SIZE(len) > W25_SECTOR_SIZE) {
+      w25_kv_stats.crc_errors++; // Повреждённый заголовок - дальнейшее содержимое сектора не используется
+      return W25_SECTOR_SIZE;
+    }
+
+    if (crc == w25_kv_crc(w25_kv_buf, len)) {
+      if (len && w25_kv_index[key] == W25_KV_NONE) w25_kv_stats.live++;
+      if (!len && w25_kv_index[key] != W25_KV_NONE) w25_kv_stats.live--;
+      w25_kv_index[key] = len ? base + off : W25_KV_NONE;
+      w25_kv_len[key]   = (uint8_t)len;
+      w25_kv_stats.records++;
+    } else {
+      w25_kv_stats.crc_errors++;
+    }
+
+    off += W25_KV_REC_SIZE(len);
+  }
+
+  return off;
+}
+
+/**
+ * @brief Монтирование хранилища: построение индекса по содержимому области.
+ *
+ * 1. Чтение заголовков секторов; сектор без заголовка, содержащий данные, стирается.
+ * 2. Пустая область размечается: сектор 0 становится активным.
+ * 3. Сектора просматриваются в порядке возрастания seq, последний - активный.
+ * 4. Если за свободным местом активного сектора есть данные, сектор закрывается для записи.
+ * 5. Если сектор за активным не стёрт (прервана сборка мусора), перенос выполняется повторно.
+ *
+ * @return uint8_t 1 - хранилище готово к работе.
+ */
+uint8_t w25_kv_mount(void) {
+  uint32_t start, hdr[2], last = 0, seq;
+  uint8_t  s, found = 0;
+
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; // Включение счётчика тактов DWT
+  DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+  start = DWT->CYCCNT;
+
+  memset(&w25_kv_stats, 0, sizeof(w25_kv_stats));
+  for (uint16_t key = 0; key < W25_KV_KEYS; key++) w25_kv_index[key] = W25_KV_NONE;
+
+  for (s = 0; s < W25_KV_SECTORS; s++) {
+    w25_read(W25_KV_SECT(s), w25_kv_buf, W25_KV_HDR_SIZE);
+    memcpy(hdr, w25_kv_buf, W25_KV_HDR_SIZE);
+    if (hdr[0] == W25_KV_MAGIC && hdr[1] != 0 && hdr[1] != 0xFFFFFFFF) {
+      w25_kv_seq[s] = hdr[1];
+      found = 1;
+    } else {
+      w25_kv_seq[s] = 0;
+      if (!w25_kv_blank(W25_KV_SECT(s), W25_SECTOR_SIZE)) { // Прерванное стирание или чужие данные
+        w25_erase_sector(W25_KV_SECT(s));
+        w25_kv_stats.erases++;
+      }
+    }
+  }
+
+  if (!found) {
+    w25_kv_open(0, 1); // Пустая область
+  } else {
+    while (1) { // Сектора в порядке возрастания seq
+      seq = 0xFFFFFFFF;
+      for (uint8_t i = 0; i < W25_KV_SECTORS; i++) {
+        if (w25_kv_seq[i] > last && w25_kv_seq[i] < seq) { seq = w25_kv_seq[i]; s = i; }
+      }
+      if (seq == 0xFFFFFFFF) break;
+      last          = seq;
+      w25_kv_active = s;
+      w25_kv_wr     = w25_kv_scan(s);
+    }
+    w25_kv_stats.active = w25_kv_active;
+
+    // Свободное место активного сектора должно быть стёрто на длину максимальной записи
+    if (w25_kv_wr < W25_SECTOR_SIZE) {
+      uint32_t tail = W25_SECTOR_SIZE - w25_kv_wr;
+      if (tail > W25_KV_REC_MAX) tail = W25_KV_REC_MAX;
+      if (!w25_kv_blank(W25_KV_SECT(w25_kv_active) + w25_kv_wr, tail)) w25_kv_wr = W25_SECTOR_SIZE;
+    }
+
+    s = W25_KV_NEXT(w25_kv_active);
+    if (w25_kv_seq[s]) { // Прервана сборка мусора: активный сектор содержит только копии записей сектора s
+      if (w25_kv_wr == W25_SECTOR_SIZE) { // Копирование оборвано на середине записи - перенос заново
+        seq = w25_kv_seq[w25_kv_active];
+        w25_erase_sector(W25_KV_SECT(w25_kv_active));
+        w25_kv_open(w25_kv_active, seq);
+        return w25_kv_mount();
+      }
+      w25_kv_collect(s);
+    }
+  }
+
+  w25_kv_stats.mount_cycles = DWT->CYCCNT - start;
+
+  return 1;
+}
+
+/**
+ * @brief Запись значения ключа.
+ *
+ * @param key   Ключ (0 .. W25_KV_KEYS - 1).
+ * @param value Значение.
+ * @param len   Длина значения (0 - удаление, не более W25_KV_MAX_LEN).
+ * @return uint8_t 1 - значение записано, 0 - неверный ключ или длина.
+ */
+uint8_t w25_kv_set(uint16_t key, const void *value, uint16_t len) {
+  uint32_t crc;
+
+  if (key >= W25_KV_KEYS || len > W25_KV_MAX_LEN) return 0;
+
+  if (w25_kv_wr + W25_KV_REC_SIZE(len) > W25_SECTOR_SIZE) w25_kv_rotate(); // Место для записи есть: см. W25_KV_KEYS в w25_kv.h
+
+  memcpy(&w25_kv_buf[0], &key, 2);
+  memcpy(&w25_kv_buf[2], &len, 2);
+  if (len) memcpy(&w25_kv_buf[W25_KV_HDR_SIZE], value, len);
+  crc = w25_kv_crc(w25_kv_buf, len);
+  memcpy(&w25_kv_buf[4], &crc, 4);
+
+  w25_kv_put();
+
+  return 1;
+}
+
+/**
+ * @brief Чтение значения ключа.
+ *
+ * @param key  Ключ.
+ * @param buf  Буфер для значения.
+ * @param size Размер буфера (копируется не более size байт).
+ * @return int16_t Длина значения, -1 - ключ отсутствует или запись повреждена.
+ */
+int16_t w25_kv_get(uint16_t key, void *buf, uint16_t size) {
+  uint16_t len;
+
+  if (key >= W25_KV_KEYS || w25_kv_index[key] == W25_KV_NONE) return -1;
+
+  len = w25_kv_len[key];
+  if (!w25_kv_load(w25_kv_index[key], len)) return -1;
+
+  memcpy(buf, &w25_kv_buf[W25_KV_HDR_SIZE], (len < size) ? len : size);
+
+  return (int16_t)len;
+}
+
+/**
+ * @brief Удаление ключа (запись с нулевой длиной).
+ *
+ * @param key Ключ.
+ * @return uint8_t 1 - ключ удалён или отсутствовал.
+ */
+uint8_t w25_kv_delete(uint16_t key) {
+  if (key >= W25_KV_KEYS) return 0;
+  if (w25_kv_index[key] == W25_KV_NONE) return 1;
+
+  return w25_kv_set(key, 0, 0);
+}
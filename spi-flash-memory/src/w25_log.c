@@ -0,0 +1,403 @@
+/**
+------------------------------------------------------------------------------------------------------------------------------
+ * @file        : w25_log.c
+ * @brief       : Кольцевой журнал измерений в памяти W25Q64.
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ * @Description : Страница журнала: { seq (4), W25_LOG_MAGIC (2), used (2), crc (4) } + данные.
+ *                CRC-32 вычисляется блоком CRC (w25_crc.c) по всей области данных (с заполнением 0xFF) и первым 8 байтам
+ *                заголовка при закрытии страницы: 63 слова - около 300 тактов, поэтому w25_log_push() только копирует
+ *                запись, а закрытие страницы в прерывании занимает постоянное время.
+ *                Буферы страниц заполняются и программируются по кольцу:
+ *                FREE -> FILL (добавление записей) -> READY (ожидает места в очереди w25_async) -> QUEUED -> FREE.
+ *                Состояние буферов изменяется при запрещённых прерываниях: w25_log_push() вызывается из прерывания DMA,
+ *                а освобождение буферов - из callback-функции движка (прерывание TIM7).
+ *                Монтирование (w25_log_mount()) выполняется до запуска движка и до первой записи:
+ *                1. Чтение заголовка первой страницы каждого сектора - сектор с наибольшим seq содержит голову журнала.
+ *                2. Просмотр страниц этого сектора - голова следует за последней страницей с признаком журнала.
+ *                3. Если остаток сектора не стёрт (прервано программирование), запись начинается со следующего сектора.
+ *                   Номер seq увеличивается на количество пропущенных страниц: адрес страницы всегда однозначно
+ *                   определяется её номером (seq 1 - первая страница области), что использует w25_log_read().
+ *                4. Блок 64 КБ, следующий за головой, стирается, если он не стёрт. Если голова - начало блока, проверяется
+ *                   и стирается весь блок головы, если начало сектора - сектор головы.
+ *                Стирание опережает запись на блок 64 КБ: при записи первой страницы блока в очередь движка ставится
+ *                фоновое стирание следующего блока (w25_async_erase_block()), страницы программируются в приостановке
+ *                стирания. Блок стирается не дольше tBE = 2 с, а заполняется потоком 12 КБ/с за 5 с - запись успевает
+ *                и при наибольшем времени стирания. Сектор 4 КБ (tSE до 400 мс) заполнялся бы за 330 мс.
+ -------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#include <string.h>
+#include "w25_log.h"
+#include "w25_async.h"
+#include "w25_crc.h"
+
+#define W25_LOG_END   (W25_LOG_BASE + W25_LOG_SECTORS * W25_SECTOR_SIZE) // Конец области
+#define W25_LOG_PAGES (W25_LOG_SECTORS * (W25_SECTOR_SIZE / W25_PAGE_SIZE)) // Количество страниц области
+
+#if (W25_LOG_BASE % W25_BLOCK_SIZE) || (W25_LOG_SECTORS % (W25_BLOCK_SIZE / W25_SECTOR_SIZE))
+#error "W25_LOG_BASE and W25_LOG_SECTORS must be 64 KB block aligned"
+#endif
+
+// Состояния буфера страницы
+#define W25_LOG_FREE   0
+#define W25_LOG_FILL   1
+#define W25_LOG_READY  2
+#define W25_LOG_QUEUED 3
+
+// Буфер страницы
+typedef struct {
+  uint8_t  data[W25_PAGE_SIZE]; // Образ страницы
+  uint32_t address;             // Адрес страницы в памяти W25Q64
+  uint16_t used;                // Заполнено байт данных
+  uint8_t  state;               // Состояние буфера
+} w25_log_buf_t;
+
+w25_log_stats_t w25_log_stats;
+
+// Буферы - в SRAM, доступной для DMA (программирование страницы выполняется через DMA1 Stream4)
+static w25_log_buf_t w25_log_bufs[W25_LOG_BUFS] __attribute__((section(".RAM1.non_init")));
+
+static uint8_t  w25_log_fill;      // Буфер, заполняемый w25_log_push()
+static uint8_t  w25_log_send;      // Следующий буфер для постановки в очередь движка
+static uint32_t w25_log_head;      // Адрес следующей страницы журнала
+static uint32_t w25_log_next_seq;  // Номер seq следующей страницы
+static uint32_t w25_log_erased;    // Сектор, стирание которого уже поставлено в очередь
+static uint8_t  w25_log_hdr[W25_LOG_HDR_SIZE]; // Буфер заголовка при монтировании
+
+/**
+ * @brief Адрес страницы, следующей за address (с переходом в начало области).
+ */
+static uint32_t w25_log_next_page(uint32_t address) {
+  address += W25_PAGE_SIZE;
+  return (address >= W25_LOG_END) ? W25_LOG_BASE : address;
+}
+
+/**
+ * @brief Адрес сектора, следующего за сектором, содержащим address.
+ */
+static uint32_t w25_log_next_sector(uint32_t address) {
+  address = (address & ~(W25_SECTOR_SIZE - 1UL)) + W25_SECTOR_SIZE;
+  return (address >= W25_LOG_END) ? W25_LOG_BASE : address;
+}
+
+/**
+ * @brief Адрес блока 64 КБ, следующего за блоком, содержащим address.
+ */
+static uint32_t w25_log_next_block(uint32_t address) {
+  address = (address & ~(W25_BLOCK_SIZE - 1UL)) + W25_BLOCK_SIZE;
+  return (address >= W25_LOG_END) ? W25_LOG_BASE : address;
+}
+
+/**
+ * @brief Количество занятых буферов (для статистики).
+ */
+static uint8_t w25_log_pending(void) {
+  uint8_t n = 0;
+
+  for (uint8_t i = 0; i < W25_LOG_BUFS; i++) {
+    if (w25_log_bufs[i].state != W25_LOG_FREE) n++;
+  }
+  return n;
+}
+
+/**
+ * @brief Чтение заголовка страницы.
+ *
+ * @param address Адрес страницы.
+ * @param seq     Номер seq страницы.
+ * @return uint8_t 1 - страница содержит признак журнала.
+ */
+static uint8_t w25_log_header(uint32_t address, uint32_t *seq) {
+  uint16_t magic;
+
+  w25_read(address, w25_log_hdr, W25_LOG_HDR_SIZE);
+  memcpy(seq, &w25_log_hdr[0], 4);
+  memcpy(&magic, &w25_log_hdr[4], 2);
+
+  return magic == W25_LOG_MAGIC && *seq != 0xFFFFFFFF;
+}
+
+/**
+ * @brief Проверка, что участок памяти стёрт (все байты 0xFF).
+ *
+ * Для чтения используется свободный буфер страницы.
+ */
+static uint8_t w25_log_blank(uint32_t address, uint32_t len) {
+  uint8_t *buf = w25_log_bufs[0].data;
+
+  while (len) {
+    w25_read(address, buf, W25_PAGE_SIZE);
+    for (uint32_t i = 0; i < W25_PAGE_SIZE; i++) {
+      if (buf[i] != 0xFF) return 0;
+    }
+    address += W25_PAGE_SIZE;
+    len     -= W25_PAGE_SIZE;
+  }
+
+  return 1;
+}
+
+/**
+ * @brief Стирание сектора при монтировании, если он не стёрт.
+ */
+static void w25_log_prepare(uint32_t sector) {
+  if (!w25_log_blank(sector, W25_SECTOR_SIZE)) {
+    w25_erase_sector(sector);
+    w25_log_stats.erases++;
+  }
+}
+
+/**
+ * @brief Стирание блока 64 КБ при монтировании, если он не стёрт.
+ */
+static void w25_log_prepare_block(uint32_t block) {
+  if (!w25_log_blank(block, W25_BLOCK_SIZE)) {
+    w25_erase_block(block);
+    w25_log_stats.erases++;
+  }
+}
+
+static void w25_log_callback(uint8_t op, uint32_t address);
+
+/**
+ * @brief Постановка готовых страниц в очередь движка (вызывается при запрещённых прерываниях).
+ *
+ * Перед первой страницей блока в очередь ставится фоновое стирание следующего блока. Если очередь
+ * движка заполнена, страница остаётся в состоянии READY до следующего вызова.
+ */
+static void w25_log_submit(void) {
+  w25_log_buf_t *b;
+  uint32_t       next;
+
+  while (w25_log_bufs[w25_log_send].state == W25_LOG_READY) {
+    b = &w25_log_bufs[w25_log_send];
+
+    if ((b->address & (W25_BLOCK_SIZE - 1)) == 0) { // Первая страница блока
+      next = w25_log_next_block(b->address);
+      if (w25_log_erased != next) {
+        if (!w25_async_erase_block(next, w25_log_callback)) return;
+        w25_log_erased = next;
+      }
+    }
+
+    if (!w25_async_program(b->address, b->data, W25_PAGE_SIZE, w25_log_callback)) return;
+
+    b->state     = W25_LOG_QUEUED;
+    w25_log_send = (w25_log_send + 1) % W25_LOG_BUFS;
+  }
+}
+
+/**
+ * @brief Callback-функция движка: освобождение буфера записанной страницы.
+ */
+static void w25_log_callback(uint8_t op, uint32_t address) {
+  uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  if (op != W25_OP_PROGRAM) {
+    w25_log_stats.erases++;
+  } else {
+    for (uint8_t i = 0; i < W25_LOG_BUFS; i++) {
+      if (w25_log_bufs[i].state == W25_LOG_QUEUED && w25_log_bufs[i].address == address) {
+        w25_log_bufs[i].state = W25_LOG_FREE;
+        w25_log_stats.pages++;
+        break;
+      }
+    }
+  }
+  w25_log_submit();
+  __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Закрытие заполняемой страницы: заголовок, CRC, переход к следующему буферу.
+ */
+static void w25_log_close(void) {
+  w25_log_buf_t *b = &w25_log_bufs[w25_log_fill];
+  uint16_t       magic = W25_LOG_MAGIC;
+  uint32_t       crc;
+
+  memset(&b->data[W25_LOG_HDR_SIZE + b->used], 0xFF, W25_LOG_PAYLOAD - b->used);
+  memcpy(&b->data[0], &w25_log_next_seq, 4);
+  memcpy(&b->data[4], &magic, 2);
+  memcpy(&b->data[6], &b->used, 2);
+  crc = w25_crc32(w25_crc32(W25_CRC_INIT, &b->data[W25_LOG_HDR_SIZE], W25_LOG_PAYLOAD), b->data, 8); // Данные, seq, magic, used
+  memcpy(&b->data[8], &crc, 4);
+
+  b->address = w25_log_head;
+  b->state   = W25_LOG_READY;
+
+  w25_log_head = w25_log_next_page(w25_log_head);
+  w25_log_next_seq++;
+  w25_log_fill = (w25_log_fill + 1) % W25_LOG_BUFS;
+
+  w25_log_submit();
+}
+
+/**
+ * @brief Монтирование журнала: поиск головы и подготовка стёртой области.
+ *
+ * @return uint8_t 1 - журнал готов к записи.
+ */
+uint8_t w25_log_mount(void) {
+  uint32_t start, sector, seq, rest, best = 0, head = W25_LOG_BASE, last = 0;
+  uint8_t  found = 0;
+
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; // Включение счётчика тактов DWT
+  DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+  start = DWT->CYCCNT;
+
+  memset(&w25_log_stats, 0, sizeof(w25_log_stats));
+  memset(w25_log_bufs, 0, sizeof(w25_log_bufs));
+  w25_log_fill = 0;
+  w25_log_send = 0;
+
+  // 1. Сектор с наибольшим seq первой страницы
+  for (sector = W25_LOG_BASE; sector < W25_LOG_END; sector += W25_SECTOR_SIZE) {
+    if (w25_log_header(sector, &seq) && (!found || seq > best)) {
+      best  = seq;
+      head  = sector;
+      found = 1;
+    }
+  }
+
+  if (found) {
+    // 2. Последняя страница сектора с признаком журнала и последовательным seq
+    sector = head;
+    last   = best;
+    for (uint32_t a = sector + W25_PAGE_SIZE; a < sector + W25_SECTOR_SIZE; a += W25_PAGE_SIZE) {
+      if (!w25_log_header(a, &seq) || seq != last + 1) break;
+      last = seq;
+      head = a;
+    }
+    head = w25_log_next_page(head);
+
+    w25_log_next_seq = last + 1;
+
+    // 3. Остаток сектора головы должен быть стёрт; пропущенные страницы сохраняют свои номера seq
+    rest = W25_SECTOR_SIZE - (head & (W25_SECTOR_SIZE - 1));
+    if (rest != W25_SECTOR_SIZE && !w25_log_blank(head, rest)) {
+      head = w25_log_next_sector(head);
+      w25_log_next_seq += rest / W25_PAGE_SIZE;
+    }
+  } else {
+    w25_log_next_seq = 1;
+  }
+
+  // 4. Блок или сектор головы (если запись начинается с его начала) и следующий блок стираются заранее
+  if ((head & (W25_BLOCK_SIZE - 1)) == 0)       w25_log_prepare_block(head);
+  else if ((head & (W25_SECTOR_SIZE - 1)) == 0) w25_log_prepare(head);
+  w25_log_prepare_block(w25_log_next_block(head));
+
+  w25_log_head   = head;
+  w25_log_erased = w25_log_next_block(head);
+
+  w25_log_stats.mount_cycles = DWT->CYCCNT - start;
+
+  return 1;
+}
+
+/**
+ * @brief Добавление записи в журнал.
+ *
+ * Запись не разбивается между страницами: если она не помещается в остаток текущей страницы,
+ * страница закрывается и запись начинает следующую. Страница закрывается сразу, как только в ней
+ * не остаётся места для ещё одной записи той же длины (поток записей одинакового размера). Функция не обращается к шине SPI2
+ * и может вызываться из обработчика прерывания.
+ *
+ * @param rec Данные записи.
+ * @param len Длина записи (не более W25_LOG_PAYLOAD).
+ * @return uint8_t 1 - запись добавлена, 0 - нет свободного буфера (запись отброшена) или неверная длина.
+ */
+uint8_t w25_log_push(const void *rec, uint16_t len) {
+  uint32_t       primask = __get_PRIMASK();
+  w25_log_buf_t *b;
+  uint8_t        ok = 0, pending;
+
+  if (len == 0 || len > W25_LOG_PAYLOAD) return 0;
+
+  __disable_irq();
+
+  b = &w25_log_bufs[w25_log_fill];
+  if (b->state == W25_LOG_FILL && b->used + len > W25_LOG_PAYLOAD) {
+    w25_log_close();
+    b = &w25_log_bufs[w25_log_fill];
+  }
+
+  if (b->state == W25_LOG_FREE) { // Начало новой страницы
+    b->used  = 0;
+    b->state = W25_LOG_FILL;
+  }
+
+  if (b->state == W25_LOG_FILL) {
+    memcpy(&b->data[W25_LOG_HDR_SIZE + b->used], rec, len);
+    b->used += len;
+    if (W25_LOG_PAYLOAD - b->used < len) w25_log_close(); // Запись такой же длины не поместится - страница готова
+    ok = 1;
+  } else {
+    w25_log_stats.dropped++; // Все буферы ожидают программирования
+  }
+
+  pending = w25_log_pending();
+  if (pending > w25_log_stats.max_pending) w25_log_stats.max_pending = pending;
+
+  __set_PRIMASK(primask);
+
+  return ok;
+}
+
+/**
+ * @brief Запись неполной текущей страницы (например, перед отключением питания).
+ */
+void w25_log_flush(void) {
+  uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  if (w25_log_bufs[w25_log_fill].state == W25_LOG_FILL && w25_log_bufs[w25_log_fill].used) w25_log_close();
+  __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Номер seq страницы, которая будет записана следующей.
+ */
+uint32_t w25_log_seq(void) {
+  return w25_log_next_seq;
+}
+
+/**
+ * @brief Чтение страницы журнала по номеру seq.
+ *
+ * Адрес страницы вычисляется от головы журнала. Страница должна быть уже записана в память
+ * (seq < w25_log_seq() и программирование завершено) и ещё не стёрта при переходе по кольцу.
+ *
+ * @param seq  Номер страницы.
+ * @param page Буфер на W25_PAGE_SIZE байт (данные начинаются со смещения W25_LOG_HDR_SIZE).
+ * @return int16_t Длина данных страницы, -1 - страница недоступна или повреждена.
+ */
+int16_t w25_log_read(uint32_t seq, uint8_t *page) {
+  uint32_t back = w25_log_next_seq - seq;
+  uint32_t address, crc, stored, s;
+  uint16_t magic, used;
+
+  if (seq >= w25_log_next_seq || back > W25_LOG_PAGES) return -1;
+
+  address = w25_log_head - W25_LOG_BASE + (W25_LOG_PAGES - back) * W25_PAGE_SIZE; // Смещение с переходом по кольцу
+  address = W25_LOG_BASE + address % (W25_LOG_PAGES * W25_PAGE_SIZE);
+
+  w25_read(address, page, W25_PAGE_SIZE);
+  memcpy(&s, &page[0], 4);
+  memcpy(&magic, &page[4], 2);
+  memcpy(&used, &page[6], 2);
+  memcpy(&stored, &page[8], 4);
+
+  if (s != seq || magic != W25_LOG_MAGIC || used > W25_LOG_PAYLOAD) return -1;
+
+  crc = w25_crc32(w25_crc32(W25_CRC_INIT, &page[W25_LOG_HDR_SIZE], W25_LOG_PAYLOAD), page, 8);
+  if (crc != stored) return -1;
+
+  return (int16_t)used;
+}
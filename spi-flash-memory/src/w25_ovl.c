@@ -0,0 +1,147 @@
+/**
+------------------------------------------------------------------------------------------------------------------------------
+ * @file        : w25_ovl.c
+ * @brief       : Загрузчик оверлеев кода из памяти W25Q64 в RAM.
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ * @Description : Образ в W25Q64: заголовок { W25_OVL_MAGIC, size, crc32 } + код и таблицы оверлея.
+ *                - Заголовок записывается после образа: при пропадании питания во время записи образ считается
+ *                  отсутствующим и записывается заново при следующем w25_ovl_install().
+ *                - Область загрузки w25_ovl_ram размещена в секции .overlay (SRAM1, без инициализации при старте):
+ *                  она доступна для DMA и для выборки команд по шине S Cortex-M4.
+ *                - Образ от программатора: w25_ovl_ram = заголовок { W25_OVL_STAGE, size } + образ (без CRC: её вычисляет
+ *                  w25_ovl_install()). Признак сбрасывается при первом чтении - образ записывается один раз.
+ *                - После загрузки выполняются барьеры __DSB()/__ISB(), чтобы первая выборка команд из области
+ *                  видела записанные DMA данные.
+ -------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#include "w25_ovl.h"
+#include "w25_crc.h"
+
+w25_ovl_stats_t w25_ovl_stats;
+
+// Область загрузки оверлеев (STM32F4xx_Flash_CCM.icf: place in INST_RAM, do not initialize)
+static uint8_t w25_ovl_ram[W25_OVL_SIZE] __attribute__((section(".overlay"), aligned(8)));
+
+static const w25_ovl_t *w25_ovl_cur = 0;                 // Загруженный оверлей
+static uint32_t         w25_ovl_hdr[W25_OVL_HDR_SIZE / 4]; // Буфер заголовка
+
+/**
+ * @brief Чтение заголовка образа в w25_ovl_hdr.
+ *
+ * @param ovl Описание оверлея.
+ * @return uint8_t 1 - заголовок содержит признак образа и допустимый размер.
+ */
+static uint8_t w25_ovl_read_hdr(const w25_ovl_t *ovl) {
+  w25_read(ovl->address, (uint8_t *)w25_ovl_hdr, W25_OVL_HDR_SIZE);
+
+  return w25_ovl_hdr[0] == W25_OVL_MAGIC && w25_ovl_hdr[1] <= W25_OVL_SIZE;
+}
+
+/**
+ * @brief Запись образа оверлея в W25Q64, если он отсутствует, повреждён или отличается от переданного.
+ *
+ * Записанный образ проверяется по заголовку и CRC-32 содержимого памяти (w25_crc_flash()).
+ *
+ * @param ovl   Описание оверлея.
+ * @param image Образ (ovl->end - ovl->start байт): w25_ovl_staged() или копия во flash (OVL_FLASH_COPY), 0 - нет образа.
+ * @return uint8_t 1 - образ записан, 0 - образ уже записан, не передан или запись не удалась.
+ */
+uint8_t w25_ovl_install(const w25_ovl_t *ovl, const uint8_t *image) {
+  uint32_t size = (uint32_t)(ovl->end - ovl->start);
+  uint32_t crc;
+  uint32_t a;
+
+  if (!image || size > W25_OVL_SIZE) return 0;
+  crc = w25_crc32(W25_CRC_INIT, image, size);
+  if (w25_ovl_read_hdr(ovl) && w25_ovl_hdr[1] == size && w25_ovl_hdr[2] == crc &&
+      w25_crc_flash(ovl->address + W25_OVL_HDR_SIZE, size) == crc) return 0;
+
+  if (w25_ovl_cur == ovl) w25_ovl_cur = 0;
+
+  for (a = ovl->address; a < ovl->address + W25_OVL_HDR_SIZE + size; a += W25_SECTOR_SIZE) w25_erase_sector(a);
+
+  if (!w25_write_verified(ovl->address + W25_OVL_HDR_SIZE, image, size)) return 0;
+
+  w25_ovl_hdr[0] = W25_OVL_MAGIC;
+  w25_ovl_hdr[1] = size;
+  w25_ovl_hdr[2] = crc;
+  w25_ovl_hdr[3] = 0xFFFFFFFFUL;
+  w25_write(ovl->address, (const uint8_t *)w25_ovl_hdr, W25_OVL_HDR_SIZE); // Заголовок - последним
+
+  w25_ovl_stats.installs++;
+
+  return 1;
+}
+
+/**
+ * @brief Образ оверлея, переданный программатором в область загрузки.
+ *
+ * Программатор записывает в w25_ovl_ram заголовок { W25_OVL_STAGE, size } и с адреса w25_ovl_ram + W25_OVL_HDR_SIZE
+ * образ, извлечённый из ELF (J-Link: w4 и loadbin). Область не инициализируется при старте и сохраняет образ
+ * после сброса.
+ *
+ * @param ovl Описание оверлея.
+ * @return const uint8_t* Образ для w25_ovl_install() или 0 - образа нет или его размер не совпадает с ovl.
+ */
+const uint8_t *w25_ovl_staged(const w25_ovl_t *ovl) {
+  uint32_t *hdr = (uint32_t *)w25_ovl_ram;
+
+  if (hdr[0] != W25_OVL_STAGE || hdr[1] != (uint32_t)(ovl->end - ovl->start) ||
+      hdr[1] > W25_OVL_SIZE - W25_OVL_HDR_SIZE) return 0;
+
+  hdr[0]      = 0; // Образ используется один раз
+  w25_ovl_cur = 0; // Область занята образом, загруженного оверлея нет
+
+  return w25_ovl_ram + W25_OVL_HDR_SIZE;
+}
+
+/**
+ * @brief Загрузка оверлея в область w25_ovl_ram.
+ *
+ * Образ читается одной командой Fast Read через DMA, CRC-32 вычисляется блоком CRC во время приёма.
+ * Функции и таблицы оверлея вызываются по адресам W25_OVL_PTR(ovl, base, sym).
+ *
+ * @param ovl Описание оверлея.
+ * @return void* Адрес загрузки или 0 - образ отсутствует, не помещается в область или повреждён.
+ */
+void *w25_ovl_load(const w25_ovl_t *ovl) {
+  uint32_t start;
+
+  if (w25_ovl_cur == ovl) {
+    w25_ovl_stats.hits++;
+    return w25_ovl_ram;
+  }
+
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; // Счётчик тактов DWT для измерения времени загрузки
+  DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+  start = DWT->CYCCNT;
+
+  w25_ovl_cur = 0; // Область перезаписывается - предыдущий оверлей выгружен
+
+  if (!w25_ovl_read_hdr(ovl) || w25_ovl_hdr[1] != (uint32_t)(ovl->end - ovl->start) ||
+      !w25_read_verified(ovl->address + W25_OVL_HDR_SIZE, w25_ovl_ram, w25_ovl_hdr[1], w25_ovl_hdr[2])) {
+    w25_ovl_stats.errors++;
+    return 0;
+  }
+
+  __DSB(); // Данные DMA записаны до выборки команд из области
+  __ISB();
+
+  w25_ovl_cur = ovl;
+  w25_ovl_stats.loads++;
+  w25_ovl_stats.load_cycles = DWT->CYCCNT - start;
+
+  return w25_ovl_ram;
+}
+
+/**
+ * @brief Сброс признака загруженного оверлея (следующий w25_ovl_load() читает образ из W25Q64).
+ */
+void w25_ovl_unload(void) {
+  w25_ovl_cur = 0;
+}
@@ -10,16 +10,47 @@
  * @Description : Этот файл содержит функции для взаимодействия с внешней памятью W25Q64 через интерфейс SPI2.
  *                - Функция w25send() отправляет данные по SPI2 и возвращает полученные данные.
  *                - Функция w25read() считывает данные из памяти W25Q64 по указанному адресу и сохраняет их в переменную memrd.
+ *                - Функция w25_read() считывает блок произвольной длины одной командой Fast Read (0x0B) через DMA.
+ *                - Функция w25_write() записывает блок произвольной длины, разбивая его по границам страниц (256 байт).
+ *                - Функции w25_program_page(), w25_erase_sector_start(), w25_erase_block_start() запускают операцию
+ *                  без ожидания BUSY (используются неблокирующим движком w25_async.c).
+ *                - Программирование и стирание сквозным образом обновляют кэш чтения (w25_cache.c).
+ *                - Функции w25_suspend(), w25_resume() приостанавливают и продолжают стирание/программирование
+ *                  (используются движком w25_async.c для срочного чтения во время длительного стирания).
+ *                - Функции w25_read_verified(), w25_write_verified(), w25_crc_flash() проверяют данные блоком CRC (w25_crc.c):
+ *                  CRC порции считается, пока DMA принимает следующую, поэтому проверка почти не удлиняет чтение.
  -------------------------------------------------------------------------------------------------------------------------------
  */
 
 #include "w25q64.h"
+#include "spi2_init.h"
+#include "w25_cache.h"
+#include "w25_crc.h"
+
+// Проверка, находится ли буфер в CCM RAM (недоступна для DMA)
+#define W25_IS_CCM(p) (((uint32_t)(p) >= CCMDATARAM_BASE) && ((uint32_t)(p) <= CCMDATARAM_END))
+
+// Буферы приёма w25_crc_flash() - в SRAM, доступной для DMA (пока DMA заполняет один, CRC считается по другому)
+static uint8_t w25_crc_buf[2][W25_CRC_BLOCK] __attribute__((section(".RAM1.non_init")));
+
+// Команда Page Program и адрес - первый сегмент цепочки DMA (SRAM, заполняется при захваченной шине)
+static uint8_t w25_pp_hdr[4] __attribute__((section(".RAM1.non_init")));
 
 /**
  * @brief Глобальная переменная для хранения считанных данных из памяти W25Q64.
  */
 uint8_t memrd = 0;
 
+/**
+ * @brief Флаг активной транзакции: устанавливается макросом CSLOW и сбрасывается макросом CSHIGH.
+ */
+volatile uint8_t w25_cs_active = 0;
+
+/**
+ * @brief Дескриптор памяти на шине SPI2 (заполняется в spi2_init()).
+ */
+spi2_dev_t w25_dev;
+
 /**
  * @brief Отправка данных по SPI2 и получение ответа.
  * 
@@ -57,3 +88,377 @@ void w25read(uint32_t address) {
   CSHIGH; // Деактивация чипа (CS в высокий уровень)
 }
 
+/**
+ * @brief Блочное чтение данных из памяти W25Q64.
+ *
+ * Функция передаёт команду Fast Read (0x0B), 24-битный адрес и фиктивный байт, после чего
+ * принимает len байт подряд в буфер buf через DMA (порциями до 65535 байт) без повторной
+ * передачи команды и адреса. Если буфер находится в CCM RAM, приём выполняется побайтно через w25send().
+ *
+ * @param address Начальный адрес в памяти W25Q64.
+ * @param buf     Буфер для считанных данных.
+ * @param len     Количество байт для чтения.
+ */
+void w25_read(uint32_t address, uint8_t *buf, uint32_t len) {
+  uint16_t chunk;
+
+  if (len == 0) return;
+
+  CSLOW; // Активация чипа (CS в низкий уровень)
+
+  w25send(FAST_RD);                // Команда быстрого чтения (0x0B)
+  w25send((address >> 16) & 0xFF); // Старший байт адреса
+  w25send((address >> 8) & 0xFF);  // Средний байт адреса
+  w25send(address & 0xFF);         // Младший байт адреса
+  w25send(0x00);                   // Фиктивный байт (8 тактов ожидания)
+
+  if (W25_IS_CCM(buf)) {
+    while (len--) *buf++ = w25send(0x00); // Побайтный приём в CCM RAM
+  } else {
+    while (len) {
+      chunk = (len > 0xFFFF) ? 0xFFFF : (uint16_t)len;
+      spi2_dma_txrx(0, buf, chunk); // Приём порции через DMA
+      buf += chunk;
+      len -= chunk;
+    }
+  }
+
+  CSHIGH; // Деактивация чипа (CS в высокий уровень)
+}
+
+/**
+ * @brief Разрешение записи в память W25Q64.
+ *
+ * Функция передаёт команду WR_EN (0x06). Бит WEL сбрасывается памятью автоматически
+ * после каждой операции программирования или стирания.
+ */
+void w25_write_enable(void) {
+  CSLOW;
+  w25send(WR_EN); // Команда разрешения записи (0x06)
+  CSHIGH;
+}
+
+/**
+ * @brief Ожидание завершения операции программирования/стирания.
+ *
+ * Функция читает статусный регистр 1 (0x05) до сброса бита BUSY.
+ */
+void w25_wait_busy(void) {
+  CSLOW;
+  w25send(RD_SR1);                                // Команда - Read Status Register-1
+  while ((w25send(0x00) & SR1_BUSY) == SR1_BUSY); // Ожидание сброса бита BUSY
+  CSHIGH;
+}
+
+/**
+ * @brief Чтение статусного регистра 1.
+ *
+ * @return uint8_t Значение статусного регистра 1 (бит 0 - BUSY, бит 1 - WEL).
+ */
+uint8_t w25_read_sr1(void) {
+  uint8_t sr;
+
+  CSLOW;
+  w25send(RD_SR1);       // Команда - Read Status Register-1
+  sr = w25send(0x00);    // Значение регистра
+  CSHIGH;
+
+  return sr;
+}
+
+/**
+ * @brief Запуск стирания сектора 4 КБ без ожидания завершения.
+ *
+ * Функция передаёт команды WR_EN и SECT_ER с адресом сектора. Завершение стирания
+ * определяется по сбросу бита BUSY (w25_wait_busy() или w25_read_sr1()).
+ *
+ * @param address Любой адрес внутри стираемого сектора.
+ */
+void w25_erase_sector_start(uint32_t address) {
+  w25_write_enable();
+
+  CSLOW;
+  w25send(SECT_ER);                // Команда стирания сектора (0x20)
+  w25send((address >> 16) & 0xFF); // Адрес сектора (старший байт)
+  w25send((address >> 8) & 0xFF);  // Адрес сектора (средний байт)
+  w25send(address & 0xFF);         // Адрес сектора (младший байт)
+  CSHIGH; // Подъём CS запускает стирание
+
+  w25_cache_erase(address); // Закэшированные строки сектора - 0xFF
+}
+
+/**
+ * @brief Стирание сектора 4 КБ с ожиданием завершения.
+ *
+ * @param address Любой адрес внутри стираемого сектора.
+ */
+void w25_erase_sector(uint32_t address) {
+  w25_erase_sector_start(address);
+  w25_wait_busy();
+}
+
+/**
+ * @brief Запуск стирания блока 64 КБ без ожидания завершения.
+ *
+ * Функция передаёт команды WR_EN и BLK_ER с адресом блока. Время стирания блока (tBE) - 150 мс типовое,
+ * до 2 с по документации: на байт в 6,4 раза меньше максимального tSE (400 мс на 4 КБ).
+ *
+ * @param address Любой адрес внутри стираемого блока.
+ */
+void w25_erase_block_start(uint32_t address) {
+  w25_write_enable();
+
+  CSLOW;
+  w25send(BLK_ER);                 // Команда стирания блока 64 КБ (0xD8)
+  w25send((address >> 16) & 0xFF); // Адрес блока (старший байт)
+  w25send((address >> 8) & 0xFF);  // Адрес блока (средний байт)
+  w25send(address & 0xFF);         // Адрес блока (младший байт)
+  CSHIGH; // Подъём CS запускает стирание
+
+  address &= ~(W25_BLOCK_SIZE - 1UL);
+  for (uint32_t a = address; a < address + W25_BLOCK_SIZE; a += W25_SECTOR_SIZE) w25_cache_erase(a);
+}
+
+/**
+ * @brief Стирание блока 64 КБ с ожиданием завершения.
+ *
+ * @param address Любой адрес внутри стираемого блока.
+ */
+void w25_erase_block(uint32_t address) {
+  w25_erase_block_start(address);
+  w25_wait_busy();
+}
+
+/**
+ * @brief Чтение идентификатора JEDEC.
+ *
+ * @return uint32_t Идентификатор: производитель << 16 | тип памяти << 8 | ёмкость (W25Q64 - 0xEF4017).
+ */
+uint32_t w25_read_jedec(void) {
+  uint32_t id;
+
+  CSLOW;
+  w25send(JEDEC_ID);                            // Команда - JEDEC ID (0x9F)
+  id  = (uint32_t)(w25send(0x00) & 0xFF) << 16; // Производитель
+  id |= (uint32_t)(w25send(0x00) & 0xFF) << 8;  // Тип памяти
+  id |= (uint32_t)(w25send(0x00) & 0xFF);       // Ёмкость
+  CSHIGH;
+
+  return id;
+}
+
+/**
+ * @brief Запуск программирования в пределах одной страницы без ожидания завершения.
+ *
+ * Функция передаёт команду WR_EN, затем команду PG_PROG, 24-битный адрес и данные.
+ * Команда с адресом и данные передаются одной цепочкой DMA из двух сегментов (spi2_dma_tx_chain()), без
+ * опроса RXNE на каждый байт заголовка. Из CCM RAM или если цепочка не запустилась - побайтно через w25send().
+ * Кэш обновляется только после передачи всех байт; при ошибке потока (TE) строки диапазона признаются
+ * недействительными - страница запрограммирована частично.
+ * Блок не должен пересекать границу страницы 256 байт.
+ *
+ * @param address Начальный адрес в памяти W25Q64.
+ * @param buf     Буфер с данными для записи.
+ * @param len     Количество байт (1..256), 0 - ничего не выполняется.
+ */
+void w25_program_page(uint32_t address, const uint8_t *buf, uint32_t len) {
+  uint8_t r = 0;
+
+  if (len == 0) return;
+  w25_write_enable();
+
+  CSLOW;
+  if (!W25_IS_CCM(buf)) {
+    dma_seg_t data = { buf, (uint16_t)len, 0 };         // Данные страницы - буфер вызывающей стороны
+    dma_seg_t hdr  = { w25_pp_hdr, 4, &data };
+
+    w25_pp_hdr[0] = PG_PROG;
+    w25_pp_hdr[1] = (address >> 16) & 0xFF;
+    w25_pp_hdr[2] = (address >> 8) & 0xFF;
+    w25_pp_hdr[3] = address & 0xFF;
+    r = spi2_dma_tx_chain(&hdr);                        // Заголовок и данные без паузы на перезапуск обмена
+  }
+  if (!r) {                                             // CCM RAM или цепочка не запущена
+    w25send(PG_PROG);                // Команда - Page Program (0x02)
+    w25send((address >> 16) & 0xFF); // Старший байт адреса
+    w25send((address >> 8) & 0xFF);  // Средний байт адреса
+    w25send(address & 0xFF);         // Младший байт адреса
+    for (uint32_t i = 0; i < len; i++) w25send(buf[i]); // Побайтная передача
+    r = DMA_CHAIN_DONE;
+  }
+  CSHIGH; // Подъём CS запускает программирование
+
+  if (r == DMA_CHAIN_DONE) w25_cache_program(address, buf, len); // Сквозная запись в кэш
+  else                     w25_cache_invalidate(address, len);   // Передана часть данных
+}
+
+/**
+ * @brief Запись блока данных в память W25Q64.
+ *
+ * Функция разбивает блок на части по границам страниц (256 байт), так как команда Page Program
+ * не может пересечь границу страницы (адрес внутри страницы «заворачивается»). Для каждой страницы:
+ * 1. Передаётся команда WR_EN.
+ * 2. Передаётся команда PG_PROG, 24-битный адрес и данные страницы (w25_program_page()).
+ * 3. Ожидается сброс бита BUSY.
+ * Область памяти должна быть предварительно стёрта.
+ *
+ * @param address Начальный адрес в памяти W25Q64.
+ * @param buf     Буфер с данными для записи.
+ * @param len     Количество байт для записи.
+ */
+void w25_write(uint32_t address, const uint8_t *buf, uint32_t len) {
+  uint32_t chunk;
+
+  while (len) {
+    chunk = W25_PAGE_SIZE - (address & (W25_PAGE_SIZE - 1)); // Остаток до конца текущей страницы
+    if (chunk > len) chunk = len;
+
+    w25_program_page(address, buf, chunk);
+    w25_wait_busy();
+
+    address += chunk;
+    buf     += chunk;
+    len     -= chunk;
+  }
+}
+
+/**
+ * @brief Чтение статусного регистра 2.
+ *
+ * @return uint8_t Значение статусного регистра 2 (бит 7 - SUS).
+ */
+uint8_t w25_read_sr2(void) {
+  uint8_t sr;
+
+  CSLOW;
+  w25send(RD_SR2);       // Команда - Read Status Register-2
+  sr = w25send(0x00);    // Значение регистра
+  CSHIGH;
+
+  return sr;
+}
+
+/**
+ * @brief Приостановка стирания/программирования.
+ *
+ * Функция передаёт команду Erase/Program Suspend (0x75) и ожидает сброса бита BUSY (не более tSUS = 20 мкс).
+ * Память игнорирует команду, если операция не выполняется или с момента Resume прошло меньше tSUS -
+ * тогда ожидание BUSY длится до завершения операции.
+ *
+ * @return uint8_t 1 - операция приостановлена (бит SUS = 1), 0 - операция завершена.
+ */
+uint8_t w25_suspend(void) {
+  CSLOW;
+  w25send(SUSPEND); // Команда - Erase/Program Suspend (0x75)
+  CSHIGH;
+
+  w25_wait_busy();
+
+  return (w25_read_sr2() & SR2_SUS) ? 1 : 0;
+}
+
+/**
+ * @brief Продолжение приостановленной операции (Erase/Program Resume, 0x7A).
+ *
+ * После команды память снова устанавливает бит BUSY до завершения операции.
+ */
+void w25_resume(void) {
+  CSLOW;
+  w25send(RESUME); // Команда - Erase/Program Resume (0x7A)
+  CSHIGH;
+}
+
+/**
+ * @brief Чтение с вычислением CRC-32 по мере приёма.
+ *
+ * Данные принимаются одной командой Fast Read порциями по W25_CRC_BLOCK байт: после запуска DMA
+ * для очередной порции блок CRC обрабатывает предыдущую, затем ожидается завершение приёма.
+ * Время чтения определяется шиной SPI2, вычисление CRC выполняется в паузах ожидания DMA.
+ *
+ * @param address Начальный адрес в памяти W25Q64.
+ * @param buf     Буфер для считанных данных (вне CCM RAM) или 0 - данные принимаются в w25_crc_buf.
+ * @param len     Количество байт для чтения.
+ * @return uint32_t Значение CRC-32 считанных данных (W25_CRC_INIT при len = 0).
+ */
+static uint32_t w25_read_crc(uint32_t address, uint8_t *buf, uint32_t len) {
+  uint32_t crc = W25_CRC_INIT, prev_len = 0, chunk;
+  uint8_t *cur, *prev = 0, k = 0;
+
+  if (len == 0) return crc;
+
+  CSLOW;
+
+  w25send(FAST_RD);                // Команда быстрого чтения (0x0B)
+  w25send((address >> 16) & 0xFF);
+  w25send((address >> 8) & 0xFF);
+  w25send(address & 0xFF);
+  w25send(0x00);                   // Фиктивный байт
+
+  while (len) {
+    chunk = (len > W25_CRC_BLOCK) ? W25_CRC_BLOCK : len;
+    cur   = buf ? buf : w25_crc_buf[k ^= 1];
+
+    spi2_dma_start(0, cur, (uint16_t)chunk);                 // Приём следующей порции
+    if (prev_len) crc = w25_crc32(crc, prev, prev_len);      // CRC предыдущей порции во время приёма
+    spi2_dma_wait();
+
+    prev     = cur;
+    prev_len = chunk;
+    if (buf) buf += chunk;
+    len -= chunk;
+  }
+
+  CSHIGH;
+
+  return w25_crc32(crc, prev, prev_len); // Последняя порция
+}
+
+/**
+ * @brief Вычисление CRC-32 области памяти W25Q64 без сохранения данных.
+ *
+ * @param address Начальный адрес в памяти W25Q64.
+ * @param len     Длина области, байт.
+ * @return uint32_t Значение CRC-32 (как w25_crc32(W25_CRC_INIT, данные, len)).
+ */
+uint32_t w25_crc_flash(uint32_t address, uint32_t len) {
+  return w25_read_crc(address, 0, len);
+}
+
+/**
+ * @brief Чтение блока с проверкой CRC-32.
+ *
+ * Если буфер находится в CCM RAM, данные читаются w25_read() побайтно и CRC вычисляется после чтения.
+ *
+ * @param address Начальный адрес в памяти W25Q64.
+ * @param buf     Буфер для считанных данных.
+ * @param len     Количество байт для чтения.
+ * @param crc     Ожидаемое значение CRC-32 (w25_crc32(W25_CRC_INIT, данные, len)).
+ * @return uint8_t 1 - CRC совпала, 0 - данные повреждены.
+ */
+uint8_t w25_read_verified(uint32_t address, uint8_t *buf, uint32_t len, uint32_t crc) {
+  if (W25_IS_CCM(buf)) {
+    w25_read(address, buf, len);
+    return w25_crc32(W25_CRC_INIT, buf, len) == crc;
+  }
+
+  return w25_read_crc(address, buf, len) == crc;
+}
+
+/**
+ * @brief Запись блока с проверкой записанных данных по CRC-32.
+ *
+ * После w25_write() область считывается обратно в w25_crc_buf, и её CRC сравнивается с CRC исходных данных.
+ * Область должна быть предварительно стёрта.
+ *
+ * @param address Начальный адрес в памяти W25Q64.
+ * @param buf     Данные для записи.
+ * @param len     Количество байт.
+ * @return uint8_t 1 - данные записаны без ошибок, 0 - содержимое памяти не совпадает с данными.
+ */
+uint8_t w25_write_verified(uint32_t address, const uint8_t *buf, uint32_t len) {
+  uint32_t crc = w25_crc32(W25_CRC_INIT, buf, len);
+
+  w25_write(address, buf, len);
+
+  return w25_crc_flash(address, len) == crc;
+}
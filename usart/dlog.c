@@ -0,0 +1,164 @@
+/**
+-------------------------------------------------------------------------------------------------------------------------------------------------------
+
+ * @file        : dlog.c
+ * @brief       : Кольцевой буфер отложенного журнала и его передача через DMA (поток USART1_TX) в USART1.
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ * @Description : - Запись копируется в буфер целиком при запрещённых прерываниях (DLOG() можно вызывать из любого
+ *                  обработчика) или отбрасывается, если места не хватает (dlog_stats.dropped).
+ *                - dlog_poll() передаёт непрерывный участок буфера от dlog_tail до dlog_head (или до конца буфера)
+ *                  одной передачей DMA. Передатчик USART1 общий с буфером usart_tx.c: передача начинается только
+ *                  после usart_tx_hold() (буфер usart_tx пуст), а по окончании (TC) передатчик возвращается
+ *                  usart_tx_release(). Сообщения usart_tx_put() за время передачи накапливаются и передаются после неё.
+ *                - Запись упаковывается (dlog_pack()) при запрещённых прерываниях: время записи и Δt относительно
+ *                  предыдущей записи в буфере согласованы и при вызовах DLOG() из нескольких обработчиков.
+ *                - DMA передаёт байты буфера в USART1->DR (прямой режим, MSIZE = PSIZE = 8): записи переменной длины
+ *                  не выравниваются по словам.
+ *                Файл компилируется только с опцией DLOG_ENABLE (main.h).
+ -------------------------------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#include "main.h"
+
+#if defined(DLOG_ENABLE)
+
+#define DLOG_MASK (DLOG_SIZE - 1)
+
+dlog_stats_t dlog_stats;
+
+static uint8_t           dlog_buf[DLOG_SIZE] USART_DMA_BUF; // Кольцевой буфер записей (SRAM1 - доступен DMA)
+static volatile uint32_t dlog_head = 0;       // Счётчик записанных байт
+static volatile uint32_t dlog_tail = 0;       // Счётчик переданных байт
+static volatile uint32_t dlog_len  = 0;       // Байт в текущей передаче DMA (0 - DMA свободен)
+static uint32_t          dlog_time = 0;       // DWT->CYCCNT предыдущей записи (без остатка Δt)
+static DMA_Stream_TypeDef *dlog_dma = 0;      // Поток передачи (dma_mgr_claim(): DMA2 Stream7)
+
+/**
+ * @brief Упаковка записи и копирование в буфер.
+ *
+ * @param id   Идентификатор строки формата.
+ * @param args Аргументы.
+ * @param n    Количество аргументов.
+ * @param t0   DWT->CYCCNT при входе в dlog_N (dlog_stats.cycles).
+ */
+static void dlog_write(uint16_t id, const uint32_t *args, uint32_t n, uint32_t t0) {
+    uint32_t primask = __get_PRIMASK();
+    uint8_t  rec[DLOG_REC_MAX];
+    uint32_t head, used, len, dt;
+
+    __disable_irq();
+    dt   = (DWT->CYCCNT - dlog_time) >> DLOG_TSHIFT;
+    len  = dlog_pack(rec, id, dt, args, n);
+    head = dlog_head;
+    used = head - dlog_tail;
+    if (len > DLOG_SIZE - used) {
+        dlog_stats.dropped++;                  // Время отброшенной записи войдёт в Δt следующей
+    } else {
+        for (uint32_t i = 0; i < len; i++) dlog_buf[(head + i) & DLOG_MASK] = rec[i];
+        dlog_head  = head + len;
+        dlog_time += dt << DLOG_TSHIFT;
+        dlog_stats.records++;
+        if (used + len > dlog_stats.hwm) dlog_stats.hwm = (uint16_t)(used + len);
+    }
+    t0 = DWT->CYCCNT - t0;                     // Время вызова без восстановления прерываний
+    dlog_stats.cycles = (uint16_t)t0;
+    if (t0 > dlog_stats.cycles_max) dlog_stats.cycles_max = (uint16_t)t0;
+    __set_PRIMASK(primask);
+}
+
+void dlog_0(uint16_t id) {
+    uint32_t t0 = DWT->CYCCNT;
+    dlog_write(id, 0, 0, t0);
+}
+
+void dlog_1(uint16_t id, uint32_t a) {
+    uint32_t t0 = DWT->CYCCNT;
+    dlog_write(id, &a, 1, t0);
+}
+
+void dlog_2(uint16_t id, uint32_t a, uint32_t b) {
+    uint32_t t0 = DWT->CYCCNT;
+    uint32_t w[2] = { a, b };
+    dlog_write(id, w, 2, t0);
+}
+
+void dlog_3(uint16_t id, uint32_t a, uint32_t b, uint32_t c) {
+    uint32_t t0 = DWT->CYCCNT;
+    uint32_t w[3] = { a, b, c };
+    dlog_write(id, w, 3, t0);
+}
+
+void dlog_4(uint16_t id, uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+    uint32_t t0 = DWT->CYCCNT;
+    uint32_t w[4] = { a, b, c, d };
+    dlog_write(id, w, 4, t0);
+}
+
+static void dlog_dma_irq(void *ctx, uint32_t flags);
+
+/**
+ * @brief Настройка счётчика тактов DWT и потока DMA запроса USART1_TX (DMA2 Stream7, канал 4).
+ *
+ * Вызывается после USART1_Init(): запросы DMA по TXE разрешаются здесь, пока поток выключен. Если поток занят
+ * другим драйвером, записи накапливаются в буфере без передачи.
+ */
+void dlog_init(void) {
+    uint8_t ch;
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; // Время записей - такты ядра
+    DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+    dlog_time         = DWT->CYCCNT;
+
+    dlog_dma = dma_mgr_claim(DMA_REQ_USART1_TX, &ch, dlog_dma_irq, 0, DLOG_IRQ_PRIO);
+    if (!dlog_dma) return;
+
+    // Память -> периферия, инкремент адреса памяти, байты, прерывания TC и TE
+    dlog_dma->CR  = ((uint32_t)ch << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_DIR_0 | DMA_SxCR_MINC | DMA_SxCR_TCIE | DMA_SxCR_TEIE;
+    dlog_dma->FCR = 0;                          // Прямой режим
+    dlog_dma->PAR = (uint32_t)&USART1->DR;
+
+    USART1->CR3 |= USART_CR3_DMAT; // Запросы по TXE обслуживаются, только когда поток включён
+}
+
+/**
+ * @brief Запуск передачи накопленных записей, если DMA свободен и передатчик USART1 удалось захватить.
+ */
+void dlog_poll(void) {
+    uint32_t tail = dlog_tail, n;
+
+    if (!dlog_dma || dlog_len || dlog_head == tail) return;
+    if (!usart_tx_hold()) return;              // Буфер usart_tx передаётся - журнал ждёт конца сообщения
+
+    n = dlog_head - tail;
+    if (n > DLOG_SIZE - (tail & DLOG_MASK)) n = DLOG_SIZE - (tail & DLOG_MASK); // До конца буфера
+    dlog_len = n;
+
+    dlog_dma->M0AR = (uint32_t)&dlog_buf[tail & DLOG_MASK];
+    dlog_dma->NDTR = n;
+    dlog_dma->CR  |= DMA_SxCR_EN;              // Первый запрос - TXE = 1
+}
+
+/**
+ * @brief Прерывание потока передачи (dma_mgr.c, флаги уже сброшены): участок передан, передатчик возвращается
+ *        буферу usart_tx.
+ *
+ * Ошибка TE отключает поток: участок отбрасывается (записи на линии оборваны, host находит следующую запись
+ * по DLOG_TAG и идентификатору), иначе dlog_len не обнулился бы и журнал остановился. Следующий участок запускает
+ * dlog_poll().
+ */
+static void dlog_dma_irq(void *ctx, uint32_t flags) {
+    (void)ctx;
+    if (flags & (DMA_MGR_TC | DMA_MGR_TE)) {
+        if (flags & DMA_MGR_TE) dlog_stats.errors++;
+        else                    dlog_stats.bytes += dlog_len;
+        dlog_tail += dlog_len;                 // Место освобождается после передачи
+        dlog_len   = 0;
+        usart_tx_release();
+    }
+}
+
+#endif // DLOG_ENABLE
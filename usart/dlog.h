@@ -0,0 +1,149 @@
+/**
+-------------------------------------------------------------------------------------------------------------------------------------------------------
+
+ * @file        : dlog.h
+ * @brief       : Отложенный двоичный журнал: идентификатор строки формата и аргументы без форматирования на плате.
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ * @Description : DLOG("ADC ch%u = %u", ch, value) записывает в кольцевой буфер RAM запись переменной длины (байты, младший
+ *                байт первым):
+ *                [DLOG_TAG | N][ID, 2 байта][коды размеров, 1 байт - при N > 0][Δt, 1..5 байт][аргумент 1]...[аргумент N],
+ *                N = 0..DLOG_MAX_ARGS. Запись "boot" - 4 байта, DLOG("%c%c", 'o', 'k') - 7 байт.
+ *                - Строка формата не передаётся: она размещается в секции .dlog_fmt (только flash), а идентификатором
+ *                  служат младшие 16 бит её адреса (секция не больше 64 КБ - идентификаторы не повторяются).
+ *                - Δt - время от предыдущей записи в единицах 2^DLOG_TSHIFT тактов DWT->CYCCNT, по 7 бит в байте
+ *                  (старший бит - продолжение): до 127 единиц (6 мкс при 84 МГц) - 1 байт, до 0,78 мс - 2 байта, до 0,1 с - 3.
+ *                  Остаток от деления переносится в следующую запись: время на host не накапливает ошибку.
+ *                - Размер аргумента выбирается по значению (2 бита на аргумент в байте кодов): DLOG_ARG_U8 - 0..255,
+ *                  DLOG_ARG_S8 - -128..-1, DLOG_ARG_U16 - 0..65535, DLOG_ARG_32 - остальные и float. Host восстанавливает
+ *                  32-битное значение и форматирует его по спецификатору, поэтому %c, флаги и малые числа занимают 1 байт.
+ *                - Таблицу идентификаторов строит host из файла прошивки (ELF, секция .dlog_fmt): host/dlog_dump
+ *                  восстанавливает текст printf-подобным форматированием (host/dlog_host.c). Таблица всегда
+ *                  соответствует собранной прошивке, отдельный шаг генерации не нужен.
+ *                - Аргументы приводятся к uint32_t; float передаётся через DLOG_F(x) (биты значения), строки (%s)
+ *                  не поддерживаются - выводится адрес. Пустая строка формата не допускается.
+ *                - Буфер передаётся через DMA2 Stream7 в USART1 (dlog_poll() в основном цикле).
+ *                - Объём (host/dlog_test): 7 записей теста занимают 53 байта против 104 байт того же текста без времени
+ *                  (в 2 раза меньше) и 237 байт с временем (в 4,5 раза). Сокращение в 10 раз - только для сообщений
+ *                  длиннее ~75 символов: запись в среднем 7-8 байт независимо от длины строки формата.
+ *                - Время вызова DLOG() на плате - dlog_stats.cycles и cycles_max (DWT->CYCCNT, тактов), форматирования
+ *                  на плате нет; на host dlog_test выводит время dlog_pack() на запись.
+ *                Без DLOG_ENABLE (main.h) вызовы DLOG() не компилируются и линия USART1 остаётся только для протокола.
+ *                Файл не зависит от CMSIS и подключается в host/dlog_test.c (упаковка записи - dlog_pack()).
+ -------------------------------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#ifndef DLOG_H
+#define DLOG_H
+
+#include <stdint.h>
+
+#define DLOG_SIZE      2048 // Размер кольцевого буфера, байт (степень двойки)
+#define DLOG_MAX_ARGS  4    // Наибольшее количество аргументов записи
+#define DLOG_TAG       0xA0 // Первый байт записи: DLOG_TAG | N (поиск начала записи на host)
+#define DLOG_TAG_MASK  0xF8
+#define DLOG_TSHIFT    2    // Единица Δt - 2^DLOG_TSHIFT тактов DWT->CYCCNT (48 нс при 84 МГц)
+#define DLOG_REC_MAX   (4 + 5 + 4 * DLOG_MAX_ARGS) // Наибольший размер записи, байт
+#define DLOG_IRQ_PRIO  6    // Приоритет прерывания DMA2 Stream7 (ниже USART1 - USART_RX_IRQ_PRIO)
+
+// Коды размеров аргументов
+#define DLOG_ARG_U8  0 // 1 байт, старшие биты - 0
+#define DLOG_ARG_S8  1 // 1 байт, старшие биты - 1
+#define DLOG_ARG_U16 2 // 2 байта
+#define DLOG_ARG_32  3 // 4 байта
+
+// Идентификатор строки формата: строка в секции .dlog_fmt, младшие 16 бит её адреса
+#define DLOG_ID(fmt) __extension__({                                                           \
+    static const char dlog_fmt_[] __attribute__((section(".dlog_fmt"), used)) = fmt;           \
+    (uint16_t)(uintptr_t)dlog_fmt_; })
+
+// Биты значения float для аргумента %f/%e/%g
+#define DLOG_F(x) (((union { float f; uint32_t u; }){ .f = (float)(x) }).u)
+
+#define DLOG_U(x) ((uint32_t)(x))
+
+// Выбор dlog_N по количеству аргументов
+#define DLOG_SEL(f, a, b, c, d, name, ...) name
+#define DLOG_0(fmt)             dlog_0(DLOG_ID(fmt))
+#define DLOG_1(fmt, a)          dlog_1(DLOG_ID(fmt), DLOG_U(a))
+#define DLOG_2(fmt, a, b)       dlog_2(DLOG_ID(fmt), DLOG_U(a), DLOG_U(b))
+#define DLOG_3(fmt, a, b, c)    dlog_3(DLOG_ID(fmt), DLOG_U(a), DLOG_U(b), DLOG_U(c))
+#define DLOG_4(fmt, a, b, c, d) dlog_4(DLOG_ID(fmt), DLOG_U(a), DLOG_U(b), DLOG_U(c), DLOG_U(d))
+
+#if defined(DLOG_ENABLE)
+#define DLOG(...) DLOG_SEL(__VA_ARGS__, DLOG_4, DLOG_3, DLOG_2, DLOG_1, DLOG_0, _)(__VA_ARGS__)
+#else
+#define DLOG(...) ((void)0)
+#endif
+
+// Статистика журнала
+typedef struct {
+    uint32_t records; // Записано записей
+    uint32_t dropped; // Отброшено записей (буфер заполнен)
+    uint32_t bytes;   // Передано байт
+    uint32_t errors;  // Участков, прерванных ошибкой DMA (TE): байты отброшены, журнал продолжается
+    uint16_t hwm;     // Наибольшее заполнение буфера, байт
+    uint16_t cycles;     // Тактов последнего вызова dlog_N (DWT->CYCCNT: от входа до восстановления прерываний)
+    uint16_t cycles_max; // Наибольшее время вызова, тактов
+} dlog_stats_t;
+
+extern dlog_stats_t dlog_stats;
+
+/**
+ * @brief Упаковка записи.
+ *
+ * @param rec  Запись, не менее DLOG_REC_MAX байт.
+ * @param id   Идентификатор строки формата (DLOG_ID()).
+ * @param dt   Время от предыдущей записи, единиц 2^DLOG_TSHIFT тактов.
+ * @param args Аргументы.
+ * @param n    Количество аргументов (0..DLOG_MAX_ARGS).
+ * @return uint32_t Размер записи, байт.
+ */
+static inline uint32_t dlog_pack(uint8_t *rec, uint16_t id, uint32_t dt, const uint32_t *args, uint32_t n) {
+    uint32_t len = 3, codes = 0, v;
+
+    rec[0] = (uint8_t)(DLOG_TAG | n);
+    rec[1] = (uint8_t)id;
+    rec[2] = (uint8_t)(id >> 8);
+    if (n) len++;
+
+    do {                                               // Δt: по 7 бит, старший бит - продолжение
+        rec[len++] = (uint8_t)((dt & 0x7F) | (dt > 0x7F ? 0x80 : 0));
+        dt >>= 7;
+    } while (dt);
+
+    for (uint32_t i = 0; i < n; i++) {
+        v = args[i];
+        if (v <= 0xFF) {
+            codes |= DLOG_ARG_U8 << (2 * i);
+            rec[len++] = (uint8_t)v;
+        } else if (v >= 0xFFFFFF80UL) {
+            codes |= DLOG_ARG_S8 << (2 * i);
+            rec[len++] = (uint8_t)v;
+        } else if (v <= 0xFFFF) {
+            codes |= DLOG_ARG_U16 << (2 * i);
+            rec[len++] = (uint8_t)v;
+            rec[len++] = (uint8_t)(v >> 8);
+        } else {
+            codes |= DLOG_ARG_32 << (2 * i);
+            for (uint32_t k = 0; k < 4; k++) rec[len++] = (uint8_t)(v >> (8 * k));
+        }
+    }
+    if (n) rec[3] = (uint8_t)codes;
+
+    return len;
+}
+
+void dlog_0(uint16_t id);                                                     // Запись без аргументов
+void dlog_1(uint16_t id, uint32_t a);
+void dlog_2(uint16_t id, uint32_t a, uint32_t b);
+void dlog_3(uint16_t id, uint32_t a, uint32_t b, uint32_t c);
+void dlog_4(uint16_t id, uint32_t a, uint32_t b, uint32_t c, uint32_t d);
+
+void dlog_init(void); // Настройка DWT->CYCCNT и DMA2 Stream7 (после USART1_Init())
+void dlog_poll(void); // Запуск передачи накопленных записей (основной цикл)
+
+#endif // DLOG_H
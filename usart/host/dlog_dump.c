@@ -0,0 +1,111 @@
+/**
+-------------------------------------------------------------------------------------------------------------------------------------------------------
+
+ * @file        : dlog_dump.c
+ * @brief       : Вывод отложенного журнала DLOG() в текстовом виде (Linux, host).
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : Linux x86-64 (host)
+ * @MCU         : STM32F407VET6 (плата по USART1)
+ * @IDE         : gcc
+ * @Description : Таблица строк формата берётся из того же файла прошивки (ELF), что записан в плату.
+ *                Сборка:
+ *                cd usart
+ *                gcc -std=gnu11 -O2 -Wall -Wextra -I. -Ihost -o dlog_dump host/dlog_dump.c host/dlog_host.c
+ *                Запуск:
+ *                ./dlog_dump [--hz 84000000] [--baud 115200] Output/Debug/Exe/usart.elf /dev/ttyUSB0
+ *                ./dlog_dump Output/Debug/Exe/usart.elf capture.bin     (записанный поток, "-" - stdin)
+ *                ./dlog_dump --table Output/Debug/Exe/usart.elf         (таблица идентификаторов)
+ *                При чтении порта программа работает до Ctrl+C и выводит количество пропущенных байт
+ *                (кадры протокола и текст на той же линии) при завершении потока.
+ -------------------------------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "dlog_host.h"
+
+static speed_t dlog_dump_speed(unsigned baud) {
+    switch (baud) {
+        case 9600:    return B9600;
+        case 57600:   return B57600;
+        case 230400:  return B230400;
+        case 460800:  return B460800;
+        case 921600:  return B921600;
+        case 1000000: return B1000000;
+        case 2000000: return B2000000;
+        default:      return B115200;
+    }
+}
+
+// Открытие потока: файл, stdin ("-") или последовательный порт (raw 8N1)
+static int dlog_dump_open(const char *path, unsigned baud) {
+    struct termios tio;
+    int            fd;
+
+    if (strcmp(path, "-") == 0) return STDIN_FILENO;
+
+    fd = open(path, O_RDONLY | O_NOCTTY);
+    if (fd >= 0 && isatty(fd) && tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tio.c_cflag |= CLOCAL | CREAD;
+        cfsetispeed(&tio, dlog_dump_speed(baud));
+        cfsetospeed(&tio, dlog_dump_speed(baud));
+        tcsetattr(fd, TCSANOW, &tio);
+        tcflush(fd, TCIFLUSH);
+    }
+
+    return fd;
+}
+
+static void dlog_dump_usage(void) {
+    fprintf(stderr, "usage: dlog_dump [--hz N] [--baud N] firmware.elf [stream|tty|-]\n"
+                    "       dlog_dump --table firmware.elf\n");
+}
+
+int main(int argc, char **argv) {
+    dlog_host_t h;
+    double      hz    = 84e6;
+    unsigned    baud  = 115200;
+    int         table = 0, i, fd;
+    uint8_t     buf[256];
+    ssize_t     n;
+
+    for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; i++) {
+        if      (strcmp(argv[i], "--table") == 0)             table = 1;
+        else if (strcmp(argv[i], "--hz") == 0 && i + 1 < argc)   hz   = atof(argv[++i]);
+        else if (strcmp(argv[i], "--baud") == 0 && i + 1 < argc) baud = (unsigned)atoi(argv[++i]);
+        else { dlog_dump_usage(); return 2; }
+    }
+    if (i >= argc || (!table && i + 2 != argc)) { dlog_dump_usage(); return 2; }
+
+    if (dlog_host_load(&h, argv[i], hz) < 0) {
+        fprintf(stderr, "%s: нет секции .dlog_fmt\n", argv[i]);
+        return 1;
+    }
+
+    if (table) {
+        for (unsigned k = 0; k < h.count; k++)
+            printf("0x%04X  %u  %s\n", (unsigned)h.fmt[k].id, h.fmt[k].args, h.fmt[k].fmt);
+        dlog_host_free(&h);
+        return 0;
+    }
+
+    fd = dlog_dump_open(argv[i + 1], baud);
+    if (fd < 0) { perror(argv[i + 1]); dlog_host_free(&h); return 1; }
+
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        dlog_host_feed(&h, buf, (size_t)n, stdout);
+        fflush(stdout);
+    }
+
+    fprintf(stderr, "Записей: %u, пропущено байт: %u\n", h.records, h.skipped);
+    if (fd != STDIN_FILENO) close(fd);
+    dlog_host_free(&h);
+
+    return 0;
+}
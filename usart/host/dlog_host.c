@@ -0,0 +1,374 @@
+/**
+-------------------------------------------------------------------------------------------------------------------------------------------------------
+
+ * @file        : dlog_host.c
+ * @brief       : Таблица строк формата DLOG() из ELF и расшифровка потока записей (Linux, host).
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : Linux x86-64 (host)
+ * @MCU         : STM32F407VET6 (плата по USART1)
+ * @IDE         : gcc
+ * @Description : Строки формата в секции .dlog_fmt (или в блоке __dlog_fmt_start__..__dlog_fmt_end__) разделены нулевыми байтами (в том числе байтами выравнивания),
+ *                поэтому начало каждой строки - первый ненулевой байт после нуля. Аргументы форматируются по одному
+ *                спецификатору через snprintf: %d %i - int32_t, %u %x %X %o %c - uint32_t, %f %e %g %a - биты float
+ *                (DLOG_F()), %p и %s - адрес. Модификаторы длины (h, l, ll, z) пропускаются.
+ -------------------------------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#include <elf.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dlog_host.h"
+
+#define DLOG_HOST_CONV "diuxXocfFeEgGaAps" // Спецификаторы с аргументом
+
+// Чтение файла целиком
+static uint8_t *dlog_host_read_file(const char *path, size_t *size) {
+    FILE    *f = fopen(path, "rb");
+    uint8_t *buf = 0;
+    long     n;
+
+    if (!f) return 0;
+    if (fseek(f, 0, SEEK_END) == 0 && (n = ftell(f)) > 0 && fseek(f, 0, SEEK_SET) == 0) {
+        buf = malloc((size_t)n);
+        if (buf && fread(buf, 1, (size_t)n, f) != (size_t)n) { free(buf); buf = 0; }
+        *size = (size_t)n;
+    }
+    fclose(f);
+
+    return buf;
+}
+
+// Заголовок секции (ELF32 и ELF64)
+typedef struct {
+    uint32_t name, type, link;
+    uint64_t addr, offset, size, entsize;
+} dlog_host_sec_t;
+
+// Файл ELF (little-endian)
+typedef struct {
+    const uint8_t *data;
+    size_t         size;
+    int            is64;
+    uint64_t       shoff;
+    unsigned       shnum, shentsize, shstrndx;
+} dlog_host_elf_t;
+
+static int dlog_host_elf(dlog_host_elf_t *e, const uint8_t *data, size_t size) {
+    e->data = data;
+    e->size = size;
+    if (size < sizeof(Elf64_Ehdr) || memcmp(data, ELFMAG, SELFMAG) || data[EI_DATA] != ELFDATA2LSB) return -1;
+    e->is64 = data[EI_CLASS] == ELFCLASS64;
+
+    if (e->is64) {
+        const Elf64_Ehdr *eh = (const Elf64_Ehdr *)data;
+        e->shoff = eh->e_shoff; e->shnum = eh->e_shnum; e->shentsize = eh->e_shentsize; e->shstrndx = eh->e_shstrndx;
+    } else {
+        const Elf32_Ehdr *eh = (const Elf32_Ehdr *)data;
+        e->shoff = eh->e_shoff; e->shnum = eh->e_shnum; e->shentsize = eh->e_shentsize; e->shstrndx = eh->e_shstrndx;
+    }
+
+    return (e->shoff + (uint64_t)e->shnum * e->shentsize > size || e->shstrndx >= e->shnum) ? -1 : 0;
+}
+
+static int dlog_host_sec(const dlog_host_elf_t *e, unsigned i, dlog_host_sec_t *s) {
+    const uint8_t *sh = e->data + e->shoff + (uint64_t)i * e->shentsize;
+
+    if (e->is64) {
+        const Elf64_Shdr *h = (const Elf64_Shdr *)sh;
+        s->name = h->sh_name; s->type = h->sh_type; s->link = h->sh_link;
+        s->addr = h->sh_addr; s->offset = h->sh_offset; s->size = h->sh_size; s->entsize = h->sh_entsize;
+    } else {
+        const Elf32_Shdr *h = (const Elf32_Shdr *)sh;
+        s->name = h->sh_name; s->type = h->sh_type; s->link = h->sh_link;
+        s->addr = h->sh_addr; s->offset = h->sh_offset; s->size = h->sh_size; s->entsize = h->sh_entsize;
+    }
+    if (s->type == SHT_NOBITS) s->size = 0;
+
+    return s->offset + s->size > e->size ? -1 : 0;
+}
+
+// Строка таблицы строк (секция strndx) или 0
+static const char *dlog_host_str(const dlog_host_elf_t *e, unsigned strndx, uint64_t off) {
+    dlog_host_sec_t s;
+
+    if (strndx >= e->shnum || dlog_host_sec(e, strndx, &s) || off >= s.size) return 0;
+    if (!memchr(e->data + s.offset + off, 0, s.size - off)) return 0;
+    return (const char *)e->data + s.offset + off;
+}
+
+// Значение символа из .symtab
+static int dlog_host_sym(const dlog_host_elf_t *e, const char *name, uint64_t *value) {
+    dlog_host_sec_t s;
+
+    for (unsigned i = 0; i < e->shnum; i++) {
+        if (dlog_host_sec(e, i, &s) || s.type != SHT_SYMTAB || !s.entsize) continue;
+        for (uint64_t k = 0; k < s.size / s.entsize; k++) {
+            const uint8_t *p = e->data + s.offset + k * s.entsize;
+            uint64_t       n, v;
+            const char    *str;
+
+            if (e->is64) { n = ((const Elf64_Sym *)p)->st_name; v = ((const Elf64_Sym *)p)->st_value; }
+            else         { n = ((const Elf32_Sym *)p)->st_name; v = ((const Elf32_Sym *)p)->st_value; }
+            str = dlog_host_str(e, s.link, n);
+            if (str && strcmp(str, name) == 0) { *value = v; return 0; }
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Поиск строк формата: секция .dlog_fmt или, если линкер объединил её с другими, блок dlog_fmt
+ * по символам __dlog_fmt_start__/__dlog_fmt_end__ (линкер SEGGER, STM32F4xx_Flash_CCM.icf).
+ *
+ * @return int 0 - найдено: адрес, смещение в файле и размер.
+ */
+static int dlog_host_find_fmt(const dlog_host_elf_t *e, uint64_t *addr, uint64_t *offset, uint64_t *len) {
+    dlog_host_sec_t s;
+    uint64_t        start, end;
+
+    for (unsigned i = 0; i < e->shnum; i++) {
+        const char *name;
+
+        if (dlog_host_sec(e, i, &s)) continue;
+        name = dlog_host_str(e, e->shstrndx, s.name);
+        if (name && strcmp(name, ".dlog_fmt") == 0) {
+            *addr = s.addr; *offset = s.offset; *len = s.size;
+            return 0;
+        }
+    }
+
+    if (dlog_host_sym(e, "__dlog_fmt_start__", &start) || dlog_host_sym(e, "__dlog_fmt_end__", &end) || end < start) return -1;
+
+    for (unsigned i = 0; i < e->shnum; i++) {
+        if (dlog_host_sec(e, i, &s) || !s.addr || s.type == SHT_NOBITS) continue;
+        if (start >= s.addr && end <= s.addr + s.size) {   // Секция, содержащая блок
+            *addr = start; *offset = s.offset + (start - s.addr); *len = end - start;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+// Количество аргументов строки формата (разбор - как в dlog_host_format())
+static uint8_t dlog_host_count(const char *fmt) {
+    uint8_t n = 0;
+
+    for (const char *p = fmt; *p; p++) {
+        if (*p != '%') continue;
+        if (p[1] == '%') { p++; continue; }
+        while (p[1] && strchr("-+ #0123456789.", p[1])) p++;
+        while (p[1] && strchr("hlLqjzt", p[1])) p++;
+        if (!p[1]) break;
+        if (strchr(DLOG_HOST_CONV, *++p)) n++;
+    }
+
+    return n;
+}
+
+static int dlog_host_cmp(const void *a, const void *b) {
+    uint32_t x = ((const dlog_fmt_t *)a)->id, y = ((const dlog_fmt_t *)b)->id;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Построение таблицы строк формата по секции .dlog_fmt файла прошивки.
+ *
+ * @param h   Таблица.
+ * @param elf Путь к ELF (прошивка или программа host с DLOG()).
+ * @param hz  Частота DWT->CYCCNT, Гц.
+ * @return int Количество строк или -1 - файл не найден, не содержит секции или секция больше 64 КБ.
+ */
+int dlog_host_load(dlog_host_t *h, const char *elf, double hz) {
+    dlog_host_elf_t e;
+    uint64_t        addr, off, len, i;
+    size_t          size;
+    uint8_t        *file = dlog_host_read_file(elf, &size);
+
+    memset(h, 0, sizeof(*h));
+    h->hz = hz;
+    if (!file) return -1;
+    if (dlog_host_elf(&e, file, size) || dlog_host_find_fmt(&e, &addr, &off, &len)) { free(file); return -1; }
+
+    if (len > 0x10000) { free(file); return -1; }             // Идентификаторы (16 бит адреса) повторялись бы
+
+    h->data = malloc(len + 1);
+    h->fmt  = malloc(sizeof(dlog_fmt_t) * (len / 2 + 1));
+    memcpy(h->data, file + off, len);
+    h->data[len] = 0;
+    free(file);
+
+    for (i = 0; i < len; i++) {
+        if (h->data[i] == 0) continue;                         // Конец строки или выравнивание
+        h->fmt[h->count].id   = (uint16_t)(addr + i);
+        h->fmt[h->count].fmt  = &h->data[i];
+        h->fmt[h->count].args = dlog_host_count(&h->data[i]);
+        h->count++;
+        i += strlen(&h->data[i]);
+    }
+    qsort(h->fmt, h->count, sizeof(dlog_fmt_t), dlog_host_cmp);
+
+    return (int)h->count;
+}
+
+void dlog_host_free(dlog_host_t *h) {
+    free(h->fmt);
+    free(h->data);
+    memset(h, 0, sizeof(*h));
+}
+
+const dlog_fmt_t *dlog_host_find(const dlog_host_t *h, uint16_t id) {
+    dlog_fmt_t key = { id, 0, 0 };
+
+    if (!h->count) return 0;
+    return bsearch(&key, h->fmt, h->count, sizeof(dlog_fmt_t), dlog_host_cmp);
+}
+
+/**
+ * @brief Форматирование записи: строка формата и аргументы uint32_t.
+ *
+ * @return int Длина текста (без усечения по size).
+ */
+int dlog_host_format(char *out, size_t size, const char *fmt, const uint32_t *args) {
+    size_t pos = 0;
+    char   spec[32];
+
+#define DLOG_HOST_PUT(...) do {                                                                  \
+        int n_ = snprintf(out + (pos < size ? pos : size), pos < size ? size - pos : 0, __VA_ARGS__); \
+        if (n_ > 0) pos += (size_t)n_;                                                           \
+    } while (0)
+
+    for (const char *p = fmt; *p; p++) {
+        size_t k = 0;
+        char   conv;
+
+        if (*p != '%') { DLOG_HOST_PUT("%c", *p); continue; }
+        if (p[1] == '%') { DLOG_HOST_PUT("%%"); p++; continue; }
+
+        spec[k++] = '%';
+        while (p[1] && strchr("-+ #0123456789.", p[1])) {                                          // Флаги, ширина, точность
+            p++;
+            if (k < sizeof(spec) - 2) spec[k++] = *p;
+        }
+        while (p[1] && strchr("hlLqjzt", p[1])) p++;                                              // Модификаторы длины
+        if (!p[1]) break;
+        conv = *++p;
+
+        switch (conv) {
+            case 'd': case 'i':
+                spec[k++] = conv; spec[k] = 0;
+                DLOG_HOST_PUT(spec, (int)(int32_t)*args++);
+                break;
+            case 'u': case 'x': case 'X': case 'o': case 'c':
+                spec[k++] = conv; spec[k] = 0;
+                DLOG_HOST_PUT(spec, (unsigned)*args++);
+                break;
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': {
+                union { uint32_t u; float f; } v = { *args++ };
+                spec[k++] = conv; spec[k] = 0;
+                DLOG_HOST_PUT(spec, (double)v.f);
+                break;
+            }
+            case 'p': case 's':                                // Адрес на плате
+                DLOG_HOST_PUT("0x%08x", (unsigned)*args++);
+                break;
+            default:                                           // Неизвестный спецификатор - выводится как текст
+                spec[k++] = conv; spec[k] = 0;
+                DLOG_HOST_PUT("%s", spec);
+                break;
+        }
+    }
+
+#undef DLOG_HOST_PUT
+
+    if (size) out[pos < size ? pos : size - 1] = 0;
+    return (int)pos;
+}
+
+/**
+ * @brief Разбор записи в начале буфера (формат - dlog.h, dlog_pack()).
+ *
+ * @param h    Таблица строк.
+ * @param b    Байты.
+ * @param len  Количество байт.
+ * @param f    Строка формата записи.
+ * @param dt   Время от предыдущей записи, тактов.
+ * @param args Аргументы (DLOG_MAX_ARGS).
+ * @return int Размер записи, 0 - запись принята не целиком, -1 - в начале буфера нет записи.
+ */
+static int dlog_host_rec(const dlog_host_t *h, const uint8_t *b, unsigned len, const dlog_fmt_t **f, uint64_t *dt,
+                         uint32_t *args) {
+    static const uint8_t size[4] = { 1, 1, 2, 4 }; // DLOG_ARG_U8, DLOG_ARG_S8, DLOG_ARG_U16, DLOG_ARG_32
+    unsigned n, pos = 3, codes = 0;
+    uint64_t t = 0;
+
+    if ((b[0] & DLOG_TAG_MASK) != DLOG_TAG || (n = b[0] & ~DLOG_TAG_MASK) > DLOG_MAX_ARGS) return -1;
+    if (len < 3) return 0;
+    *f = dlog_host_find(h, (uint16_t)(b[1] | b[2] << 8));
+    if (!*f || (*f)->args != n) return -1;
+    if (n) {
+        if (len < 4) return 0;
+        codes = b[pos++];
+        if (codes >> (2 * n)) return -1;                         // Коды отсутствующих аргументов - 0
+    }
+
+    for (unsigned k = 0;; k++) {                                 // Δt: по 7 бит, не более 5 байт
+        if (pos >= len) return 0;
+        if (k == 5) return -1;
+        t |= (uint64_t)(b[pos] & 0x7F) << (7 * k);
+        if (!(b[pos++] & 0x80)) break;
+    }
+    *dt = t << DLOG_TSHIFT;
+
+    for (unsigned a = 0; a < n; a++) {
+        unsigned code = (codes >> (2 * a)) & 3;
+        uint32_t v    = 0;
+
+        if (pos + size[code] > len) return 0;
+        for (unsigned k = 0; k < size[code]; k++) v |= (uint32_t)b[pos++] << (8 * k);
+        if (code == DLOG_ARG_S8) v |= 0xFFFFFF00UL;
+        args[a] = v;
+    }
+
+    return (int)pos;
+}
+
+/**
+ * @brief Разбор участка потока и вывод расшифрованных записей.
+ *
+ * @param h    Таблица и состояние разбора.
+ * @param data Байты потока.
+ * @param len  Количество байт.
+ * @param out  Вывод текста.
+ */
+void dlog_host_feed(dlog_host_t *h, const uint8_t *data, size_t len, FILE *out) {
+    for (size_t i = 0; i < len; i++) {
+        h->buf[h->len++] = data[i];
+
+        while (h->len) {
+            const dlog_fmt_t *f;
+            uint64_t          dt;
+            uint32_t          args[DLOG_MAX_ARGS];
+            char              text[512];
+            int               need = dlog_host_rec(h, h->buf, h->len, &f, &dt, args);
+
+            if (need < 0) {                                      // Не запись - сдвиг на один байт
+                memmove(h->buf, h->buf + 1, --h->len);
+                h->skipped++;
+                continue;
+            }
+            if (need == 0) break;                                // Запись ещё не принята целиком
+
+            if (h->records) h->time += dt;
+            h->records++;
+            dlog_host_format(text, sizeof(text), f->fmt, args);
+            if (out) fprintf(out, "%14.3f us  %s\n", (double)h->time * 1e6 / h->hz, text);
+
+            h->len -= (unsigned)need;
+            memmove(h->buf, h->buf + need, h->len);
+        }
+    }
+}
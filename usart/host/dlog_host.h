@@ -0,0 +1,55 @@
+/**
+-------------------------------------------------------------------------------------------------------------------------------------------------------
+
+ * @file        : dlog_host.h
+ * @brief       : Расшифровка отложенного журнала DLOG() на Linux (host): таблица строк формата из ELF и поток записей.
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : Linux x86-64 (host)
+ * @MCU         : STM32F407VET6 (плата по USART1)
+ * @IDE         : gcc
+ * @Description : dlog_host_load() читает секцию .dlog_fmt файла прошивки (ELF32 или ELF64) и строит таблицу
+ *                «младшие 16 бит адреса строки -> строка формата, количество аргументов».
+ *                dlog_host_feed() принимает поток байт в любом разбиении: запись (формат - dlog.h) начинается с байта
+ *                DLOG_TAG | N и известного идентификатора строки с N аргументами; байты, не образующие такую запись
+ *                (кадры протокола, текст OPTION2, начало потока с середины записи), пропускаются и считаются в skipped.
+ *                Каждая запись выводится строкой «время_мкс  текст»; время отсчитывается от первой записи
+ *                суммой Δt (интервал между записями должен быть меньше 51 с при 84 МГц - периода DWT->CYCCNT).
+ -------------------------------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#ifndef DLOG_HOST_H
+#define DLOG_HOST_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "dlog.h"
+
+// Строка формата
+typedef struct {
+    uint16_t    id;   // Младшие 16 бит адреса строки
+    const char *fmt;  // Строка формата
+    uint8_t     args; // Количество аргументов (спецификаторов формата)
+} dlog_fmt_t;
+
+// Таблица строк и состояние разбора потока
+typedef struct {
+    dlog_fmt_t *fmt;                          // Строки, упорядоченные по id
+    unsigned    count;                        // Количество строк
+    char       *data;                         // Содержимое секции .dlog_fmt
+    double      hz;                           // Частота DWT->CYCCNT, Гц
+    uint8_t     buf[DLOG_REC_MAX];            // Принимаемая запись
+    unsigned    len;                          // Байт в buf
+    uint64_t    time;                         // Тактов от первой записи
+    uint32_t    records;                      // Расшифровано записей
+    uint32_t    skipped;                      // Пропущено байт вне записей
+} dlog_host_t;
+
+int  dlog_host_load(dlog_host_t *h, const char *elf, double hz);     // Таблица из ELF, возврат - количество строк или -1
+void dlog_host_free(dlog_host_t *h);
+const dlog_fmt_t *dlog_host_find(const dlog_host_t *h, uint16_t id); // Поиск строки по id (младшие 16 бит адреса)
+int  dlog_host_format(char *out, size_t size, const char *fmt, const uint32_t *args); // Текст записи (как snprintf)
+void dlog_host_feed(dlog_host_t *h, const uint8_t *data, size_t len, FILE *out);      // Разбор участка потока
+
+#endif // DLOG_HOST_H
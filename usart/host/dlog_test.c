@@ -0,0 +1,195 @@
+/**
+-------------------------------------------------------------------------------------------------------------------------------------------------------
+
+ * @file        : dlog_test.c
+ * @brief       : Проверка отложенного журнала DLOG() на Linux (host): макросы dlog.h, таблица из ELF и расшифровка.
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : Linux x86-64 (host)
+ * @MCU         : STM32F407VET6 (модель)
+ * @IDE         : gcc
+ * @Description : Вызовы DLOG() компилируются неизменённым dlog.h: строки формата попадают в секцию .dlog_fmt этой
+ *                программы, а модель dlog_N упаковывает записи той же dlog_pack(), что dlog.c на плате (время - модель
+ *                DWT->CYCCNT с шагом 84 такта = 1 мкс при 84 МГц). Таблица строится dlog_host_load() по /proc/self/exe,
+ *                поэтому программа собирается без PIE (адреса строк совпадают с адресами в ELF).
+ *                Сборка и запуск:
+ *                cd usart
+ *                gcc -std=gnu11 -O2 -Wall -Wextra -no-pie -I. -Ihost -o dlog_test host/dlog_test.c host/dlog_host.c
+ *                ./dlog_test
+ *                Программа:
+ *                - проверяет таблицу строк формата (количество, число аргументов);
+ *                - расшифровывает записи с 0..4 аргументами, знаковыми, шестнадцатеричными и float-аргументами;
+ *                - проверяет синхронизацию после посторонних байт (текст, кадр протокола, ложный DLOG_TAG) и
+ *                  разбор потока по одному байту;
+ *                - проверяет время записей при переполнении счётчика тактов;
+ *                - проверяет, что двоичные записи меньше текста без времени и в несколько раз меньше текста со временем,
+ *                  и выводит достигнутое сокращение;
+ *                - измеряет время упаковки одной записи (dlog_pack() и модель dlog_write()).
+ *                Код возврата - количество непройденных проверок.
+ -------------------------------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#define _GNU_SOURCE
+#define DLOG_ENABLE 1
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dlog.h"
+#include "dlog_host.h"
+
+#define TEST_HZ    84e6 // Частота модели DWT->CYCCNT
+#define TEST_STEP  84   // Тактов между записями (1 мкс)
+#define TEST_SITES 10   // Вызовов DLOG() в программе
+
+static uint8_t  test_stream[4096]; // Поток записей (модель буфера dlog.c)
+static size_t   test_len;
+static uint32_t test_cycles;       // Модель DWT->CYCCNT
+static int      test_failed = 0;
+
+static void test_check(const char *name, int ok) {
+    printf("  %-52s %s\n", name, ok ? "OK" : "FAIL");
+    if (!ok) test_failed++;
+}
+
+/* ---------------------------------------- Модель dlog.c ---------------------------------------- */
+
+static uint32_t test_time;          // Модель dlog_time
+
+static void test_write(uint16_t id, const uint32_t *args, uint32_t n) {
+    uint32_t dt = (test_cycles - test_time) >> DLOG_TSHIFT;
+
+    test_len    += dlog_pack(test_stream + test_len, id, dt, args, n);
+    test_time   += dt << DLOG_TSHIFT;
+    test_cycles += TEST_STEP;
+}
+
+void dlog_0(uint16_t id)                                                  { test_write(id, 0, 0); }
+void dlog_1(uint16_t id, uint32_t a)                                      { test_write(id, &a, 1); }
+void dlog_2(uint16_t id, uint32_t a, uint32_t b)                          { uint32_t w[] = { a, b }; test_write(id, w, 2); }
+void dlog_3(uint16_t id, uint32_t a, uint32_t b, uint32_t c)              { uint32_t w[] = { a, b, c }; test_write(id, w, 3); }
+void dlog_4(uint16_t id, uint32_t a, uint32_t b, uint32_t c, uint32_t d)  { uint32_t w[] = { a, b, c, d }; test_write(id, w, 4); }
+
+/* ---------------------------------------- Записи ---------------------------------------- */
+
+static void test_log(void) {
+    int delta = -5;
+
+    DLOG("boot");
+    DLOG("S1: tx hwm %u, dropped %u", 17, 0);
+    DLOG("temp %d C, delta %+d", delta * 4, 3);
+    DLOG("reg 0x%08X", 0x40011000UL);
+    DLOG("vdd = %.3f V", DLOG_F(3.3f));
+    DLOG("%c%c %lu%%", 'o', 'k', 100UL);
+    DLOG("a=%u b=%u c=%u d=%u", 1, 2, 3, 4);
+}
+
+static const char test_text[] =
+    "         0.000 us  boot\n"
+    "         1.000 us  S1: tx hwm 17, dropped 0\n"
+    "         2.000 us  temp -20 C, delta +3\n"
+    "         3.000 us  reg 0x40011000\n"
+    "         4.000 us  vdd = 3.300 V\n"
+    "         5.000 us  ok 100%\n"
+    "         6.000 us  a=1 b=2 c=3 d=4\n";
+
+// Расшифровка потока участками по chunk байт
+static char *test_decode(dlog_host_t *h, const uint8_t *data, size_t len, size_t chunk) {
+    char  *text = 0;
+    size_t size = 0;
+    FILE  *out  = open_memstream(&text, &size);
+
+    h->len = 0; h->records = 0; h->skipped = 0; h->time = 0;
+    for (size_t i = 0; i < len; i += chunk) dlog_host_feed(h, data + i, len - i < chunk ? len - i : chunk, out);
+    fclose(out);
+
+    return text;
+}
+
+int main(void) {
+    dlog_host_t h;
+    char       *text;
+    int         n = dlog_host_load(&h, "/proc/self/exe", TEST_HZ);
+
+    printf("Таблица строк формата (.dlog_fmt):\n");
+    test_check("секция найдена", n >= 0);
+    test_check("количество строк = количество вызовов DLOG()", n == TEST_SITES);
+    {
+        int args_ok = 1;
+        for (unsigned k = 0; k < h.count; k++) {
+            if (strcmp(h.fmt[k].fmt, "a=%u b=%u c=%u d=%u") == 0 && h.fmt[k].args != 4) args_ok = 0;
+            if (strcmp(h.fmt[k].fmt, "%c%c %lu%%") == 0 && h.fmt[k].args != 3) args_ok = 0;
+            if (strcmp(h.fmt[k].fmt, "boot") == 0 && h.fmt[k].args != 0) args_ok = 0;
+        }
+        test_check("количество аргументов (%%, модификаторы длины)", args_ok);
+    }
+
+    printf("Расшифровка:\n");
+    test_len = 0; test_cycles = 1000; test_time = test_cycles;
+    test_log();
+    text = test_decode(&h, test_stream, test_len, sizeof(test_stream));
+    test_check("записи с 0..4 аргументами", strcmp(text, test_text) == 0 && h.records == 7);
+    if (strcmp(text, test_text) != 0) printf("%s", text);
+    free(text);
+
+    text = test_decode(&h, test_stream, test_len, 1);
+    test_check("поток по одному байту", strcmp(text, test_text) == 0);
+    free(text);
+
+    {
+        static const uint8_t junk[] = "Button S1\n\n\x00\x05\x81\x01\x02\x03\x00\x00\x00\x00\xA2";
+        static uint8_t       mixed[sizeof(test_stream) + 2 * sizeof(junk)];
+        size_t               half = 4 + 7; // Граница после записей "boot" (4 байта) и "S1: ..." (7 байт)
+        size_t               len  = 0;
+
+        memcpy(mixed + len, junk, sizeof(junk) - 1); len += sizeof(junk) - 1;
+        memcpy(mixed + len, test_stream, half);      len += half;
+        memcpy(mixed + len, junk, sizeof(junk) - 1); len += sizeof(junk) - 1;
+        memcpy(mixed + len, test_stream + half, test_len - half); len += test_len - half;
+
+        text = test_decode(&h, mixed, len, 3);
+        test_check("посторонние байты между записями пропускаются",
+                   strcmp(text, test_text) == 0 && h.skipped == 2 * (sizeof(junk) - 1));
+        free(text);
+
+        text = test_decode(&h, test_stream + 2, test_len - 2, 5);
+        test_check("начало потока с середины записи", h.records == 6 && strstr(text, "a=1 b=2 c=3 d=4") != 0);
+        free(text);
+    }
+
+    printf("Время записей:\n");
+    test_len = 0; test_cycles = 0xFFFFFFFFUL - 100; test_time = test_cycles;
+    DLOG("wrap %u", 1);
+    DLOG("wrap %u", 2);
+    DLOG("wrap %u", 3);
+    text = test_decode(&h, test_stream, test_len, sizeof(test_stream));
+    test_check("переполнение DWT->CYCCNT", strstr(text, "         2.000 us  wrap 3\n") != 0);
+    free(text);
+
+    printf("Объём:\n");
+    test_len = 0; test_cycles = 0; test_time = test_cycles;
+    test_log();
+    printf("  %-52s %zu / %zu / %zu байт\n", "двоичные записи / текст без времени / со временем:", test_len,
+           strlen(test_text) - 7 * 19, strlen(test_text));
+    test_check("двоичные записи меньше текста без времени", test_len < strlen(test_text) - 7 * 19);
+    test_check("двоичные записи в 4 раза меньше текста со временем", 4 * test_len < strlen(test_text));
+    printf("  %-52s %.1f / %.1f раза\n", "сокращение без времени / со временем:",
+           (double)(strlen(test_text) - 7 * 19) / test_len, (double)strlen(test_text) / test_len);
+
+    // Время записи: 100 000 проходов test_log() по 7 записей
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int i = 0; i < 100000; i++) {
+        test_len = 0;
+        test_log();
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+    printf("  %-52s %.2f нс/запись (host)\n", "упаковка:", ns / (100000.0 * 7));
+
+    dlog_host_free(&h);
+
+    printf("Непройдено проверок: %d\n", test_failed);
+    return test_failed;
+}
@@ -0,0 +1,166 @@
+/**
+-------------------------------------------------------------------------------------------------------------------------------------------------------
+
+ * @file        : proto_link.c
+ * @brief       : Клиент двоичного протокола для Linux (host): последовательный порт, запросы и ответы.
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : Linux x86-64 (host)
+ * @MCU         : STM32F407VET6 (плата по USART1)
+ * @IDE         : gcc
+ * @Description : Порт переводится в режим raw (cfmakeraw): без эха, без преобразования символов конца строки,
+ *                иначе байты 0x0A/0x0D в закодированных кадрах искажаются драйвером терминала.
+ -------------------------------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "proto_link.h"
+
+static int64_t proto_link_now_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static speed_t proto_link_speed(unsigned baud) {
+    switch (baud) {
+        case 9600:    return B9600;
+        case 57600:   return B57600;
+        case 230400:  return B230400;
+        case 460800:  return B460800;
+        case 921600:  return B921600;
+        case 1000000: return B1000000;
+        case 2000000: return B2000000;
+        default:      return B115200;
+    }
+}
+
+/**
+ * @brief Использование уже открытого дескриптора (например, master псевдотерминала).
+ */
+int proto_link_attach(proto_link_t *link, int fd) {
+    link->fd     = fd;
+    link->seq    = 0;
+    link->errors = 0;
+    proto_dec_reset(&link->dec);
+    return 0;
+}
+
+/**
+ * @brief Открытие последовательного порта в режиме raw 8N1.
+ *
+ * @return int 0 - успешно, -1 - ошибка (errno).
+ */
+int proto_link_open(proto_link_t *link, const char *path, unsigned baud) {
+    struct termios tio;
+    int            fd = open(path, O_RDWR | O_NOCTTY);
+
+    if (fd < 0) return -1;
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tio.c_cflag |= CLOCAL | CREAD;
+        cfsetispeed(&tio, proto_link_speed(baud));
+        cfsetospeed(&tio, proto_link_speed(baud));
+        tcsetattr(fd, TCSANOW, &tio);
+        tcflush(fd, TCIOFLUSH);
+    }
+
+    return proto_link_attach(link, fd);
+}
+
+void proto_link_close(proto_link_t *link) {
+    if (link->fd >= 0) close(link->fd);
+    link->fd = -1;
+}
+
+/**
+ * @brief Передача запроса со следующим порядковым номером.
+ *
+ * @return int Номер запроса (seq) или -1 - ошибка записи.
+ */
+int proto_link_send(proto_link_t *link, uint8_t id, const uint8_t *payload, uint8_t len) {
+    uint8_t  out[PROTO_MAX_ENCODED];
+    uint16_t n = proto_encode(id, ++link->seq, payload, len, out);
+    uint16_t done = 0;
+
+    if (n == 0) return -1;
+    while (done < n) {
+        ssize_t w = write(link->fd, out + done, n - done);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        done += (uint16_t)w;
+    }
+
+    return link->seq;
+}
+
+/**
+ * @brief Приём следующего кадра.
+ *
+ * @param data Буфер данных кадра (не менее PROTO_MAX_PAYLOAD байт).
+ * @return int 1 - кадр принят, 0 - тайм-аут, -1 - ошибка чтения.
+ */
+int proto_link_recv(proto_link_t *link, uint8_t *id, uint8_t *seq, uint8_t *data, uint8_t *len, int timeout_ms) {
+    int64_t       deadline = proto_link_now_ms() + timeout_ms;
+    struct pollfd pfd = { link->fd, POLLIN, 0 };
+    uint8_t       b;
+
+    for (;;) {
+        int left = (int)(deadline - proto_link_now_ms());
+        if (left < 0) left = 0;
+        int r = poll(&pfd, 1, left);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) return -1;
+        if (r == 0) return 0;
+
+        if (read(link->fd, &b, 1) != 1) return -1;   // Побайтно: следующий кадр остаётся в очереди порта
+
+        switch (proto_dec_byte(&link->dec, b)) {
+            case PROTO_DEC_MORE:
+                break;
+            case PROTO_DEC_FRAME:
+                *id  = link->dec.buf[0];
+                *seq = link->dec.buf[1];
+                *len = (uint8_t)(link->dec.len - PROTO_HDR_SIZE);
+                for (uint8_t i = 0; i < *len; i++) data[i] = link->dec.buf[PROTO_HDR_SIZE + i];
+                return 1;
+            default:
+                link->errors++;
+                break;
+        }
+    }
+}
+
+/**
+ * @brief Запрос и ожидание ответа.
+ *
+ * @param rsp     Данные ответа без статуса (не менее PROTO_MAX_PAYLOAD байт).
+ * @param rsp_len Длина данных ответа.
+ * @return int Статус PROTO_ST_* или -1 - тайм-аут или ошибка порта.
+ */
+int proto_link_request(proto_link_t *link, uint8_t id, const uint8_t *payload, uint8_t len,
+                       uint8_t *rsp, uint8_t *rsp_len, int timeout_ms) {
+    int64_t deadline = proto_link_now_ms() + timeout_ms;
+    uint8_t data[PROTO_MAX_PAYLOAD], rid, rseq, n;
+    int     seq = proto_link_send(link, id, payload, len);
+
+    if (seq < 0) return -1;
+
+    for (;;) {
+        int left = (int)(deadline - proto_link_now_ms());
+        if (left <= 0 || proto_link_recv(link, &rid, &rseq, data, &n, left) != 1) return -1;
+        if (rid != (id | PROTO_RSP) || rseq != (uint8_t)seq || n == 0) continue; // Чужой кадр
+        *rsp_len = n - 1;
+        for (uint8_t i = 1; i < n; i++) rsp[i - 1] = data[i];
+        return data[0];
+    }
+}
@@ -0,0 +1,39 @@
+/**
+-------------------------------------------------------------------------------------------------------------------------------------------------------
+
+ * @file        : proto_link.h
+ * @brief       : Клиент двоичного протокола для Linux (host): последовательный порт, запросы и ответы.
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : Linux x86-64 (host)
+ * @MCU         : STM32F407VET6 (плата по USART1)
+ * @IDE         : gcc
+ * @Description : Кадры кодируются и декодируются тем же кодом, что и на плате (../proto_codec.c).
+ *                proto_link_request() передаёт запрос со следующим seq и ждёт ответ с тем же seq; кадры без запроса
+ *                (PROTO_MSG_ADC_DATA) и ответы на устаревшие запросы, пришедшие раньше, пропускаются.
+ *                proto_link_recv() возвращает следующий принятый кадр любого типа (поток АЦП).
+ -------------------------------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#ifndef PROTO_LINK_H
+#define PROTO_LINK_H
+
+#include "proto.h"
+
+// Соединение с платой
+typedef struct {
+    int         fd;     // Дескриптор порта
+    uint8_t     seq;    // Номер последнего запроса
+    proto_dec_t dec;    // Декодер принятого потока
+    uint32_t    errors; // Кадров с ошибкой CRC или структуры
+} proto_link_t;
+
+int proto_link_open(proto_link_t *link, const char *path, unsigned baud);    // Открытие порта (8N1, без эха)
+int proto_link_attach(proto_link_t *link, int fd);                           // Использование открытого дескриптора
+int proto_link_send(proto_link_t *link, uint8_t id, const uint8_t *payload, uint8_t len); // Передача, возврат - seq
+int proto_link_recv(proto_link_t *link, uint8_t *id, uint8_t *seq, uint8_t *data, uint8_t *len, int timeout_ms);
+int proto_link_request(proto_link_t *link, uint8_t id, const uint8_t *payload, uint8_t len,
+                       uint8_t *rsp, uint8_t *rsp_len, int timeout_ms);       // Статус PROTO_ST_* или -1 (тайм-аут)
+void proto_link_close(proto_link_t *link);
+
+#endif // PROTO_LINK_H
@@ -0,0 +1,245 @@
+/**
+-------------------------------------------------------------------------------------------------------------------------------------------------------
+
+ * @file        : proto_pty.c
+ * @brief       : Проверка двоичного протокола на Linux (host) через псевдотерминал.
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : Linux x86-64 (host)
+ * @MCU         : STM32F407VET6 (модель)
+ * @IDE         : gcc
+ * @Description : Сторона платы - неизменённые proto.c и proto_codec.c в отдельном потоке: байты из slave псевдотерминала
+ *                передаются proto_rx(), ответы записываются обратно в slave. Сторона host - proto_link.c на master.
+ *                Обработчики команд - модели (память READ_MEM - массив host), таблица - как в proto_cmd.c.
+ *                Сборка и запуск:
+ *                cd usart
+ *                gcc -std=gnu11 -O2 -Wall -Wextra -I. -Ihost -o proto_pty \
+ *                    host/proto_pty.c host/proto_link.c proto.c proto_codec.c -lpthread
+ *                ./proto_pty
+ *                Программа:
+ *                - проверяет кодирование/декодирование кадров всех длин и данных с нулевыми байтами;
+ *                - выполняет запросы PING, LED, READ_MEM (в том числе адрес с переполнением uint32), неизвестный
+ *                  идентификатор и неверную длину;
+ *                - проверяет, что кадр с искажённой CRC отбрасывается без ответа, а следующий обрабатывается;
+ *                - проверяет восстановление синхронизации после текста вне протокола и приём кадров по одному байту;
+ *                - передаёт пакет запросов подряд и проверяет порядок ответов;
+ *                - измеряет время разбора одного байта декодером.
+ *                Код возврата - количество непройденных проверок.
+ -------------------------------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "proto.h"
+#include "proto_link.h"
+
+#define PTY_TIMEOUT 500     // Тайм-аут ответа, мс
+#define PTY_MEM_BASE 0x08000000UL
+#define PTY_MEM_SIZE 256
+
+static int          pty_slave;
+static uint8_t      pty_mem[PTY_MEM_SIZE]; // Модель внутренней flash
+static uint8_t      pty_leds;              // Модель светодиодов
+static int          pty_failed = 0;
+static proto_link_t link_;
+
+static void pty_check(const char *name, int ok) {
+    printf("  %-52s %s\n", name, ok ? "OK" : "FAIL");
+    if (!ok) pty_failed++;
+}
+
+/* ---------------------------------------- Сторона платы ---------------------------------------- */
+
+static uint8_t pty_tx(const uint8_t *data, uint16_t len) {
+    return write(pty_slave, data, len) == len;
+}
+
+static uint8_t pty_ping(const uint8_t *req, uint8_t len, uint8_t *rsp, uint8_t *rsp_len) {
+    memcpy(rsp, req, len);
+    *rsp_len = len;
+    return PROTO_ST_OK;
+}
+
+static uint8_t pty_led(const uint8_t *req, uint8_t len, uint8_t *rsp, uint8_t *rsp_len) {
+    (void)len; (void)rsp; (void)rsp_len;
+    if (req[0] & ~0x07) return PROTO_ST_ARG;
+    pty_leds = req[0];
+    return PROTO_ST_OK;
+}
+
+static uint8_t pty_read_mem(const uint8_t *req, uint8_t len, uint8_t *rsp, uint8_t *rsp_len) {
+    uint32_t addr = (uint32_t)req[0] | ((uint32_t)req[1] << 8) | ((uint32_t)req[2] << 16) | ((uint32_t)req[3] << 24);
+    (void)len;
+    if (req[4] == 0 || req[4] > PROTO_READ_MAX || addr < PTY_MEM_BASE || addr >= PTY_MEM_BASE + PTY_MEM_SIZE ||
+        req[4] > PTY_MEM_BASE + PTY_MEM_SIZE - addr) return PROTO_ST_ARG;           // Без addr + n: переполнение uint32
+    memcpy(rsp, &pty_mem[addr - PTY_MEM_BASE], req[4]);
+    *rsp_len = req[4];
+    return PROTO_ST_OK;
+}
+
+static const proto_cmd_t pty_table[PROTO_MSG_COUNT] = {
+    [PROTO_MSG_PING]     = { pty_ping,     0, PROTO_MAX_PAYLOAD - 1 },
+    [PROTO_MSG_LED]      = { pty_led,      1, 1 },
+    [PROTO_MSG_READ_MEM] = { pty_read_mem, 5, 5 },
+};
+
+static void *pty_device(void *arg) {
+    uint8_t buf[64];
+    ssize_t n;
+    (void)arg;
+
+    while ((n = read(pty_slave, buf, sizeof(buf))) > 0) proto_rx(buf, (uint16_t)n); // Участки произвольной длины, как от DMA
+    return 0;
+}
+
+/* ---------------------------------------- Сторона host ---------------------------------------- */
+
+static int pty_write(const void *data, size_t len) {
+    return write(link_.fd, data, len) == (ssize_t)len;
+}
+
+static void pty_codec(void) {
+    proto_dec_t dec;
+    uint8_t     payload[PROTO_MAX_PAYLOAD], out[PROTO_MAX_ENCODED];
+    int         ok = 1, zeros = 1;
+
+    printf("Кодек COBS + CRC-16:\n");
+    pty_check("CRC-16/CCITT-FALSE(\"123456789\") = 0x29B1", proto_crc16(0xFFFF, (const uint8_t *)"123456789", 9) == 0x29B1);
+
+    proto_dec_reset(&dec);
+    for (int len = 0; len <= PROTO_MAX_PAYLOAD; len++) {
+        for (int i = 0; i < len; i++) payload[i] = (uint8_t)((i * 37 + len) % 5 == 0 ? 0 : rand());
+        uint16_t n = proto_encode(0x11, (uint8_t)len, payload, (uint8_t)len, out);
+        uint8_t  res = PROTO_DEC_MORE;
+        for (uint16_t i = 1; i + 1 < n; i++) if (out[i] == 0) zeros = 0;  // Нулевые байты - только разделители
+        for (uint16_t i = 0; i < n; i++) res = proto_dec_byte(&dec, out[i]);
+        if (res != PROTO_DEC_FRAME || dec.len != PROTO_HDR_SIZE + len || dec.buf[0] != 0x11 ||
+            memcmp(&dec.buf[PROTO_HDR_SIZE], payload, len) != 0) ok = 0;
+    }
+    pty_check("кадры 0..64 байт: декодированы без изменений", ok);
+    pty_check("в закодированном кадре нет нулевых байт", zeros);
+    pty_check("длина данных больше PROTO_MAX_PAYLOAD отклоняется", proto_encode(1, 0, payload, PROTO_MAX_PAYLOAD + 1, out) == 0);
+
+    uint16_t n = proto_encode(0x22, 7, payload, 10, out);
+    out[5] ^= 0x40;
+    uint8_t res = PROTO_DEC_MORE;
+    for (uint16_t i = 0; i < n; i++) if (res == PROTO_DEC_MORE) res = proto_dec_byte(&dec, out[i]);
+    pty_check("искажённый байт: ошибка CRC или структуры", res == PROTO_DEC_CRC || res == PROTO_DEC_MALFORMED);
+
+    memset(out, 0x55, sizeof(out));
+    res = PROTO_DEC_MORE;
+    for (int i = 0; i < 200; i++) { uint8_t r = proto_dec_byte(&dec, 0x55); if (r != PROTO_DEC_MORE) res = r; }
+    pty_check("кадр без разделителя длиннее буфера: нет ложного приёма", res == PROTO_DEC_MORE);
+    pty_check("... отброшен на разделителе", proto_dec_byte(&dec, 0) == PROTO_DEC_OVERFLOW);
+
+    // Время разбора: 1 000 000 байт кадров PING по 63 байта
+    n = proto_encode(PROTO_MSG_PING, 0, payload, PROTO_MAX_PAYLOAD - 1, out);
+    struct timespec t0, t1;
+    uint32_t frames = 0, bytes = 0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    while (bytes < 1000000) {
+        for (uint16_t i = 0; i < n; i++) frames += proto_dec_byte(&dec, out[i]) == PROTO_DEC_FRAME;
+        bytes += n;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+    pty_check("все кадры потока разобраны", frames == bytes / n);
+    printf("  %-52s %.2f нс/байт (host)\n", "разбор:", ns / bytes);
+}
+
+int main(void) {
+    uint8_t   req[PROTO_MAX_PAYLOAD], rsp[PROTO_MAX_PAYLOAD], rsp_len, out[PROTO_MAX_ENCODED];
+    int       master, st, ok;
+    pthread_t thr;
+    struct termios tio;
+
+    pty_codec();
+
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) || unlockpt(master)) { perror("posix_openpt"); return 1; }
+    pty_slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    if (pty_slave < 0) { perror("ptsname"); return 1; }
+    tcgetattr(pty_slave, &tio);
+    cfmakeraw(&tio);                                     // Без эха и преобразования 0x0A/0x0D
+    tcsetattr(pty_slave, TCSANOW, &tio);
+
+    for (int i = 0; i < PTY_MEM_SIZE; i++) pty_mem[i] = (uint8_t)(i ^ 0xA5);
+    proto_init(pty_table, PROTO_MSG_COUNT, pty_tx);
+    proto_link_attach(&link_, master);
+    pthread_create(&thr, 0, pty_device, 0);
+
+    printf("Запросы через псевдотерминал %s:\n", ptsname(master));
+    for (int i = 0; i < PROTO_MAX_PAYLOAD - 1; i++) req[i] = (uint8_t)(i % 3 ? i : 0);
+    st = proto_link_request(&link_, PROTO_MSG_PING, req, PROTO_MAX_PAYLOAD - 1, rsp, &rsp_len, PTY_TIMEOUT);
+    pty_check("PING 63 байта (с нулевыми байтами): эхо", st == PROTO_ST_OK && rsp_len == PROTO_MAX_PAYLOAD - 1 &&
+              memcmp(req, rsp, rsp_len) == 0);
+    st = proto_link_request(&link_, PROTO_MSG_PING, req, 0, rsp, &rsp_len, PTY_TIMEOUT);
+    pty_check("PING без данных", st == PROTO_ST_OK && rsp_len == 0);
+
+    req[0] = 0x05;
+    st = proto_link_request(&link_, PROTO_MSG_LED, req, 1, rsp, &rsp_len, PTY_TIMEOUT);
+    pty_check("LED: маска 0x05", st == PROTO_ST_OK && pty_leds == 0x05);
+    req[0] = 0x10;
+    pty_check("LED: недопустимая маска -> PROTO_ST_ARG",
+              proto_link_request(&link_, PROTO_MSG_LED, req, 1, rsp, &rsp_len, PTY_TIMEOUT) == PROTO_ST_ARG);
+    pty_check("LED: неверная длина -> PROTO_ST_LENGTH",
+              proto_link_request(&link_, PROTO_MSG_LED, req, 2, rsp, &rsp_len, PTY_TIMEOUT) == PROTO_ST_LENGTH);
+    pty_check("неподдерживаемая команда (PWM) -> PROTO_ST_UNKNOWN",
+              proto_link_request(&link_, PROTO_MSG_PWM, req, 3, rsp, &rsp_len, PTY_TIMEOUT) == PROTO_ST_UNKNOWN);
+    pty_check("идентификатор вне таблицы -> PROTO_ST_UNKNOWN",
+              proto_link_request(&link_, 0x42, req, 0, rsp, &rsp_len, PTY_TIMEOUT) == PROTO_ST_UNKNOWN);
+
+    uint32_t addr = PTY_MEM_BASE + 200;
+    memcpy(req, &addr, 4);
+    req[4] = 56;
+    st = proto_link_request(&link_, PROTO_MSG_READ_MEM, req, 5, rsp, &rsp_len, PTY_TIMEOUT);
+    pty_check("READ_MEM 56 байт", st == PROTO_ST_OK && rsp_len == 56 && memcmp(rsp, &pty_mem[200], 56) == 0);
+    req[4] = 57;
+    pty_check("READ_MEM за границей памяти -> PROTO_ST_ARG",
+              proto_link_request(&link_, PROTO_MSG_READ_MEM, req, 5, rsp, &rsp_len, PTY_TIMEOUT) == PROTO_ST_ARG);
+    addr = 0xFFFFFFF0UL;                                  // addr + 32 = 0x10 в uint32
+    memcpy(req, &addr, 4);
+    req[4] = 32;
+    pty_check("READ_MEM с переполнением адреса -> PROTO_ST_ARG",
+              proto_link_request(&link_, PROTO_MSG_READ_MEM, req, 5, rsp, &rsp_len, PTY_TIMEOUT) == PROTO_ST_ARG);
+
+    printf("Ошибки линии:\n");
+    uint16_t n = proto_encode(PROTO_MSG_PING, 99, req, 8, out);
+    out[4] ^= 0x01;
+    pty_write(out, n);
+    st = proto_link_request(&link_, PROTO_MSG_PING, req, 4, rsp, &rsp_len, PTY_TIMEOUT);
+    pty_check("кадр с ошибкой CRC отброшен, следующий обработан", st == PROTO_ST_OK && proto_stats.crc == 1);
+
+    pty_write("Button S1\n", 10);                         // Текст вне протокола перед кадром
+    st = proto_link_request(&link_, PROTO_MSG_PING, req, 4, rsp, &rsp_len, PTY_TIMEOUT);
+    pty_check("текст вне протокола: следующий кадр принят", st == PROTO_ST_OK && proto_stats.malformed == 1);
+
+    n = proto_encode(PROTO_MSG_PING, ++link_.seq, req, 20, out);
+    for (uint16_t i = 0; i < n; i++) { pty_write(&out[i], 1); usleep(200); } // По одному байту
+    uint8_t rid, rseq;
+    ok = proto_link_recv(&link_, &rid, &rseq, rsp, &rsp_len, PTY_TIMEOUT) == 1;
+    pty_check("кадр по одному байту", ok && rid == (PROTO_MSG_PING | PROTO_RSP) && rseq == link_.seq && rsp_len == 21);
+
+    // Пакет из 50 запросов без ожидания ответов
+    uint8_t first = link_.seq + 1;
+    for (int i = 0; i < 50; i++) { req[0] = (uint8_t)i; proto_link_send(&link_, PROTO_MSG_PING, req, 1); }
+    ok = 1;
+    for (int i = 0; i < 50; i++) {
+        if (proto_link_recv(&link_, &rid, &rseq, rsp, &rsp_len, PTY_TIMEOUT) != 1 || rseq != (uint8_t)(first + i) ||
+            rsp_len != 2 || rsp[1] != i) ok = 0;
+    }
+    pty_check("50 запросов подряд: ответы по порядку", ok);
+    pty_check("кадров с верной CRC принято стороной платы: 63", proto_stats.frames == 63);
+    pty_check("ошибок приёма на стороне host нет", link_.errors == 0);
+
+    printf("Непройдено проверок: %d\n", pty_failed);
+    return pty_failed;
+}
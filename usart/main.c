@@ -16,11 +16,19 @@
                   OPTION2: При использовании этой опции, обработчик прерываний EXTI отправляет строки "Button S1\n",
                   "Button S2\n" и "Button S3\n" через USART1 при нажатии соответствующих кнопок S1, S2 и S3.
 
-                  USART также обрабатывает входящие данные для включения и выключения светодиодов в зависимости 
-                  от полученного символа ('0' выключает все светодиоды, '1', '2', '3' включают соответствующие 
-                  светодиоды PE13, PE14, PE15).
+                  Входящие данные USART - кадры двоичного протокола (proto.h: COBS, CRC-16, таблица обработчиков):
+                  включение светодиодов PE13, PE14, PE15, яркость LED1/LED2 (ШИМ TIM1), чтение внутренней flash,
+                  поток отсчётов АЦП. Обработчики команд - proto_cmd.c, клиент для Linux - host/proto_link.c.
+                  Приём выполняет DMA2 Stream2 в кольцевой буфер usart_rx.c: прерывание возникает на паузе после
+                  кадра (IDLE) и на половине/конце буфера, а не на каждый байт.
                   
                   Для выбора OPTION1 или OPTION 2 необходимо их раскомментировать по одному в файле main.h
+
+                  Передача не блокирует обработчик EXTI: символы и строки ставятся в кольцевой буфер usart_tx.c
+                  и передаются из прерывания USART1 по флагу TXE (наибольшее заполнение - usart_tx_stats.hwm).
+
+                  DLOG_ENABLE (main.h): отладочные записи DLOG() - идентификатор строки формата и аргументы -
+                  передаются через DMA2 Stream7 между сообщениями буфера передачи, текст восстанавливает host/dlog_dump.
                   
 
    
@@ -30,6 +38,11 @@
 
 #include "main.h"
 
+usart_baud_t usart1_baud; // Полученная скорость USART1 и её ошибка
+
+// Выводы и скорость USART1 (usart_port.h); потоки DMA настраивают usart_rx.c (приём) и dlog.c (журнал)
+static const usart_port_cfg_t usart1_cfg = { UART_HW_USART1, USART1_BAUD, 0, 0, 0, 0, USART_RX_IRQ_PRIO, 0,
+                                             UART_FC_NONE };
 
 
 int main(void) {
@@ -39,8 +52,17 @@ int main(void) {
     EXTI_Init();    // Инициализация EXTI для обработки прерываний от кнопок
     GPIO_Init();    // Настройка GPIO для управления светодиодами и кнопками
     USART1_Init();  // Инициализация USART1 для обмена данными по UART
+    proto_cmd_init(); // ШИМ, АЦП и таблица команд протокола
+#if defined(DLOG_ENABLE)
+    dlog_init();      // Журнал DLOG(): DWT->CYCCNT, DMA2 Stream7
+#endif
 
-    while (1) {}
+    while (1) {
+        proto_cmd_poll(); // Поток отсчётов АЦП
+#if defined(DLOG_ENABLE)
+        dlog_poll();      // Передача накопленных записей журнала
+#endif
+    }
 }
 
 /* Инициализация EXTI */
@@ -71,20 +93,10 @@ void EXTI_Init(void) {
 /* Инициализация USART1 */
 void USART1_Init(void) {
 
-    RCC->AHB1ENR  |= RCC_AHB1ENR_GPIOAEN;                                        // вкл. тактирования GPIOA
-
-    GPIOA->MODER  |= GPIO_MODER_MODE9_1 | GPIO_MODER_MODE10_1;                   // Альт. режим работы 
-    GPIOA->AFR[1] |= (7 << GPIO_AFRH_AFSEL9_Pos) | (7 << GPIO_AFRH_AFSEL10_Pos); // AF7 для A9, A10
-
-    RCC->APB2ENR  |= RCC_APB2ENR_USART1EN;                                       // Включение тактирования USART1
-    // 84MHz / 115200bod / 16 = 45,57  M=45 (0x2D) F=0,57*16=9 (0x09)
-    USART1->BRR    = 0x02D9;                                                     // Boudrate = 115200
+    usart_port_hw_init(&usart1_cfg, &usart1_baud);                               // Тактирование, PA9/PA10 (AF7), BRR по APB2, 8N1
                    
-    USART1->CR1   |= USART_CR1_RXNEIE;                                           // Прерывание по приему 
+    usart_rx_init(USART1_RxHandler);                                             // Приём через DMA2 Stream2, прерывание IDLE
     USART1->CR1   |= USART_CR1_TE | USART_CR1_RE;                                //  Вкл. передатчик и приемник
-                  
-    USART1->CR1   &= ~(USART_CR1_M) | ~(USART_CR1_PCE);                          // 8-бит, без контроля четности  
-    USART1->CR2   &= ~(USART_CR2_STOP);                                          // 1 стоповый бит                                                   
                                                                                  
     NVIC_EnableIRQ(USART1_IRQn);                                                 // Разрешение прерывания NVIC
                                                                                  
@@ -102,12 +114,12 @@ void GPIO_Init(void) {
     ALL_LEDS_OFF;                                                                    // Предварительное отключение LED по дефолту
 }
 
-/* Функция отправки строки через USART */
+/* Функция отправки строки через USART (постановка в буфер передачи без ожидания передатчика) */
 void sendStringUSART(char* str) {
-    while (*str) {                            // Пока не достигнут конец строки (символ '\0')
-        while (!(USART1->SR & USART_SR_TXE)); // Ожидание готовности передатчика (TXE = 1)
-        USART1->DR = *str++;                  // Запись символа в регистр данных USART и переход к следующему символу
-    }
+    uint16_t len = 0;
+
+    while (str[len]) len++;                   // Длина строки до символа '\0'
+    usart_tx_put(str, len);                   // Строка передаётся из прерывания USART1 по TXE
 }
 
 
@@ -116,17 +128,17 @@ void sendStringUSART(char* str) {
 void EXTI15_10_IRQHandler(void) {
 
     if (EXTI->PR & EXTI_PR_PR10) {  // Проверка флага прерывания для EXTI10
-        USART1->DR = '1';           // Отправка символа '1' через USART1
+        usart_tx_put("1", 1);       // Отправка символа '1' через USART1
         EXTI->PR |= EXTI_PR_PR10;   // Сброс флага прерывания для EXTI10
     }
 
     if (EXTI->PR & EXTI_PR_PR11) {  // Проверка флага прерывания для EXTI11
-        USART1->DR = '2';           // Отправка символа '2' через USART1
+        usart_tx_put("2", 1);       // Отправка символа '2' через USART1
         EXTI->PR |= EXTI_PR_PR11;   // Сброс флага прерывания для EXTI11
     }
 
     if (EXTI->PR & EXTI_PR_PR12) {  // Проверка флага прерывания для EXTI12
-        USART1->DR = '3';           // Отправка символа '3' через USART1
+        usart_tx_put("3", 1);       // Отправка символа '3' через USART1
         EXTI->PR |= EXTI_PR_PR12;   // Сброс флага прерывания для EXTI12
     }
 }
@@ -138,6 +150,8 @@ void EXTI15_10_IRQHandler(void) {
 
     if (EXTI->PR & EXTI_PR_PR10) {        // Проверка флага прерывания для EXTI10
         sendStringUSART("Button S1\n\n"); // Отправка строки "Button S1\n\n" через USART1 при нажатии S1
+        DLOG("S1: tx hwm %u, dropped %u", usart_tx_stats.hwm, usart_tx_stats.dropped);
+        DLOG("dlog: %u cycles/call, max %u", dlog_stats.cycles, dlog_stats.cycles_max);
         EXTI->PR |= EXTI_PR_PR10;         // Сброс флага прерывания для EXTI10
     }
     if (EXTI->PR & EXTI_PR_PR11) {        // Проверка флага прерывания для EXTI11
@@ -152,28 +166,17 @@ void EXTI15_10_IRQHandler(void) {
 #endif
 
 
+/* Обработка принятых данных: участок кольцевого буфера приёма (вызывается из прерывания IDLE/HT/TC) */
+void USART1_RxHandler(const uint8_t *data, uint16_t len, uint8_t end) {
+    (void)end;                                // Границы кадров задают разделители COBS
+
+    proto_rx(data, len);                      // Сборка кадров протокола и вызов обработчиков команд
+}
+
 /* Обработчик прерывания USART1 */
 void USART1_IRQHandler(void) {
-    if ((USART1->SR & USART_SR_RXNE) != 0) {  // Проверка флага приема данных (RXNE = 1)
-        uint16_t RXc = (uint16_t)(USART1->DR & (uint16_t)0x01FF);  // Чтение принятого символа из регистра данных
-
-        switch (RXc) {
-            case '0':
-                ALL_LEDS_OFF;  // Выключение всех светодиодов
-                break;
-            case '1':
-                LED1_ON;  // Включение светодиода LED1 (PE13)
-                break;
-            case '2':
-                LED2_ON;  // Включение светодиода LED2 (PE14)
-                break;
-            case '3':
-                LED3_ON;  // Включение светодиода LED3 (PE15)
-                break;
-            default:
-                break;  // Игнорирование других символов
-        }
-    }
+    usart_tx_irq();                           // Передача следующего байта из буфера (TXE)
+    usart_rx_irq();                           // Пауза на линии (IDLE) - передача принятого кадра
 
     NVIC_ClearPendingIRQ(USART1_IRQn);  // Сброс запроса прерывания USART1
 }
\ No newline at end of file
@@ -2,6 +2,11 @@
 #define MAIN_H
 
 #include <stm32f4xx.h>
+#include "usart_tx.h"
+#include "usart_rx.h"
+#include "proto_cmd.h"
+#include "usart_baud.h"
+#include "usart_port.h"
 
 // Макросы для управления светодиодами
 #define LED1_ON     GPIOE->ODR  &= ~GPIO_ODR_OD13
@@ -19,17 +24,26 @@
 // Макрос для включения всех светодиодов
 #define ALL_LEDS_ON GPIOE->ODR &= ~(GPIO_ODR_OD13 | GPIO_ODR_OD14 | GPIO_ODR_OD15)
 
+#define USART1_BAUD 115200 // Скорость USART1, бод (до 10,5 Мбод: выше 5,25 Мбод - OVER8)
+
 // Конфигурационные опции
 // раскоментируйте по одному
 //#define OPTION1 1
   #define OPTION2 2
 
+// Отложенный двоичный журнал DLOG() через DMA2 Stream7 (dlog.h, расшифровка - host/dlog_dump).
+// Записи передаются по той же линии USART1, что и кадры протокола: включать для отладки
+//#define DLOG_ENABLE 1
+
+#include "dlog.h"
+
 // Прототипы функций
 void RCC_Init(void);
 void EXTI_Init(void);
 void USART1_Init(void);
 void GPIO_Init(void);
 void sendStringUSART(char* str);
+void USART1_RxHandler(const uint8_t *data, uint16_t len, uint8_t end);
 
 #endif // MAIN_H
 
@@ -0,0 +1,105 @@
+/**
+-------------------------------------------------------------------------------------------------------------------------------------------------------
+
+ * @file        : proto.c
+ * @brief       : Двоичный протокол команд: разбор принятого потока и вызов обработчиков из таблицы.
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ * @Description : proto_rx() передаёт байты декодеру proto_codec.c; для каждого кадра с верной CRC обработчик
+ *                выполняется сразу (в контексте вызывающего - на плате это прерывание приёма USART1), ответ
+ *                кодируется в статический буфер и передаётся функцией proto_tx_t.
+ *                Ответ на запрос отправляется всегда, кроме кадров с ошибкой CRC или структуры: у такого кадра
+ *                нельзя доверять ни идентификатору, ни seq, повтор запроса - по тайм-ауту на стороне host.
+ -------------------------------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#include "proto.h"
+
+proto_stats_t proto_stats;
+
+static proto_dec_t        proto_dec;           // Декодер принятого потока
+static const proto_cmd_t *proto_table = 0;     // Таблица обработчиков
+static uint8_t            proto_count = 0;     // Размер таблицы
+static proto_tx_t         proto_tx    = 0;     // Функция передачи
+
+/**
+ * @brief Настройка протокола.
+ *
+ * @param table Таблица обработчиков, индекс - идентификатор сообщения.
+ * @param count Размер таблицы.
+ * @param tx    Функция передачи закодированного кадра.
+ */
+void proto_init(const proto_cmd_t *table, uint8_t count, proto_tx_t tx) {
+    proto_table = table;
+    proto_count = count;
+    proto_tx    = tx;
+    proto_dec_reset(&proto_dec);
+}
+
+/**
+ * @brief Кодирование и передача кадра.
+ *
+ * @return uint8_t 1 - кадр передан функции передачи, 0 - данные слишком длинные или функция отказала.
+ */
+uint8_t proto_send(uint8_t id, uint8_t seq, const uint8_t *payload, uint8_t len) {
+    uint8_t  out[PROTO_MAX_ENCODED];
+    uint16_t n = proto_encode(id, seq, payload, len, out);
+
+    if (n && proto_tx && proto_tx(out, n)) return 1;
+
+    proto_stats.tx_drop++;
+    return 0;
+}
+
+/**
+ * @brief Вызов обработчика для принятого кадра и передача ответа.
+ */
+static void proto_dispatch(const uint8_t *frame, uint8_t len) {
+    uint8_t            rsp[PROTO_MAX_PAYLOAD];
+    uint8_t            rsp_len = 0;
+    uint8_t            id = frame[0], seq = frame[1];
+    const proto_cmd_t *cmd = (id < proto_count) ? &proto_table[id] : 0;
+
+    len -= PROTO_HDR_SIZE;
+
+    if (!cmd || !cmd->fn) {
+        proto_stats.unknown++;
+        rsp[0] = PROTO_ST_UNKNOWN;
+    } else if (len < cmd->min_len || len > cmd->max_len) {
+        rsp[0] = PROTO_ST_LENGTH;
+    } else {
+        rsp[0] = cmd->fn(&frame[PROTO_HDR_SIZE], len, &rsp[1], &rsp_len);
+    }
+
+    proto_send(id | PROTO_RSP, seq, rsp, (uint8_t)(1 + (rsp[0] == PROTO_ST_OK ? rsp_len : 0)));
+}
+
+/**
+ * @brief Разбор принятых байт.
+ *
+ * Данные могут приходить любыми частями: кадр собирается декодером между вызовами.
+ *
+ * @param data Принятые байты.
+ * @param len  Количество байт.
+ */
+void proto_rx(const uint8_t *data, uint16_t len) {
+    for (uint16_t i = 0; i < len; i++) {
+        switch (proto_dec_byte(&proto_dec, data[i])) {
+            case PROTO_DEC_MORE:
+                break;
+            case PROTO_DEC_FRAME:
+                proto_stats.frames++;
+                proto_dispatch(proto_dec.buf, (uint8_t)proto_dec.len);
+                break;
+            case PROTO_DEC_CRC:
+                proto_stats.crc++;
+                break;
+            default:
+                proto_stats.malformed++;
+                break;
+        }
+    }
+}
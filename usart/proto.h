@@ -0,0 +1,73 @@
+/**
+-------------------------------------------------------------------------------------------------------------------------------------------------------
+
+ * @file        : proto.h
+ * @brief       : Двоичный протокол команд: сообщения, таблица обработчиков и разбор принятого потока.
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ * @Description : Запрос - кадр proto_codec.h с идентификатором PROTO_MSG_*. Ответ - кадр с идентификатором id | PROTO_RSP,
+ *                тем же seq и данными [статус PROTO_ST_*][данные ответа]. Сообщения без запроса (поток АЦП) передаются
+ *                с идентификатором PROTO_MSG_ADC_DATA | PROTO_RSP и seq = 0.
+ *                Обработчик выбирается индексом в таблице proto_cmd_t[id] за постоянное время; длина данных запроса
+ *                проверяется по min_len/max_len до вызова обработчика.
+ *                Модуль не зависит от периферии: передача выполняется функцией proto_tx_t, заданной в proto_init(),
+ *                поэтому он же собирается на host (host/proto_pty.c). Описание сообщений используют обе стороны.
+ -------------------------------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#ifndef PROTO_H
+#define PROTO_H
+
+#include "proto_codec.h"
+
+// Идентификаторы сообщений (данные - little-endian)
+#define PROTO_MSG_PING       0x01 // Запрос: любые данные. Ответ: те же данные
+#define PROTO_MSG_LED        0x02 // Запрос: [маска LED1..LED3 (биты 0..2), 1 - включён]
+#define PROTO_MSG_PWM        0x03 // Запрос: [канал 1..2 (LED1, LED2)][скважность u16, 0..1000 - 0,1 %]
+#define PROTO_MSG_READ_MEM   0x04 // Запрос: [адрес u32][длина u8, 1..PROTO_READ_MAX]. Ответ: данные
+#define PROTO_MSG_ADC_STREAM 0x05 // Запрос: [канал АЦП u8][период мс u16][количество u16, 0 - остановка]
+#define PROTO_MSG_ADC_DATA   0x06 // Сообщение без запроса: [номер отсчёта u16][значение u16]
+#define PROTO_MSG_COUNT      0x07 // Размер таблицы обработчиков
+
+#define PROTO_RSP      0x80                  // Признак ответа в идентификаторе
+#define PROTO_READ_MAX (PROTO_MAX_PAYLOAD - 1) // Наибольшая длина чтения памяти (статус + данные)
+
+// Статус ответа
+#define PROTO_ST_OK      0 // Выполнено
+#define PROTO_ST_UNKNOWN 1 // Неизвестный идентификатор
+#define PROTO_ST_LENGTH  2 // Неверная длина данных запроса
+#define PROTO_ST_ARG     3 // Недопустимое значение параметра
+#define PROTO_ST_BUSY    4 // Команда не может быть выполнена сейчас
+
+// Обработчик команды: данные запроса, буфер данных ответа (до PROTO_MAX_PAYLOAD - 1 байт). Возврат - статус PROTO_ST_*
+typedef uint8_t (*proto_handler_t)(const uint8_t *req, uint8_t len, uint8_t *rsp, uint8_t *rsp_len);
+
+// Элемент таблицы обработчиков
+typedef struct {
+    proto_handler_t fn;      // Обработчик или 0 - идентификатор не поддерживается
+    uint8_t         min_len; // Наименьшая длина данных запроса
+    uint8_t         max_len; // Наибольшая длина данных запроса
+} proto_cmd_t;
+
+// Функция передачи закодированного кадра. Возврат - 1 при успехе
+typedef uint8_t (*proto_tx_t)(const uint8_t *data, uint16_t len);
+
+// Статистика разбора
+typedef struct {
+    uint32_t frames;    // Принято кадров с верной CRC
+    uint32_t crc;       // Ошибок CRC
+    uint32_t malformed; // Кадров с неверной структурой или длиннее PROTO_MAX_FRAME
+    uint32_t unknown;   // Запросов с неизвестным идентификатором
+    uint32_t tx_drop;   // Ответов, не принятых функцией передачи
+} proto_stats_t;
+
+extern proto_stats_t proto_stats;
+
+void    proto_init(const proto_cmd_t *table, uint8_t count, proto_tx_t tx); // Таблица обработчиков и функция передачи
+void    proto_rx(const uint8_t *data, uint16_t len);                        // Разбор принятых байт и вызов обработчиков
+uint8_t proto_send(uint8_t id, uint8_t seq, const uint8_t *payload, uint8_t len); // Передача кадра
+
+#endif // PROTO_H
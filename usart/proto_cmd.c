@@ -0,0 +1,199 @@
+/**
+-------------------------------------------------------------------------------------------------------------------------------------------------------
+
+ * @file        : proto_cmd.c
+ * @brief       : Обработчики команд двоичного протокола: светодиоды, ШИМ, чтение памяти, поток АЦП.
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ * @Description : - PROTO_MSG_LED переводит PE13..PE15 в режим выхода и задаёт состояние светодиодов (0 - включён).
+ *                - PROTO_MSG_PWM переводит PE13 (TIM1_CH3) или PE14 (TIM1_CH4) в альтернативный режим AF1 и задаёт
+ *                  скважность; полярность каналов инвертирована (CCxP = 1), т.к. светодиоды включаются нулём.
+ *                - PROTO_MSG_READ_MEM читает внутреннюю flash (0x08000000..0x0807FFFF) или системную память/OTP/UID
+ *                  (0x1FFF0000..0x1FFF7A1F); другие адреса отклоняются, чтобы не обращаться к несуществующей памяти.
+ *                - PROTO_MSG_ADC_STREAM запускает измерение канала ADC1 (IN0..IN7, выводы PA0..PA7) с заданным периодом.
+ *                Кадры передаются из прерывания USART1 и из основного цикла, поэтому постановка в буфер передачи
+ *                выполняется при запрещённых прерываниях.
+ -------------------------------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#include "main.h"
+#include "proto_cmd.h"
+
+#define PROTO_FLASH_START 0x08000000UL // Внутренняя flash (512 КБ)
+#define PROTO_FLASH_END   0x08080000UL
+#define PROTO_SYS_START   0x1FFF0000UL // Системная память, OTP, уникальный идентификатор
+#define PROTO_SYS_END     0x1FFF7A20UL
+
+static volatile uint32_t proto_ms        = 0; // Счётчик миллисекунд (SysTick)
+static volatile uint16_t proto_adc_left  = 0; // Осталось отсчётов потока (0 - поток остановлен)
+static uint16_t          proto_adc_period;    // Период потока, мс
+static uint16_t          proto_adc_index;     // Номер следующего отсчёта
+static uint32_t          proto_adc_next;      // Время следующего отсчёта, мс
+
+/**
+ * @brief Передача кадра через буфер передачи USART1 (источники - прерывание и основной цикл).
+ */
+static uint8_t proto_cmd_tx(const uint8_t *data, uint16_t len) {
+    uint32_t primask = __get_PRIMASK();
+    uint8_t  ok;
+
+    __disable_irq();
+    ok = usart_tx_put((const char *)data, len);
+    __set_PRIMASK(primask);
+
+    return ok;
+}
+
+/* PROTO_MSG_PING: ответ - данные запроса */
+static uint8_t proto_cmd_ping(const uint8_t *req, uint8_t len, uint8_t *rsp, uint8_t *rsp_len) {
+    for (uint8_t i = 0; i < len; i++) rsp[i] = req[i];
+    *rsp_len = len;
+    return PROTO_ST_OK;
+}
+
+/* PROTO_MSG_LED: [маска] */
+static uint8_t proto_cmd_led(const uint8_t *req, uint8_t len, uint8_t *rsp, uint8_t *rsp_len) {
+    (void)len; (void)rsp; (void)rsp_len;
+
+    if (req[0] & ~0x07) return PROTO_ST_ARG;
+
+    GPIOE->MODER = (GPIOE->MODER & ~(GPIO_MODER_MODE13 | GPIO_MODER_MODE14 | GPIO_MODER_MODE15)) |
+                   GPIO_MODER_MODE13_0 | GPIO_MODER_MODE14_0 | GPIO_MODER_MODE15_0; // Выходы (ШИМ отключён от выводов)
+    ALL_LEDS_OFF;
+    if (req[0] & 0x01) LED1_ON;
+    if (req[0] & 0x02) LED2_ON;
+    if (req[0] & 0x04) LED3_ON;
+
+    return PROTO_ST_OK;
+}
+
+/* PROTO_MSG_PWM: [канал][скважность u16] */
+static uint8_t proto_cmd_pwm(const uint8_t *req, uint8_t len, uint8_t *rsp, uint8_t *rsp_len) {
+    uint16_t duty = (uint16_t)(req[1] | (req[2] << 8));
+    uint8_t  pin;
+    (void)len; (void)rsp; (void)rsp_len;
+
+    if (req[0] < 1 || req[0] > 2 || duty > 1000) return PROTO_ST_ARG;
+
+    if (req[0] == 1) { TIM1->CCR3 = duty; pin = 13; }
+    else             { TIM1->CCR4 = duty; pin = 14; }
+
+    GPIOE->MODER = (GPIOE->MODER & ~(3UL << (2 * pin))) | (2UL << (2 * pin)); // Альтернативный режим (AF1 - TIM1)
+    DLOG("PWM ch%u duty %u/1000", req[0], duty);
+
+    return PROTO_ST_OK;
+}
+
+/* Участок addr..addr + n - 1 внутри окна start..end - 1: без вычисления addr + n (переполнение uint32) */
+static uint8_t proto_cmd_in(uint32_t addr, uint8_t n, uint32_t start, uint32_t end) {
+    return addr >= start && addr < end && n <= end - addr;
+}
+
+/* PROTO_MSG_READ_MEM: [адрес u32][длина u8] */
+static uint8_t proto_cmd_read_mem(const uint8_t *req, uint8_t len, uint8_t *rsp, uint8_t *rsp_len) {
+    uint32_t addr = (uint32_t)req[0] | ((uint32_t)req[1] << 8) | ((uint32_t)req[2] << 16) | ((uint32_t)req[3] << 24);
+    uint8_t  n    = req[4];
+    (void)len;
+
+    if (n == 0 || n > PROTO_READ_MAX) return PROTO_ST_ARG;
+    if (!(proto_cmd_in(addr, n, PROTO_FLASH_START, PROTO_FLASH_END) ||
+          proto_cmd_in(addr, n, PROTO_SYS_START, PROTO_SYS_END))) return PROTO_ST_ARG;
+
+    for (uint8_t i = 0; i < n; i++) rsp[i] = *(const volatile uint8_t *)(addr + i);
+    *rsp_len = n;
+
+    return PROTO_ST_OK;
+}
+
+/* PROTO_MSG_ADC_STREAM: [канал][период u16][количество u16] */
+static uint8_t proto_cmd_adc_stream(const uint8_t *req, uint8_t len, uint8_t *rsp, uint8_t *rsp_len) {
+    uint16_t period = (uint16_t)(req[1] | (req[2] << 8));
+    uint16_t count  = (uint16_t)(req[3] | (req[4] << 8));
+    (void)len; (void)rsp; (void)rsp_len;
+
+    proto_adc_left = 0;                                    // Остановка текущего потока
+    if (count == 0) return PROTO_ST_OK;
+    if (req[0] > 7 || period < PROTO_ADC_PERIOD_MIN) return PROTO_ST_ARG;
+
+    GPIOA->MODER |= 3UL << (2 * req[0]);                   // Аналоговый режим вывода PAx
+    ADC1->SQR3    = req[0];                                // Канал единственного преобразования
+    proto_adc_period = period;
+    proto_adc_index  = 0;
+    proto_adc_next   = proto_ms;
+    proto_adc_left   = count;                              // Запуск - последним
+
+    return PROTO_ST_OK;
+}
+
+// Таблица обработчиков: индекс - идентификатор сообщения
+static const proto_cmd_t proto_cmd_table[PROTO_MSG_COUNT] = {
+    [PROTO_MSG_PING]       = { proto_cmd_ping,       0, PROTO_MAX_PAYLOAD - 1 },
+    [PROTO_MSG_LED]        = { proto_cmd_led,        1, 1 },
+    [PROTO_MSG_PWM]        = { proto_cmd_pwm,        3, 3 },
+    [PROTO_MSG_READ_MEM]   = { proto_cmd_read_mem,   5, 5 },
+    [PROTO_MSG_ADC_STREAM] = { proto_cmd_adc_stream, 5, 5 },
+};
+
+/**
+ * @brief Настройка TIM1 (ШИМ 1 кГц, каналы 3, 4), ADC1, SysTick и протокола.
+ */
+void proto_cmd_init(void) {
+    RCC->APB2ENR |= RCC_APB2ENR_TIM1EN | RCC_APB2ENR_ADC1EN;   // Тактирование TIM1 и ADC1 (APB2 - 84 МГц)
+    RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN | RCC_AHB1ENR_GPIOEEN;
+
+    GPIOE->AFR[1] |= (1 << GPIO_AFRH_AFSEL13_Pos) | (1 << GPIO_AFRH_AFSEL14_Pos); // AF1 (TIM1) для E13, E14
+
+    TIM1->PSC   = 84 - 1;                                       // 1 МГц
+    TIM1->ARR   = 1000 - 1;                                     // 1 кГц, шаг скважности 0,1 %
+    TIM1->CCMR2 = (6 << TIM_CCMR2_OC3M_Pos) | TIM_CCMR2_OC3PE |  // ШИМ режим 1 с предзагрузкой
+                  (6 << TIM_CCMR2_OC4M_Pos) | TIM_CCMR2_OC4PE;
+    TIM1->CCER  = TIM_CCER_CC3E | TIM_CCER_CC3P | TIM_CCER_CC4E | TIM_CCER_CC4P; // Активный уровень - 0
+    TIM1->BDTR |= TIM_BDTR_MOE;                                 // Разрешение выходов (TIM1 - расширенный таймер)
+    TIM1->CR1  |= TIM_CR1_ARPE | TIM_CR1_CEN;
+
+    ADC->CCR    = ADC_CCR_ADCPRE_0;                             // ADCCLK = 84 / 4 = 21 МГц
+    ADC1->SMPR2 = 0x00FFFFFF;                                   // 480 тактов для IN0..IN7 (высокоомный источник)
+    ADC1->CR2   = ADC_CR2_ADON;
+
+    SysTick_Config(84000000UL / 1000);                          // Прерывание каждую 1 мс (HCLK 84 МГц после RCC_Init())
+
+    proto_init(proto_cmd_table, PROTO_MSG_COUNT, proto_cmd_tx);
+}
+
+/**
+ * @brief Обработчик прерывания SysTick: счётчик миллисекунд.
+ */
+void SysTick_Handler(void) {
+    proto_ms++;
+}
+
+/**
+ * @brief Измерение и передача очередного отсчёта потока АЦП, если наступило его время.
+ */
+void proto_cmd_poll(void) {
+    uint8_t  data[4];
+    uint16_t value;
+
+    if (proto_adc_left == 0 || (int32_t)(proto_ms - proto_adc_next) < 0) return;
+
+    ADC1->CR2 |= ADC_CR2_SWSTART;
+    while (!(ADC1->SR & ADC_SR_EOC));                           // Около 24 мкс при 480 тактах выборки
+    value = (uint16_t)ADC1->DR;
+
+    data[0] = (uint8_t)proto_adc_index;
+    data[1] = (uint8_t)(proto_adc_index >> 8);
+    data[2] = (uint8_t)value;
+    data[3] = (uint8_t)(value >> 8);
+    proto_send(PROTO_MSG_ADC_DATA | PROTO_RSP, 0, data, sizeof(data));
+
+    __disable_irq();                                            // Команда может изменить поток во время передачи
+    if (proto_adc_left) {
+        proto_adc_index++;
+        proto_adc_next += proto_adc_period;
+        proto_adc_left--;
+    }
+    __enable_irq();
+}
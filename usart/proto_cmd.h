@@ -0,0 +1,27 @@
+/**
+-------------------------------------------------------------------------------------------------------------------------------------------------------
+
+ * @file        : proto_cmd.h
+ * @brief       : Обработчики команд двоичного протокола: светодиоды, ШИМ, чтение памяти, поток АЦП.
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ * @Description : proto_cmd_init() настраивает TIM1 (ШИМ 1 кГц на LED1/LED2), ADC1, SysTick (1 мс) и таблицу протокола.
+ *                Обработчики выполняются в прерывании приёма USART1. Отсчёты потока АЦП измеряются и передаются
+ *                из основного цикла (proto_cmd_poll()), чтобы преобразование не задерживало приём.
+ -------------------------------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#ifndef PROTO_CMD_H
+#define PROTO_CMD_H
+
+#include "proto.h"
+
+#define PROTO_ADC_PERIOD_MIN 2 // Наименьший период потока АЦП, мс (кадр 10 байт при 115200 бод - 0,9 мс)
+
+void proto_cmd_init(void); // Настройка периферии команд и протокола
+void proto_cmd_poll(void); // Поток АЦП (вызывается из основного цикла)
+
+#endif // PROTO_CMD_H
@@ -0,0 +1,53 @@
+/**
+-------------------------------------------------------------------------------------------------------------------------------------------------------
+
+ * @file        : proto_codec.h
+ * @brief       : Кодирование кадров двоичного протокола: COBS и CRC-16 (общий код для микроконтроллера и host).
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ * @Description : Кадр до кодирования: [id][seq][данные 0..PROTO_MAX_PAYLOAD][crc16 младший байт][crc16 старший байт].
+ *                CRC-16/CCITT-FALSE (полином 0x1021, начальное значение 0xFFFF) вычисляется по id, seq и данным.
+ *                Кадр кодируется COBS (в закодированном кадре нет нулевых байт) и окружается разделителями 0x00,
+ *                поэтому после потери байта приёмник восстанавливает синхронизацию на следующем разделителе.
+ *                Декодер обрабатывает по одному байту за постоянное время (один переход автомата и шаг таблицы CRC),
+ *                память - один буфер кадра. Файлы не зависят от периферии и собираются также на host.
+ -------------------------------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#ifndef PROTO_CODEC_H
+#define PROTO_CODEC_H
+
+#include <stdint.h>
+
+#define PROTO_MAX_PAYLOAD 64                                             // Наибольшая длина данных кадра, байт
+#define PROTO_HDR_SIZE    2                                              // id, seq
+#define PROTO_MAX_FRAME   (PROTO_HDR_SIZE + PROTO_MAX_PAYLOAD + 2)        // Кадр до кодирования (с CRC)
+#define PROTO_MAX_ENCODED (PROTO_MAX_FRAME + PROTO_MAX_FRAME / 254 + 3)   // Закодированный кадр с разделителями
+
+// Результат обработки байта декодером
+#define PROTO_DEC_MORE      0 // Кадр не завершён
+#define PROTO_DEC_FRAME     1 // Принят кадр с верной CRC (dec->buf, dec->len без CRC)
+#define PROTO_DEC_CRC       2 // Ошибка CRC
+#define PROTO_DEC_OVERFLOW  3 // Кадр длиннее PROTO_MAX_FRAME
+#define PROTO_DEC_MALFORMED 4 // Неверная структура COBS или кадр короче заголовка с CRC
+
+// Состояние потокового декодера
+typedef struct {
+    uint8_t  buf[PROTO_MAX_FRAME]; // Декодированный кадр
+    uint16_t len;                  // Длина кадра
+    uint16_t crc;                  // CRC-16 по байтам buf[0 .. len - 3]
+    uint8_t  code;                 // Код текущего блока COBS (0 - начало кадра)
+    uint8_t  left;                 // Байт до конца текущего блока
+    uint8_t  error;                // Ошибка в текущем кадре (PROTO_DEC_OVERFLOW), кадр отбрасывается на разделителе
+} proto_dec_t;
+
+uint16_t proto_crc16(uint16_t crc, const uint8_t *buf, uint16_t len);               // CRC-16/CCITT-FALSE
+uint16_t proto_encode(uint8_t id, uint8_t seq, const uint8_t *payload, uint8_t len,
+                      uint8_t *out);                                               // Кадр COBS с разделителями
+void     proto_dec_reset(proto_dec_t *dec);                                        // Сброс декодера
+uint8_t  proto_dec_byte(proto_dec_t *dec, uint8_t b);                              // Обработка байта (PROTO_DEC_*)
+
+#endif // PROTO_CODEC_H
@@ -0,0 +1,101 @@
+/**
+-------------------------------------------------------------------------------------------------------------------------------------------------------
+
+ * @file        : usart_baud.c
+ * @brief       : Расчёт USARTx->BRR по фактической частоте шины APB и выбор передискретизации (OVER8).
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ * @Description : Формат BRR: DIV_Mantissa (биты 15:4) и DIV_Fraction (биты 3:0). При OVER8 = 1 дробная часть
+ *                занимает биты 2:0, бит 3 должен быть равен 0, поэтому D = 8 * M + F записывается как (M << 4) | F.
+ -------------------------------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#include "usart_baud.h"
+
+static const uint8_t usart_ahb_shift[8] = { 1, 2, 3, 4, 6, 7, 8, 9 }; // HPRE = 1xxx: деление на 2..512
+static const uint8_t usart_apb_shift[4] = { 1, 2, 3, 4 };             // PPRE = 1xx: деление на 2..16
+
+/**
+ * @brief Частота SYSCLK по регистрам RCC.
+ */
+static uint32_t usart_sysclk(void) {
+    uint32_t pllcfgr = RCC->PLLCFGR, src, m, n, p;
+
+    switch (RCC->CFGR & RCC_CFGR_SWS) {
+        case RCC_CFGR_SWS_HSE:
+            return USART_HSE_HZ;
+        case RCC_CFGR_SWS_PLL:
+            src = (pllcfgr & RCC_PLLCFGR_PLLSRC_HSE) ? USART_HSE_HZ : USART_HSI_HZ;
+            m   = (pllcfgr & RCC_PLLCFGR_PLLM) >> RCC_PLLCFGR_PLLM_Pos;
+            n   = (pllcfgr & RCC_PLLCFGR_PLLN) >> RCC_PLLCFGR_PLLN_Pos;
+            p   = (((pllcfgr & RCC_PLLCFGR_PLLP) >> RCC_PLLCFGR_PLLP_Pos) + 1) * 2;
+            return (uint32_t)((uint64_t)src * n / m / p);
+        default:
+            return USART_HSI_HZ;
+    }
+}
+
+/**
+ * @brief Частота шины APB, от которой тактируется модуль USART.
+ *
+ * @param usart Модуль USART1..USART6.
+ * @return uint32_t Частота, Гц.
+ */
+uint32_t usart_pclk(const USART_TypeDef *usart) {
+    uint32_t cfgr = RCC->CFGR, hclk = usart_sysclk(), ppre;
+
+    if (cfgr & RCC_CFGR_HPRE_3) hclk >>= usart_ahb_shift[((cfgr & RCC_CFGR_HPRE) >> RCC_CFGR_HPRE_Pos) & 7];
+
+    if (usart == USART1 || usart == USART6) ppre = (cfgr & RCC_CFGR_PPRE2) >> RCC_CFGR_PPRE2_Pos; // APB2
+    else                                    ppre = (cfgr & RCC_CFGR_PPRE1) >> RCC_CFGR_PPRE1_Pos; // APB1
+
+    return (ppre & 4) ? hclk >> usart_apb_shift[ppre & 3] : hclk;
+}
+
+/**
+ * @brief Настройка скорости модуля USART.
+ *
+ * На время записи OVER8 модуль отключается (UE = 0): вызывать, когда передача и приём не выполняются.
+ *
+ * @param usart Модуль USART1..USART6.
+ * @param baud  Требуемая скорость, бод.
+ * @param res   Результат (может быть 0).
+ * @return uint8_t 1 - скорость установлена с ошибкой не более USART_BAUD_ERR_MAX, 0 - скорость недостижима
+ *                 (BRR не изменяется) или ошибка больше допустимой.
+ */
+uint8_t usart_set_baud(USART_TypeDef *usart, uint32_t baud, usart_baud_t *res) {
+    uint32_t pclk = usart_pclk(usart), d, ue;
+    uint8_t  over8;
+    int32_t  error;
+
+    if (baud == 0) return 0;
+    d = (pclk + baud / 2) / baud;                              // Делитель в единицах 1/16 или 1/8 такта
+    if (d < 8 || d > 0xFFFF) return 0;                         // Выше fPCLK / 8 или ниже fPCLK / 65535
+    over8 = d < 16;
+
+    ue = usart->CR1 & USART_CR1_UE;
+    usart->CR1 &= ~USART_CR1_UE;
+    if (over8) {
+        usart->CR1 |= USART_CR1_OVER8;
+        usart->BRR  = (uint16_t)(((d >> 3) << 4) | (d & 7));   // Бит 3 дробной части равен 0
+    } else {
+        usart->CR1 &= ~USART_CR1_OVER8;
+        usart->BRR  = (uint16_t)d;
+    }
+    usart->CR1 |= ue;
+
+    error = (int32_t)(((int64_t)(pclk / d) - baud) * 10000 / baud);
+
+    if (res) {
+        res->pclk  = pclk;
+        res->baud  = pclk / d;
+        res->error = (int16_t)error;
+        res->brr   = (uint16_t)usart->BRR;
+        res->over8 = over8;
+    }
+
+    return error <= USART_BAUD_ERR_MAX && error >= -USART_BAUD_ERR_MAX;
+}
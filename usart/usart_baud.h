@@ -0,0 +1,40 @@
+/**
+-------------------------------------------------------------------------------------------------------------------------------------------------------
+
+ * @file        : usart_baud.h
+ * @brief       : Расчёт USARTx->BRR по фактической частоте шины APB и выбор передискретизации (OVER8).
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ * @Description : Частота шины определяется по регистрам RCC (источник SYSCLK, PLL, делители AHB/APB), а не по константе:
+ *                USART1/USART6 тактируются от APB2 (84 МГц), остальные - от APB1 (42 МГц).
+ *                Скорость = fPCLK / D, где D = round(fPCLK / baud) - значение BRR в единицах 1/16 (OVER8 = 0)
+ *                или 1/8 (OVER8 = 1) такта. Передискретизация x16 устойчивее к шуму и используется, пока D >= 16;
+ *                выше fPCLK / 16 (5,25 Мбод для USART1) включается OVER8 - до fPCLK / 8 (10,5 Мбод).
+ -------------------------------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#ifndef USART_BAUD_H
+#define USART_BAUD_H
+
+#include <stm32f4xx.h>
+
+#define USART_HSE_HZ       25000000UL // Частота кварцевого резонатора HSE на плате JZ-F407VET6
+#define USART_HSI_HZ       16000000UL // Частота внутреннего генератора HSI
+#define USART_BAUD_ERR_MAX 200        // Наибольшая допустимая ошибка скорости, 0,01 % (приёмник допускает около 3 %)
+
+// Результат настройки скорости
+typedef struct {
+    uint32_t pclk;      // Частота шины APB модуля, Гц
+    uint32_t baud;      // Полученная скорость, бод
+    int16_t  error;     // Ошибка скорости относительно заданной, 0,01 %
+    uint16_t brr;       // Записанное значение BRR
+    uint8_t  over8;     // 1 - передискретизация x8
+} usart_baud_t;
+
+uint32_t usart_pclk(const USART_TypeDef *usart);                             // Частота шины APB модуля, Гц
+uint8_t  usart_set_baud(USART_TypeDef *usart, uint32_t baud, usart_baud_t *res); // Настройка BRR/OVER8, 1 - ошибка допустима
+
+#endif // USART_BAUD_H
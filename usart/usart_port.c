@@ -0,0 +1,494 @@
+/**
+-------------------------------------------------------------------------------------------------------------------------------------------------------
+
+ * @file        : usart_port.c
+ * @brief       : Общий код приёма и передачи USART1..USART6 через DMA по описанию порта.
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ * @Description : - Потоки DMA выдаёт dma_mgr_claim() (dma/dma_mgr.c), их прерывания приходят в usart_port_dma_rx_irq()
+ *                  и usart_port_dma_tx_irq() с уже сброшенными флагами. Если поток занят другим драйвером,
+ *                  usart_port_init() возвращает 0, а направление не обслуживается (как DMA_REQ_NONE).
+ *                - Позиция записи DMA приёма - rx_size - NDTR. usart_port_rx_update() переводит её в счётчик rx_head;
+ *                  прерывания HT/TC гарантируют обновление не реже чем через половину буфера.
+ *                - Управление потоком приёма: запросы DMA отключаются (DMAR = 0), когда непрочитанных байт больше
+ *                  USART_PORT_RX_STOP. Проверка выполняется при каждом обновлении rx_head, а HT/TC - не реже чем через
+ *                  rx_size / 2 байт, поэтому до перезаписи непрочитанных данных остаётся не меньше rx_size / 8 байт
+ *                  (запас на задержку прерывания). После остановки модуль принимает один байт в DR и снимает RTS.
+ *                  Прерывание IDLE на время остановки отключается: сбросить IDLE можно только чтением DR, а оно
+ *                  забрало бы байт, ожидающий DMA.
+ *                - Поток приёма запускается dma_mgr_start(): после ошибки, остановившей поток, dma_mgr.c включает его
+ *                  снова с начала буфера. Позиция записи на момент ошибки неизвестна, поэтому непрочитанные байты
+ *                  отбрасываются (stats.rx_lost), rx_head переходит к началу следующего круга буфера. После
+ *                  USART_PORT_REARM_MAX ошибок подряд поток перезапускает usart_port_read().
+ *                - Прерывания модуля и обоих потоков порта имеют один приоритет (cfg->prio) и не вытесняют друг друга;
+ *                  usart_port_read()/usart_port_write() из основного цикла или других прерываний изменяют состояние
+ *                  при запрещённых прерываниях.
+ -------------------------------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#include "usart_port.h"
+
+// Пороги управления потоком приёма, байт
+#define USART_PORT_RX_STOP(size)   ((size) * 3 / 8) // Остановка приёма: непрочитанных байт больше
+#define USART_PORT_RX_RESUME(size) ((size) / 4)     // Возобновление: непрочитанных байт не больше
+
+// Модуль: прерывание и бит тактирования
+typedef struct {
+    USART_TypeDef     *usart;
+    IRQn_Type          irq;
+    volatile uint32_t *rcc;
+    uint32_t           en;
+} usart_port_hw_t;
+
+static const usart_port_hw_t usart_port_hw[USART_PORT_COUNT] = {
+    { USART1, USART1_IRQn, &RCC->APB2ENR, RCC_APB2ENR_USART1EN },
+    { USART2, USART2_IRQn, &RCC->APB1ENR, RCC_APB1ENR_USART2EN },
+    { USART3, USART3_IRQn, &RCC->APB1ENR, RCC_APB1ENR_USART3EN },
+    { UART4,  UART4_IRQn,  &RCC->APB1ENR, RCC_APB1ENR_UART4EN  },
+    { UART5,  UART5_IRQn,  &RCC->APB1ENR, RCC_APB1ENR_UART5EN  },
+    { USART6, USART6_IRQn, &RCC->APB2ENR, RCC_APB2ENR_USART6EN },
+};
+
+static const usart_port_hw_t *usart_port_find(const USART_TypeDef *usart) {
+    for (uint8_t i = 0; i < USART_PORT_COUNT; i++) {
+        if (usart_port_hw[i].usart == usart) return &usart_port_hw[i];
+    }
+    return 0;
+}
+
+/* ---------------------------------------- Потоки DMA ---------------------------------------- */
+
+static void usart_port_dma_rx_irq(void *ctx, uint32_t flags);
+static void usart_port_dma_tx_irq(void *ctx, uint32_t flags);
+
+/**
+ * @brief Получение потока у dma_mgr.c и запись CR, PAR (поток не включается).
+ *
+ * @return DMA_Stream_TypeDef* Поток или 0 - запрос не задан или все его потоки заняты.
+ */
+static DMA_Stream_TypeDef *usart_port_dma_setup(usart_port_t *port, dma_req_t req, dma_mgr_cb_t cb, uint32_t cr) {
+    DMA_Stream_TypeDef *s;
+    uint8_t             ch;
+
+    if (req == DMA_REQ_NONE) return 0;
+    s = dma_mgr_claim(req, &ch, cb, port, port->cfg->prio);
+    if (!s) return 0;
+
+    s->CR  = ((uint32_t)ch << DMA_SxCR_CHSEL_Pos) | cr;
+    s->FCR = 0;                                                   // Прямой режим (байт -> байт)
+    s->PAR = (uint32_t)&port->cfg->usart->DR;
+    return s;
+}
+
+/* ---------------------------------------- Настройка ---------------------------------------- */
+
+/**
+ * @brief Альтернативная функция вывода (AFR записывается до MODER - без кратковременного выхода GPIO).
+ */
+static void usart_port_pin(GPIO_TypeDef *gpio, uint8_t pin, uint8_t af, uint32_t pull) {
+    RCC->AHB1ENR |= 1UL << (((uint32_t)gpio - AHB1PERIPH_BASE) / 0x400);  // GPIOA..GPIOI - шаг 0x400
+
+    gpio->AFR[pin >> 3] = (gpio->AFR[pin >> 3] & ~(0xFUL << (4 * (pin & 7)))) | ((uint32_t)af << (4 * (pin & 7)));
+    gpio->OSPEEDR       = (gpio->OSPEEDR & ~(3UL << (2 * pin))) | (2UL << (2 * pin));   // High speed (до 10,5 Мбод)
+    gpio->PUPDR         = (gpio->PUPDR & ~(3UL << (2 * pin))) | (pull << (2 * pin));
+    gpio->MODER         = (gpio->MODER & ~(3UL << (2 * pin))) | (2UL << (2 * pin));
+}
+
+/**
+ * @brief Тактирование модуля, выводы TX/RX (и RTS/CTS), скорость и формат 8N1 (модуль остаётся выключенным, UE = 0).
+ *
+ * Используется usart_port_init() и проектами со своим кодом приёма и передачи (usart/main.c).
+ *
+ * @param cfg  Описание порта.
+ * @param baud Полученная скорость (может быть 0).
+ * @return uint8_t 1 - скорость установлена с допустимой ошибкой (usart_set_baud()).
+ */
+uint8_t usart_port_hw_init(const usart_port_cfg_t *cfg, usart_baud_t *baud) {
+    const usart_port_hw_t *hw    = usart_port_find(cfg->usart);
+    USART_TypeDef         *usart = cfg->usart;
+
+    if (!hw) return 0;
+    *hw->rcc |= hw->en;
+
+    usart_port_pin(cfg->tx_port, cfg->tx_pin, cfg->af, 0);
+    usart_port_pin(cfg->rx_port, cfg->rx_pin, cfg->af, 1);          // Подтяжка RX к 1 - линия в покое без помех
+
+    usart->CR1 = 0;                                                  // 8 бит, без контроля чётности, UE = 0
+    usart->CR2 = 0;                                                  // 1 стоповый бит
+    usart->CR3 = 0;
+
+    if (cfg->rts_port) {                                             // RTS = 0, пока DR свободен
+        usart_port_pin(cfg->rts_port, cfg->rts_pin, cfg->af, 0);
+        usart->CR3 |= USART_CR3_RTSE;
+    }
+    if (cfg->cts_port) {                                             // Передача каждого байта - при CTS = 0
+        usart_port_pin(cfg->cts_port, cfg->cts_pin, cfg->af, 1);     // Подтяжка к 1 - приёмник не подключён
+        usart->CR3 |= USART_CR3_CTSE;
+    }
+
+    return usart_set_baud(usart, cfg->baud, baud);
+}
+
+/**
+ * @brief Настройка порта: модуль, DMA приёма в циклическом режиме, DMA передачи, прерывания.
+ *
+ * @param port Состояние порта.
+ * @param cfg  Описание порта.
+ * @return uint8_t 1 - скорость установлена с допустимой ошибкой и потоки DMA получены.
+ */
+uint8_t usart_port_init(usart_port_t *port, const usart_port_cfg_t *cfg) {
+    const usart_port_hw_t *hw    = usart_port_find(cfg->usart);
+    USART_TypeDef         *usart = cfg->usart;
+    uint8_t                ok;
+
+    if (!hw) return 0;
+
+    port->cfg     = cfg;
+    port->rx_head = port->rx_tail = port->rx_pos = 0;
+    port->tx_head = port->tx_tail = port->tx_len = 0;
+    port->rx_hold = 0;
+    port->stats   = (usart_port_stats_t){ 0 };
+
+    ok = usart_port_hw_init(cfg, &port->baud);
+
+    // Периферия -> память, инкремент адреса памяти, циклический режим, прерывания HT, TC и ошибок
+    port->rx_dma = usart_port_dma_setup(port, cfg->rx_req, usart_port_dma_rx_irq, DMA_SxCR_MINC | DMA_SxCR_CIRC |
+                                        DMA_SxCR_PL_1 | DMA_SxCR_HTIE | DMA_SxCR_TCIE | DMA_SxCR_TEIE | DMA_SxCR_DMEIE);
+    // Память -> периферия, инкремент адреса памяти, прерывания TC и ошибок (поток включается usart_port_tx_start())
+    port->tx_dma = usart_port_dma_setup(port, cfg->tx_req, usart_port_dma_tx_irq, DMA_SxCR_DIR_0 | DMA_SxCR_MINC |
+                                        DMA_SxCR_PL_0 | DMA_SxCR_TCIE | DMA_SxCR_TEIE | DMA_SxCR_DMEIE);
+    if ((cfg->rx_req && !port->rx_dma) || (cfg->tx_req && !port->tx_dma)) ok = 0;
+
+    if (port->rx_dma) {
+        port->rx_dma->NDTR = cfg->rx_size;
+        port->rx_dma->M0AR = (uint32_t)cfg->rx_buf;
+        dma_mgr_start(port->rx_dma, USART_PORT_REARM_MAX);
+
+        usart->CR3 |= USART_CR3_DMAR | USART_CR3_EIE;               // Запросы по RXNE, прерывание ORE/FE/NE
+        usart->CR1 |= USART_CR1_RE | USART_CR1_IDLEIE | USART_CR1_PEIE;
+    }
+
+    port->tx_sg = 0;
+    if (port->tx_dma) {
+        dma_chain_init(&port->tx_chain, port->tx_dma);
+        usart->CR3 |= USART_CR3_DMAT;
+    }
+    usart->CR1 |= USART_CR1_TE;
+
+    NVIC_SetPriority(hw->irq, cfg->prio);
+    NVIC_EnableIRQ(hw->irq);
+
+    usart->CR1 |= USART_CR1_UE;
+
+    return ok;
+}
+
+/* ---------------------------------------- Передача ---------------------------------------- */
+
+/**
+ * @brief Запуск DMA для непрерывного участка буфера передачи или ожидающей цепочки (при запрещённых прерываниях
+ *        или из прерывания TC).
+ */
+static void usart_port_tx_start(usart_port_t *port) {
+    const usart_port_cfg_t *cfg  = port->cfg;
+    uint32_t                tail = port->tx_tail;
+    uint32_t                off  = tail & (cfg->tx_size - 1);
+    uint32_t                n    = port->tx_head - tail;
+
+    if (dma_chain_busy(&port->tx_chain)) return;
+    if (port->tx_sg) {
+        if (tail == port->tx_sg_at) {                              // Байты, поставленные до цепочки, переданы
+            dma_chain_start(&port->tx_chain, port->tx_sg);
+            port->tx_sg = 0;
+            return;
+        }
+        n = port->tx_sg_at - tail;                                 // Участок не заходит за цепочку
+    }
+
+    if (!n) return;
+    if (n > cfg->tx_size - off) n = cfg->tx_size - off;            // До конца буфера
+
+    port->tx_len = (uint16_t)n;
+    dma_mgr_clear(port->tx_dma, DMA_MGR_ALL);
+    port->tx_dma->M0AR = (uint32_t)&cfg->tx_buf[off];
+    port->tx_dma->NDTR = n;
+    port->tx_dma->CR  |= DMA_SxCR_EN;                              // Первый запрос - TXE = 1
+}
+
+/**
+ * @brief Постановка сообщения в буфер передачи.
+ *
+ * Сообщение записывается целиком или отбрасывается (stats.tx_dropped). Функцию можно вызывать из любого контекста.
+ *
+ * @return uint16_t len - сообщение поставлено, 0 - не хватило места или передача не обслуживается драйвером.
+ */
+uint16_t usart_port_write(usart_port_t *port, const void *data, uint16_t len) {
+    const usart_port_cfg_t *cfg  = port->cfg;
+    const uint8_t          *src  = (const uint8_t *)data;
+    uint32_t                mask = cfg->tx_size - 1, primask = __get_PRIMASK(), head;
+
+    if (!port->tx_dma || !len) return 0;
+
+    __disable_irq();
+    head = port->tx_head;
+    if (len > cfg->tx_size - (head - port->tx_tail)) {
+        port->stats.tx_dropped++;
+        __set_PRIMASK(primask);
+        return 0;
+    }
+
+    for (uint16_t i = 0; i < len; i++) cfg->tx_buf[(head + i) & mask] = src[i];
+    port->tx_head = head + len;
+    if (!port->tx_len) usart_port_tx_start(port);
+    __set_PRIMASK(primask);
+
+    return len;
+}
+
+/**
+ * @brief Постановка цепочки сегментов (пакета из нескольких буферов) в очередь передачи.
+ *
+ * Цепочка передаётся после байт, уже поставленных usart_port_write(), и до байт, поставленных позже. Одновременно
+ * ожидает или передаётся одна цепочка. Функцию можно вызывать из любого контекста.
+ *
+ * @param port Порт.
+ * @param seg  Первый сегмент (адрес, длина в байтах, next). Буферы вне CCM RAM, без изменений до окончания передачи.
+ * @return uint8_t 1 - цепочка поставлена, 0 - предыдущая цепочка не передана, пустой сегмент или передача
+ *                 не обслуживается драйвером.
+ */
+uint8_t usart_port_write_sg(usart_port_t *port, const dma_seg_t *seg) {
+    uint32_t primask = __get_PRIMASK(), len = 0;
+
+    if (!port->tx_dma || !seg) return 0;
+    for (const dma_seg_t *p = seg; p; p = p->next) {
+        if (!p->len) return 0;
+        len += p->len;
+    }
+
+    __disable_irq();
+    if (port->tx_sg || dma_chain_busy(&port->tx_chain)) {
+        __set_PRIMASK(primask);
+        return 0;
+    }
+    port->tx_sg     = seg;
+    port->tx_sg_at  = port->tx_head;
+    port->tx_sg_len = len;
+    if (!port->tx_len) usart_port_tx_start(port);
+    __set_PRIMASK(primask);
+
+    return 1;
+}
+
+/**
+ * @brief Проверка цепочки: 1 - ожидает или передаётся, её буферы изменять нельзя.
+ */
+uint8_t usart_port_sg_busy(const usart_port_t *port) {
+    return port->tx_sg || dma_chain_busy(&port->tx_chain);
+}
+
+/**
+ * @brief Проверка окончания передачи: буфер пуст, DMA свободен, последний байт передан (TC = 1).
+ */
+uint8_t usart_port_tx_idle(const usart_port_t *port) {
+    return port->tx_head == port->tx_tail && !port->tx_len && !usart_port_sg_busy(port) &&
+           (port->cfg->usart->SR & USART_SR_TC);
+}
+
+/**
+ * @brief Обработка прерывания потока DMA передачи: участок передан - запуск следующего.
+ *
+ * Во время цепочки следующий сегмент запускает dma_chain_irq() в начале прерывания, до остальной обработки.
+ * При ошибке потока (TE) участок или остаток цепочки считается переданным и пропускается: передача продолжается
+ * со следующего.
+ */
+static void usart_port_dma_tx_irq(void *ctx, uint32_t flags) {
+    usart_port_t *port = (usart_port_t *)ctx;
+    uint32_t      primask;
+    uint8_t       r;
+
+    if (dma_chain_busy(&port->tx_chain)) {
+        r = dma_chain_irq(&port->tx_chain, flags);
+        if (flags & DMA_MGR_ERR) port->stats.dma_errors++;
+        if (r == DMA_CHAIN_BUSY) return;
+        if (r == DMA_CHAIN_DONE) port->stats.tx_bytes += port->tx_sg_len;
+
+        primask = __get_PRIMASK();
+        __disable_irq();
+        usart_port_tx_start(port);                                 // Байты, поставленные после цепочки
+        __set_PRIMASK(primask);
+        return;
+    }
+
+    if (flags & DMA_MGR_ERR) port->stats.dma_errors++;           // Те же биты, что при приёме
+    if (!(flags & (DMA_MGR_TC | DMA_MGR_TE))) return;
+
+    primask = __get_PRIMASK();
+    __disable_irq();                                               // usart_port_write() из прерывания с большим приоритетом
+    if (flags & DMA_MGR_TC) port->stats.tx_bytes += port->tx_len;
+    port->tx_tail += port->tx_len;
+    port->tx_len   = 0;
+    usart_port_tx_start(port);
+    __set_PRIMASK(primask);
+}
+
+/* ---------------------------------------- Приём ---------------------------------------- */
+
+/**
+ * @brief Остановка и возобновление приёма по заполнению буфера (только при управлении потоком RTS).
+ */
+static void usart_port_rx_flow(usart_port_t *port) {
+    const usart_port_cfg_t *cfg = port->cfg;
+    uint32_t                n   = port->rx_head - port->rx_tail;
+
+    if (!cfg->rts_port) return;
+
+    if (!port->rx_hold && n > USART_PORT_RX_STOP(cfg->rx_size)) {
+        cfg->usart->CR3 &= ~USART_CR3_DMAR;                        // Следующий байт остаётся в DR - RTS = 1
+        cfg->usart->CR1 &= ~USART_CR1_IDLEIE;
+        port->rx_hold = 1;
+        port->stats.rx_pauses++;
+    } else if (port->rx_hold && n <= USART_PORT_RX_RESUME(cfg->rx_size)) {
+        port->rx_hold = 0;
+        cfg->usart->CR3 |= USART_CR3_DMAR;                         // Запрос по RXNE = 1 обслуживается сразу
+        cfg->usart->CR1 |= USART_CR1_IDLEIE;
+    }
+}
+
+/**
+ * @brief Перевод позиции DMA приёма в счётчик rx_head.
+ */
+static void usart_port_rx_update(usart_port_t *port) {
+    uint16_t size = port->cfg->rx_size;
+    uint16_t pos  = size - (uint16_t)port->rx_dma->NDTR;
+    uint16_t delta;
+
+    if (pos >= size) pos = 0;                                      // NDTR = 0 перед перезагрузкой циклического режима
+    delta = (pos >= port->rx_pos) ? pos - port->rx_pos : size - port->rx_pos + pos;
+
+    port->rx_pos          = pos;
+    port->rx_head        += delta;
+    port->stats.rx_bytes += delta;
+
+    usart_port_rx_flow(port);
+}
+
+/**
+ * @brief Согласование счётчиков с потоком приёма, перезапущенным с начала буфера.
+ */
+static void usart_port_rx_restart(usart_port_t *port) {
+    uint16_t size = port->cfg->rx_size;
+
+    port->stats.rx_rearms++;
+    port->stats.rx_lost += port->rx_head - port->rx_tail;
+    port->rx_head       += (uint16_t)(size - port->rx_pos) % size; // Индекс rx_head % rx_size = 0
+    port->rx_tail        = port->rx_head;
+    port->rx_pos         = 0;
+    usart_port_rx_flow(port);                                      // Буфер пуст - возобновление приёма
+}
+
+/**
+ * @brief Количество непрочитанных байт (не больше размера буфера).
+ */
+uint16_t usart_port_rx_count(usart_port_t *port) {
+    uint32_t primask = __get_PRIMASK(), n;
+
+    if (!port->rx_dma) return 0;
+
+    __disable_irq();
+    usart_port_rx_update(port);
+    n = port->rx_head - port->rx_tail;
+    __set_PRIMASK(primask);
+
+    return (uint16_t)(n > port->cfg->rx_size ? port->cfg->rx_size : n);
+}
+
+/**
+ * @brief Чтение принятых байт.
+ *
+ * Если DMA перезаписал непрочитанные данные, сохранившиеся rx_size байт читаются, остальные считаются в stats.rx_lost.
+ *
+ * @param port Порт.
+ * @param data Буфер.
+ * @param max  Размер буфера.
+ * @return uint16_t Прочитано байт.
+ */
+uint16_t usart_port_read(usart_port_t *port, void *data, uint16_t max) {
+    const usart_port_cfg_t *cfg = port->cfg;
+    uint8_t                *dst = (uint8_t *)data;
+    uint32_t                primask = __get_PRIMASK(), head, tail, n, off;
+
+    if (!port->rx_dma) return 0;
+
+    __disable_irq();
+    if (!(port->rx_dma->CR & DMA_SxCR_EN) && dma_mgr_rearm(port->rx_dma)) usart_port_rx_restart(port); // DMA_MGR_FAIL
+    usart_port_rx_update(port);
+    head = port->rx_head;
+    tail = port->rx_tail;
+    if (head - tail > cfg->rx_size) {
+        port->stats.rx_lost += head - tail - cfg->rx_size;
+        tail = head - cfg->rx_size;
+    }
+    __set_PRIMASK(primask);
+
+    n   = head - tail;
+    if (n > max) n = max;
+    off = tail % cfg->rx_size;
+    for (uint32_t i = 0; i < n; i++) {
+        dst[i] = cfg->rx_buf[off];
+        if (++off == cfg->rx_size) off = 0;
+    }
+    __disable_irq();
+    port->rx_tail = tail + n;
+    usart_port_rx_flow(port);                                      // Возобновление приёма после остановки
+    __set_PRIMASK(primask);
+
+    return (uint16_t)n;
+}
+
+/**
+ * @brief Обработка прерывания модуля: пауза на линии (IDLE) и ошибки ORE, FE, NE, PE.
+ *
+ * Флаги сбрасываются чтением SR, затем DR. Пока RXNE = 1 и поток DMA работает, DR не читается: байт забирает DMA,
+ * флаги сбрасываются при следующем входе в прерывание. При FE/NE/PE байт в DR повреждён, при ORE следующий байт
+ * потерян, поэтому чтение DR в обход DMA (в том числе при остановке приёма) допустимо.
+ */
+void usart_port_irq(usart_port_t *port) {
+    const usart_port_cfg_t *cfg = port->cfg;
+    uint32_t                sr  = cfg->usart->SR;
+
+    if (!(sr & (USART_SR_IDLE | USART_SR_ORE | USART_SR_FE | USART_SR_NE | USART_SR_PE))) return;
+    if ((sr & USART_SR_RXNE) && (cfg->usart->CR3 & USART_CR3_DMAR) && port->rx_dma && (port->rx_dma->CR & DMA_SxCR_EN)) return;
+
+    if (sr & USART_SR_ORE) port->stats.ore++;
+    if (sr & USART_SR_FE)  port->stats.fe++;
+    if (sr & USART_SR_NE)  port->stats.ne++;
+    if (sr & USART_SR_PE)  port->stats.pe++;
+    (void)cfg->usart->DR;
+
+    if ((sr & USART_SR_IDLE) && port->rx_dma) {
+        port->stats.rx_idle++;
+        usart_port_rx_update(port);
+        if (cfg->rx_cb) cfg->rx_cb(port, 1);
+    }
+}
+
+/**
+ * @brief Обработка прерывания потока DMA приёма: заполнена половина или весь буфер, поток перезапущен после ошибки.
+ */
+static void usart_port_dma_rx_irq(void *ctx, uint32_t flags) {
+    usart_port_t *port = (usart_port_t *)ctx;
+
+    if (flags & DMA_MGR_ERR) port->stats.dma_errors++;
+    if (flags & DMA_MGR_REARM) {
+        usart_port_rx_restart(port);
+        return;
+    }
+
+    if (flags & (DMA_MGR_HT | DMA_MGR_TC)) {
+        usart_port_rx_update(port);
+        if (port->cfg->rx_cb) port->cfg->rx_cb(port, 0);
+    }
+}
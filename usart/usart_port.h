@@ -0,0 +1,139 @@
+/**
+-------------------------------------------------------------------------------------------------------------------------------------------------------
+
+ * @file        : usart_port.h
+ * @brief       : Драйвер USART1..USART6 по таблице описаний: выводы, DMA приёма и передачи, скорость, буферы.
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ * @Description : Каждый порт задаётся описанием usart_port_cfg_t (константа во flash), состояние - usart_port_t.
+ *                Все шесть модулей обслуживаются одним кодом: номер модуля, прерывание NVIC, бит тактирования RCC,
+ *                регистры флагов и прерывания потоков DMA определяются по адресам из описания.
+ *                - Приём: DMA в циклическом режиме в rx_buf, прерывания HT/TC потока и IDLE модуля. Принятые байты
+ *                  читаются usart_port_read(); rx_cb (если задана) вызывается из прерывания при появлении данных.
+ *                  Если данные не прочитаны до перезаписи DMA, старые байты отбрасываются (stats.rx_lost).
+ *                - Передача: кольцевой буфер tx_buf, usart_port_write() ставит сообщение целиком или отбрасывает его
+ *                  (stats.tx_dropped); DMA передаёт непрерывный участок буфера, следующий запускается из прерывания TC.
+ *                  usart_port_write_sg() передаёт пакет из нескольких буферов (заголовок, данные, CRC) цепочкой
+ *                  dma_seg_t без копирования в tx_buf (dma/dma_chain.c): цепочка занимает место в очереди после уже
+ *                  поставленных в буфер байт, буферы сегментов не изменяются до usart_port_sg_busy() = 0.
+ *                - Ошибки линии ORE, FE, NE, PE считаются в stats (прерывание EIE/PEIE модуля).
+ *                - Управление потоком RTS/CTS (UART_FC_*): CTS приостанавливает передачу модулем, пока приёмник не готов.
+ *                  Если непрочитанных байт в rx_buf больше порога (3/8 буфера), запросы DMA приёма отключаются:
+ *                  байт остаётся в DR, модуль снимает RTS и передатчик с другой стороны останавливается без потерь.
+ *                  usart_port_read() возобновляет приём, когда в буфере остаётся не больше 1/4 (stats.rx_pauses).
+ *                Потоки DMA выдаёт dma_mgr_claim() по запросам rx_req/tx_req, их прерывания вызывают обработчики
+ *                драйвера через dma_mgr.c. DMA_REQ_NONE в описании: направление не обслуживается драйвером (например,
+ *                передачу выполняет usart_stream.c). Обработчик прерывания модуля пишет приложение: USARTx_IRQHandler()
+ *                вызывает usart_port_irq(). UART_HW_* - выводы и запросы DMA модулей на плате JZ-F407VET6.
+ -------------------------------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#ifndef USART_PORT_H
+#define USART_PORT_H
+
+#include <stm32f4xx.h>
+#include "usart_baud.h"
+#include "dma_mgr.h"
+#include "dma_chain.h"
+
+#define USART_PORT_COUNT 6 // Модулей USART/UART в STM32F407
+#define USART_PORT_REARM_MAX 4 // Перезапусков потока приёма подряд в прерывании (дальше - из usart_port_read())
+
+// Размещение буфера DMA в SRAM1 без инициализации: область DATA_RAM (STM32F4xx_Flash_CCM.icf) включает CCM RAM,
+// недоступную DMA
+#define USART_DMA_BUF __attribute__((section(".RAM1.non_init"), aligned(4)))
+
+// Аппаратная часть описания: модуль, TX, RX, AF, запрос DMA приёма, запрос DMA передачи
+#define UART_HW_USART1 USART1, GPIOA,  9, GPIOA, 10, 7, DMA_REQ_USART1_RX, DMA_REQ_USART1_TX
+#define UART_HW_USART2 USART2, GPIOA,  2, GPIOA,  3, 7, DMA_REQ_USART2_RX, DMA_REQ_USART2_TX
+#define UART_HW_USART3 USART3, GPIOB, 10, GPIOB, 11, 7, DMA_REQ_USART3_RX, DMA_REQ_USART3_TX
+#define UART_HW_UART4  UART4,  GPIOC, 10, GPIOC, 11, 8, DMA_REQ_UART4_RX,  DMA_REQ_UART4_TX
+#define UART_HW_UART5  UART5,  GPIOC, 12, GPIOD,  2, 8, DMA_REQ_UART5_RX,  DMA_REQ_UART5_TX
+#define UART_HW_USART6 USART6, GPIOC,  6, GPIOC,  7, 8, DMA_REQ_USART6_RX, DMA_REQ_USART6_TX
+
+// Аппаратное управление потоком: вывод RTS, вывод CTS (AF модуля). Выводы RTS/CTS USART6 (PG8/PG12, PG13/PG15)
+// в корпусе LQFP100 отсутствуют, UART4/UART5 управления потоком не имеют
+#define UART_FC_NONE   0, 0, 0, 0
+#define UART_FC_USART1 GPIOA, 12, GPIOA, 11
+#define UART_FC_USART2 GPIOD,  4, GPIOD,  3 // PA1/PA0 заняты: PA0 - кнопка K_UP
+#define UART_FC_USART3 GPIOB, 14, GPIOB, 13
+
+typedef struct usart_port usart_port_t;
+
+// Уведомление о принятых данных (из прерывания): idle = 1 - пауза на линии после данных
+typedef void (*usart_port_cb_t)(usart_port_t *port, uint8_t idle);
+
+// Описание порта
+typedef struct {
+    USART_TypeDef      *usart;    // Модуль USART1..USART6
+    GPIO_TypeDef       *tx_port;  // Вывод TX
+    uint8_t             tx_pin;
+    GPIO_TypeDef       *rx_port;  // Вывод RX
+    uint8_t             rx_pin;
+    uint8_t             af;       // Альтернативная функция выводов (7 - USART1..3, 8 - UART4..USART6)
+    dma_req_t           rx_req;   // Запрос DMA приёма (DMA_REQ_NONE - приём не используется)
+    dma_req_t           tx_req;   // Запрос DMA передачи (DMA_REQ_NONE - передача не обслуживается драйвером)
+    uint32_t            baud;     // Скорость, бод
+    uint8_t            *rx_buf;   // Буфер приёма (USART_DMA_BUF)
+    uint16_t            rx_size;  // Размер, байт (чётный)
+    uint8_t            *tx_buf;   // Буфер передачи (USART_DMA_BUF)
+    uint16_t            tx_size;  // Размер, байт (степень двойки)
+    uint8_t             prio;     // Приоритет прерываний модуля и потоков DMA
+    usart_port_cb_t     rx_cb;    // Уведомление о принятых данных (0 - только usart_port_read())
+    GPIO_TypeDef       *rts_port; // Вывод RTS (0 - без управления потоком приёма)
+    uint8_t             rts_pin;
+    GPIO_TypeDef       *cts_port; // Вывод CTS (0 - передача без ожидания готовности приёмника)
+    uint8_t             cts_pin;
+} usart_port_cfg_t;
+
+// Статистика порта
+typedef struct {
+    uint32_t rx_bytes;   // Принято байт
+    uint32_t tx_bytes;   // Передано байт
+    uint32_t rx_idle;    // Пауз на линии после данных (кадров)
+    uint32_t rx_lost;    // Байт перезаписано DMA до чтения или отброшено при перезапуске потока
+    uint32_t tx_dropped; // Отброшено сообщений (буфер передачи заполнен)
+    uint32_t ore;        // Ошибок переполнения (байт не забран из DR)
+    uint32_t fe;         // Ошибок кадра (нет стоп-бита)
+    uint32_t ne;         // Шумов на линии
+    uint32_t pe;         // Ошибок чётности
+    uint32_t dma_errors; // Ошибок потоков DMA приёма и передачи (DMA_MGR_ERR; FE прямого режима dma_mgr.c не передаёт)
+    uint32_t rx_rearms;  // Перезапусков потока приёма после ошибки
+    uint32_t rx_pauses;  // Остановок приёма по заполнению буфера (RTS = 1)
+} usart_port_stats_t;
+
+// Состояние порта
+struct usart_port {
+    const usart_port_cfg_t *cfg;
+    DMA_Stream_TypeDef     *rx_dma;  // Поток DMA приёма (0 - приём не используется)
+    DMA_Stream_TypeDef     *tx_dma;  // Поток DMA передачи (0 - передача не обслуживается драйвером)
+    usart_baud_t            baud;    // Полученная скорость
+    usart_port_stats_t      stats;
+    volatile uint32_t       rx_head; // Счётчик принятых байт (позиция DMA)
+    volatile uint32_t       rx_tail; // Счётчик прочитанных байт
+    uint16_t                rx_pos;  // Позиция DMA при последнем обновлении
+    volatile uint32_t       tx_head; // Счётчик поставленных байт
+    volatile uint32_t       tx_tail; // Счётчик переданных байт
+    volatile uint16_t       tx_len;  // Байт в текущей передаче DMA (0 - поток свободен)
+    volatile uint8_t        rx_hold; // 1 - приём остановлен (DMAR = 0), RTS снят до чтения буфера
+    dma_chain_t             tx_chain;  // Цепочка сегментов на потоке передачи (stats - паузы между сегментами)
+    const dma_seg_t *volatile tx_sg;   // Цепочка, ожидающая передачи байт буфера до tx_sg_at (0 - нет)
+    uint32_t                tx_sg_at;  // tx_head при постановке цепочки
+    uint32_t                tx_sg_len; // Байт в цепочке
+};
+
+uint8_t  usart_port_hw_init(const usart_port_cfg_t *cfg, usart_baud_t *baud); // Тактирование, выводы, скорость, 8N1
+uint8_t  usart_port_init(usart_port_t *port, const usart_port_cfg_t *cfg);    // Полная настройка, 1 - скорость допустима, потоки DMA выданы
+uint16_t usart_port_write(usart_port_t *port, const void *data, uint16_t len); // Постановка в буфер, возврат - len или 0
+uint8_t  usart_port_write_sg(usart_port_t *port, const dma_seg_t *seg);       // Постановка цепочки, 1 - принята
+uint8_t  usart_port_sg_busy(const usart_port_t *port);                        // 1 - цепочка ожидает или передаётся
+uint16_t usart_port_read(usart_port_t *port, void *data, uint16_t max);       // Чтение принятых байт, возврат - количество
+uint16_t usart_port_rx_count(usart_port_t *port);                             // Байт в буфере приёма
+uint8_t  usart_port_tx_idle(const usart_port_t *port);                        // 1 - буфер передачи пуст, линия свободна
+
+void usart_port_irq(usart_port_t *port); // Из USARTx_IRQHandler()
+
+#endif // USART_PORT_H
@@ -0,0 +1,129 @@
+/**
+-------------------------------------------------------------------------------------------------------------------------------------------------------
+
+ * @file        : usart_rx.c
+ * @brief       : Приём USART1 через DMA2 Stream2 в кольцевой буфер с выделением кадров по паузе на линии (IDLE).
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ * @Description : Позиция записи DMA в буфере - USART_RX_SIZE - NDTR. usart_rx_process() передаёт callback-функции
+ *                участок от предыдущей обработанной позиции (usart_rx_pos) до текущей. Функция вызывается из обработчиков
+ *                USART1 и потока DMA приёма (dma_mgr.c) с одинаковым приоритетом, поэтому usart_rx_pos изменяется без запрета
+ *                прерываний.
+ *                При NDTR = 0 (кратковременно перед перезагрузкой циклического режима) позиция равна USART_RX_SIZE,
+ *                что соответствует концу буфера.
+ *                Поток запускается dma_mgr_start(): после ошибки DMA он перезапускается с начала буфера, usart_rx_pos = 0.
+ *                Если перезапуски исчерпаны, поток остановлен: байт остаётся в DR, следующая ошибка линии (ORE)
+ *                вызывает usart_rx_irq(), который перезапускает поток.
+ -------------------------------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#include "usart_rx.h"
+#include "usart_port.h"
+
+usart_rx_stats_t usart_rx_stats;
+
+static uint8_t       usart_rx_buf[USART_RX_SIZE] USART_DMA_BUF; // Кольцевой буфер DMA (SRAM1)
+static uint16_t      usart_rx_pos = 0;            // Обработанная позиция в буфере
+static usart_rx_cb_t usart_rx_cb  = 0;            // Получатель участков
+static DMA_Stream_TypeDef *usart_rx_dma = 0;      // Поток приёма (dma_mgr_claim(): DMA2 Stream2 или Stream5)
+
+/**
+ * @brief Передача новых данных callback-функции.
+ *
+ * @param end 1 - пауза на линии: последний участок кадра.
+ */
+static void usart_rx_process(uint8_t end) {
+    uint16_t pos = USART_RX_SIZE - (uint16_t)usart_rx_dma->NDTR;
+
+    usart_rx_stats.irqs++;
+    if (pos == usart_rx_pos) return;              // Нет новых данных (IDLE после HT/TC на границе кадра уже учтён)
+
+    if (pos > usart_rx_pos) {                     // Непрерывный участок
+        usart_rx_stats.bytes += pos - usart_rx_pos;
+        if (usart_rx_cb) usart_rx_cb(&usart_rx_buf[usart_rx_pos], pos - usart_rx_pos, end);
+    } else {                                      // Переход через конец буфера - два участка
+        usart_rx_stats.bytes += USART_RX_SIZE - usart_rx_pos + pos;
+        if (usart_rx_cb) {
+            usart_rx_cb(&usart_rx_buf[usart_rx_pos], USART_RX_SIZE - usart_rx_pos, end && pos == 0);
+            if (pos) usart_rx_cb(usart_rx_buf, pos, end);
+        }
+    }
+    if (end) usart_rx_stats.frames++;
+
+    usart_rx_pos = (pos == USART_RX_SIZE) ? 0 : pos;
+}
+
+static void usart_rx_dma_irq(void *ctx, uint32_t flags);
+
+/**
+ * @brief Настройка приёма: поток DMA запроса USART1_RX в циклическом режиме, прерывания HT/TC и IDLE.
+ *
+ * Вызывается при настройке USART1 до установки бита UE.
+ *
+ * @param cb Callback-функция для участков принятых данных.
+ */
+void usart_rx_init(usart_rx_cb_t cb) {
+    usart_rx_cb  = cb;
+    usart_rx_pos = 0;
+
+    uint8_t ch;
+
+    usart_rx_dma = dma_mgr_claim(DMA_REQ_USART1_RX, &ch, usart_rx_dma_irq, 0, USART_RX_IRQ_PRIO); // Поток остановлен
+    if (!usart_rx_dma) return;                                                        // Потоки USART1_RX заняты
+
+    // Канал 4 (USART1_RX), периферия -> память, инкремент адреса памяти, циклический режим, прерывания HT и TC
+    usart_rx_dma->CR   = ((uint32_t)ch << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_MINC | DMA_SxCR_CIRC | DMA_SxCR_PL_1 |
+                         DMA_SxCR_HTIE | DMA_SxCR_TCIE;
+    usart_rx_dma->NDTR = USART_RX_SIZE;
+    usart_rx_dma->PAR  = (uint32_t)&USART1->DR;
+    usart_rx_dma->M0AR = (uint32_t)usart_rx_buf;
+    dma_mgr_start(usart_rx_dma, USART_RX_REARM_MAX);                                 // Включение, прерывания ошибок
+
+    USART1->CR3 |= USART_CR3_DMAR | USART_CR3_EIE;                                   // Запросы DMA по RXNE, прерывание ORE/FE/NE
+    USART1->CR1 |= USART_CR1_IDLEIE;                                                 // Прерывание по паузе на линии
+
+    NVIC_SetPriority(USART1_IRQn, USART_RX_IRQ_PRIO);
+}
+
+/**
+ * @brief Обработка паузы на линии (флаг IDLE) и ошибок линии ORE, FE, NE.
+ *
+ * Флаги сбрасываются чтением SR, затем DR. Пока RXNE = 1, DR не читается: байт забирает DMA, флаги сбрасываются
+ * при следующем входе в прерывание. Чтение DR при RXNE = 0 не забирает байт у DMA.
+ */
+void usart_rx_irq(void) {
+    uint32_t sr = USART1->SR;
+
+    if (!(sr & (USART_SR_IDLE | USART_SR_ORE | USART_SR_FE | USART_SR_NE)) || !usart_rx_dma) return;
+    if ((sr & USART_SR_RXNE) && (usart_rx_dma->CR & DMA_SxCR_EN)) return;
+
+    if (sr & USART_SR_ORE) usart_rx_stats.ore++;
+    if (sr & USART_SR_FE)  usart_rx_stats.fe++;
+    if (sr & USART_SR_NE)  usart_rx_stats.ne++;
+    (void)USART1->DR;                             // Сброс флагов (последовательность SR -> DR)
+
+    if (!(usart_rx_dma->CR & DMA_SxCR_EN) && dma_mgr_rearm(usart_rx_dma)) { // Поток остановлен ошибками DMA
+        usart_rx_stats.rearms++;
+        usart_rx_pos = 0;
+        return;
+    }
+
+    if (sr & USART_SR_IDLE) usart_rx_process(1);
+}
+
+/**
+ * @brief Прерывание потока приёма (dma_mgr.c, флаги уже сброшены): заполнена половина или весь буфер,
+ *        поток перезапущен после ошибки.
+ */
+static void usart_rx_dma_irq(void *ctx, uint32_t flags) {
+    (void)ctx;
+    if (flags & DMA_MGR_REARM) {
+        usart_rx_stats.rearms++;
+        usart_rx_pos = 0;
+        return;
+    }
+    if (flags & (DMA_MGR_HT | DMA_MGR_TC)) usart_rx_process(0);
+}
@@ -0,0 +1,51 @@
+/**
+-------------------------------------------------------------------------------------------------------------------------------------------------------
+
+ * @file        : usart_rx.h
+ * @brief       : Приём USART1 через DMA2 Stream2 в кольцевой буфер с выделением кадров по паузе на линии (IDLE).
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ * @Description : DMA2 Stream2 (канал 4, USART1_RX) в циклическом режиме записывает принятые байты в кольцевой буфер
+ *                usart_rx_buf без участия ядра. Прерывания возникают только:
+ *                - по паузе на линии после кадра (IDLE, USART1) - конец кадра;
+ *                - по заполнению половины и конца буфера (HT/TC, DMA2 Stream2) - длинный кадр передаётся частями,
+ *                  пока DMA не перезаписал его начало.
+ *                Новые данные передаются callback-функции как участки кольцевого буфера без копирования: непрерывный
+ *                участок [data, data + len), на границе буфера - двумя вызовами. Признак end = 1 - последний участок кадра.
+ *                Callback-функция вызывается из прерывания и должна обработать участок до того, как DMA запишет
+ *                USART_RX_SIZE байт поверх него (при 2 Мбод - 2,5 мс для буфера 512 байт).
+ -------------------------------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#ifndef USART_RX_H
+#define USART_RX_H
+
+#include <stm32f4xx.h>
+
+#define USART_RX_SIZE     512 // Размер кольцевого буфера, байт (чётный - прерывание HT на половине)
+#define USART_RX_IRQ_PRIO 5   // Приоритет прерываний USART1 и DMA2 Stream2 (одинаковый - обработчики не вытесняют друг друга)
+#define USART_RX_REARM_MAX 4  // Перезапусков потока подряд в его прерывании (дальше - по следующей ошибке линии)
+
+// Тип callback-функции: участок кольцевого буфера и признак конца кадра
+typedef void (*usart_rx_cb_t)(const uint8_t *data, uint16_t len, uint8_t end);
+
+// Статистика приёма
+typedef struct {
+    uint32_t bytes;  // Принято байт
+    uint32_t frames; // Принято кадров (пауз на линии после данных)
+    uint32_t irqs;   // Прерываний IDLE/HT/TC
+    uint32_t ore;    // Ошибок переполнения (байт не забран из DR)
+    uint32_t fe;     // Ошибок кадра (нет стоп-бита)
+    uint32_t ne;     // Шумов на линии
+    uint32_t rearms; // Перезапусков потока после ошибки DMA (буфер с начала, необработанные байты потеряны)
+} usart_rx_stats_t;
+
+extern usart_rx_stats_t usart_rx_stats;
+
+void usart_rx_init(usart_rx_cb_t cb); // Настройка DMA2 Stream2 и прерывания IDLE (до включения USART1)
+void usart_rx_irq(void);              // Обработка IDLE и ошибок линии (вызывается из USART1_IRQHandler)
+
+#endif // USART_RX_H
@@ -0,0 +1,121 @@
+/**
+-------------------------------------------------------------------------------------------------------------------------------------------------------
+
+ * @file        : usart_tx.c
+ * @brief       : Кольцевой буфер передачи USART1 с опустошением по прерыванию TXE.
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ * @Description : Буфер без блокировок для одного источника и одного получателя:
+ *                - usart_tx_head изменяет только usart_tx_put() (источник), usart_tx_tail - только usart_tx_irq();
+ *                  индексы свободно растут, позиция в буфере - индекс & (USART_TX_SIZE - 1).
+ *                - Сообщение публикуется увеличением usart_tx_head после копирования (барьер __DMB()),
+ *                  поэтому обработчик TXE не видит недописанных байт.
+ *                - Бит TXEIE изменяется через область bit-band: запись одного бита не требует чтения-изменения-записи
+ *                  USART1->CR1 и не может затереть изменение, сделанное прерыванием.
+ *                Сообщения ставятся из одного контекста. Если источников несколько и их приоритеты различаются,
+ *                вызов usart_tx_put() оборачивается запретом прерываний (proto_cmd_tx()); источник с наивысшим
+ *                приоритетом (обработчик EXTI15_10) вызывает функцию напрямую.
+ *                usart_tx_hold()/usart_tx_release() передают передатчик другому источнику (DMA журнала dlog.c) между
+ *                сообщениями: пока он захвачен, usart_tx_put() только накапливает сообщения.
+ -------------------------------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#include "usart_tx.h"
+
+#define USART_TX_MASK (USART_TX_SIZE - 1)
+
+// Адрес бита TXEIE регистра USART1->CR1 в области bit-band
+#define USART1_TXEIE_BB (*(volatile uint32_t *)(PERIPH_BB_BASE + ((USART1_BASE - PERIPH_BASE) + 0x0C) * 32 + USART_CR1_TXEIE_Pos * 4))
+
+usart_tx_stats_t usart_tx_stats;
+
+static char              usart_tx_buf[USART_TX_SIZE]; // Кольцевой буфер
+static volatile uint32_t usart_tx_head = 0;           // Счётчик записанных байт
+static volatile uint32_t usart_tx_tail = 0;           // Счётчик переданных байт
+static volatile uint8_t  usart_tx_held = 0;           // Передатчик занят другим источником (DMA журнала dlog)
+
+/**
+ * @brief Постановка сообщения в буфер передачи.
+ *
+ * Сообщение записывается целиком или отбрасывается (usart_tx_stats.dropped), если в буфере не хватает места.
+ *
+ * @param data Данные.
+ * @param len  Количество байт.
+ * @return uint8_t 1 - сообщение поставлено, 0 - не хватило места.
+ */
+uint8_t usart_tx_put(const char *data, uint16_t len) {
+    uint32_t head = usart_tx_head;
+    uint32_t used = head - usart_tx_tail;
+
+    if (len > USART_TX_SIZE - used) {
+        usart_tx_stats.dropped++;
+        return 0;
+    }
+
+    for (uint16_t i = 0; i < len; i++) usart_tx_buf[(head + i) & USART_TX_MASK] = data[i];
+
+    __DMB();                          // Данные записаны до публикации индекса
+    usart_tx_head = head + len;
+    if (!usart_tx_held) USART1_TXEIE_BB = 1; // Прерывание по TXE: передача начнётся сразу, если передатчик свободен
+
+    usart_tx_stats.bytes += len;
+    if (used + len > usart_tx_stats.hwm) usart_tx_stats.hwm = (uint16_t)(used + len);
+
+    return 1;
+}
+
+/**
+ * @brief Обработка прерывания TXE: запись следующего байта или запрет прерывания, если буфер пуст.
+ */
+void usart_tx_irq(void) {
+    uint32_t tail;
+
+    if (!(USART1->CR1 & USART_CR1_TXEIE) || !(USART1->SR & USART_SR_TXE)) return;
+
+    tail = usart_tx_tail;
+    if (tail == usart_tx_head || usart_tx_held) {
+        USART1_TXEIE_BB = 0;
+        if (tail != usart_tx_head && !usart_tx_held) USART1_TXEIE_BB = 1; // Сообщение поставлено после проверки
+        return;
+    }
+
+    USART1->DR    = (uint8_t)usart_tx_buf[tail & USART_TX_MASK];
+    usart_tx_tail = tail + 1;
+}
+
+/**
+ * @brief Проверка окончания передачи: буфер пуст и последний кадр передан (флаг TC).
+ */
+uint8_t usart_tx_idle(void) {
+    return usart_tx_head == usart_tx_tail && (USART1->SR & USART_SR_TC);
+}
+
+/**
+ * @brief Захват передатчика другим источником (DMA): буфер перестаёт опустошаться до usart_tx_release().
+ *
+ * Захват выполняется только между сообщениями: если буфер не пуст или последний байт ещё передаётся,
+ * функция возвращает 0 и передатчик остаётся за буфером. Вызывается из основного цикла.
+ *
+ * @return uint8_t 1 - передатчик свободен и захвачен.
+ */
+uint8_t usart_tx_hold(void) {
+    usart_tx_held   = 1;              // Источники больше не разрешают TXE
+    USART1_TXEIE_BB = 0;
+    __DSB();                          // Прерывание, разрешённое до захвата, обработано до проверки
+
+    if (usart_tx_idle()) return 1;
+
+    usart_tx_release();
+    return 0;
+}
+
+/**
+ * @brief Освобождение передатчика: продолжение передачи сообщений, поставленных во время захвата.
+ */
+void usart_tx_release(void) {
+    usart_tx_held = 0;
+    if (usart_tx_head != usart_tx_tail) USART1_TXEIE_BB = 1;
+}
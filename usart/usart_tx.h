@@ -0,0 +1,40 @@
+/**
+-------------------------------------------------------------------------------------------------------------------------------------------------------
+
+ * @file        : usart_tx.h
+ * @brief       : Кольцевой буфер передачи USART1 с опустошением по прерыванию TXE.
+ * @author      : xmatech
+ * @date        : 13.01.2025
+ * @board       : JZ-F407VET6
+ * @MCU         : STM32F407VET6
+ * @IDE         : Segger Embedded Studio
+ * @Description : usart_tx_put() копирует сообщение в кольцевой буфер и разрешает прерывание TXE, не ожидая передатчик:
+ *                время вызова не зависит от скорости линии, функцию можно вызывать из обработчиков прерываний.
+ *                Обработчик USART1_IRQHandler() вызывает usart_tx_irq(), который записывает в USART1->DR по одному
+ *                байту на каждое TXE и запрещает прерывание, когда буфер пуст.
+ -------------------------------------------------------------------------------------------------------------------------------------------------------
+ */
+
+#ifndef USART_TX_H
+#define USART_TX_H
+
+#include <stm32f4xx.h>
+
+#define USART_TX_SIZE 256 // Размер кольцевого буфера, байт (степень двойки)
+
+// Статистика буфера передачи
+typedef struct {
+    uint32_t bytes;   // Принято в буфер байт
+    uint32_t dropped; // Отброшено сообщений (не хватило места)
+    uint16_t hwm;     // Наибольшее заполнение буфера, байт
+} usart_tx_stats_t;
+
+extern usart_tx_stats_t usart_tx_stats;
+
+uint8_t usart_tx_put(const char *data, uint16_t len); // Постановка сообщения в буфер, возврат - 1 при успехе
+void    usart_tx_irq(void);                           // Обработка TXE (вызывается из USART1_IRQHandler)
+uint8_t usart_tx_idle(void);                          // 1 - буфер пуст и последний байт передан (TC = 1)
+uint8_t usart_tx_hold(void);                          // Захват передатчика для DMA (только при пустом буфере)
+void    usart_tx_release(void);                       // Освобождение передатчика
+
+#endif // USART_TX_H